@@ -24,27 +24,43 @@
 
 cvar_t	*cvar_vars;
 
+// Open addressed index of cvar_vars by hashid, so lookups don't walk the
+// whole list.  The table only holds pointers, cvar_t are never moved.
+typedef struct {
+	cvar_t	**slots;
+	int		size;		// power of two
+	int		count;
+} cvarHash_t;
+
+static cvarHash_t	cvar_hash;
+
+#define CVAR_HASH_MIN_SIZE	256
 
 /*
 -----------------------------------------------------------------------------
- Function: Cvar_FindVar -Return cvar;
+ Function: Cvar_HashLookup -Probe a hash index for a cvar.
  
- Parameters: var_name -[in] Name of cvar to lookup.
+ Parameters: hash -[in] Index to search.
+			var_name -[in] Name of cvar to lookup.
+			hashid -[in] HashString( var_name ).
  
  Returns: NULL if cvar not found, otherwise returns the cvar.
  
- Notes: 
+ Notes: Linear probing, an empty slot ends the search.
 
 -----------------------------------------------------------------------------
 */
-cvar_t *Cvar_FindVar( const char *var_name )
+static cvar_t *Cvar_HashLookup( const cvarHash_t *hash, const char *var_name, int hashid )
 {
+	int		i;
 	cvar_t	*var;
-	int hashid;
 
-	hashid = HashString( var_name );
-	
-	for( var = cvar_vars ; var ; var = var->next )
+	if( ! hash->size )
+	{
+		return NULL;
+	}
+
+	for( i = hashid & ( hash->size - 1 ) ; ( var = hash->slots[ i ] ) ; i = ( i + 1 ) & ( hash->size - 1 ) )
 	{
 		if( hashid == var->hashid && !strcasecmp( var_name, var->name ) )
 		{
@@ -55,6 +71,64 @@ cvar_t *Cvar_FindVar( const char *var_name )
 	return NULL;
 }
 
+/*
+-----------------------------------------------------------------------------
+ Function: Cvar_HashInsert -Add a cvar to a hash index.
+ 
+ Parameters: hash -[in] Index to add to.
+			var -[in] cvar with hashid set, not already in the index.
+ 
+ Returns: Nothing.
+ 
+ Notes: The table doubles when it becomes half full.
+
+-----------------------------------------------------------------------------
+*/
+static void Cvar_HashInsert( cvarHash_t *hash, cvar_t *var )
+{
+	int		i;
+
+	if( ( hash->count + 1 ) * 2 > hash->size )
+	{
+		cvarHash_t	old = *hash;
+
+		hash->size = old.size ? old.size * 2 : CVAR_HASH_MIN_SIZE;
+		hash->slots = calloc( hash->size, sizeof( *hash->slots ) );
+		hash->count = 0;
+		for( i = 0 ; i < old.size ; i++ )
+		{
+			if( old.slots[ i ] )
+			{
+				Cvar_HashInsert( hash, old.slots[ i ] );
+			}
+		}
+		free( old.slots );
+	}
+
+	for( i = var->hashid & ( hash->size - 1 ) ; hash->slots[ i ] ; i = ( i + 1 ) & ( hash->size - 1 ) )
+	{
+	}
+	hash->slots[ i ] = var;
+	hash->count++;
+}
+
+/*
+-----------------------------------------------------------------------------
+ Function: Cvar_FindVar -Return cvar;
+ 
+ Parameters: var_name -[in] Name of cvar to lookup.
+ 
+ Returns: NULL if cvar not found, otherwise returns the cvar.
+ 
+ Notes: Case insensitive.
+
+-----------------------------------------------------------------------------
+*/
+cvar_t *Cvar_FindVar( const char *var_name )
+{
+	return Cvar_HashLookup( &cvar_hash, var_name, HashString( var_name ) );
+}
+
 /*
 -----------------------------------------------------------------------------
  Function: Cvar_VariableValue -Get value of cvar.
@@ -185,6 +259,7 @@ cvar_t *Cvar_Get( const char *var_name, const char *var_value, CVARFlags flags )
 	// link the variable in
 	var->next = cvar_vars;
 	cvar_vars = var;
+	Cvar_HashInsert( &cvar_hash, var );
 
 	var->flags = flags;
 
@@ -372,3 +447,84 @@ void Cvar_Reset_f( void ) {
 	}
 }
 
+/*
+-----------------------------------------------------------------------------
+ Function: Cvar_Benchmark_f -Time cvar lookups against the old list scan.
+ 
+ Parameters: Nothing.
+ 
+ Returns: Nothing.
+ 
+ Notes: Builds private registries of 100, 1000 and 10000 cvars, so the
+		real cvar_vars is untouched, and looks every name up in both a
+		hash index and a linked list.
+
+-----------------------------------------------------------------------------
+*/
+void Cvar_Benchmark_f( void )
+{
+	static const int	counts[] = { 100, 1000, 10000 };
+	const int			lookups = 100000;
+	int					c, i;
+
+	for( c = 0 ; c < sizeof( counts ) / sizeof( counts[ 0 ] ) ; c++ )
+	{
+		int			count = counts[ c ];
+		cvar_t		*vars = calloc( count, sizeof( *vars ) );
+		char		**names = malloc( count * sizeof( *names ) );
+		cvarHash_t	hash = { NULL, 0, 0 };
+		cvar_t		*list = NULL;
+		int			found = 0;
+		int			start, hashTime, listTime;
+
+		for( i = 0 ; i < count ; i++ )
+		{
+			// mixed case, so the lookups exercise case folding
+			vars[ i ].name = strdup( va( "bench_%i", i ) );
+			names[ i ] = strdup( va( "BENCH_%i", i ) );
+			vars[ i ].hashid = HashString( vars[ i ].name );
+			vars[ i ].next = list;
+			list = &vars[ i ];
+			Cvar_HashInsert( &hash, &vars[ i ] );
+		}
+
+		start = SysIphoneMicroseconds();
+		for( i = 0 ; i < lookups ; i++ )
+		{
+			const char *name = names[ ( i * 7919 ) % count ];
+			found += Cvar_HashLookup( &hash, name, HashString( name ) ) != NULL;
+		}
+		hashTime = SysIphoneMicroseconds() - start;
+
+		start = SysIphoneMicroseconds();
+		for( i = 0 ; i < lookups ; i++ )
+		{
+			const char	*name = names[ ( i * 7919 ) % count ];
+			int			hashid = HashString( name );
+			cvar_t		*var;
+
+			for( var = list ; var ; var = var->next )
+			{
+				if( hashid == var->hashid && !strcasecmp( name, var->name ) )
+				{
+					break;
+				}
+			}
+			found += var != NULL;
+		}
+		listTime = SysIphoneMicroseconds() - start;
+
+		Com_Printf( "%5i cvars: hash %5.3f usec, list %8.3f usec per lookup (%i found)\n",
+				   count, (float)hashTime / lookups, (float)listTime / lookups, found );
+
+		for( i = 0 ; i < count ; i++ )
+		{
+			free( vars[ i ].name );
+			free( names[ i ] );
+		}
+		free( names );
+		free( vars );
+		free( hash.slots );
+	}
+}
+
@@ -90,6 +90,7 @@ extern	cvar_t	*cvar_vars;
 
 void Cvar_List_f();
 void Cvar_Reset_f();
+void Cvar_Benchmark_f();
 
 extern cvar_t *Cvar_Get( const char *var_name, const char *value, CVARFlags flags );
 // creates the variable if it doesn't exist, or returns the existing one
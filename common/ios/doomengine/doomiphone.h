@@ -92,6 +92,10 @@ extern "C" {
 #include "prboom/m_misc.h"
 #include "prboom/m_menu.h"
 #include "prboom/p_checksum.h"
+#include "prboom/m_profile.h"
+#include "prboom/d_cmdqueue.h"
+#include "prboom/d_jitter.h"
+#include "prboom/p_predict.h"
 #include "prboom/i_main.h"
 #include "prboom/i_system.h"
 #include "prboom/i_sound.h"
@@ -113,6 +117,7 @@ extern "C" {
 #include "prboom/p_mobj.h"
 #include "prboom/p_maputl.h"
 #include "prboom/p_map.h"
+#include "prboom/p_tick.h"
 // open / close name collision problem... #include "prboom/p_spec.h"
 #include "prboom/p_inter.h"
 #include "prboom/m_random.h"
@@ -38,6 +38,11 @@ pkTexture_t	*pkTextures;
 pkWav_t		*pkWavs;
 
 void PK_LoadTexture( pkTexture_t *image );
+static int PK_TextureBytes( const pkTextureData_t *imd );
+static void PK_UploadTexture( void *owner );
+
+// bound in place of a texture that hasn't been uploaded yet
+static unsigned	placeholderTexNum;
 
 /*
  ==================
@@ -77,8 +82,13 @@ void PK_Init( const char *pakFileName ) {
 	pkTextures = malloc( sizeof( pkTextures[0] ) * pkHeader->textures.count );
 	memset( pkTextures, 0, sizeof( pkTextures[0] ) * pkHeader->textures.count );
 	for ( int i = 0 ; i < pkHeader->textures.count ; i++ ) {
-		pkTextures[i].textureData = (pkTextureData_t *)( (byte *)pkHeader + pkHeader->textures.tableOfs + i * pkHeader->textures.structSize );
+		pkTexture_t *tex = &pkTextures[i];
+		tex->textureData = (pkTextureData_t *)( (byte *)pkHeader + pkHeader->textures.tableOfs + i * pkHeader->textures.structSize );
+		tex->stream.owner = tex;
+		tex->stream.data = (byte *)pkHeader + tex->textureData->picDataOfs;
+		tex->stream.size = PK_TextureBytes( tex->textureData );
 	}
+	TS_Init( PK_UploadTexture, SysIphoneMicroseconds );
 	
 	// build the local wav table
 	int	startLoadingWavs = SysIphoneMicroseconds();
@@ -149,6 +159,56 @@ void PK_Init( const char *pakFileName ) {
 }
 
 
+// load the image directly from the mapped file
+typedef struct {
+	int		internalFormat;
+	int		externalFormat;
+	int		type;
+	int		bpp;
+} formatInfo_t;
+
+static formatInfo_t formatInfo[9] = {
+	{ GL_RGB , GL_RGB, GL_UNSIGNED_SHORT_5_6_5, 16 },
+	{ GL_RGBA, GL_RGBA, GL_UNSIGNED_SHORT_5_5_5_1, 16 },
+	{ GL_RGBA, GL_RGBA, GL_UNSIGNED_SHORT_4_4_4_4, 16 },
+	{ GL_RGBA, GL_BGRA, GL_UNSIGNED_BYTE, 32 },
+	{ GL_LUMINANCE_ALPHA, GL_LUMINANCE_ALPHA, GL_UNSIGNED_BYTE, 16 },
+	{ GL_COMPRESSED_RGB_PVRTC_4BPPV1_IMG, 0, 0, 4 },
+	{ GL_COMPRESSED_RGBA_PVRTC_4BPPV1_IMG, 0, 0, 4 },
+	{ GL_COMPRESSED_RGB_PVRTC_2BPPV1_IMG, 0, 0, 2 },
+	{ GL_COMPRESSED_RGBA_PVRTC_2BPPV1_IMG, 0, 0, 2 },
+};
+
+/*
+ ==================
+ PK_TextureBytes
+ 
+ Size of all the mip levels, the same walk PK_LoadTexture makes.
+ ==================
+ */
+static int PK_TextureBytes( const pkTextureData_t *imd ) {
+	assert( imd->format < 9 );
+	formatInfo_t *fi = &formatInfo[imd->format];
+	
+	int	w = imd->uploadWidth;
+	int h = imd->uploadHeight;
+	int l = 0;
+	int	totalSize = 0;
+	while( 1 ) {
+		int	size = (w*h*fi->bpp)/8;
+		if ( fi->type == 0 && size < 32 ) {
+			size = 32;
+		}
+		totalSize += size;
+		if ( ++l == imd->numLevels || ( w == 1 && h == 1 ) ) {
+			break;
+		}
+		w = w > 1 ? w >> 1 : 1;
+		h = h > 1 ? h >> 1 : 1;
+	}
+	return totalSize;
+}
+
 /*
  ==================
  PK_LoadTexture
@@ -156,33 +216,11 @@ void PK_Init( const char *pakFileName ) {
  ==================
  */
 void PK_LoadTexture( pkTexture_t *tex ) {
-	int startTime = SysIphoneMicroseconds();
-
 	const pkTextureData_t *imd = tex->textureData;
 
 	glGenTextures( 1, &tex->glTexNum );
 	glBindTexture( GL_TEXTURE_2D, tex->glTexNum );
 	
-	// load the image directly from the mapped file
-	typedef struct {
-		int		internalFormat;
-		int		externalFormat;
-		int		type;
-		int		bpp;
-	} formatInfo_t;
-	
-	static formatInfo_t formatInfo[9] = {
-		{ GL_RGB , GL_RGB, GL_UNSIGNED_SHORT_5_6_5, 16 },
-		{ GL_RGBA, GL_RGBA, GL_UNSIGNED_SHORT_5_5_5_1, 16 },
-		{ GL_RGBA, GL_RGBA, GL_UNSIGNED_SHORT_4_4_4_4, 16 },
-		{ GL_RGBA, GL_BGRA, GL_UNSIGNED_BYTE, 32 },
-		{ GL_LUMINANCE_ALPHA, GL_LUMINANCE_ALPHA, GL_UNSIGNED_BYTE, 16 },
-		{ GL_COMPRESSED_RGB_PVRTC_4BPPV1_IMG, 0, 0, 4 },
-		{ GL_COMPRESSED_RGBA_PVRTC_4BPPV1_IMG, 0, 0, 4 },
-		{ GL_COMPRESSED_RGB_PVRTC_2BPPV1_IMG, 0, 0, 2 },
-		{ GL_COMPRESSED_RGBA_PVRTC_2BPPV1_IMG, 0, 0, 2 },
-	};
-	
 	assert( imd->format < 9 );
 	formatInfo_t *fi = &formatInfo[imd->format];
 	
@@ -191,7 +229,6 @@ void PK_LoadTexture( pkTexture_t *tex ) {
 	int h = imd->uploadHeight;
 	// upload each mip level
 	int l = 0;
-	int	totalSize = 0;
 	while( 1 ) {
 		int	size = (w*h*fi->bpp)/8;
 		if ( fi->type == 0 ) {
@@ -207,7 +244,6 @@ void PK_LoadTexture( pkTexture_t *tex ) {
 		}
 		GLCheckError( "texture upload" );
 
-		totalSize += size;
 		if ( ++l == imd->numLevels ) {
 			break;
 		}
@@ -229,21 +265,22 @@ void PK_LoadTexture( pkTexture_t *tex ) {
 	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, imd->wrapS );
 	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, imd->wrapT );
 	glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, 2.0f );
-	
-	int endTime = SysIphoneMicroseconds();
-	
-	printf( "%5.1f mb/s TexImage for %s\n",  (float)totalSize / 
-		   ( endTime - startTime ), imd->name.name );
+}
+
+static void PK_UploadTexture( void *owner ) {
+	PK_LoadTexture( (pkTexture_t *)owner );
 }
 
 /*
  ==================
- PK_FindTexture
+ PK_RequestTexture
  
- Fully creates the gl texture before returning.
+ Queues the texture for page-in and upload and returns without waiting,
+ unless the priority is TS_PRI_IMMEDIATE. Until it is uploaded,
+ PK_BindTexture binds a transparent placeholder.
  ==================
  */
-pkTexture_t *PK_FindTexture( const char *imageName ) {
+pkTexture_t *PK_RequestTexture( const char *imageName, int priority ) {
 	int	texIndex;
 	pkTexture_t *texData = (pkTexture_t *)PK_FindType( imageName, &pkHeader->textures, &texIndex );
 	if ( !texData ) {
@@ -251,11 +288,54 @@ pkTexture_t *PK_FindTexture( const char *imageName ) {
 	}
 	pkTexture_t *tex = pkTextures + texIndex;
 	if ( tex->glTexNum == 0 ) {
-		PK_LoadTexture( tex );
+		// a budget of 0 gets the old synchronous behavior
+		if ( texUploadBudget->value <= 0 ) {
+			priority = TS_PRI_IMMEDIATE;
+		}
+		TS_Request( &tex->stream, priority );
 	}
 	return tex;
 }
 
+/*
+ ==================
+ PK_FindTexture
+ 
+ ==================
+ */
+pkTexture_t *PK_FindTexture( const char *imageName ) {
+	return PK_RequestTexture( imageName, TS_PRI_NORMAL );
+}
+
+/*
+ ==================
+ PK_ServiceTextures
+ 
+ ==================
+ */
+void PK_ServiceTextures( void ) {
+	if ( TS_Pending() ) {
+		TS_Service( texUploadBudget->value * 1024 );
+	}
+}
+
+/*
+ ==================
+ PK_TextureStats_f
+ 
+ ==================
+ */
+void PK_TextureStats_f( void ) {
+	Com_Printf( "%i requests, %i uploads (%i immediate), %i pending\n",
+			   tsStats.requests, tsStats.uploads, tsStats.immediateUploads, TS_Pending() );
+	Com_Printf( "%i kb uploaded, most in a frame %i kb, %i over the budget\n",
+			   tsStats.bytesUploaded / 1024, tsStats.maxFrameBytes / 1024, tsStats.oversized );
+	if ( tsStats.uploads ) {
+		Com_Printf( "request to ready: %i usec avg, %i usec max\n",
+				   tsStats.totalLatency / tsStats.uploads, tsStats.maxLatency );
+	}
+}
+
 /*
  ==================
  PK_FindWav
@@ -367,8 +447,21 @@ const pkName_t *PK_FindType( const char *rawName, const pkType_t *type, int *ind
  ==================
  */
 void PK_BindTexture( pkTexture_t *tex ) {
-	assert( tex->glTexNum );
-	glBindTexture( GL_TEXTURE_2D, tex->glTexNum );
+	if ( tex->glTexNum ) {
+		glBindTexture( GL_TEXTURE_2D, tex->glTexNum );
+		return;
+	}
+	// it is on screen now, so move it up the queue
+	TS_Request( &tex->stream, TS_PRI_VISIBLE );
+	if ( placeholderTexNum == 0 ) {
+		static const byte clear[4] = { 0, 0, 0, 0 };
+		glGenTextures( 1, &placeholderTexNum );
+		glBindTexture( GL_TEXTURE_2D, placeholderTexNum );
+		glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, clear );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+	}
+	glBindTexture( GL_TEXTURE_2D, placeholderTexNum );
 }
 
 /*
@@ -31,6 +31,8 @@
 #ifndef IPAK_H
 #define IPAK_H
 
+#include "texstream.h"
+
 //============================================================
 //
 // In-file structures
@@ -148,8 +150,9 @@ typedef struct {
 //============================================================
 
 typedef struct {
-	unsigned	glTexNum;
+	unsigned	glTexNum;			// 0 until the upload queue gets to it
 	const pkTextureData_t	*textureData;
+	tsEntry_t	stream;				// page-in / upload scheduling
 	// we will need to add LRU links if texture caching is needed
 } pkTexture_t;
 
@@ -162,6 +165,9 @@ void			PK_Init( const char *pakFileName );
 const pkName_t *PK_FindType( const char *rawName, const pkType_t *type, int *index );
 const byte *	PK_FindRaw( const char *rawName, int *len );	// len can be NULL if you don't need it
 pkTexture_t *	PK_FindTexture( const char *imageName );
+pkTexture_t *	PK_RequestTexture( const char *imageName, int priority );	// tsPriority_t
+void			PK_ServiceTextures( void );		// once a frame, with the context current
+void			PK_TextureStats_f( void );
 pkWav_t *		PK_FindWav( const char *soundName );
 
 // The name will be converted to canonical name (backslashes converted to slashes and lowercase)
@@ -38,6 +38,10 @@ typedef struct {
 	int	sent;
 	int	received;
 	int	latency;
+	int	bytesSent;		// largest server packet this tic
+	int	target;			// tics the playout buffer is aiming for
+	int	depth;			// tics it actually held
+	int	lead;			// tics the server may run ahead of the slowest client
 } asyncStats_t;
 
 #define MAX_ASYNC_LOGS	256
@@ -47,6 +51,263 @@ int	asyncTicNum;
 // we save this for the packet acknowledge, and also for debugging
 static packetServer_t	lastServerPacket;
 
+// the server remembers the maketic it sent with each packetSequence, so
+// when a client acknowledges a packet we know which commands it has
+typedef struct {
+	int		packetSequence;
+	int		maketic;
+} sentPacket_t;
+
+#define MAX_SENT_PACKETS	64
+static sentPacket_t	sentPackets[MAX_SENT_PACKETS];
+
+cmdqueue_t	cmdQueue;
+cmdqueue_t	touchQueue;
+cmdqueue_t	predictQueue;
+cmdqueue_t	hashQueue;
+touch_t		frameTouches[MAX_TOUCHES];
+
+// The game thread's copy of the commands this client has sent, and the
+// newest of them the server is known to have put in a tic.
+static predictCmd_t	localCmds[BACKUPTICS];
+static int			localSequence = -1;
+static int			latchedSequence = -1;
+
+// Only the game thread writes these, the release store of commandEpoch
+// publishes commandResetTic with it.
+static int	commandEpoch;
+static int	commandResetTic;
+
+// The application thread's own copy of maketic and the commands it has
+// queued, which the server builds its packets from.
+static int		asyncEpoch;
+static int		asyncMaketic;
+static ticcmd_t	asyncNetcmds[MAXPLAYERS][BACKUPTICS];
+
+// on the server, the packetSequence of each client's command in tic asyncMaketic-1
+static int		asyncLatched[MAXPLAYERS];
+
+// The newest state hashes the game thread has made, for our packets.  Only
+// the game thread writes them, the release store of stateHashCount
+// publishes each one.
+#define MAX_PUBLISHED_HASHES	4
+static statehash_t	publishedHashes[MAX_PUBLISHED_HASHES];
+static int			stateHashCount;
+
+// the tic of the newest state hash queued from each player
+static int		asyncHashTic[MAXPLAYERS];
+
+/*
+ ==================
+ iphoneInitCommandQueues
+ 
+ Must be called before the first iphoneAsyncTic.
+ ==================
+ */
+void iphoneInitCommandQueues() {
+	CQ_Init( &cmdQueue, CMD_QUEUE_SIZE, sizeof( asyncCmd_t ) );
+	CQ_Init( &touchQueue, TOUCH_QUEUE_SIZE, sizeof( touchSnapshot_t ) );
+	CQ_Init( &predictQueue, PREDICT_QUEUE_SIZE, sizeof( predictCmd_t ) );
+	CQ_Init( &hashQueue, HASH_QUEUE_SIZE, sizeof( remoteHash_t ) );
+}
+
+/*
+ ==================
+ iphoneResetCommands
+ 
+ Called by the game thread wherever it used to set maketic directly.
+ Anything still queued from before is dropped, and the application thread
+ starts making commands from tic on the next time it looks.
+ ==================
+ */
+void iphoneResetCommands( int tic ) {
+	maketic = tic;
+	latchedSequence = -1;
+	__atomic_store_n( &stateHashCount, 0, __ATOMIC_RELEASE );
+	__atomic_store_n( &commandResetTic, tic, __ATOMIC_RELAXED );
+	__atomic_store_n( &commandEpoch, commandEpoch + 1, __ATOMIC_RELEASE );
+}
+
+static void SyncCommandEpoch() {
+	int	epoch = __atomic_load_n( &commandEpoch, __ATOMIC_ACQUIRE );
+	if ( epoch != asyncEpoch ) {
+		asyncEpoch = epoch;
+		asyncMaketic = __atomic_load_n( &commandResetTic, __ATOMIC_RELAXED );
+		memset( asyncNetcmds, 0, sizeof( asyncNetcmds ) );
+		for ( int i = 0 ; i < MAXPLAYERS ; i++ ) {
+			asyncHashTic[i] = -1;
+		}
+	}
+}
+
+/*
+ ==================
+ QueueCommands
+ 
+ Hands the commands for one tic to the game thread.  If the game thread
+ has fallen so far behind that the queue is full, the tic isn't made.
+ ==================
+ */
+static boolean QueueCommands( int tic, int players, ticcmd_t cmds[MAXPLAYERS], int commandSequence ) {
+	asyncCmd_t *ac = (asyncCmd_t *)CQ_Reserve( &cmdQueue );
+	if ( !ac ) {
+		return false;
+	}
+	ac->epoch = asyncEpoch;
+	ac->tic = tic;
+	ac->players = players;
+	ac->commandSequence = commandSequence;
+	memcpy( ac->cmds, cmds, sizeof( ac->cmds ) );
+	CQ_Commit( &cmdQueue );
+	return true;
+}
+
+/*
+ ==================
+ iphoneDrainCommands
+ 
+ Called by the game thread at the start of each frame to take everything
+ the application thread has made since the last one.
+ ==================
+ */
+void iphoneDrainCommands() {
+	const asyncCmd_t	*ac;
+	uint_64_t			queued;
+	uint_64_t			now = I_GetTime_US();
+	int					longest = 0;
+	
+	while ( ( ac = (const asyncCmd_t *)CQ_Peek( &cmdQueue, &queued ) ) ) {
+		if ( ac->epoch == commandEpoch ) {
+			for ( int i = 0 ; i < MAXPLAYERS ; i++ ) {
+				if ( ac->players & ( 1 << i ) ) {
+					netcmds[i][ac->tic&BACKUPTICMASK] = ac->cmds[i];
+				}
+			}
+			if ( ac->tic >= maketic ) {
+				maketic = ac->tic + 1;
+			}
+			if ( ac->commandSequence != -1 ) {
+				latchedSequence = ac->commandSequence;
+			}
+		}
+		if ( (int)( now - queued ) > longest ) {
+			longest = now - queued;
+		}
+		CQ_Pop( &cmdQueue );
+	}
+	loggedTimes[iphoneFrameNum&(MAX_LOGGED_TIMES-1)].cmdLatency = longest;
+	
+	// only the newest touches matter
+	const touchSnapshot_t *ts;
+	while ( ( ts = (const touchSnapshot_t *)CQ_Peek( &touchQueue, NULL ) ) ) {
+		memcpy( frameTouches, ts->touches, sizeof( frameTouches ) );
+		CQ_Pop( &touchQueue );
+	}
+	
+	const predictCmd_t *pc;
+	while ( ( pc = (const predictCmd_t *)CQ_Peek( &predictQueue, NULL ) ) ) {
+		localCmds[pc->packetSequence&BACKUPTICMASK] = *pc;
+		localSequence = pc->packetSequence;
+		CQ_Pop( &predictQueue );
+	}
+	
+	// P_StateHashCheck holds on to hashes for tics we haven't run yet
+	const remoteHash_t *rh;
+	while ( ( rh = (const remoteHash_t *)CQ_Peek( &hashQueue, NULL ) ) ) {
+		P_StateHashCheck( &rh->hash, rh->player );
+		CQ_Pop( &hashQueue );
+	}
+}
+
+/*
+ ==================
+ iphonePublishStateHash
+ 
+ Called by the game thread after each tic.  Every statehash_tics tics the
+ hash P_StateHashTic() made is handed to the application thread, which
+ puts the newest one in every packet it sends, so losing a packet doesn't
+ lose the hash.
+ ==================
+ */
+void iphonePublishStateHash( int tic ) {
+	if ( !netgame || !statehash_tics || tic % statehash_tics ) {
+		return;
+	}
+	const statehash_t *h = P_StateHashAt( tic );
+	if ( !h ) {
+		return;
+	}
+	int	count = stateHashCount;
+	publishedHashes[count&(MAX_PUBLISHED_HASHES-1)] = *h;
+	__atomic_store_n( &stateHashCount, count + 1, __ATOMIC_RELEASE );
+}
+
+static void LatestStateHash( statehash_t *h ) {
+	int	count = __atomic_load_n( &stateHashCount, __ATOMIC_ACQUIRE );
+	if ( count == 0 ) {
+		h->tic = -1;
+		return;
+	}
+	*h = publishedHashes[(count-1)&(MAX_PUBLISHED_HASHES-1)];
+}
+
+/*
+ ==================
+ QueueStateHash
+ 
+ Every packet repeats the sender's newest hash, only hand each one to the
+ game thread once.
+ ==================
+ */
+static void QueueStateHash( int player, const statehash_t *h ) {
+	if ( h->tic < 0 || h->tic == asyncHashTic[player] ) {
+		return;
+	}
+	remoteHash_t	rh;
+	rh.player = player;
+	rh.hash = *h;
+	if ( CQ_Push( &hashQueue, &rh ) ) {
+		asyncHashTic[player] = h->tic;
+	}
+}
+
+/*
+ ==================
+ iphonePredictLocalPlayer
+ 
+ A client's own movement otherwise shows up a round trip after the touch
+ that made it.  Before the frame is drawn, move the local player on
+ through the commands for tics we have but haven't run, then through
+ the ones we have sent that the server hadn't used yet, and put it back
+ with P_UnpredictPlayer() afterwards.  Every frame starts again from the
+ tic the game has really reached, so a wrong guess only lasts until the
+ server's version of it arrives.
+ ==================
+ */
+boolean iphonePredictLocalPlayer() {
+	if ( !netgame || consoleplayer == 0 || !netPredict->value || gamestate != GS_LEVEL
+		|| latchedSequence == -1 ) {
+		return false;
+	}
+	
+	ticcmd_t	cmds[BACKUPTICS*2];
+	int			count = 0;
+	for ( int i = gametic ; i < maketic && count < BACKUPTICS ; i++ ) {
+		cmds[count++] = netcmds[consoleplayer][i&BACKUPTICMASK];
+	}
+	int	first = latchedSequence + 1;
+	if ( localSequence - first >= BACKUPTICS ) {
+		first = localSequence - BACKUPTICS + 1;	// older ones have been overwritten
+	}
+	for ( int s = first ; s - localSequence <= 0 ; s++ ) {
+		const predictCmd_t *pc = &localCmds[s&BACKUPTICMASK];
+		if ( pc->packetSequence == s ) {
+			cmds[count++] = pc->cmd;
+		}
+	}
+	return P_PredictPlayer( &players[consoleplayer], cmds, count );
+}
+
 /*
  ==================
  ShowNet
@@ -61,6 +322,9 @@ void ShowNet() {
 	color4_t red = { 255, 0, 0, 255 };
 	color4_t green = { 0, 255, 0, 255 };
 	color4_t blue = { 0, 0, 255, 255 };
+	color4_t yellow = { 255, 255, 0, 255 };
+	color4_t white = { 255, 255, 255, 255 };
+	color4_t gray = { 128, 128, 128, 255 };
 	
 	int	now = asyncTicNum;	// latch it in case it changes
 	
@@ -69,7 +333,22 @@ void ShowNet() {
 		R_Draw_Fill( 0, i * 4, lt->sent * 10, 2, red );
 		R_Draw_Fill( 100, i * 4, lt->received * 10, 2, green );
 		R_Draw_Fill( 200, i * 4, lt->latency * 10, 2, blue );
+		R_Draw_Fill( 300, i * 4, lt->bytesSent / 10, 2, yellow );
+		
+		// the playout buffer: what it is aiming for against what it held,
+		// and on the server how far ahead it would let itself run
+		R_Draw_Fill( 400, i * 4, lt->target * 10, 2, gray );
+		R_Draw_Fill( 400, i * 4, lt->depth * 10, 1, white );
+		R_Draw_Fill( 500, i * 4, lt->lead * 5, 2, green );
 	}
+	
+	// the buffer's view of the peer that matters to us
+	const jitterbuffer_t *jb = consoleplayer != 0 ? &netServer.jitter : &netPlayers[1].peer.jitter;
+	char	str[128];
+	snprintf( str, sizeof( str ), "jitter %ims target %i depth %i rate %i%% stalls %u +%u -%u",
+			 jb->deviation / JB_SCALE, JB_Target( jb ), jb->depth, jb->rate * 100 / JB_UNIT,
+			 jb->stalls, jb->stretched, jb->shrunk );
+	iphoneDrawText( 0, 140, 0.75f, str );
 }
 
 void ShowMiniNet() {
@@ -115,10 +394,109 @@ void UpdatePeerTiming( netPeer_t *peer, int remoteMilliseconds ) {
 		peer->lowestTimeDelta = peer->lastTimeDelta;
 		peer->oneWayLatency = 0;
 	}
+	JB_Arrival( &peer->jitter, peer->oneWayLatency );
 //	printf( "OWL:%i timeDelta:%i  lowest:%i\n", peer->oneWayLatency,
 //		   peer->lastTimeDelta, peer->lowestTimeDelta );
 }
 
+/*
+ ==================
+ WriteDeltaCmd
+ 
+ Writes a flags byte followed by only the fields of cmd that differ
+ from base.  The first command for each player in a packet is written
+ against a zeroed cmd, so a packet never depends on an earlier packet
+ having arrived.
+ ==================
+ */
+enum {
+	DC_FORWARDMOVE	= 1,
+	DC_SIDEMOVE		= 2,
+	DC_ANGLETURN	= 4,
+	DC_CONSISTANCY	= 8,
+	DC_CHATCHAR		= 16,
+	DC_BUTTONS		= 32
+};
+
+static byte *WriteDeltaCmd( byte *out, const ticcmd_t *base, const ticcmd_t *cmd ) {
+	byte	*flags = out++;
+	
+	*flags = 0;
+	if ( cmd->forwardmove != base->forwardmove ) {
+		*flags |= DC_FORWARDMOVE;
+		*out++ = cmd->forwardmove;
+	}
+	if ( cmd->sidemove != base->sidemove ) {
+		*flags |= DC_SIDEMOVE;
+		*out++ = cmd->sidemove;
+	}
+	if ( cmd->angleturn != base->angleturn ) {
+		*flags |= DC_ANGLETURN;
+		*out++ = cmd->angleturn & 255;
+		*out++ = ( cmd->angleturn >> 8 ) & 255;
+	}
+	if ( cmd->consistancy != base->consistancy ) {
+		*flags |= DC_CONSISTANCY;
+		*out++ = cmd->consistancy & 255;
+		*out++ = ( cmd->consistancy >> 8 ) & 255;
+	}
+	if ( cmd->chatchar != base->chatchar ) {
+		*flags |= DC_CHATCHAR;
+		*out++ = cmd->chatchar;
+	}
+	if ( cmd->buttons != base->buttons ) {
+		*flags |= DC_BUTTONS;
+		*out++ = cmd->buttons;
+	}
+	return out;
+}
+
+/*
+ ==================
+ ReadDeltaCmd
+ 
+ Returns NULL if the data runs past end.
+ ==================
+ */
+static const byte *ReadDeltaCmd( const byte *in, const byte *end, const ticcmd_t *base, ticcmd_t *cmd ) {
+	if ( in >= end ) {
+		return NULL;
+	}
+	int flags = *in++;
+	int	size = 0;
+	for ( int bit = 0 ; bit < 6 ; bit++ ) {
+		if ( flags & ( 1 << bit ) ) {
+			size += ( ( 1 << bit ) & ( DC_ANGLETURN | DC_CONSISTANCY ) ) ? 2 : 1;
+		}
+	}
+	if ( end - in < size ) {
+		return NULL;
+	}
+	
+	*cmd = *base;
+	if ( flags & DC_FORWARDMOVE ) {
+		cmd->forwardmove = (signed char)*in++;
+	}
+	if ( flags & DC_SIDEMOVE ) {
+		cmd->sidemove = (signed char)*in++;
+	}
+	if ( flags & DC_ANGLETURN ) {
+		cmd->angleturn = (signed short)( in[0] | ( in[1] << 8 ) );
+		in += 2;
+	}
+	if ( flags & DC_CONSISTANCY ) {
+		cmd->consistancy = (short)( in[0] | ( in[1] << 8 ) );
+		in += 2;
+	}
+	if ( flags & DC_CHATCHAR ) {
+		cmd->chatchar = *in++;
+	}
+	if ( flags & DC_BUTTONS ) {
+		cmd->buttons = *in++;
+	}
+	return in;
+}
+
 /*
  ==================
  iphoneProcessPacket
@@ -239,6 +617,7 @@ void iphoneProcessPacket( const struct sockaddr *from, const void *data, int len
 		// good packet from client
 		np->pc = *pc;
 		UpdatePeerTiming( &np->peer, np->pc.milliseconds );
+		QueueStateHash( pc->consoleplayer, &pc->stateHash );
 	} else {
 		// we are a client, and should only receive server packets
 		if ( packetID != PACKET_VERSION_SERVER ) {
@@ -250,7 +629,8 @@ void iphoneProcessPacket( const struct sockaddr *from, const void *data, int len
 			return;
 		}
 		packetServer_t		*ps = (packetServer_t *)data;
-		if ( len > sizeof( *ps ) ) {
+		int	headerSize = (int)offsetof( packetServer_t, cmdData );
+		if ( len > sizeof( *ps ) || len < headerSize ) {
 			// packets will usually have less ticcmd_t, but never more
 			return;
 		}
@@ -274,6 +654,44 @@ void iphoneProcessPacket( const struct sockaddr *from, const void *data, int len
 			printf( "Dropped %i packets from server\n", drop );
 		}
 		
+		SyncCommandEpoch();
+		
+		// The server starts the range at a maketic we have acknowledged,
+		// so there should never be a gap before it.
+		if ( ps->starttic > asyncMaketic || ps->starttic > ps->maketic
+			|| ps->maketic - ps->starttic > BACKUPTICS ) {
+			printf( "Bad tic range from server: %i to %i, maketic %i\n",
+				   ps->starttic, ps->maketic, asyncMaketic );
+			return;
+		}
+		
+		// decode the commands before accepting the packet
+		static ticcmd_t	cmds[BACKUPTICS][MAXPLAYERS];
+		ticcmd_t	base[MAXPLAYERS];
+		memset( base, 0, sizeof( base ) );
+		const byte *cmd_p = ps->cmdData;
+		const byte *cmd_end = (const byte *)data + len;
+		for ( int i = ps->starttic ; i < ps->maketic && cmd_p ; i++ ) {
+			for ( int j = 0 ; j < MAXPLAYERS && cmd_p ; j++ ) {
+				if ( ps->playersInGame[j] ) {
+					ticcmd_t *cmd = &cmds[i - ps->starttic][j];
+					cmd_p = ReadDeltaCmd( cmd_p, cmd_end, &base[j], cmd );
+					base[j] = *cmd;
+				}
+			}
+		}
+		if ( !cmd_p ) {
+			printf( "Truncated server packet %i\n", ps->packetSequence );
+			return;
+		}
+		
+		// If the game thread hasn't taken enough of the queue to hold the
+		// new tics, treat the packet as dropped so it isn't acknowledged.
+		if ( ps->maketic - asyncMaketic > (int)cmdQueue.size - CQ_Count( &cmdQueue ) ) {
+			printf( "Command queue full, dropping server packet %i\n", ps->packetSequence );
+			return;
+		}
+		
 		// good packet from server
 		memcpy( &lastServerPacket, ps, len );
 		UpdatePeerTiming( &netServer, ps->milliseconds );
@@ -285,7 +703,7 @@ void iphoneProcessPacket( const struct sockaddr *from, const void *data, int len
 		// assert( ps->gametic >= gametic );
 		
 		// this should never happen
-		assert( ps->maketic >= maketic );
+		assert( ps->maketic >= asyncMaketic );
 		
 		// if a ticcmd_t that we need has permanently rolled off the end, we are hosed.
 		// This shouldn't happen, since we don't create commands if all the clients
@@ -296,20 +714,20 @@ void iphoneProcessPacket( const struct sockaddr *from, const void *data, int len
 			netGameFailure = NF_INTERRUPTED;
 		}
 		
-		// move over the new commands
+		// queue the new commands for the game thread
 		// it is possible that some early frames of these are redundant, due
-		// to packets crossing in flight.
-		ticcmd_t *cmd_p = ps->netcmds;
-		for ( int i = ps->starttic ; i < ps->maketic ; i++ ) {
-			for ( int j = 0 ; j < MAXPLAYERS ; j++ ) {
-				if ( playeringame[j] ) {
-					netcmds[j][i&BACKUPTICMASK] = *cmd_p++;
-				}
+		// to packets crossing in flight, and those we already have.
+		int	players = 0;
+		for ( int j = 0 ; j < MAXPLAYERS ; j++ ) {
+			if ( ps->playersInGame[j] ) {
+				players |= 1 << j;
 			}
 		}
-		
-		// copy this after the cmds have been updated
-		maketic = ps->maketic;
+		for ( int i = asyncMaketic ; i < ps->maketic ; i++ ) {
+			QueueCommands( i, players, cmds[i - ps->starttic],
+						  i == ps->maketic - 1 ? ps->commandSequence : -1 );
+		}
+		asyncMaketic = ps->maketic;
 		
 		// See if anyone has disconnected.
 		for ( int i = 0; i < MAXPLAYERS; ++i ) {
@@ -330,6 +748,7 @@ void iphoneProcessPacket( const struct sockaddr *from, const void *data, int len
 				}
 			}
 		}
+		QueueStateHash( 0, &ps->stateHash );
 	}	
 }
 
@@ -795,6 +1214,8 @@ void iphoneAsyncTic() {
 
 	int	afterLock = SysIphoneMilliseconds();
 	
+	SyncCommandEpoch();
+	
 	// latch the current touches for processing
 	for ( int i = 0 ; i < MAX_TOUCHES ; i++ ) {
 		touch_t *t = &sysTouches[i];
@@ -812,6 +1233,9 @@ void iphoneAsyncTic() {
 		}
 	}	
 	
+	// and give the game thread its copy, if it has taken the last few
+	CQ_Push( &touchQueue, gameTouches );
+	
 	//---------------------------------
 	// Create local user command
 	// 
@@ -827,6 +1251,8 @@ void iphoneAsyncTic() {
 	if ( consoleplayer != 0 ) {
 		if ( gameID != 0 && netgame && !netGameFailure ) {
 			stats->latency = packetSequence - lastServerPacket.packetAcknowledge;
+			stats->target = JB_Target( &netServer.jitter );
+			stats->depth = netServer.jitter.depth;
 			if ( ShouldSendPacket( &netServer, packetSequence - lastServerPacket.packetAcknowledge ) ) {
 				packetClient_t	cp;
 				memset( &cp, 0, sizeof( cp ) );
@@ -837,9 +1263,15 @@ void iphoneAsyncTic() {
 				cp.packetSequence = packetSequence++;
 				cp.consoleplayer = consoleplayer;
 				cp.gametic = gametic;
+				LatestStateHash( &cp.stateHash );
 				cp.cmd = cmd;
 				
 				idGameCenter::SendPacketToPlayerUnreliable( serverGameCenterID, &cp, sizeof ( cp ) );
+				
+				predictCmd_t	pc;
+				pc.packetSequence = cp.packetSequence;
+				pc.cmd = cmd;
+				CQ_Push( &predictQueue, &pc );
 			}
 		}
 	} else {
@@ -854,24 +1286,54 @@ void iphoneAsyncTic() {
 		// Decide if we want to latch the current commands for execution by the game
 		//
 		//---------------------------------
-		int	ticIndex = maketic & BACKUPTICMASK;
+		int	ticIndex = asyncMaketic & BACKUPTICMASK;
 		
-		int	worstTic = gametic;
+		int	worstLead = netBuffer->value;
+		boolean	ahead = false;
+		int	players = 0;
+		ticcmd_t	cmds[MAXPLAYERS];
+		int			latched[MAXPLAYERS];
+		memset( cmds, 0, sizeof( cmds ) );
 		for ( int i = 0 ; i < MAXPLAYERS ; i++ ) {
+			latched[i] = -1;
 			if ( playeringame[i] ) {
-				netcmds[i][ticIndex] = netPlayers[i].pc.cmd;
-				if ( netPlayers[i].pc.gametic < worstTic ) {
-					worstTic = netPlayers[i].pc.gametic;
+				cmds[i] = asyncNetcmds[i][ticIndex] = netPlayers[i].pc.cmd;
+				latched[i] = netPlayers[i].pc.packetSequence;
+				players |= 1 << i;
+				
+				// only let the server get a few tics ahead of any client, so if
+				// anyone is having significant net delivery problems, everyone will
+				// stall instead of losing the player.  If this is too small, then
+				// every little hitch that any player gets will cause everyone to hitch.
+				// The limit follows each client's playout buffer and round trip, so
+				// a quiet network keeps everyone close and a noisy one gets room,
+				// but never more than netBuffer.
+				int lead = netBuffer->value;
+				if ( i != 0 ) {
+					// we can't see the client's own buffer, but its packets cross
+					// the same wireless network, so the jitter we measure on them
+					// is a good stand in for what it measures on ours
+					netPeer_t *peer = &netPlayers[i].peer;
+					lead = JB_Lead( &peer->jitter, peer->currentPingTics );
+					if ( lead > netBuffer->value ) {
+						lead = netBuffer->value;
+					}
+				}
+				if ( lead < worstLead ) {
+					worstLead = lead;
+				}
+				if ( asyncMaketic - netPlayers[i].pc.gametic >= lead ) {
+					ahead = true;
 				}
 			}
 		}
+		stats->lead = worstLead;
 		
-		// only let the server get a few tics ahead of any client, so if
-		// anyone is having significant net delivery problems, everyone will
-		// stall instead of losing the player.  If this is too small, then
-		// every little hitch that any player gets will cause everyone to hitch.
-		if ( maketic - worstTic < netBuffer->value ) {
-			maketic++;
+		if ( !ahead ) {
+			if ( QueueCommands( asyncMaketic, players, cmds, -1 ) ) {
+				memcpy( asyncLatched, latched, sizeof( asyncLatched ) );
+				asyncMaketic++;
+			}
 		}
 		
 		
@@ -886,6 +1348,7 @@ void iphoneAsyncTic() {
 			// since we are sampling a shared wireless network, any of the player's
 			// latencies should be a good enough metric
 			stats->latency = packetSequence - netPlayers[1].pc.packetAcknowledge;
+			stats->target = JB_Target( &netPlayers[1].peer.jitter );
 
 			if ( ShouldSendPacket( &netPlayers[1].peer, stats->latency ) ) {
 				packetServer_t	gp;
@@ -893,11 +1356,14 @@ void iphoneAsyncTic() {
 				gp.packetType = PACKET_VERSION_SERVER;
 				gp.gameID = gameID;
 				gp.packetSequence = packetSequence++;
-				gp.maketic = maketic;
+				gp.maketic = asyncMaketic;
 				for ( int i = 0; i < MAXPLAYERS; ++i ) {
 					gp.playersInGame[i] = playeringame[i];
 				}
-				memcpy( gp.netcmds, netcmds, sizeof( gp.netcmds ) );
+				
+				sentPacket_t *sent = &sentPackets[gp.packetSequence&(MAX_SENT_PACKETS-1)];
+				sent->packetSequence = gp.packetSequence;
+				sent->maketic = gp.maketic;
 				
 				//---------------------------------
 				// Send network packets to the clients
@@ -909,18 +1375,34 @@ void iphoneAsyncTic() {
 					
 					netPlayer_t *np = &netPlayers[i];
 					
-					// only send over the ticcmd that this client needs
-					gp.starttic = np->pc.gametic;				
-					ticcmd_t *cmd_p = gp.netcmds;
+					// only send over the ticcmd that this client doesn't have,
+					// either because it has run them or because it has
+					// acknowledged a packet that carried them
+					gp.starttic = np->pc.gametic;
+					const sentPacket_t *acked = &sentPackets[np->pc.packetAcknowledge&(MAX_SENT_PACKETS-1)];
+					if ( acked->packetSequence == np->pc.packetAcknowledge && acked->maketic > gp.starttic ) {
+						gp.starttic = acked->maketic;
+					}
+					if ( gp.starttic > gp.maketic ) {
+						gp.starttic = gp.maketic;
+					}
+					
+					ticcmd_t	base[MAXPLAYERS];
+					memset( base, 0, sizeof( base ) );
+					byte *cmd_p = gp.cmdData;
 					for ( int j = gp.starttic ; j < gp.maketic ; j++ ) {
 						for ( int k = 0 ; k < MAXPLAYERS ; k++ ) {
 							if ( playeringame[k] ) {
-								*cmd_p++ = netcmds[k][j&BACKUPTICMASK];
+								const ticcmd_t *cmd = &asyncNetcmds[k][j&BACKUPTICMASK];
+								cmd_p = WriteDeltaCmd( cmd_p, &base[k], cmd );
+								base[k] = *cmd;
 							}
 						}
 					}
-					int	packetSize = (byte *)cmd_p - (byte *)&gp;
-					(void)packetSize;
+					int	packetSize = cmd_p - (byte *)&gp;
+					if ( packetSize > stats->bytesSent ) {
+						stats->bytesSent = packetSize;
+					}
 					
 					// use the most recent tic that both the client and
 					// server have run 
@@ -931,7 +1413,9 @@ void iphoneAsyncTic() {
 						gp.consistancy[j] = consistancy[j][gp.consistancyTic&BACKUPTICMASK];
 					}
 					
+					LatestStateHash( &gp.stateHash );
 					gp.packetAcknowledge = np->pc.packetSequence;
+					gp.commandSequence = asyncLatched[i];
 					gp.milliseconds = SysIphoneMilliseconds();
 					
 					// transmit the packet				
@@ -41,6 +41,11 @@
 extern "C" {
 #endif
 
+// prboom types in the structures below, which are C like the rest
+#include "prboom/d_cmdqueue.h"
+#include "prboom/d_jitter.h"
+#include "prboom/p_checksum.h"
+
 typedef enum menuState {
 	IPM_GAME,
 	IPM_MAIN,
@@ -156,6 +161,11 @@ extern cvar_t	*throttle;
 extern cvar_t	*centerSticks;
 extern cvar_t	*rampTurn;
 extern cvar_t	*netBuffer;
+extern cvar_t	*netPredict;
+extern cvar_t	*thinkerThreads;
+extern cvar_t	*loadThreads;
+extern cvar_t	*levelCache;
+extern cvar_t	*texUploadBudget;
 
 extern int	numTouches;
 extern int	touches[5][2];	// [0] = x, [1] = y in landscape mode, raster order with y = 0 at top
@@ -174,7 +184,7 @@ typedef unsigned char color3_t[3];
 
 // networking
 typedef enum {
-	PACKET_VERSION_BASE = 0x24350010,
+	PACKET_VERSION_BASE = 0x24350040,	// 0x24350010 sent full netcmds in packetServer_t, 0x24350020 had no commandSequence, 0x24350030 no stateHash
 	PACKET_VERSION_SETUP,
 	PACKET_VERSION_JOIN,
 	PACKET_VERSION_CLIENT,
@@ -183,6 +193,9 @@ typedef enum {
 
 #define DOOM_PORT	14666		// setup packets will go to DOOM_PORT+1
 
+// a delta encoded ticcmd_t is a flags byte and at most every field
+#define MAX_DELTA_CMD_BYTES	( 1 + sizeof( ticcmd_t ) )
+
 // the server sends out a setup packet by broadcast, and also directly addressed
 // to each client that has joined the game because broadcast packets have truly
 // crappy delivery characteristics over WiFi
@@ -238,6 +251,10 @@ typedef struct {
 	// the last tic that the client has run
 	int		gametic;
 	
+	// the newest state hash the client has made, see iphonePublishStateHash(),
+	// so the server can find the tic a diverged game went wrong at
+	statehash_t	stateHash;
+	
 	// some commands will get missed over the network
 	ticcmd_t	cmd;
 } packetClient_t;
@@ -255,6 +272,11 @@ typedef struct {
 	// used to show current round trip latency
 	int		packetAcknowledge;
 	
+	// the packetSequence of the client packet whose cmd went into tic
+	// maketic-1, so the client knows which of its commands the game
+	// hasn't seen yet and has to predict
+	int		commandSequence;
+	
 	// the server's clock at the time the packet was sent, used
 	// to track one-way latency
 	int		milliseconds;
@@ -268,7 +290,15 @@ typedef struct {
 	// which is an unrecoverable error
 	short	consistancy[MAXPLAYERS];
 	
-	// this will be the last pc.gametic from the player
+	// the newest state hash the server has made, which the client checks
+	// when it runs that tic, giving the exact tic and subsystem of a
+	// divergence that consistancy only notices later, if at all
+	statehash_t	stateHash;
+	
+	// the packet carries the commands for tics [starttic,maketic).
+	// starttic is the newest of the last pc.gametic from the player and
+	// the maketic of the last server packet the player acknowledged, so
+	// commands the client already has are not sent again.
 	int		starttic;
 	
 	// netcmds[][(maketic-1)&BACKUPTICMASK] is the most recent
@@ -278,8 +308,10 @@ typedef struct {
 	// that disconnect in the middle of a game.
 	int		playersInGame[MAXPLAYERS];
 	
-	// only the [playersInGame*(maketic-starttic)] will be transmitted
-	ticcmd_t	netcmds[MAXPLAYERS*BACKUPTICS];
+	// for each tic, for each player in game, a ticcmd_t delta encoded
+	// against the previous one for that player (see WriteDeltaCmd).
+	// Only the bytes used will be transmitted.
+	byte	cmdData[MAXPLAYERS*BACKUPTICS*MAX_DELTA_CMD_BYTES];
 } packetServer_t;
 
 extern int		gameSocket;
@@ -319,6 +351,7 @@ typedef struct {
 	int		lastTimeDelta;			// packet milliseconds - local milliseconds
 	int		lowestTimeDelta;		// min'd with lastTimeDelta each arrival
 	int		currentPingTics;		// packetSequence - last packetAcknowledge
+	jitterbuffer_t	jitter;			// fed from oneWayLatency, sizes the playout buffer
 } netPeer_t;
 
 typedef struct {
@@ -342,6 +375,7 @@ typedef struct {
 	int		afterSleep;
 	int		beforeSwap;
 	int		afterSwap;
+	int		cmdLatency;		// longest a command drained this frame waited, usec
 } logTime_t;
 #define MAX_LOGGED_TIMES	512
 extern logTime_t	loggedTimes[MAX_LOGGED_TIMES];	// indexed by iphoneFrameNum
@@ -441,6 +475,54 @@ typedef struct touch_s {
 #define	MAX_TOUCHES		5
 extern touch_t		sysTouches[MAX_TOUCHES];
 extern touch_t		gameTouches[MAX_TOUCHES];
+extern touch_t		frameTouches[MAX_TOUCHES];	// the newest snapshot the game thread has taken
+
+// The async tic and the packet handler run on the application thread and
+// hand what they make to the game thread through lock-free queues, instead
+// of writing netcmds, maketic and the latched touches under it.  Each
+// command carries the epoch of the last iphoneResetCommands(), so the game
+// thread can throw away commands made before a restart.
+typedef struct {
+	int			epoch;
+	int			tic;
+	int			players;			// bit for each player that cmds[] has
+	int			commandSequence;	// see packetServer_t, -1 if not known for this tic
+	ticcmd_t	cmds[MAXPLAYERS];
+} asyncCmd_t;
+
+// Every command a client sends is also handed to the game thread, which
+// predicts the local player through the ones the game hasn't run yet.
+typedef struct {
+	int			packetSequence;
+	ticcmd_t	cmd;
+} predictCmd_t;
+
+typedef struct {
+	touch_t		touches[MAX_TOUCHES];
+} touchSnapshot_t;
+
+// State hashes that arrived from the other players, which the game thread
+// checks against its own.
+typedef struct {
+	int			player;
+	statehash_t	hash;
+} remoteHash_t;
+
+#define CMD_QUEUE_SIZE		( BACKUPTICS * 2 )	// a whole server packet always fits
+#define TOUCH_QUEUE_SIZE	8
+#define PREDICT_QUEUE_SIZE	BACKUPTICS
+#define HASH_QUEUE_SIZE		( MAXPLAYERS * 4 )
+
+extern cmdqueue_t	cmdQueue;
+extern cmdqueue_t	touchQueue;
+extern cmdqueue_t	predictQueue;
+extern cmdqueue_t	hashQueue;
+
+void iphoneInitCommandQueues();
+void iphoneResetCommands( int tic );	// game thread, sets maketic
+void iphoneDrainCommands();				// game thread, once a frame
+boolean iphonePredictLocalPlayer();		// game thread, undo with P_UnpredictPlayer()
+void iphonePublishStateHash( int tic );	// game thread, after each tic
 
 touch_t *TouchInBounds( int x, int y, int w, int h );
 touch_t *AnyTouchInBounds( int x, int y, int w, int h );
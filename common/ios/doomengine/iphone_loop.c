@@ -755,6 +755,7 @@ void ShowTime() {
 	color4_t activeColor = { 0, 255, 0, 255 };
 	color4_t swapColor = { 0, 0, 255, 255 };
 	color4_t ticColor = { 255, 255, 255, 255 };
+	color4_t latencyColor = { 255, 255, 0, 255 };
 	
 	for ( int i = 1 ; i < 30 ; i++ ) {
 		logTime_t *lt = &loggedTimes[(iphoneFrameNum - i ) & (MAX_LOGGED_TIMES-1)];
@@ -764,6 +765,7 @@ void ShowTime() {
 		R_Draw_Fill( 0, i * 4, activeTime, 2, activeColor );
 		R_Draw_Fill( activeTime, i * 4, swapTime, 2, swapColor );
 		R_Draw_Fill( activeTime + swapTime, i * 4, sleepTime, 2, sleepColor );
+		R_Draw_Fill( 0, i * 4 + 2, lt->cmdLatency >> 7, 2, latencyColor );
 		
 		R_Draw_Fill( 480 - lt->numGameTics * 10, i * 4, lt->numGameTics * 10, 2, ticColor );		
 		R_Draw_Fill( 480 - lt->numPingTics * 10, i * 4+2, lt->numPingTics * 10, 2, swapColor );
@@ -1337,6 +1339,12 @@ void iphoneFrame() {
 		consoleCommand[0] = 0;
 	}
 	
+	// upload textures that have been paged in, up to the budget
+	PK_ServiceTextures();
+	
+	// take the commands and touches the async tic has made
+	iphoneDrainCommands();
+	
 	// move touches to prevTouches (old style use, remove...)
 	numPrevTouches = numTouches;
 	memcpy( prevTouches, touches, sizeof( prevTouches ) );
@@ -1344,7 +1352,7 @@ void iphoneFrame() {
 	// process old style touches
 	numTouches = 0;
 	for ( int i = 0 ; i < MAX_TOUCHES ; i++ ) {
-		touch_t *t = &gameTouches[i];
+		touch_t *t = &frameTouches[i];
 		if ( t->down ) {
 			touches[numTouches][0] = t->x;
 			touches[numTouches][1] = t->y;
@@ -1376,8 +1384,10 @@ void iphoneFrame() {
 	if ( saveOnExitState == 1 ) {
 		printf( "SaveOnExitState == 1\n" );
 		if ( !netgame && !demoplayback && usergame && gamestate == GS_LEVEL ) {
+			// only what changed since the last full save is written,
+			// on another thread
 			G_SaveGame( 0, "quicksave" );
-			G_DoSaveGame(true);
+			G_DoSnapshotGame();
 		}
 		saveOnExitState = 2;
 		return;
@@ -1425,7 +1435,7 @@ void iphoneFrame() {
 		// unless we are doing a flat-out timedemo run
 		if ( iphoneTimeDemo ) {
 			stopTic = gametic+1;
-			maketic = stopTic+1;
+			iphoneResetCommands( stopTic+1 );
 		} else {
 			
 
@@ -1438,27 +1448,14 @@ void iphoneFrame() {
 			
 			// On the server, we always want to execute all available tics.
 			// For a remote client, that would also give the minimum lag, but things are much
-			// smoother if they instead try to leave one buffer tic, unless that would
-			// leave the frame without running a single gametic.
+			// smoother if they instead hold back enough tics to ride out the jitter
+			// measured on the server's packets. Ideally that is one gametic per frame,
+			// running a little slower or faster than real time while the buffer grows or
+			// shrinks toward its target; if the server stops delivering, the client
+			// has to stall when it runs out.
 			stopTic = maketic;
 			if ( consoleplayer != 0 ) {
-				// we are a client, so try to leave a buffer frame
-				static const int COMMAND_BUFFER_SIZE = 1;
-				
-				stopTic = maketic - COMMAND_BUFFER_SIZE;
-				
-				if ( gametic >= stopTic ) {
-					// Ideally, clients should run 1 gametic per frame. But if the client is
-					// waiting on the server to deliver more tics, the client has to stall
-					// if it runs out of buffered tics.
-					const int idealTic = gametic + 1;
-					
-					if ( idealTic < maketic ) {
-						stopTic = idealTic;
-					} else {
-						stopTic = maketic;
-					}
-				}
+				stopTic = gametic + JB_Playout( &netServer.jitter, maketic - gametic );
 			}			
 		}
 		
@@ -1469,6 +1466,9 @@ void iphoneFrame() {
 			// run the gametic with all the player and monster logic
 			// this will extract netcmds[player][gametic%BACKUPTICS] for each player
 //	Com_Printf( "gametic %i\n", gametic );
+			thinker_threads = thinkerThreads->value;
+			load_threads = loadThreads->value;
+			gl_levelcache = levelCache->value;
 			G_Ticker();
 
 			// if we just respawned with add-gear, give items now
@@ -1489,6 +1489,13 @@ void iphoneFrame() {
 			// generate the checksum for consistency failure testing
 			P_Checksum(gametic);
 			
+			// hand the state hash to the asyncTic for the others to check, and
+			// stop on the first tic found to differ from theirs
+			iphonePublishStateHash( gametic );
+			if ( statehash_desync != -1 ) {
+				netGameFailure = NF_CONSISTANCY;
+			}
+			
 			// on to the next tic
 			loggedTimes[iphoneFrameNum&(MAX_LOGGED_TIMES-1)].numGameTics++;
 			gametic++;
@@ -1538,7 +1545,11 @@ void iphoneFrame() {
     
 	// Draw the game screen.  This can also be called by the pacifier update
 	// during level loading.
+	boolean predicted = iphonePredictLocalPlayer();
 	iphoneDrawScreen();
+	if ( predicted ) {
+		P_UnpredictPlayer();
+	}
 	
 	// If we just loaded a level, do the texture precaching after we
 	// have drawn and displayed the first frame, so the user has
@@ -1611,7 +1622,7 @@ void iphoneDrawScreen() {
 			static ibutton_t btnSave;
 			if ( NewTextButton( &btnSave, "SAVE", 480-64, 0, 64, 32 ) ) {
 				G_SaveGame( 0, "ManualSave" );
-				G_DoSaveGame(true);
+				G_DoSnapshotGame();
 				AM_Stop();
 			}
 		}
@@ -1624,7 +1635,7 @@ void iphoneDrawScreen() {
         
         
 		// draw rotating pacifier icon 
-		PK_BindTexture( PK_FindTexture( "iphone/loading.tga" ) );
+		PK_BindTexture( PK_RequestTexture( "iphone/loading.tga", TS_PRI_IMMEDIATE ) );
 		glColor4f( 1, 1, 1, 1 );
 
 		float	cx = 240 * ((float)displaywidth) / 480.0f;
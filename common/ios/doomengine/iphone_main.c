@@ -232,6 +232,11 @@ cvar_t	*throttle;
 cvar_t	*centerSticks;
 cvar_t	*rampTurn;
 cvar_t	*netBuffer;
+cvar_t	*netPredict;
+cvar_t	*thinkerThreads;
+cvar_t	*loadThreads;
+cvar_t	*levelCache;
+cvar_t	*texUploadBudget;
 
 #define VERSION_BCONFIG	( 0x89490000 + sizeof( huds ) + sizeof( playState ) )
 
@@ -295,6 +300,62 @@ void ResetMaps_f() {
 	memset( playState.mapStats, 0, sizeof( playState.mapStats ) );
 }
 
+/*
+ ==================
+ Profile_f
+ 
+ "profile" starts recording the hot path zones, "profile stop" stops.
+ "profiledump [file]" writes a Chrome trace to the documents directory.
+ ==================
+ */
+void Profile_f() {
+	if ( !strcmp( Cmd_Argv( 1 ), "stop" ) ) {
+		M_ProfStop();
+		Com_Printf( "profiling stopped\n" );
+		return;
+	}
+	M_ProfStart( NULL );
+}
+
+/*
+ ==================
+ LoadBench_f
+ 
+ Loads every map with zone copies and with the mapped wad, see
+ G_BenchmarkLoads. Leaves the last map loaded.
+ ==================
+ */
+void LoadBench_f() {
+	G_BenchmarkLoads( gameskill );
+}
+
+/*
+ ==================
+ DemoSeek_f
+ 
+ Moves the demo being played the given number of seconds back or forward,
+ see G_DemoSeek.
+ ==================
+ */
+void DemoSeek_f() {
+	if ( Cmd_Argc() < 2 ) {
+		Com_Printf( "usage: demoseek <seconds>\n" );
+		return;
+	}
+	G_DemoSeek( gametic + (int)( atof( Cmd_Argv( 1 ) ) * TICRATE ) );
+}
+
+void ProfileDump_f() {
+	char	path[1024];
+	const char *name = Cmd_Argc() > 1 ? Cmd_Argv( 1 ) : "profile.json";
+	
+	snprintf( path, sizeof( path ), "%s/%s", SysIphoneGetDocDir(), name );
+	int count = M_ProfDump( path );
+	if ( count >= 0 ) {
+		Com_Printf( "%i events written to %s\n", count, path );
+	}
+}
+
 /*
  ==================
  iphoneStartup
@@ -310,6 +371,8 @@ void iphoneStartup() {
 	// microseconds will be plenty random for playerID and localGameID
 	playerID = localGameID = SysIphoneMicroseconds();
 	
+	iphoneInitCommandQueues();
+	
 	InitImmediateModeGL();
 
 	// init OpenAL before pak file, so the pak file can
@@ -324,11 +387,18 @@ void iphoneStartup() {
 	// register console commands
 	Cmd_AddCommand( "listcvars", Cvar_List_f );
 	Cmd_AddCommand( "resetcvars", Cvar_Reset_f );
+	Cmd_AddCommand( "cvarbench", Cvar_Benchmark_f );
+	Cmd_AddCommand( "texStats", PK_TextureStats_f );
 	Cmd_AddCommand( "resetmaps", ResetMaps_f );
 	Cmd_AddCommand( "listcmds", Cmd_ListCommands_f );
 	Cmd_AddCommand( "give", Give_f );
 	Cmd_AddCommand( "god", God_f );
 	Cmd_AddCommand( "mail", EmailConsole );  //gsh, mails the console to id
+	Cmd_AddCommand( "profile", Profile_f );
+	Cmd_AddCommand( "profiledump", ProfileDump_f );
+	Cmd_AddCommand( "loadtimes", P_PrintLoadTimes );
+	Cmd_AddCommand( "loadbench", LoadBench_f );
+	Cmd_AddCommand( "demoseek", DemoSeek_f );
 
 	// register console variables
 	Cvar_Get( "version", va( "%3.1f %s %s", DOOM_IPHONE_VERSION, __DATE__, __TIME__ ), 0 );
@@ -381,6 +451,11 @@ void iphoneStartup() {
 	
 	// Was origiinally 4. Trying different values to help internet play.
 	netBuffer = Cvar_Get( "netBuffer", "12", 0 );	// max tics to buffer ahead
+	netPredict = Cvar_Get( "netPredict", "1", 0 );	// draw clients where their own commands will take them
+	thinkerThreads = Cvar_Get( "thinkerThreads", "0", 0 );	// threads for the monster sight prepass
+	loadThreads = Cvar_Get( "loadThreads", "2", 0 );	// threads for blockmap and tesselation on level load
+	levelCache = Cvar_Get( "levelCache", "1", 0 );		// 0 = off, 2 = check the cache against a fresh tesselation
+	texUploadBudget = Cvar_Get( "texUploadBudget", "256", 0 );	// kb of texture uploads per frame, 0 = load on first use
 	
 	// load the archived cvars
 	Cmd_ExecuteFile( va( "%s/config.cfg", SysIphoneGetDocDir() ) );
@@ -426,7 +501,7 @@ void iphoneStartup() {
 	// the texnums might have been different in the savegame
 	HudSetTexnums();
 	
-	arialFontTexture = PK_FindTexture( "iphone/arialImageLAL.tga" );
+	arialFontTexture = PK_RequestTexture( "iphone/arialImageLAL.tga", TS_PRI_IMMEDIATE );
 	
 	Com_Printf( "preloadBeforePlay(): %i msec\n", SysIphoneMilliseconds() - start );	
 
@@ -458,6 +533,8 @@ void iphoneDoomStartup( const char * iwad, const char * pwad ) {
 	// put savegames here
     strcpy( basesavegame, SysIphoneGetDocDir() );
 	
+	// and anything written about a net game desync
+	statehash_dumpdir = SysIphoneGetDocDir();
 }
 
 /*
@@ -474,8 +551,10 @@ void iphoneShutdown() {
 	char	buffer[1024];
     
     if( lastState == IPM_GAME && gamestate != GS_INTERMISSION && !demoplayback ) {
-      G_DoSaveGame( false );
+      G_DoSnapshotGame();
     }
+    // the process is going away, so the save has to be on disk first
+    G_WaitSnapshotWrite();
     
 	// write the ascii config file
 	snprintf( path, sizeof( path ), "%s/config.cfg", SysIphoneGetDocDir() );
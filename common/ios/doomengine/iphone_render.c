@@ -50,6 +50,9 @@
 #include "lprintf.h"
 #include "gl_intern.h"
 #include "gl_struct.h"
+#include "m_profile.h"
+#include "r_drawlist.h"
+#include "p_saveg.h"
 
 // If the Doom levels had been built with realistic visibility
 // taken into account for the sky areas, we could just draw the
@@ -72,15 +75,61 @@ typedef struct {
 sortLine_t			sortLines[MAX_SORT_LINES];
 int					numSortLines;
 
+// Walls and flats go into draw lists as the BSP walk finds them, a bucket
+// per texture and state, so NewDrawScene has nothing to sort and makes one
+// glDrawElements per bucket out of a single merged index buffer.  The flats
+// index the sectors' drawVerts, the walls index static per-level pages.
+#define IR_STATE_SKY	1		// depth only, the sky is already drawn
+#define IR_STATE_ALPHA	2		// alpha tested two sided mid textures
+#define IR_STATE_FLAT	4		// bound with gld_BindFlat
+
+#define IR_LAYER_SKY	0		// sky walls first, to mask off the sky
+#define IR_LAYER_WALL	1
+#define IR_LAYER_ALPHA	2		// alpha tested walls after the opaque ones
+
+drawlist_t			flatList;
+
+// Every wall piece of a side gets a slot of four verts the first time it is
+// drawn and keeps it for the rest of the level.  The slot remembers what its
+// verts were built from, so a frame only rewrites the pieces whose heights or
+// texture coordinates were changed by a mover or scroller, and the colors of
+// the ones whose light changed or that were faded for a different view.
+// The indexes are shorts, so the slots are split into pages of 64k verts.
+#define IR_PIECE_SKYTOP		0
+#define IR_PIECE_TOP		1
+#define IR_PIECE_MID		2
+#define IR_PIECE_SKYBOTTOM	3
+#define IR_PIECE_BOTTOM		4
+#define IR_WALL_PIECES		5
+
+#define IR_PAGE_SLOTS		( MAX_DRAW_VERTS / 4 )
+#define IR_MAX_WALL_PAGES	8
+
+typedef struct {
+	float		ytop, ybottom;
+	float		ul, ur, vt, vb;
+	int			light;
+	unsigned	lightGen;
+} wallSlot_t;
+
 typedef struct {
-	GLTexture		*texture;
-	sector_t		*sector;
-	boolean			ceiling;
-} sortSectorPlane_t;
+	drawVert_t	*verts;
+	wallSlot_t	*slots;
+	drawlist_t	list;
+} wallPage_t;
+
+wallPage_t			wallPages[IR_MAX_WALL_PAGES];
+int					numWallPages;
+int					*sideSlots;		// numsides * IR_WALL_PIECES, -1 until drawn
+int					numWallSlots;
+
+// bumped whenever lightingVector changes, which invalidates all the colors
+unsigned			lightGen = 1;
 
-#define MAX_SECTOR_PLANES	1024
-sortSectorPlane_t	sectorPlanes[MAX_SECTOR_PLANES];
-int					numSectorPlanes;
+// bytes of vertex data written this frame, and what rebuilding every
+// visible wall quad and flat color each frame would have written
+int					c_vertBytes;
+int					c_vertBytesFull;
 
 typedef struct {
 	GLTexture		*tex;
@@ -207,6 +256,12 @@ void IR_InitLevel() {
 	BuildSideSegs();			// create a seg_t for each side_t so we can draw the
 								// unclipped versions that fit perfectly with the sectors
 	
+	// the wall pages went away with the last level's PU_LEVEL memory
+	sideSlots = Z_Malloc( numsides * IR_WALL_PIECES * sizeof( *sideSlots ), PU_LEVEL, 0 );
+	memset( sideSlots, -1, numsides * IR_WALL_PIECES * sizeof( *sideSlots ) );
+	numWallSlots = 0;
+	numWallPages = 0;
+	
 	// find something else used in the level for a default texture
 	for ( int i = 0 ; i < numsides ; i++ ) {
 		if ( sides[i].toptexture ) {
@@ -249,6 +304,171 @@ static int FadedLighting( float x, float y, int sectorLightLevel ) {
 	return sectorLightLevel | (sectorLightLevel<<8) | (sectorLightLevel<<16) | (255<<24);
 }
 
+/*
+ IR_AllocWallSlot
+ 
+ Gives a side's wall piece its four verts, which only need the heights,
+ texture coordinates and colors filled in.
+ */
+static int IR_AllocWallSlot( const side_t *side, int piece ) {
+	int	slot = numWallSlots;
+	int	page = slot / IR_PAGE_SLOTS;
+	
+	if ( page >= IR_MAX_WALL_PAGES ) {
+		return -1;
+	}
+	if ( page == numWallPages ) {
+		wallPages[page].verts = Z_Malloc( IR_PAGE_SLOTS * 4 * sizeof( drawVert_t ), PU_LEVEL, 0 );
+		wallPages[page].slots = Z_Malloc( IR_PAGE_SLOTS * sizeof( wallSlot_t ), PU_LEVEL, 0 );
+		DL_Clear( &wallPages[page].list );
+		numWallPages++;
+	}
+	numWallSlots++;
+	
+	drawVert_t	*dv = &wallPages[page].verts[( slot % IR_PAGE_SLOTS ) * 4];
+	dv[0].xyz[0] = dv[1].xyz[0] = -side->sideSeg.v1->x / MAP_SCALE;
+	dv[0].xyz[2] = dv[1].xyz[2] = side->sideSeg.v1->y / MAP_SCALE;
+	dv[2].xyz[0] = dv[3].xyz[0] = -side->sideSeg.v2->x / MAP_SCALE;
+	dv[2].xyz[2] = dv[3].xyz[2] = side->sideSeg.v2->y / MAP_SCALE;
+	c_vertBytes += 4 * 2 * sizeof( float );
+	
+	// a NaN height never compares equal, so the first draw fills everything
+	wallSlot_t	*ws = &wallPages[page].slots[slot % IR_PAGE_SLOTS];
+	memset( ws, 0, sizeof( *ws ) );
+	ws->ytop = NAN;
+	
+	sideSlots[( side - sides ) * IR_WALL_PIECES + piece] = slot;
+	return slot;
+}
+
+/*
+ IR_QueueWall
+ 
+ Updates whatever changed in a wall piece's static quad and adds it to the
+ wall list of its page.
+ */
+static void IR_QueueWall( const GLWall *wall, int piece ) {
+	dlindex_t	*indexes;
+	int			layer = IR_LAYER_WALL;
+	unsigned	state = 0;
+	
+	int	slot = sideSlots[( wall->side - sides ) * IR_WALL_PIECES + piece];
+	if ( slot < 0 ) {
+		// more than IR_MAX_WALL_PAGES of pieces in a level don't draw
+		slot = IR_AllocWallSlot( wall->side, piece );
+		if ( slot < 0 ) {
+			return;
+		}
+	}
+	rendered_segs++;
+	c_vertBytesFull += 4 * sizeof( drawVert_t );
+	
+	wallPage_t	*page = &wallPages[slot / IR_PAGE_SLOTS];
+	int			first = ( slot % IR_PAGE_SLOTS ) * 4;
+	drawVert_t	*dv = &page->verts[first];
+	wallSlot_t	*ws = &page->slots[slot % IR_PAGE_SLOTS];
+	
+	if ( ws->ytop != wall->ytop || ws->ybottom != wall->ybottom
+		|| ws->ul != wall->ul || ws->ur != wall->ur
+		|| ws->vt != wall->vt || ws->vb != wall->vb ) {
+		ws->ytop = wall->ytop;
+		ws->ybottom = wall->ybottom;
+		ws->ul = wall->ul;
+		ws->ur = wall->ur;
+		ws->vt = wall->vt;
+		ws->vb = wall->vb;
+		
+		dv[0].st[0] = wall->ul;
+		dv[0].st[1] = wall->vt;
+		dv[0].xyz[1] = wall->ytop;
+		dv[1].st[0] = wall->ul;
+		dv[1].st[1] = wall->vb;
+		dv[1].xyz[1] = wall->ybottom;
+		dv[2].st[0] = wall->ur;
+		dv[2].st[1] = wall->vt;
+		dv[2].xyz[1] = wall->ytop;
+		dv[3].st[0] = wall->ur;
+		dv[3].st[1] = wall->vb;
+		dv[3].xyz[1] = wall->ybottom;
+		c_vertBytes += 4 * 3 * sizeof( float );
+	}
+	
+	if ( ws->light != (int)wall->light || ws->lightGen != lightGen ) {
+		ws->light = wall->light;
+		ws->lightGen = lightGen;
+		*(int *)dv[0].rgba = FadedLighting( dv[0].xyz[0], dv[0].xyz[2], wall->light );
+		*(int *)dv[1].rgba = *(int *)dv[0].rgba;
+		*(int *)dv[2].rgba = FadedLighting( dv[2].xyz[0], dv[2].xyz[2], wall->light );
+		*(int *)dv[3].rgba = *(int *)dv[2].rgba;
+		c_vertBytes += 4 * sizeof( dv->rgba );
+	}
+	
+	if ( wall->flag == GLDWF_SKY ) {
+		layer = IR_LAYER_SKY;
+		state = IR_STATE_SKY;
+	} else if ( wall->flag == GLDWF_M2S ) {
+		layer = IR_LAYER_ALPHA;
+		state = IR_STATE_ALPHA;
+	}
+	
+	// add two tris to draw the wall
+	indexes = DL_AddIndexes( &page->list, layer, wall->gltexture, state, 6 );
+	indexes[0] = first;
+	indexes[1] = first+1;
+	indexes[2] = first+2;
+	indexes[3] = first+1;
+	indexes[4] = first+2;
+	indexes[5] = first+3;
+}
+
+/*
+ IR_QueueFlat
+ 
+ Updates a sector's floor or ceiling verts and adds its triangles to the flat
+ list.
+ 
+ If we were able to directly fill the GPU command buffers,
+ we would be using multiple DrawArrays instead of a single DrawElements,
+ and we would fill the plane height and color in as we copied vertexes
+ from a single set of verts per sector, but because the driver validation
+ overhead is the main poison on the iPhone currently, it is better to
+ duplicate the windings for the floors and ceilings, patch the
+ vertex data, and generate new index lists to minimize the number of
+ draw calls.
+ */
+static void IR_QueueFlat( sector_t *sector, int ceiling, GLTexture *tex ) {
+	drawVert_t *dv = sector->verts[ceiling];
+	
+	// Patch the height values if they have changed since the last draw.
+	float	y = ceiling ? sector->ceilingheight : sector->floorheight;
+	y *= ( 1.0 / MAP_SCALE );
+	if ( y != dv->xyz[1] ) {
+		for ( int j = 0 ; j < sector->numVerts ; j++ ) {
+			(dv+j)->xyz[1] = y;
+		}
+		c_vertBytes += sector->numVerts * sizeof( float );
+	}
+	
+	// per-vertex faded light color, only redone when the light or the view
+	// changed since the last time this plane was drawn
+	int	light = sector->lightlevel + (extralight<<5);
+	if ( light > 255 ) {
+		light = 255;
+	}
+	c_vertBytesFull += sector->numVerts * sizeof( dv->rgba );
+	if ( sector->vertLight[ceiling] != light || sector->vertLightGen[ceiling] != lightGen ) {
+		sector->vertLight[ceiling] = light;
+		sector->vertLightGen[ceiling] = lightGen;
+		for ( int j = 0 ; j < sector->numVerts ; j++ ) {
+			*(int *)(dv+j)->rgba = FadedLighting( (dv+j)->xyz[0], (dv+j)->xyz[2], light );
+		}
+		c_vertBytes += sector->numVerts * sizeof( dv->rgba );
+	}
+	
+	memcpy( DL_AddIndexes( &flatList, 0, tex, IR_STATE_FLAT, sector->numIndexes ),
+		   sector->indexes[ceiling], sector->numIndexes * sizeof( dlindex_t ) );
+}
+
 
 //
 // IR_ProjectSprite
@@ -547,17 +767,11 @@ wall.flag = GLDWF_SKY;\
 
 #define SKYTEXTURE(sky1,sky2)\
 wall.gltexture=NULL;\
+wall.ul=wall.ur=wall.vt=wall.vb=0.0f;\
 wall.flag = GLDWF_SKY;
 
-#define ADDWALL(wall)\
-{\
-if (gld_drawinfo.num_walls>=gld_drawinfo.max_walls)\
-{\
-gld_drawinfo.max_walls+=128;\
-gld_drawinfo.walls=Z_Realloc(gld_drawinfo.walls,gld_drawinfo.max_walls*sizeof(GLWall),PU_LEVEL,0);\
-}\
-gld_drawinfo.walls[gld_drawinfo.num_walls++]=*wall;\
-};
+#define ADDWALL(wall,piece)\
+IR_QueueWall(wall,piece);
 
 extern GLSeg *gl_segs;
 extern byte rendermarker;
@@ -596,14 +810,14 @@ void IR_AddWall(seg_t *seg)
 			wall.ytop=255.0f;
 			wall.ybottom=(float)thefrontsector->ceilingheight/MAP_SCALE;
 			SKYTEXTURE(thefrontsector->sky,thefrontsector->sky);
-			ADDWALL(&wall);
+			ADDWALL(&wall, IR_PIECE_SKYTOP);
 		}
 		if (thefrontsector->floorpic==skyflatnum)
 		{
 			wall.ytop=(float)thefrontsector->floorheight/MAP_SCALE;
 			wall.ybottom=-255.0f;
 			SKYTEXTURE(thefrontsector->sky,thefrontsector->sky);
-			ADDWALL(&wall);
+			ADDWALL(&wall, IR_PIECE_SKYBOTTOM);
 		}
 #endif		
 		temptex=gld_RegisterTexture(texturetranslation[seg->sidedef->midtexture], true, false);
@@ -615,7 +829,7 @@ void IR_AddWall(seg_t *seg)
 									 wall, seg, (LINE->flags & ML_DONTPEGBOTTOM)>0,
 									 seg->length, lineheight
 									 );
-			ADDWALL(&wall);
+			ADDWALL(&wall, IR_PIECE_MID);
 		}
 	}
 	else /* twosided */
@@ -642,7 +856,7 @@ void IR_AddWall(seg_t *seg)
 			{
 				wall.ybottom=(float)thebacksector->floorheight/MAP_SCALE;
 				SKYTEXTURE(thefrontsector->sky,thebacksector->sky);
-				ADDWALL(&wall);
+				ADDWALL(&wall, IR_PIECE_SKYTOP);
 			}
 			else
 			{
@@ -654,7 +868,7 @@ void IR_AddWall(seg_t *seg)
 					wall.ybottom=(float)MAX(thefrontsector->ceilingheight,thebacksector->ceilingheight)/MAP_SCALE;
 					
 					SKYTEXTURE(thefrontsector->sky,thebacksector->sky);
-					ADDWALL(&wall);
+					ADDWALL(&wall, IR_PIECE_SKYTOP);
 				}
 				else
 					if ( (thebacksector->ceilingheight <= thefrontsector->floorheight) ||
@@ -662,7 +876,7 @@ void IR_AddWall(seg_t *seg)
 					{
 						wall.ybottom=(float)thebacksector->ceilingheight/MAP_SCALE;
 						SKYTEXTURE(thefrontsector->sky,thebacksector->sky);
-						ADDWALL(&wall);
+						ADDWALL(&wall, IR_PIECE_SKYTOP);
 					}
 			}
 		}
@@ -681,7 +895,7 @@ void IR_AddWall(seg_t *seg)
 									wall, seg, (LINE->flags & (ML_DONTPEGBOTTOM | ML_DONTPEGTOP))==0,
 									seg->length, lineheight
 									);
-				ADDWALL(&wall);
+				ADDWALL(&wall, IR_PIECE_TOP);
 			}
 		}
 		
@@ -753,7 +967,7 @@ void IR_AddWall(seg_t *seg)
             if (seg->linedef->tranlump >= 0 && general_translucency)
                 wall.alpha=(float)tran_filter_pct/100.0f;
 			wall.alpha=1.0f;
-			ADDWALL(&wall);
+			ADDWALL(&wall, IR_PIECE_MID);
 		}
 	bottomtexture:
 		/* bottomtexture */
@@ -770,7 +984,7 @@ void IR_AddWall(seg_t *seg)
 			{
 				wall.ytop=(float)thebacksector->floorheight/MAP_SCALE;
 				SKYTEXTURE(thefrontsector->sky,thebacksector->sky);
-				ADDWALL(&wall);
+				ADDWALL(&wall, IR_PIECE_SKYBOTTOM);
 			}
 			else
 			{
@@ -778,7 +992,7 @@ void IR_AddWall(seg_t *seg)
 				{
 					wall.ytop=(float)thefrontsector->floorheight/MAP_SCALE;
 					SKYTEXTURE(thefrontsector->sky,thebacksector->sky);
-					ADDWALL(&wall);
+					ADDWALL(&wall, IR_PIECE_SKYBOTTOM);
 				}
 				else
 					if ( (thebacksector->floorheight >= thefrontsector->ceilingheight) ||
@@ -786,7 +1000,7 @@ void IR_AddWall(seg_t *seg)
 					{
 						wall.ytop=(float)thebacksector->floorheight/MAP_SCALE;
 						SKYTEXTURE(thefrontsector->sky,thebacksector->sky);
-						ADDWALL(&wall);
+						ADDWALL(&wall, IR_PIECE_SKYBOTTOM);
 					}
 			}
 		}
@@ -804,7 +1018,7 @@ void IR_AddWall(seg_t *seg)
 								   seg->length, lineheight,
 								   floor_height-thefrontsector->ceilingheight
 								   );
-			ADDWALL(&wall);
+			ADDWALL(&wall, IR_PIECE_BOTTOM);
 		}
 	}
 }
@@ -944,10 +1158,7 @@ void IR_Subsector(int num)
 				// contains the number of the current animation frame
 				GLTexture *tex = gld_RegisterFlat(flattranslation[thefrontsector->floorpic], true);
 				if ( tex ) {
-					sectorPlanes[numSectorPlanes].texture = tex;
-					sectorPlanes[numSectorPlanes].ceiling = false;
-					sectorPlanes[numSectorPlanes].sector = thefrontsector;
-					numSectorPlanes++;
+					IR_QueueFlat( thefrontsector, 0, tex );
 				}
 			}
 		}
@@ -959,10 +1170,7 @@ void IR_Subsector(int num)
 				// contains the number of the current animation frame
 				GLTexture *tex = gld_RegisterFlat(flattranslation[thefrontsector->ceilingpic], true);
 				if ( tex ) {
-					sectorPlanes[numSectorPlanes].texture = tex;
-					sectorPlanes[numSectorPlanes].ceiling = true;
-					sectorPlanes[numSectorPlanes].sector = thefrontsector;
-					numSectorPlanes++;
+					IR_QueueFlat( thefrontsector, 1, tex );
 				}
 			}
 		}
@@ -1073,7 +1281,10 @@ void IR_Subsector(int num)
 		line->validcount = validcount;
 
 		// this line can show up on the automap now
-		line->flags |= ML_MAPPED;
+		if ( !( line->flags & ML_MAPPED ) ) {
+			line->flags |= ML_MAPPED;
+			P_MarkLineDirty( line );
+		}
 	
 		// Adding a line may generate up to four drawn walls -- a top wall,
 		// a bottom wall, a perforated middle wall, and a sky wall.
@@ -1202,18 +1413,6 @@ static void IR_RenderBSPNode( int bspnum ) {
 }
 
 
-typedef struct {
-	void *texture;
-	void *user;
-} texSort_t;
-
-static int TexSort( const void *a, const void *b ) {
-	if ( ((texSort_t *)a)->texture < ((texSort_t *)b)->texture ) {
-		return -1;
-	}
-	return 1;
-}
-
 int SysIphoneMicroseconds();
 void SetImmediateModeGLVertexArrays();
 extern float yaw;
@@ -1222,13 +1421,42 @@ extern GLTexture **gld_GLPatchTextures;
 extern GLVertex *gld_vertexes;
 extern GLTexcoord *gld_texcoords;
 
-#define MAX_DRAW_INDEXES	0x10000
-unsigned short	drawIndexes[MAX_DRAW_INDEXES];
-int			numDrawIndexes;
-
 drawVert_t		drawVerts[MAX_DRAW_VERTS];
 int			numDrawVerts;
 
+// the draw list backend
+static void IR_SetState( unsigned state ) {
+	// Sky walls aren't actually drawing anything, they are just
+	// masking off areas in the depth buffer so nothing can
+	// overwrite the already drawn sky image
+	if ( state & IR_STATE_SKY ) {
+		glColorMask( 0, 0, 0, 0 );
+	} else {
+		glColorMask( 1, 1, 1, 1 );
+	}
+	if ( state & IR_STATE_ALPHA ) {
+		glEnable( GL_ALPHA_TEST );
+	} else {
+		glDisable( GL_ALPHA_TEST );
+	}
+}
+
+static void IR_BindTexture( const void *texture, unsigned state ) {
+	if ( state & IR_STATE_FLAT ) {
+		gld_BindFlat( (GLTexture *)texture );
+	} else {
+		gld_BindTexture( (GLTexture *)texture );
+	}
+}
+
+static void IR_DrawIndexed( const dlindex_t *indexes, int count ) {
+	glDrawElements( GL_TRIANGLES, count, GL_UNSIGNED_SHORT, indexes );
+}
+
+static const dlbackend_t irBackend = {
+	IR_SetState, IR_BindTexture, IR_DrawIndexed
+};
+
 void NewDrawScene(player_t *player)	// JDC: new version
 {
 	int i,k;
@@ -1306,11 +1534,6 @@ void NewDrawScene(player_t *player)	// JDC: new version
 		glPopMatrix();
 	}
 
-	// walls and flats use the drawVerts array for everything
-	glTexCoordPointer(2,GL_FLOAT,sizeof(drawVert_t),drawVerts[0].st);
-	glVertexPointer(3,GL_FLOAT,sizeof(drawVert_t),drawVerts[0].xyz);
-	glColorPointer(4,GL_UNSIGNED_BYTE,sizeof(drawVert_t),drawVerts[0].rgba);
-	
 	// everything will draw at full brightness in this case
 	if (player->fixedcolormap) {
 		glColor4f(1.0f, 1.0f, 1.0f, 1.0f );
@@ -1319,178 +1542,29 @@ void NewDrawScene(player_t *player)	// JDC: new version
 		glEnableClientState( GL_COLOR_ARRAY );
 	}
 	
-	int	c_drawElements = 0;
-	numDrawIndexes = 0;
-	
-	//-----------------------------------------
-	// draw all the walls, sky walls sorted first
-	//-----------------------------------------
-	// sort the walls by texture
-	texSort_t	*wallSort = alloca( sizeof( wallSort[0] ) * gld_drawinfo.num_walls );
-	for (i=0 ; i < gld_drawinfo.num_walls ; i++ ) {
-		GLWall *wall = &gld_drawinfo.walls[i];
-		wallSort[i].texture = wall->gltexture;
-		wallSort[i].user = wall;
-	}
-	qsort( wallSort, gld_drawinfo.num_walls, sizeof( wallSort[0] ), TexSort );
-	
-	// continue building drawverts after the floor and ceiling data 
-	int		tempDrawVert = numDrawVerts;
-	
 	// alpha tested walls will use half alpha to get the best edging effects
 	glAlphaFunc( GL_GREATER, 0.5 );
 	
-	for (i=0 ; i < gld_drawinfo.num_walls ; i++ ) {
-		texSort_t *sort = &wallSort[i];
-		GLWall *wall = sort->user;
-		rendered_segs++;
-		
-		// add two tris to draw the wall
-		drawIndexes[numDrawIndexes+0] = tempDrawVert;
-		drawIndexes[numDrawIndexes+1] = tempDrawVert+1;
-		drawIndexes[numDrawIndexes+2] = tempDrawVert+2;
-		
-		drawIndexes[numDrawIndexes+3] = tempDrawVert+1;
-		drawIndexes[numDrawIndexes+4] = tempDrawVert+2;
-		drawIndexes[numDrawIndexes+5] = tempDrawVert+3;
-		
-		numDrawIndexes += 6;
-		
-		unsigned char	rgba[4];
-		rgba[0] = rgba[1] = rgba[2] = wall->light;
-		rgba[3] = 255;
-		int lightInt = *(int *)rgba;		
-		
-		drawVerts[tempDrawVert].st[0] = wall->ul;
-		drawVerts[tempDrawVert].st[1] = wall->vt;
-		drawVerts[tempDrawVert].xyz[0] = -wall->side->sideSeg.v1->x / MAP_SCALE;
-		drawVerts[tempDrawVert].xyz[1] = wall->ytop;
-		drawVerts[tempDrawVert].xyz[2] = wall->side->sideSeg.v1->y / MAP_SCALE;
-		
-		lightInt = FadedLighting( drawVerts[tempDrawVert].xyz[0], drawVerts[tempDrawVert].xyz[2], wall->light );
-		
-		*(int *)drawVerts[tempDrawVert].rgba = lightInt;
-		tempDrawVert++;
-		
-		drawVerts[tempDrawVert].st[0] = wall->ul;
-		drawVerts[tempDrawVert].st[1] = wall->vb;
-		drawVerts[tempDrawVert].xyz[0] = -wall->side->sideSeg.v1->x / MAP_SCALE;
-		drawVerts[tempDrawVert].xyz[1] = wall->ybottom;
-		drawVerts[tempDrawVert].xyz[2] = wall->side->sideSeg.v1->y / MAP_SCALE;
-		*(int *)drawVerts[tempDrawVert].rgba = lightInt;
-		tempDrawVert++;
-		
-		drawVerts[tempDrawVert].st[0] = wall->ur;
-		drawVerts[tempDrawVert].st[1] = wall->vt;
-		drawVerts[tempDrawVert].xyz[0] = -wall->side->sideSeg.v2->x / MAP_SCALE;
-		drawVerts[tempDrawVert].xyz[1] = wall->ytop;
-		drawVerts[tempDrawVert].xyz[2] = wall->side->sideSeg.v2->y / MAP_SCALE;
-		
-		lightInt = FadedLighting( drawVerts[tempDrawVert].xyz[0], drawVerts[tempDrawVert].xyz[2], wall->light );
-		*(int *)drawVerts[tempDrawVert].rgba = lightInt;
-		tempDrawVert++;
-		
-		drawVerts[tempDrawVert].st[0] = wall->ur;
-		drawVerts[tempDrawVert].st[1] = wall->vb;
-		drawVerts[tempDrawVert].xyz[0] = -wall->side->sideSeg.v2->x / MAP_SCALE;
-		drawVerts[tempDrawVert].xyz[1] = wall->ybottom;
-		drawVerts[tempDrawVert].xyz[2] = wall->side->sideSeg.v2->y / MAP_SCALE;
-		*(int *)drawVerts[tempDrawVert].rgba = lightInt;
-		tempDrawVert++;		
-		
-		// only draw when textures change
-		if ( i == gld_drawinfo.num_walls-1 || sort->texture != (sort+1)->texture ) {
-			if ( numDrawIndexes ) {
-				if ( wall->flag == GLDWF_SKY ) {
-					// we aren't actually drawing anything with this,
-					// we are just masking off areas in the depth
-					// buffer so nothing can overwrite the already
-					// drawn sky image
-					glColorMask( 0, 0, 0, 0 );
-				}
-				if ( wall->flag == GLDWF_M2S ) {
-					glEnable( GL_ALPHA_TEST );
-				}
-				
-				if ( wall->gltexture ) {	// skies are texture = NULL
-					gld_BindTexture( wall->gltexture );
-				}
-				
-				glDrawElements( GL_TRIANGLES, numDrawIndexes, GL_UNSIGNED_SHORT,
-							   drawIndexes );
-				
-				if ( wall->flag == GLDWF_M1S ) {
-					glDisable( GL_ALPHA_TEST );
-				}
-				if ( wall->flag == GLDWF_SKY ) {
-					glColorMask( 1, 1, 1, 1 );
-				}
-				
-				numDrawIndexes = 0;
-				tempDrawVert = numDrawVerts;
-				c_drawElements++;
-			}
-		}
-		
+	//-----------------------------------------
+	// draw all the walls, sky walls first
+	//-----------------------------------------
+	for ( int i = 0 ; i < numWallPages ; i++ ) {
+		wallPage_t *page = &wallPages[i];
+		DL_Finish( &page->list );
+		glTexCoordPointer(2,GL_FLOAT,sizeof(drawVert_t),page->verts[0].st);
+		glVertexPointer(3,GL_FLOAT,sizeof(drawVert_t),page->verts[0].xyz);
+		glColorPointer(4,GL_UNSIGNED_BYTE,sizeof(drawVert_t),page->verts[0].rgba);
+		DL_Submit( &page->list, &irBackend );
 	}
 	
 	//-----------------------------------------
-	// draw all the flats
-	//
-	// If we were able to directly fill the GPU command buffers,
-	// we would be using multiple DrawArrays instead of a single DrawElements,
-	// and we would fill the plane height and color in as we copied vertexes
-	// from a single set of verts per sector, but because the driver validation
-	// overhead is the main poison on the iPhone currently, it is better to
-	// duplicate the windings for the floors and ceilings, patch the
-	// vertex data, and generate new index lists to minimize the number of
-	// draw calls.
+	// draw all the flats, from the sector verts in drawVerts
 	//-----------------------------------------
-	
-	// sort the flats by texture
-	qsort( sectorPlanes, numSectorPlanes, sizeof( sectorPlanes[0] ), TexSort );
-	
-	// draw them in texture order
-	for (i=0 ; i < numSectorPlanes ; i++ ) {
-		sortSectorPlane_t *sort = &sectorPlanes[i];
-		sector_t *sector = sort->sector;
-		
-		drawVert_t *dv = sector->verts[(int)sort->ceiling];
-		
-		// Patch the height values if they have changed since the last draw.
-		float	y = sort->ceiling ? sector->ceilingheight : sector->floorheight;
-		y *= ( 1.0 / MAP_SCALE );
-		if ( y != dv->xyz[1] ) {
-			for ( int j = 0 ; j < sector->numVerts ; j++ ) {
-				(dv+j)->xyz[1] = y;
-			}
-		}
-
-		// per-vertex faded light color
-		int	light = sector->lightlevel + (extralight<<5);
-		if ( light > 255 ) {
-			light = 255;
-		}
-		for ( int j = 0 ; j < sector->numVerts ; j++ ) {
-			*(int *)(dv+j)->rgba = FadedLighting( (dv+j)->xyz[0], (dv+j)->xyz[2], light );
-		}
-		
-		// copy the indexes
-		assert( numDrawIndexes + sector->numIndexes < MAX_DRAW_INDEXES );
-		memcpy( drawIndexes + numDrawIndexes, sector->indexes[(int)sort->ceiling], sector->numIndexes*sizeof(drawIndexes[0]) );
-		numDrawIndexes += sector->numIndexes;
-		
-		// only change textures when necessary
-		if ( i == numSectorPlanes - 1 || sort->texture != (sort+1)->texture ) {
-			if ( numDrawIndexes ) {
-				gld_BindFlat( sort->texture );			
-				glDrawElements( GL_TRIANGLES, numDrawIndexes, GL_UNSIGNED_SHORT,
-							   drawIndexes );
-				numDrawIndexes = 0;
-				c_drawElements++;
-			}
-		}
-	}
+	DL_Finish( &flatList );
+	glTexCoordPointer(2,GL_FLOAT,sizeof(drawVert_t),drawVerts[0].st);
+	glVertexPointer(3,GL_FLOAT,sizeof(drawVert_t),drawVerts[0].xyz);
+	glColorPointer(4,GL_UNSIGNED_BYTE,sizeof(drawVert_t),drawVerts[0].rgba);
+	DL_Submit( &flatList, &irBackend );
 	
 	glDisableClientState( GL_COLOR_ARRAY );
 	
@@ -1731,9 +1805,18 @@ void IR_RenderPlayerView (player_t* player) {
 	
 	// setup the vector for calculating light fades, which is just a scale
 	// of the forward vector
-	lightingVector[0] = lightDistance * glMVPmatrix[2];
-	lightingVector[1] = lightDistance * glMVPmatrix[10];
-	lightingVector[2] = lightDistance * glMVPmatrix[14];
+	// all the cached vertex colors are stale if it changed
+	{
+		float	v0 = lightDistance * glMVPmatrix[2];
+		float	v1 = lightDistance * glMVPmatrix[10];
+		float	v2 = lightDistance * glMVPmatrix[14];
+		if ( v0 != lightingVector[0] || v1 != lightingVector[1] || v2 != lightingVector[2] ) {
+			lightingVector[0] = v0;
+			lightingVector[1] = v1;
+			lightingVector[2] = v2;
+			lightGen++;
+		}
+	}
 	
 	
 	rendermarker++;
@@ -1745,12 +1828,21 @@ void IR_RenderPlayerView (player_t* player) {
 	c_occludedSprites = 0;
 	c_sectors = 0;
 	c_subsectors = 0;
-	numSectorPlanes = 0;
+	for ( int i = 0 ; i < numWallPages ; i++ ) {
+		DL_Clear( &wallPages[i].list );
+	}
+	DL_Clear( &flatList );
+	c_vertBytes = 0;
+	c_vertBytesFull = 0;
 	failCount = 0;
 	
 	// Find everything we need to draw, but don't draw anything yet,
 	// because we want to sort by texture to reduce GL driver overhead.
-	IR_RenderBSPNode( numnodes-1 );
+	{
+		PROF_BEGIN(IR_RenderBSPNode);
+		IR_RenderBSPNode( numnodes-1 );
+		PROF_END(IR_RenderBSPNode);
+	}
 	
     NewDrawScene(player);
 
@@ -1758,7 +1850,7 @@ void IR_RenderPlayerView (player_t* player) {
 	
 	if ( showRenderTime ) {
 		int end = SysIphoneMicroseconds();
-		printf( "%i usec\n", end - start );
+		printf( "%i usec, %i of %i vertex bytes rewritten\n", end - start, c_vertBytes, c_vertBytesFull );
 	}
 }
 
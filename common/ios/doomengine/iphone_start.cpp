@@ -219,10 +219,18 @@ boolean StartNetGame() {
 	}
 	
 	gametic = 0;
-	maketic = 1;	// allow everyone to run the first frame without waiting for a packet
+	iphoneResetCommands( 1 );	// allow everyone to run the first frame without waiting for a packet
+	
+	// every peer starts with the smallest playout buffer and grows it
+	// from the delay variation it sees
+	JB_Init( &netServer.jitter, 1000 / 30 );	// asyncTic rate, not TICRATE
+	for ( int i = 0 ; i < MAXPLAYERS ; i++ ) {
+		JB_Init( &netPlayers[i].peer.jitter, 1000 / 30 );
+	}
 	
 	memset( netcmds, 0, sizeof( netcmds ) );
 	memset( consistancy, 0, sizeof( consistancy ) );
+	statehash_desync = -1;
 	
 	gameID = setupPacket.gameID;
 	
@@ -77,8 +77,9 @@ char *va( const char *format, ... ) {
 	return string;	
 }
 
+// case insensitive, so cvars can be found with any capitalization
 int HashString( const char *string ) {
-	int hash = *string;
+	int hash = tolower( *string );
 	
 	if( hash ) {
 		for( string += 1; *string != '\0'; ++string ) {
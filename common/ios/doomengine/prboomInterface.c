@@ -29,6 +29,7 @@
 
 
 #include "doomiphone.h"
+#include <sys/time.h>
 
 int	desired_fullscreen;
 int usejoystick;
@@ -160,6 +161,12 @@ void I_EndDisplay(void) {}
 int I_GetTime_RealTime(void) { return 0; }
 fixed_t I_GetTimeFrac (void) { return 0; }
 void I_GetTime_SaveMS(void) {}
+uint_64_t I_GetTime_US(void) {
+	struct timeval	tp;
+	gettimeofday( &tp, NULL );
+	return (uint_64_t)tp.tv_sec * 1000000 + tp.tv_usec;
+}
+boolean I_ReadMemCounters(uint_64_t *cachemisses, uint_64_t *tlbmisses) { return false; }
 unsigned long I_GetRandomTimeSeed(void) { return 0; }
 
 //const char* I_GetVersionString(char* buf, size_t sz);
@@ -0,0 +1,434 @@
+/*
+ *  texstream.c
+ *  doom
+ *
+ *  Background page-in and budgeted upload scheduling for pak textures.
+ *
+ */
+/*
+
+ Copyright (C) 2009 Id Software, Inc.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+ */
+
+// This file deliberately doesn't include doomiphone.h, so it can be built
+// and exercised without GL or the rest of the engine.
+#include <pthread.h>
+#include <limits.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include "texstream.h"
+
+tsStats_t	tsStats;
+
+static void	(*tsUpload)( void *owner );
+static int	(*tsMicroseconds)( void );
+
+// everything below is protected by tsMutex
+static pthread_mutex_t	tsMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t	tsWake = PTHREAD_COND_INITIALIZER;		// something to page in
+static pthread_cond_t	tsIdle = PTHREAD_COND_INITIALIZER;		// the thread finished one
+static tsEntry_t		*pagingList;
+static tsEntry_t		*stagedList;
+static int				tsBusy;			// the thread is touching an entry
+static int				tsPending;
+static int				tsThreaded;		// otherwise requests go straight to staged
+
+/*
+ ==================
+ TS_Highest
+
+ The oldest entry of the highest priority. New entries are pushed
+ on the front, so that is the last one of equal priority.
+ ==================
+ */
+static tsEntry_t **TS_Highest( tsEntry_t **list ) {
+	tsEntry_t **best = NULL;
+	for ( tsEntry_t **e = list ; *e ; e = &(*e)->next ) {
+		if ( !best || (*e)->priority >= (*best)->priority ) {
+			best = e;
+		}
+	}
+	return best;
+}
+
+static int TS_Unlink( tsEntry_t **list, tsEntry_t *entry ) {
+	for ( tsEntry_t **e = list ; *e ; e = &(*e)->next ) {
+		if ( *e == entry ) {
+			*e = entry->next;
+			entry->next = NULL;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/*
+ ==================
+ TS_PageIn
+
+ Reading one byte from each page is enough to get the mmapped file
+ into memory, which is the part that stalls.
+ ==================
+ */
+static int TS_PageIn( const unsigned char *data, int size ) {
+	volatile const unsigned char *p = data;
+	int		sum = 0;
+	for ( int i = 0 ; i < size ; i += 4096 ) {
+		sum += p[i];
+	}
+	if ( size > 0 ) {
+		sum += p[size-1];
+	}
+	return sum;
+}
+
+/*
+ ==================
+ TS_Thread
+
+ ==================
+ */
+static void *TS_Thread( void *arg ) {
+	pthread_mutex_lock( &tsMutex );
+	while ( 1 ) {
+		while ( !pagingList ) {
+			pthread_cond_wait( &tsWake, &tsMutex );
+		}
+		tsEntry_t **best = TS_Highest( &pagingList );
+		tsEntry_t *e = *best;
+		*best = e->next;
+		e->next = NULL;
+		tsBusy = 1;
+		pthread_mutex_unlock( &tsMutex );
+
+		TS_PageIn( e->data, e->size );
+
+		pthread_mutex_lock( &tsMutex );
+		tsBusy = 0;
+		// an immediate request may have uploaded it while we were paging
+		if ( e->state == TS_PAGING ) {
+			e->state = TS_STAGED;
+			e->next = stagedList;
+			stagedList = e;
+		}
+		pthread_cond_broadcast( &tsIdle );
+	}
+	return NULL;
+}
+
+/*
+ ==================
+ TS_Init
+
+ ==================
+ */
+void TS_Init( void (*upload)( void *owner ), int (*microseconds)( void ) ) {
+	tsUpload = upload;
+	tsMicroseconds = microseconds;
+
+	if ( !tsThreaded ) {
+		pthread_t	thread;
+		if ( pthread_create( &thread, NULL, TS_Thread, NULL ) == 0 ) {
+			pthread_detach( thread );
+			tsThreaded = 1;
+		}
+	}
+}
+
+/*
+ ==================
+ TS_Uploaded
+
+ Called on the GL thread after the callback has run.
+ ==================
+ */
+static void TS_Uploaded( tsEntry_t *e ) {
+	int latency = tsMicroseconds() - e->requestTime;
+
+	tsStats.uploads++;
+	tsStats.bytesUploaded += e->size;
+	tsStats.totalLatency += latency;
+	if ( latency > tsStats.maxLatency ) {
+		tsStats.maxLatency = latency;
+	}
+}
+
+/*
+ ==================
+ TS_Request
+
+ Raising the priority of an entry that is already queued is allowed.
+ ==================
+ */
+void TS_Request( tsEntry_t *e, int priority ) {
+	if ( e->state == TS_READY ) {
+		return;
+	}
+
+	pthread_mutex_lock( &tsMutex );
+	if ( e->state == TS_IDLE ) {
+		tsStats.requests++;
+		tsPending++;
+		e->requestTime = tsMicroseconds();
+		e->priority = priority;
+		if ( tsThreaded ) {
+			e->state = TS_PAGING;
+			e->next = pagingList;
+			pagingList = e;
+			pthread_cond_signal( &tsWake );
+		} else {
+			e->state = TS_STAGED;
+			e->next = stagedList;
+			stagedList = e;
+		}
+	} else if ( priority > e->priority ) {
+		e->priority = priority;
+	}
+
+	if ( priority < TS_PRI_IMMEDIATE ) {
+		pthread_mutex_unlock( &tsMutex );
+		return;
+	}
+
+	// it has to be there before we return
+	TS_Unlink( &pagingList, e );
+	TS_Unlink( &stagedList, e );
+	e->state = TS_READY;
+	tsPending--;
+	pthread_mutex_unlock( &tsMutex );
+
+	tsUpload( e->owner );
+	tsStats.immediateUploads++;
+	TS_Uploaded( e );
+}
+
+/*
+ ==================
+ TS_Service
+
+ Uploads staged textures until the next one would go over the budget.
+ At least one is always uploaded, so a texture larger than the budget
+ still gets through.
+ ==================
+ */
+int TS_Service( int byteBudget ) {
+	int	bytes = 0;
+
+	while ( 1 ) {
+		pthread_mutex_lock( &tsMutex );
+		tsEntry_t **best = TS_Highest( &stagedList );
+		if ( !best || ( bytes > 0 && bytes + (*best)->size > byteBudget ) ) {
+			pthread_mutex_unlock( &tsMutex );
+			break;
+		}
+		tsEntry_t *e = *best;
+		*best = e->next;
+		e->next = NULL;
+		e->state = TS_READY;
+		tsPending--;
+		pthread_mutex_unlock( &tsMutex );
+
+		tsUpload( e->owner );
+		TS_Uploaded( e );
+		if ( e->size > byteBudget ) {
+			tsStats.oversized++;
+		}
+		bytes += e->size;
+	}
+
+	if ( bytes > tsStats.maxFrameBytes ) {
+		tsStats.maxFrameBytes = bytes;
+	}
+	return bytes;
+}
+
+/*
+ ==================
+ TS_Finish
+
+ For loading screens and anything else that would rather wait once.
+ Entries still waiting to be paged in are uploaded directly; the upload
+ faults them in anyway.
+ ==================
+ */
+void TS_Finish( void ) {
+	pthread_mutex_lock( &tsMutex );
+	while ( pagingList ) {
+		tsEntry_t *e = pagingList;
+		pagingList = e->next;
+		e->state = TS_STAGED;
+		e->next = stagedList;
+		stagedList = e;
+	}
+	while ( tsBusy ) {
+		pthread_cond_wait( &tsIdle, &tsMutex );
+	}
+	pthread_mutex_unlock( &tsMutex );
+
+	TS_Service( INT_MAX );
+}
+
+/*
+ ==================
+ TS_Pending
+
+ ==================
+ */
+int TS_Pending( void ) {
+	return tsPending;
+}
+
+/*
+ ==================
+ TS_Check
+
+ Runs the scheduler against a fixed set of requests with a stub upload
+ and checks the order things come out in and the bytes each frame takes.
+ It takes over the callbacks, so it is for the headless build, not the
+ game. Returns the number of failures.
+ ==================
+ */
+#define TS_CHECK_BUDGET		(100*1024)
+
+static int	tsCheckOrder[16];
+static int	tsCheckUploads;
+static int	tsCheckClock;
+
+static void TS_CheckUpload( void *owner ) {
+	if ( tsCheckUploads < 16 ) {
+		tsCheckOrder[tsCheckUploads] = (int)(size_t)owner;
+	}
+	tsCheckUploads++;
+}
+
+static int TS_CheckMicroseconds( void ) {
+	return tsCheckClock += 10;
+}
+
+static int TS_CheckUploads( const char *what, const int *expect, int count ) {
+	int	ok = ( tsCheckUploads == count );
+	for ( int i = 0 ; ok && i < count ; i++ ) {
+		ok = ( tsCheckOrder[i] == expect[i] );
+	}
+	printf( "  %-24s", what );
+	for ( int i = 0 ; i < tsCheckUploads && i < 16 ; i++ ) {
+		printf( " %i", tsCheckOrder[i] );
+	}
+	printf( ", %s\n", ok ? "ok" : "FAILED" );
+	tsCheckUploads = 0;
+	return !ok;
+}
+
+int TS_Check( void ) {
+	static unsigned char	bits[128*1024];
+	static const struct {
+		int		priority;
+		int		kb;
+	} requests[] = {
+		{ TS_PRI_NORMAL, 64 },		// 0
+		{ TS_PRI_PREFETCH, 32 },	// 1
+		{ TS_PRI_VISIBLE, 48 },		// 2
+		{ TS_PRI_NORMAL, 16 },		// 3
+		{ TS_PRI_VISIBLE, 16 },		// 4
+		{ TS_PRI_PREFETCH, 128 },	// 5, more than the whole budget
+		{ TS_PRI_NORMAL, 32 },		// 6, raised to visible below
+		{ TS_PRI_NORMAL, 8 },		// 7, made immediate below
+	};
+	// highest priority first, in request order within one, and a frame
+	// stops before the texture that would take it over the budget
+	static const int frames[][4] = {
+		{ 2, 4, 6, -1 },	// 96k
+		{ 0, 3, -1 },		// 80k, prefetch 1 would make it 112k
+		{ 1, -1 },			// 32k, 5 would make it 160k
+		{ 5, -1 },			// 128k alone, at least one goes every frame
+		{ -1 }
+	};
+	static const int frameBytes[] = { 96*1024, 80*1024, 32*1024, 128*1024, 0 };
+	enum { NUM_REQUESTS = sizeof( requests ) / sizeof( requests[0] ) };
+	tsEntry_t	entries[NUM_REQUESTS + 3];
+	int			errors = 0;
+
+	printf( "TS_Check: %i requests, %ik per frame\n", NUM_REQUESTS, TS_CHECK_BUDGET / 1024 );
+
+	memset( &tsStats, 0, sizeof( tsStats ) );
+	memset( entries, 0, sizeof( entries ) );
+	for ( int i = 0 ; i < NUM_REQUESTS + 3 ; i++ ) {
+		entries[i].data = bits;
+		entries[i].size = 16*1024;
+		entries[i].owner = (void *)(size_t)i;
+	}
+	TS_Init( TS_CheckUpload, TS_CheckMicroseconds );
+
+	for ( int i = 0 ; i < NUM_REQUESTS ; i++ ) {
+		entries[i].size = requests[i].kb * 1024;
+		TS_Request( &entries[i], requests[i].priority );
+	}
+
+	// an immediate request is uploaded before it returns, whatever it was queued as
+	TS_Request( &entries[7], TS_PRI_IMMEDIATE );
+	static const int immediate[] = { 7 };
+	errors += TS_CheckUploads( "immediate:", immediate, 1 );
+	TS_Request( &entries[6], TS_PRI_VISIBLE );
+
+	// let the page-in thread stage everything, so the frames below
+	// don't depend on how far it got
+	pthread_mutex_lock( &tsMutex );
+	while ( pagingList || tsBusy ) {
+		pthread_cond_wait( &tsIdle, &tsMutex );
+	}
+	pthread_mutex_unlock( &tsMutex );
+
+	for ( int f = 0 ; f < (int)( sizeof( frameBytes ) / sizeof( frameBytes[0] ) ) ; f++ ) {
+		char	what[32];
+		int		count = 0;
+
+		while ( frames[f][count] >= 0 ) {
+			count++;
+		}
+		int bytes = TS_Service( TS_CHECK_BUDGET );
+		snprintf( what, sizeof( what ), "frame %i, %3ik:", f, bytes / 1024 );
+		errors += TS_CheckUploads( what, frames[f], count );
+		if ( bytes != frameBytes[f] ) {
+			printf( "  frame %i took %i bytes, expected %i\n", f, bytes, frameBytes[f] );
+			errors++;
+		}
+	}
+
+	// TS_Finish takes whatever is still paging in as well
+	for ( int i = NUM_REQUESTS ; i < NUM_REQUESTS + 3 ; i++ ) {
+		TS_Request( &entries[i], TS_PRI_NORMAL );
+	}
+	TS_Finish();
+	int finished = tsCheckUploads;
+	tsCheckUploads = 0;
+	printf( "  finish: %i uploads, %i pending, %s\n", finished, TS_Pending(),
+		finished == 3 && TS_Pending() == 0 ? "ok" : "FAILED" );
+	if ( finished != 3 || TS_Pending() != 0 ) {
+		errors++;
+	}
+
+	printf( "  %i requests, %i uploads, %i immediate, %i oversized, max %ik in a frame, %s\n",
+		tsStats.requests, tsStats.uploads, tsStats.immediateUploads, tsStats.oversized,
+		tsStats.maxFrameBytes / 1024,
+		tsStats.uploads == NUM_REQUESTS + 3 && tsStats.immediateUploads == 1 && tsStats.oversized == 1 ? "ok" : "FAILED" );
+	if ( tsStats.uploads != NUM_REQUESTS + 3 || tsStats.immediateUploads != 1 || tsStats.oversized != 1 ) {
+		errors++;
+	}
+	return errors;
+}
@@ -0,0 +1,85 @@
+/*
+ *  texstream.h
+ *  doom
+ *
+ *  Background page-in and budgeted upload scheduling for pak textures.
+ *
+ */
+/*
+
+ Copyright (C) 2009 Id Software, Inc.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+ */
+
+#ifndef TEXSTREAM_H
+#define TEXSTREAM_H
+
+// The texture bits live in the mmapped pak file, so the expensive parts of
+// a first use are faulting those pages in and the glTexImage itself. A
+// request puts the texture on the page-in queue; a background thread touches
+// every page and moves it to the staged queue, and TS_Service() uploads
+// staged textures on the GL thread, highest priority first, until the
+// frame's byte budget is used. Nothing in here calls GL: the upload is a
+// callback, so the scheduling can be run without a context.
+
+typedef enum {
+	TS_IDLE,			// never requested
+	TS_PAGING,			// waiting for, or on, the page-in thread
+	TS_STAGED,			// resident, waiting for an upload slot
+	TS_READY			// uploaded
+} tsState_t;
+
+// priority hints, higher goes first
+typedef enum {
+	TS_PRI_PREFETCH,	// may be wanted later
+	TS_PRI_NORMAL,		// drawn with a placeholder until it arrives
+	TS_PRI_VISIBLE,		// on screen now, jump the queue
+	TS_PRI_IMMEDIATE	// upload before returning, like the old path
+} tsPriority_t;
+
+typedef struct tsEntry_s {
+	struct tsEntry_s	*next;
+	volatile int		state;			// tsState_t
+	int					priority;
+	const unsigned char	*data;			// bits to page in
+	int					size;			// bytes, counted against the budget
+	void				*owner;			// passed to the upload callback
+	int					requestTime;	// usec, for latency stats
+} tsEntry_t;
+
+typedef struct {
+	int		requests;
+	int		uploads;
+	int		bytesUploaded;
+	int		immediateUploads;	// requests that could not wait
+	int		maxLatency;			// usec from request to ready
+	int		totalLatency;
+	int		oversized;			// uploads larger than the whole budget
+	int		maxFrameBytes;
+} tsStats_t;
+
+extern tsStats_t	tsStats;
+
+void	TS_Init( void (*upload)( void *owner ), int (*microseconds)( void ) );
+void	TS_Request( tsEntry_t *entry, int priority );
+int		TS_Service( int byteBudget );	// returns bytes uploaded this call
+void	TS_Finish( void );				// upload everything requested so far
+int		TS_Pending( void );				// requested but not yet uploaded
+
+int		TS_Check( void );				// headless check of the order and budget, returns failures
+
+#endif
@@ -0,0 +1,168 @@
+/* Emacs style mode select   -*- C++ -*-
+ *-----------------------------------------------------------------------------
+ *
+ *
+ *  PrBoom: a Doom port merged with LxDoom and LSDLDoom
+ *  based on BOOM, a modified and improved DOOM engine
+ *  Copyright (C) 1999 by
+ *  id Software, Chi Hoang, Lee Killough, Jim Flynn, Rand Phares, Ty Halderman
+ *  Copyright (C) 1999-2000 by
+ *  Jess Haas, Nicolas Kalkhof, Colin Phipps, Florian Schulze
+ *  Copyright 2005, 2006 by
+ *  Florian Schulze, Colin Phipps, Neil Stevens, Andrey Budko
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ *  02111-1307, USA.
+ *
+ * DESCRIPTION:
+ *  Headless benchmark build: startup and exit.
+ *  No window, input or sound; runs -timedemo/-fastdemo and prints the report.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+
+#include "doomdef.h"
+#include "doomstat.h"
+#include "d_main.h"
+#include "m_argv.h"
+#include "lprintf.h"
+#include "i_main.h"
+#include "i_sound.h"
+#include "i_system.h"
+#include "r_drawsimd.h"
+#include "r_main.h"
+#include "r_things.h"
+#include "r_drawlist.h"
+#include "d_cmdqueue.h"
+#include "d_jitter.h"
+#include "../ios/doomengine/texstream.h"
+
+int (*I_GetTime)(void) = I_GetTime_RealTime;
+
+void I_Init(void)
+{
+  I_InitSound();
+}
+
+/* I_SafeExit
+ * This function is called instead of exit() by functions that might be called
+ * during the exit process (i.e. after exit() has already been called)
+ * Prevent infinitely recursive exits -- killough
+ */
+void I_SafeExit(int rc)
+{
+  static int has_exited;
+  if (!has_exited) {
+    has_exited=rc ? 2 : 1;
+    exit(rc);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  myargc = argc;
+  myargv = (const char * const *)argv;
+
+  /* the span and column kernels make up their own textures, no wad needed */
+  if (M_CheckParm("-drawbench"))
+    {
+      R_BenchmarkDrawKernels();
+      return 0;
+    }
+  if (M_CheckParm("-tilebench"))
+    {
+      int p, width = 3840, height = 2160;
+
+      if ((p = M_CheckParm("-width")) && ++p < myargc)
+        width = atoi(myargv[p]);
+      if ((p = M_CheckParm("-height")) && ++p < myargc)
+        height = atoi(myargv[p]);
+      R_BenchmarkTiledView(width, height);
+      return 0;
+    }
+  if (M_CheckParm("-drawlistbench"))
+    {
+      int p, walls = 3000, textures = 150;
+
+      if ((p = M_CheckParm("-walls")) && ++p < myargc)
+        walls = atoi(myargv[p]);
+      if ((p = M_CheckParm("-textures")) && ++p < myargc)
+        textures = atoi(myargv[p]);
+      DL_Benchmark(walls > 0 ? walls : 1, textures > 0 ? textures : 1);
+      return 0;
+    }
+  if (M_CheckParm("-spritebench"))
+    {
+      int p, sprites = 6000;
+
+      if ((p = M_CheckParm("-sprites")) && ++p < myargc)
+        sprites = atoi(myargv[p]);
+      R_BenchmarkVisSprites(sprites > 0 ? sprites : 1);
+      return 0;
+    }
+  if (M_CheckParm("-queuestress"))
+    {
+      int p, records = 200000;
+
+      if ((p = M_CheckParm("-records")) && ++p < myargc)
+        records = atoi(myargv[p]);
+      return CQ_StressTest(records > 0 ? records : 1) != 0;
+    }
+  if (M_CheckParm("-jittersim"))
+    {
+      int p, seconds = 120;
+
+      if ((p = M_CheckParm("-seconds")) && ++p < myargc)
+        seconds = atoi(myargv[p]);
+      return JB_Simulate(seconds > 0 ? seconds : 1) != 0;
+    }
+  if (M_CheckParm("-texstreamcheck"))
+    return TS_Check() != 0;
+
+  if (!M_CheckParm("-timedemo") && !M_CheckParm("-fastdemo") &&
+      !M_CheckParm("-renderbench") && !M_CheckParm("-loadbench") &&
+      !M_CheckParm("-seekbench") && !M_CheckParm("-predictbench"))
+    {
+      lprintf(LO_ALWAYS, "usage: %s [-iwad <wad>] -timedemo|-fastdemo <demo> "
+              "[-width <w>] [-height <h>] [-nodraw] [-renderthreads <n>] [-tiledview] [-nosimd]\n"
+              "           [-snapshotcheck <tics>] [-keyframes <tics>]\n"
+              "       %s [-iwad <wad>] -seekbench <demo> [-seeks <n>] [-keyframes <tics>]\n"
+              "       %s [-iwad <wad>] -predictbench <demo> [-rtts <tics,...>]\n"
+              "       %s [-iwad <wad>] -renderbench [-warp <map>] [-width <w>] [-height <h>]\n"
+              "       %s [-iwad <wad>] -loadbench\n"
+              "       %s -drawbench\n"
+              "       %s -tilebench [-width <w>] [-height <h>]\n"
+              "       %s -spritebench [-sprites <n>]\n"
+              "       %s -drawlistbench [-walls <n>] [-textures <n>]\n"
+              "       %s -queuestress [-records <n>]\n"
+              "       %s -jittersim [-seconds <n>]\n"
+              "       %s -texstreamcheck\n",
+              argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0],
+              argv[0], argv[0]);
+      return 1;
+    }
+
+  /* the iwad is located by IdentifyVersion from -iwad or the standard names */
+  D_DoomMainSetup(NULL, NULL);
+
+  D_DoomLoop();  // never returns, G_CheckDemoStatus exits with the report
+  return 0;
+}
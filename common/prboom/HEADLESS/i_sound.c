@@ -0,0 +1,93 @@
+/* Emacs style mode select   -*- C++ -*-
+ *-----------------------------------------------------------------------------
+ *
+ *
+ *  PrBoom: a Doom port merged with LxDoom and LSDLDoom
+ *  based on BOOM, a modified and improved DOOM engine
+ *  Copyright (C) 1999 by
+ *  id Software, Chi Hoang, Lee Killough, Jim Flynn, Rand Phares, Ty Halderman
+ *  Copyright (C) 1999-2000 by
+ *  Jess Haas, Nicolas Kalkhof, Colin Phipps, Florian Schulze
+ *  Copyright 2005, 2006 by
+ *  Florian Schulze, Colin Phipps, Neil Stevens, Andrey Budko
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ *  02111-1307, USA.
+ *
+ * DESCRIPTION:
+ *  Headless benchmark build: silent sound and music.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+
+#include "doomtype.h"
+#include "w_wad.h"
+#include "i_sound.h"
+
+// Allegro card support jff 1/18/98
+int snd_card;
+int mus_card;
+int snd_samplerate = 11025;
+
+void I_InitSound(void) {}
+void I_ShutdownSound(void) {}
+void I_SetChannels(void) {}
+
+//
+// Retrieve the raw data lump index
+//  for a given SFX name.
+//
+int I_GetSfxLumpNum(sfxinfo_t* sfx)
+{
+  char namebuf[9];
+  sprintf(namebuf, "ds%s", sfx->name);
+  return W_GetNumForName(namebuf);
+}
+
+int I_StartSound(int id, int channel, int vol, int sep, int pitch, int priority)
+{
+  (void)id; (void)vol; (void)sep; (void)pitch; (void)priority;
+  return channel;
+}
+
+void I_StopSound(int handle) { (void)handle; }
+boolean I_SoundIsPlaying(int handle) { (void)handle; return false; }
+boolean I_AnySoundStillPlaying(void) { return false; }
+void I_UpdateSoundParams(int handle, int vol, int sep, int pitch)
+{
+  (void)handle; (void)vol; (void)sep; (void)pitch;
+}
+
+void I_InitMusic(void) {}
+void I_ShutdownMusic(void) {}
+void I_UpdateMusic(void) {}
+void I_SetMusicVolume(int volume) { (void)volume; }
+void I_PauseSong(int handle) { (void)handle; }
+void I_ResumeSong(int handle) { (void)handle; }
+int I_RegisterSong(const void *data, size_t len) { (void)data; (void)len; return 0; }
+int I_RegisterMusic(const char* filename, musicinfo_t *music)
+{
+  (void)filename; (void)music;
+  return 1;
+}
+void I_PlaySong(int handle, int looping) { (void)handle; (void)looping; }
+void I_StopSong(int handle) { (void)handle; }
+void I_UnRegisterSong(int handle) { (void)handle; }
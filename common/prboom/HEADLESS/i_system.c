@@ -0,0 +1,251 @@
+/* Emacs style mode select   -*- C++ -*-
+ *-----------------------------------------------------------------------------
+ *
+ *
+ *  PrBoom: a Doom port merged with LxDoom and LSDLDoom
+ *  based on BOOM, a modified and improved DOOM engine
+ *  Copyright (C) 1999 by
+ *  id Software, Chi Hoang, Lee Killough, Jim Flynn, Rand Phares, Ty Halderman
+ *  Copyright (C) 1999-2000 by
+ *  Jess Haas, Nicolas Kalkhof, Colin Phipps, Florian Schulze
+ *  Copyright 2005, 2006 by
+ *  Florian Schulze, Colin Phipps, Neil Stevens, Andrey Budko
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ *  02111-1307, USA.
+ *
+ * DESCRIPTION:
+ *  Headless benchmark build: system interface (clock, files).
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#include "doomdef.h"
+#include "doomtype.h"
+#include "m_fixed.h"
+#include "lprintf.h"
+#include "i_system.h"
+
+int ms_to_next_tick;
+int realtic_clock_rate = 100;   // killough 4/13/98: adjustable timer
+int endoom_mode;
+
+int usejoystick;
+int joyleft;
+int joyright;
+int joyup;
+int joydown;
+
+/* I_GetTime_US
+ * Monotonic microseconds since an arbitrary start.
+ */
+uint_64_t I_GetTime_US(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint_64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* I_ReadMemCounters
+ * perf events on Linux, opened on the first call for the calling thread.
+ * Most virtual machines and containers don't pass them through.
+ */
+#ifdef __linux__
+static int I_OpenMemCounter(unsigned int type, unsigned long long config)
+{
+  struct perf_event_attr attr;
+
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = type;
+  attr.config = config;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  return (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+boolean I_ReadMemCounters(uint_64_t *cachemisses, uint_64_t *tlbmisses)
+{
+  static int cachefd = -2, tlbfd = -2;
+  unsigned long long cache, tlb;
+
+  if (cachefd == -2)
+    {
+      cachefd = I_OpenMemCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+      tlbfd = I_OpenMemCounter(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB |
+                               (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                               (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+    }
+  if (cachefd < 0 || tlbfd < 0 ||
+      read(cachefd, &cache, sizeof(cache)) != sizeof(cache) ||
+      read(tlbfd, &tlb, sizeof(tlb)) != sizeof(tlb))
+    return false;
+  *cachemisses = cache;
+  *tlbmisses = tlb;
+  return true;
+}
+#else
+boolean I_ReadMemCounters(uint_64_t *cachemisses, uint_64_t *tlbmisses)
+{
+  (void)cachemisses;
+  (void)tlbmisses;
+  return false;
+}
+#endif
+
+static uint_64_t basetime;
+
+/* I_GetTime_RealTime
+ * Tics since the first call, scaled by realtic_clock_rate.
+ */
+int I_GetTime_RealTime(void)
+{
+  uint_64_t t = I_GetTime_US();
+  int i;
+
+  if (!basetime)
+    basetime = t;
+  t -= basetime;
+  i = (int)(t * TICRATE * realtic_clock_rate / 100000000);
+  ms_to_next_tick = (int)((i+1) * 100000000 / ((uint_64_t)TICRATE * realtic_clock_rate) - t) / 1000;
+  if (ms_to_next_tick > 1000/TICRATE || ms_to_next_tick < 1)
+    ms_to_next_tick = 1;
+  return i;
+}
+
+/* the headless build has no interpolation, every frame is drawn on a tic */
+fixed_t I_GetTimeFrac(void) { return FRACUNIT; }
+void I_GetTime_SaveMS(void) {}
+
+unsigned long I_GetRandomTimeSeed(void)
+{
+  return (unsigned long)time(NULL);
+}
+
+boolean I_StartDisplay(void) { return true; }
+void I_EndDisplay(void) {}
+
+void I_uSleep(unsigned long usecs)
+{
+  usleep(usecs);
+}
+
+const char *I_DoomExeDir(void)
+{
+  return ".";
+}
+
+/*
+ * HasTrailingSlash
+ *
+ * cphipps - simple test for trailing slash on dir names
+ */
+boolean HasTrailingSlash(const char* dn)
+{
+  return ( (dn[strlen(dn)-1] == '/') );
+}
+
+/*
+ * I_FindFile
+ *
+ * Looks for wfname (and wfname with ext appended) in the current directory,
+ * $DOOMWADDIR, and the usual system places. returnFileName is set to the
+ * path found, or to an empty string.
+ */
+void I_FindFile(const char* wfname, const char* ext, char * returnFileName)
+{
+  // lookup table of directories to search
+  static const struct {
+    const char *dir; // directory
+    const char *env; // environment variable
+  } search[] = {
+    {NULL}, // current working directory
+    {NULL, "DOOMWADDIR"}, // run-time $DOOMWADDIR
+    {"/usr/local/share/games/doom"},
+    {"/usr/share/games/doom"},
+    {"/usr/local/share/doom"},
+    {"/usr/share/doom"},
+  };
+  size_t i;
+
+  for (i = 0; i < sizeof(search)/sizeof(*search); i++) {
+    const char *d = search[i].dir;
+
+    if (search[i].env && !(d = getenv(search[i].env)))
+      continue;
+    if (d && strlen(d) + strlen(wfname) + strlen(ext) + 2 > PATH_MAX)
+      continue;
+
+    sprintf(returnFileName, "%s%s%s", d ? d : "",
+            (d && !HasTrailingSlash(d)) ? "/" : "", wfname);
+    if (access(returnFileName,F_OK))
+      strcat(returnFileName, ext);  // try adding the extension
+    if (!access(returnFileName,F_OK)) {
+      lprintf(LO_INFO, " found %s\n", returnFileName);
+      return;
+    }
+  }
+
+  returnFileName[0] = '\0';
+  lprintf(LO_INFO, " NOT found %s\n", wfname);
+}
+
+/*
+ * I_Read
+ *
+ * cph 2001/11/18 - wrapper for read(2) which handles partial reads and aborts
+ * on error.
+ */
+void I_Read(int fd, void* vbuf, size_t sz)
+{
+  unsigned char* buf = vbuf;
+
+  while (sz) {
+    int rc = read(fd,buf,sz);
+    if (rc <= 0) {
+      I_Error("I_Read: read failed: %s", rc ? strerror(errno) : "EOF");
+    }
+    sz -= rc; buf += rc;
+  }
+}
+
+/*
+ * I_Filelength
+ *
+ * Return length of an open file.
+ */
+int I_Filelength(int handle)
+{
+  struct stat   fileinfo;
+  if (fstat(handle,&fileinfo) == -1)
+    I_Error("I_Filelength: %s",strerror(errno));
+  return (int)fileinfo.st_size;
+}
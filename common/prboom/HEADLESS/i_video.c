@@ -0,0 +1,120 @@
+/* Emacs style mode select   -*- C++ -*-
+ *-----------------------------------------------------------------------------
+ *
+ *
+ *  PrBoom: a Doom port merged with LxDoom and LSDLDoom
+ *  based on BOOM, a modified and improved DOOM engine
+ *  Copyright (C) 1999 by
+ *  id Software, Chi Hoang, Lee Killough, Jim Flynn, Rand Phares, Ty Halderman
+ *  Copyright (C) 1999-2000 by
+ *  Jess Haas, Nicolas Kalkhof, Colin Phipps, Florian Schulze
+ *  Copyright 2005, 2006 by
+ *  Florian Schulze, Colin Phipps, Neil Stevens, Andrey Budko
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ *  02111-1307, USA.
+ *
+ * DESCRIPTION:
+ *  Headless benchmark build: offscreen software framebuffer, no input.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "doomdef.h"
+#include "doomstat.h"
+#include "v_video.h"
+#include "r_draw.h"
+#include "st_stuff.h"
+#include "lprintf.h"
+#include "i_video.h"
+
+int use_fullscreen;
+int desired_fullscreen;
+
+void I_PreInitGraphics(void) {}
+void I_ShutdownGraphics(void) {}
+void I_SetPalette(int pal) { (void)pal; }
+void I_UpdateNoBlit(void) {}
+/* the frame stays in screens[0], nothing to present */
+void I_FinishUpdate(void) {}
+int I_ScreenShot(const char *fname) { (void)fname; return 0; }
+
+/* I_StartTic / I_StartFrame
+ * Called by D_DoomLoop, there are no events to post.
+ */
+void I_StartTic(void) {}
+void I_StartFrame(void) {}
+
+// CPhipps -
+// I_CalculateRes
+// Clamps the requested resolution to what the renderer supports
+void I_CalculateRes(unsigned int width, unsigned int height)
+{
+  SCREENWIDTH = width < 320 ? 320 : width > MAX_SCREENWIDTH ? MAX_SCREENWIDTH : width;
+  SCREENHEIGHT = height < 200 ? 200 : height > MAX_SCREENHEIGHT ? MAX_SCREENHEIGHT : height;
+  SCREENPITCH = SCREENWIDTH * V_GetModePixelDepth(V_GetMode());
+}
+
+// CPhipps -
+// I_SetRes
+// Sets the screen resolution
+void I_SetRes(void)
+{
+  int i;
+
+  I_CalculateRes(desired_screenwidth, desired_screenheight);
+
+  // set first three to standard values
+  for (i=0; i<3; i++) {
+    screens[i].width = SCREENWIDTH;
+    screens[i].height = SCREENHEIGHT;
+    screens[i].byte_pitch = SCREENPITCH;
+    screens[i].short_pitch = SCREENPITCH / V_GetModePixelDepth(VID_MODE16);
+    screens[i].int_pitch = SCREENPITCH / V_GetModePixelDepth(VID_MODE32);
+  }
+
+  // statusbar
+  screens[4].width = SCREENWIDTH;
+  screens[4].height = (ST_SCALED_HEIGHT+1);
+  screens[4].byte_pitch = SCREENPITCH;
+  screens[4].short_pitch = SCREENPITCH / V_GetModePixelDepth(VID_MODE16);
+  screens[4].int_pitch = SCREENPITCH / V_GetModePixelDepth(VID_MODE32);
+
+  lprintf(LO_INFO,"I_SetRes: Using resolution %dx%d\n", SCREENWIDTH, SCREENHEIGHT);
+}
+
+void I_UpdateVideoMode(void)
+{
+  V_InitMode(VID_MODE8);
+  I_SetRes();
+  V_AllocScreens();
+  R_InitBuffer(SCREENWIDTH, SCREENHEIGHT);
+}
+
+void I_InitGraphics(void)
+{
+  static int firsttime=1;
+
+  if (firsttime)
+  {
+    firsttime = 0;
+    lprintf(LO_INFO, "I_InitGraphics: %dx%d\n", desired_screenwidth, desired_screenheight);
+    I_UpdateVideoMode();
+  }
+}
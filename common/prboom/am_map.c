@@ -50,10 +50,11 @@
 #include "lprintf.h"  // jff 08/03/98 - declaration of lprintf
 #include "g_game.h"
 
-// IPHONE
+#ifdef IPHONE
 #include "gles_glue.h"
 
 void iphoneSet2D( void );
+#endif
 
 
 //jff 1/7/98 default automap colors added
@@ -94,8 +94,10 @@
 
 #define PACKEDATTR __attribute__((packed))
 
+#ifdef __APPLE__
 #define MACOSX
 #define HAVE_LIBKERN_OSBYTEORDER_H
+#endif
 
 
 //------ JDC config changes for iPhone ------------
@@ -107,3 +109,11 @@
 #undef USE_GLU_IMAGESCALE
 #undef USE_GLU_MIPMAP
 
+//------ headless benchmark build (HEADLESS/i_main.c) ------------
+// software renderer only, no GL or iphone layer linked in
+#ifdef PRBOOM_HEADLESS
+#undef GL_DOOM
+#undef USE_GLU_TESS
+#define RENDER_THREADS		// -renderthreads, see R_RenderPlayerView
+#endif
+
@@ -86,6 +86,11 @@ static boolean isExtraDDisplay = false;
 
 #ifdef HAVE_NET
 static void D_QuitNetGame (void);
+
+static int       aheadfrom, aheadto; // Tics received past missed ones
+static int       retranstime;
+static unsigned  ticsreceived; // PKT_TICS, counted for the server
+static int       serverxtratics; // Tics the server repeats in each packet
 #endif
 
 #ifndef HAVE_NET
@@ -266,6 +271,21 @@ boolean D_NetGetWad(const char* name)
 #endif
 }
 
+// Copies the tics of a PKT_TICS from tic to netcmds, stopping at limit
+static int D_StoreTics(int tic, int tics, const byte *p, int limit)
+{
+  while (tics-- && tic < limit) {
+    int players = *p++;
+    while (players--) {
+      int n = *p++;
+      RawToTic(&netcmds[n][tic%BACKUPTICS], p);
+      p += sizeof(ticcmd_t);
+    }
+    tic++;
+  }
+  return tic;
+}
+
 void NetUpdate(void)
 {
   static int lastmadetic;
@@ -281,22 +301,33 @@ void NetUpdate(void)
     byte *p = (void*)(packet+1);
     int tics = *p++;
     unsigned long ptic = doom_ntohl(packet->tic);
+
+    ticsreceived++;
+    serverxtratics = packet->reserved[0];
     if (ptic > (unsigned)remotetic) { // Missed some
-      packet_set(packet, PKT_RETRANS, remotetic);
-      *(byte*)(packet+1) = consoleplayer;
-      I_SendPacket(packet, sizeof(*packet)+1);
+      // Keep what netcmds has room for, and ask for just the tics missing
+      int to = D_StoreTics(ptic, tics, p, gametic + BACKUPTICS);
+
+      if (aheadto <= remotetic || (int)ptic > aheadto || to < aheadfrom) {
+        aheadfrom = ptic; aheadto = to;
+      } else {
+        if ((int)ptic < aheadfrom) aheadfrom = ptic;
+        if (to > aheadto) aheadto = to;
+      }
+      if (I_GetTime() - retranstime > 2) { // Not again before it could answer
+        int missing = aheadfrom - remotetic;
+        packet_set(packet, PKT_RETRANS, remotetic);
+        *(byte*)(packet+1) = consoleplayer;
+        *((byte*)(packet+1)+1) = missing < 255 ? missing : 255;
+        I_SendPacket(packet, sizeof(*packet)+2);
+        retranstime = I_GetTime();
+      }
     } else {
       if (ptic + tics <= (unsigned)remotetic) break; // Will not improve things
-      remotetic = ptic;
-      while (tics--) {
-        int players = *p++;
-        while (players--) {
-            int n = *p++;
-            RawToTic(&netcmds[n][remotetic%BACKUPTICS], p);
-            p += sizeof(ticcmd_t);
-        }
-        remotetic++;
-      }
+      remotetic = D_StoreTics(ptic, tics, p, INT_MAX);
+      if (aheadfrom <= remotetic && aheadto > remotetic) // Gap filled
+        remotetic = aheadto;
+      if (remotetic >= aheadto) retranstime = 0;
     }
   }
   break;
@@ -346,7 +377,7 @@ void NetUpdate(void)
     }
     if (server && maketic > remotesend) { // Send the tics to the server
       int sendtics;
-      remotesend -= xtratics;
+      remotesend -= xtratics > serverxtratics ? xtratics : serverxtratics;
       if (remotesend < 0) remotesend = 0;
       sendtics = maketic - remotesend;
       {
@@ -354,6 +385,7 @@ void NetUpdate(void)
   packet_header_t *packet = Z_Malloc(pkt_size, PU_STATIC, NULL);
 
   packet_set(packet, PKT_TICC, maketic - sendtics);
+  packet_set_count(packet, ticsreceived);
   *(byte*)(packet+1) = sendtics;
   *(((byte*)(packet+1))+1) = consoleplayer;
   {
@@ -404,6 +436,21 @@ void D_NetSendMisc(netmisctype_t type, size_t len, void* data)
   }
 }
 
+// Sends the others the state hash of a tic we have run. It is queued
+// for the tic after, by when the others have their own hash for it.
+static void D_NetSendStateHash(int tic)
+{
+  const statehash_t *h = P_StateHashAt(tic);
+  int buf[1 + NUMSTATEHASHES];
+  int i;
+
+  if (!h) return;
+  buf[0] = LONG(h->tic);
+  for (i=0; i<NUMSTATEHASHES; i++)
+    buf[i+1] = LONG(h->hash[i]);
+  D_NetSendMisc(nm_statehash, sizeof buf, buf);
+}
+
 static void CheckQueuedPackets(void)
 {
   int i;
@@ -432,6 +479,17 @@ static void CheckQueuedPackets(void)
         savedescription[len] = 0;
       }
       break;
+    case nm_statehash:
+      if (len == (1 + NUMSTATEHASHES) * sizeof(int)) {
+        statehash_t h;
+        int j;
+
+        h.tic = LONG(*(p+3));
+        for (j=0; j<NUMSTATEHASHES; j++)
+          h.hash[j] = LONG(*(p+4+j));
+        P_StateHashCheck(&h, LONG(*(p+1)));
+      }
+      break;
     }
   }
   break;
@@ -517,6 +575,8 @@ void TryRunTics (void)
     P_Checksum(gametic);
     gametic++;
 #ifdef HAVE_NET
+    if (server && statehash_tics && !(gametic % statehash_tics))
+      D_NetSendStateHash(gametic - 1);
     NetUpdate(); // Keep sending our tics to avoid stalling remote nodes
 #endif
   }
@@ -0,0 +1,288 @@
+/* Emacs style mode select   -*- C++ -*-
+ *-----------------------------------------------------------------------------
+ *
+ *
+ *  PrBoom: a Doom port merged with LxDoom and LSDLDoom
+ *  based on BOOM, a modified and improved DOOM engine
+ *  Copyright (C) 1999 by
+ *  id Software, Chi Hoang, Lee Killough, Jim Flynn, Rand Phares, Ty Halderman
+ *  Copyright (C) 1999-2000 by
+ *  Jess Haas, Nicolas Kalkhof, Colin Phipps, Florian Schulze
+ *  Copyright 2005, 2006 by
+ *  Florian Schulze, Colin Phipps, Neil Stevens, Andrey Budko
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ *  02111-1307, USA.
+ *
+ * DESCRIPTION:
+ *      Single producer, single consumer command queue, see d_cmdqueue.h.
+ *
+ *      The producer writes a record, then publishes it with a release
+ *      store of head; the consumer loads head with acquire before it reads
+ *      the record. The other way round, the consumer's release store of
+ *      tail after it is done with a record pairs with the producer's
+ *      acquire load of tail before it reuses the slot. Nothing else is
+ *      shared, so nothing needs a lock or a read-modify-write.
+ *
+ *-----------------------------------------------------------------------------*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "doomtype.h"
+#include "d_ticcmd.h"
+#include "i_system.h"
+#include "lprintf.h"
+#include "d_cmdqueue.h"
+
+// each slot is the time it was queued, then the record
+#define CQ_HEADER sizeof(uint_64_t)
+
+void CQ_Init(cmdqueue_t *q, int count, size_t recordsize)
+{
+  unsigned size = 2;
+
+  while (size < (unsigned)count)
+    size <<= 1;
+  memset(q, 0, sizeof *q);
+  q->size = size;
+  q->mask = size - 1;
+  q->recordsize = recordsize;
+  q->slotsize = (CQ_HEADER + recordsize + 7) & ~(size_t)7;
+  q->slots = calloc(size, q->slotsize);
+  if (!q->slots)
+    I_Error("CQ_Init: out of memory for %u records", size);
+}
+
+void CQ_Free(cmdqueue_t *q)
+{
+  free(q->slots);
+  memset(q, 0, sizeof *q);
+}
+
+void *CQ_Reserve(cmdqueue_t *q)
+{
+  const unsigned head = q->p.head;
+
+  // only go back to the shared tail when the cached one says it's full
+  if (head - q->p.tailcache >= q->size)
+    {
+      q->p.tailcache = __atomic_load_n(&q->c.tail, __ATOMIC_ACQUIRE);
+      if (head - q->p.tailcache >= q->size)
+        {
+          q->p.full++;
+          return NULL;
+        }
+    }
+  return q->slots + (head & q->mask) * q->slotsize + CQ_HEADER;
+}
+
+void CQ_Commit(cmdqueue_t *q)
+{
+  const unsigned head = q->p.head;
+
+  *(uint_64_t *)(q->slots + (head & q->mask) * q->slotsize) = I_GetTime_US();
+  q->p.pushed++;
+  __atomic_store_n(&q->p.head, head + 1, __ATOMIC_RELEASE);
+}
+
+boolean CQ_Push(cmdqueue_t *q, const void *record)
+{
+  void *slot = CQ_Reserve(q);
+
+  if (!slot)
+    return false;
+  memcpy(slot, record, q->recordsize);
+  CQ_Commit(q);
+  return true;
+}
+
+const void *CQ_Peek(cmdqueue_t *q, uint_64_t *queued)
+{
+  const unsigned tail = q->c.tail;
+  const unsigned char *slot;
+
+  if (tail == q->c.headcache)
+    {
+      q->c.headcache = __atomic_load_n(&q->p.head, __ATOMIC_ACQUIRE);
+      if (tail == q->c.headcache)
+        return NULL;
+    }
+  slot = q->slots + (tail & q->mask) * q->slotsize;
+  if (queued)
+    *queued = *(const uint_64_t *)slot;
+  return slot + CQ_HEADER;
+}
+
+void CQ_Pop(cmdqueue_t *q)
+{
+  const unsigned tail = q->c.tail;
+  const uint_64_t queued = *(const uint_64_t *)(q->slots + (tail & q->mask) * q->slotsize);
+  const unsigned latency = (unsigned)(I_GetTime_US() - queued);
+
+  q->c.popped++;
+  q->c.latencysum += latency;
+  if (latency > q->c.latencymax)
+    q->c.latencymax = latency;
+  __atomic_store_n(&q->c.tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+int CQ_Count(const cmdqueue_t *q)
+{
+  const unsigned tail = __atomic_load_n(&q->c.tail, __ATOMIC_ACQUIRE);
+  const unsigned head = __atomic_load_n(&q->p.head, __ATOMIC_ACQUIRE);
+
+  return (int)(head - tail);
+}
+
+//
+// CQ_StressTest
+//
+// -queuestress: a producer thread and the main thread push and pop ticcmd
+// records through queues of a few sizes, each side now and then spinning
+// or sleeping for a random while so the queue runs empty, full and
+// everything between. The consumer checks every record arrives once, in
+// order, and intact. Returns the number of bad records.
+//
+
+typedef struct {
+  unsigned sequence;
+  ticcmd_t cmd;
+  unsigned check;
+} cqstress_t;
+
+typedef struct {
+  cmdqueue_t *q;
+  int records;
+  unsigned seed;
+  unsigned stalls;
+} cqproducer_t;
+
+static unsigned CQ_StressRandom(unsigned *seed)
+{
+  *seed = *seed * 1664525 + 1013904223;
+  return *seed >> 8;
+}
+
+static void CQ_StressPause(unsigned *seed)
+{
+  const unsigned r = CQ_StressRandom(seed);
+
+  if (r % 512 == 0)
+    usleep(r % 1000);
+  else if (r % 8 == 0)
+    {
+      volatile unsigned spin;
+      for (spin = r % 4096; spin > 0; spin--)
+        ;
+    }
+}
+
+static void CQ_StressRecord(cqstress_t *rec, unsigned sequence)
+{
+  rec->sequence = sequence;
+  rec->cmd.forwardmove = (signed char)sequence;
+  rec->cmd.sidemove = (signed char)(sequence >> 8);
+  rec->cmd.angleturn = (signed short)(sequence * 7);
+  rec->cmd.consistancy = (short)(sequence >> 16);
+  rec->cmd.chatchar = (byte)(sequence * 3);
+  rec->cmd.buttons = (byte)(sequence >> 3);
+  rec->check = sequence * 0x9e3779b1u;
+}
+
+static void *CQ_StressProducer(void *arg)
+{
+  cqproducer_t *prod = arg;
+  int i;
+
+  for (i = 0; i < prod->records; i++)
+    {
+      cqstress_t *rec;
+
+      CQ_StressPause(&prod->seed);
+      while (!(rec = CQ_Reserve(prod->q)))
+        {
+          prod->stalls++;
+          sched_yield();
+        }
+      CQ_StressRecord(rec, i);
+      CQ_Commit(prod->q);
+    }
+  return NULL;
+}
+
+int CQ_StressTest(int records)
+{
+  static const int sizes[] = {2, 16, 256};
+  int errors = 0, s;
+
+  lprintf(LO_INFO, "CQ_StressTest: %d records through each queue\n", records);
+
+  for (s = 0; s < (int)(sizeof sizes / sizeof *sizes); s++)
+    {
+      cmdqueue_t q;
+      cqproducer_t prod;
+      pthread_t thread;
+      unsigned seed = 12345 + s, empty = 0;
+      int i, bad = 0;
+      uint_64_t start;
+
+      CQ_Init(&q, sizes[s], sizeof(cqstress_t));
+      prod.q = &q;
+      prod.records = records;
+      prod.seed = 1 + s;
+      prod.stalls = 0;
+
+      start = I_GetTime_US();
+      if (pthread_create(&thread, NULL, CQ_StressProducer, &prod))
+        I_Error("CQ_StressTest: can't start the producer");
+
+      for (i = 0; i < records; )
+        {
+          const cqstress_t *rec;
+          cqstress_t expect;
+
+          CQ_StressPause(&seed);
+          if (!(rec = CQ_Peek(&q, NULL)))
+            {
+              empty++;
+              sched_yield();
+              continue;
+            }
+          CQ_StressRecord(&expect, i);
+          if (memcmp(rec, &expect, sizeof expect))
+            {
+              if (bad++ < 4)
+                lprintf(LO_INFO, "  record %d came out as %u\n", i, rec->sequence);
+            }
+          CQ_Pop(&q);
+          i++;
+        }
+      pthread_join(thread, NULL);
+
+      lprintf(LO_INFO, "%4u slots: %8.1f ms, %u full, %u empty, latency avg %.1f max %u usec, %s\n",
+              q.size, (I_GetTime_US() - start) / 1000.0, prod.stalls, empty,
+              q.c.popped ? (double)q.c.latencysum / q.c.popped : 0.0, q.c.latencymax,
+              bad || q.c.popped != (unsigned)records || CQ_Count(&q) ? "FAILED" : "ok");
+      if (q.c.popped != (unsigned)records || CQ_Count(&q))
+        bad++;
+      errors += bad;
+      CQ_Free(&q);
+    }
+  return errors;
+}
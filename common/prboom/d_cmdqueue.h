@@ -0,0 +1,90 @@
+/* Emacs style mode select   -*- C++ -*-
+ *-----------------------------------------------------------------------------
+ *
+ *
+ *  PrBoom: a Doom port merged with LxDoom and LSDLDoom
+ *  based on BOOM, a modified and improved DOOM engine
+ *  Copyright (C) 1999 by
+ *  id Software, Chi Hoang, Lee Killough, Jim Flynn, Rand Phares, Ty Halderman
+ *  Copyright (C) 1999-2000 by
+ *  Jess Haas, Nicolas Kalkhof, Colin Phipps, Florian Schulze
+ *  Copyright 2005, 2006 by
+ *  Florian Schulze, Colin Phipps, Neil Stevens, Andrey Budko
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ *  02111-1307, USA.
+ *
+ * DESCRIPTION:
+ *      A lock-free single producer, single consumer queue of fixed size
+ *      records, for handing ticcmds and input snapshots from the thread
+ *      that samples the input to the thread that runs the game. Every
+ *      record is stamped when it is queued, so the consumer can tell how
+ *      long commands waited.
+ *
+ *-----------------------------------------------------------------------------*/
+
+#ifndef __D_CMDQUEUE__
+#define __D_CMDQUEUE__
+
+#include <stddef.h>
+
+#include "doomtype.h"
+
+#define CQ_CACHELINE 64
+
+/* Only the producer stores head and only the consumer stores tail, each
+ * on its own cache line with the counters that side keeps. The cached
+ * copy of the other side's index saves a shared load per record. */
+typedef struct {
+  struct {
+    unsigned head;              /* next slot to fill */
+    unsigned tailcache;         /* tail as the producer last saw it */
+    unsigned pushed;            /* records queued */
+    unsigned full;              /* CQ_Reserve calls that found no room */
+  } __attribute__((aligned(CQ_CACHELINE))) p;
+
+  struct {
+    unsigned tail;              /* next slot to read */
+    unsigned headcache;         /* head as the consumer last saw it */
+    unsigned popped;
+    unsigned latencymax;        /* usec from CQ_Commit to CQ_Pop */
+    uint_64_t latencysum;
+  } __attribute__((aligned(CQ_CACHELINE))) c;
+
+  unsigned char *slots;         /* size slots of slotsize bytes */
+  size_t slotsize, recordsize;
+  unsigned size, mask;
+} cmdqueue_t;
+
+void CQ_Init(cmdqueue_t *q, int count, size_t recordsize);
+void CQ_Free(cmdqueue_t *q);
+
+/* Producer side: fill in the record CQ_Reserve returns, then CQ_Commit
+ * it. CQ_Reserve returns NULL when the queue is full. */
+void *CQ_Reserve(cmdqueue_t *q);
+void CQ_Commit(cmdqueue_t *q);
+boolean CQ_Push(cmdqueue_t *q, const void *record);
+
+/* Consumer side: the oldest record, or NULL if there is none, stays
+ * valid until CQ_Pop. queued gets the I_GetTime_US it was committed at. */
+const void *CQ_Peek(cmdqueue_t *q, uint_64_t *queued);
+void CQ_Pop(cmdqueue_t *q);
+
+/* Either side: records waiting right now */
+int CQ_Count(const cmdqueue_t *q);
+
+int CQ_StressTest(int records);
+
+#endif
@@ -0,0 +1,340 @@
+/* Emacs style mode select   -*- C++ -*-
+ *-----------------------------------------------------------------------------
+ *
+ *
+ *  PrBoom: a Doom port merged with LxDoom and LSDLDoom
+ *  based on BOOM, a modified and improved DOOM engine
+ *  Copyright (C) 1999 by
+ *  id Software, Chi Hoang, Lee Killough, Jim Flynn, Rand Phares, Ty Halderman
+ *  Copyright (C) 1999-2000 by
+ *  Jess Haas, Nicolas Kalkhof, Colin Phipps, Florian Schulze
+ *  Copyright 2005, 2006 by
+ *  Florian Schulze, Colin Phipps, Neil Stevens, Andrey Budko
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ *  02111-1307, USA.
+ *
+ * DESCRIPTION:
+ *      Adaptive playout buffer, see d_jitter.h.
+ *
+ *      The delay of each packet is smoothed the way TCP smooths round
+ *      trips: an average, and the average deviation from it. The buffer
+ *      aims to hold enough tics to cover JB_DEVIATIONS deviations of
+ *      delay, rises at once when that grows, and comes down a tic at a
+ *      time once it has been lower for a while. Each frame runs the tics
+ *      the playout rate has earned; the rate goes up or down with how far
+ *      the buffer is from its target.
+ *
+ *-----------------------------------------------------------------------------*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "doomtype.h"
+#include "lprintf.h"
+#include "d_jitter.h"
+
+#define JB_DEVIATIONS  3
+#define JB_HOLD        60       /* arrivals, a couple of seconds */
+#define JB_MINTARGET   1
+#define JB_MAXTARGET   8
+#define JB_GAIN        (JB_UNIT/16)     /* rate change per tic off target */
+#define JB_SLOWEST     (JB_UNIT*7/8)
+#define JB_FASTEST     (JB_UNIT*2)
+#define JB_SLACK       4        /* tics of lead beyond buffer and round trip */
+
+void JB_Init(jitterbuffer_t *jb, int msecpertic)
+{
+  memset(jb, 0, sizeof *jb);
+  jb->msecpertic = msecpertic > 0 ? msecpertic : 1;
+  jb->target = JB_MINTARGET;
+  jb->rate = JB_UNIT;
+}
+
+int JB_Target(const jitterbuffer_t *jb)
+{
+  return __atomic_load_n(&jb->target, __ATOMIC_RELAXED);
+}
+
+void JB_Arrival(jitterbuffer_t *jb, int delay)
+{
+  const int tic = jb->msecpertic * JB_SCALE;
+  int err, target;
+
+  delay *= JB_SCALE;
+  if (!jb->arrivals++)
+    {
+      jb->delay = delay;
+      return;
+    }
+  err = delay - jb->delay;
+  jb->delay += err / 8;
+  jb->deviation += (abs(err) - jb->deviation) / 4;
+
+  target = JB_MINTARGET + (JB_DEVIATIONS * jb->deviation + tic/2) / tic;
+  if (target > JB_MAXTARGET)
+    target = JB_MAXTARGET;
+
+  if (target >= jb->target)
+    {
+      if (target > jb->target)
+        __atomic_store_n(&jb->target, target, __ATOMIC_RELAXED);
+      jb->hold = JB_HOLD;
+    }
+  else if (--jb->hold <= 0)
+    {
+      __atomic_store_n(&jb->target, jb->target - 1, __ATOMIC_RELAXED);
+      jb->hold = JB_HOLD;
+    }
+}
+
+int JB_Playout(jitterbuffer_t *jb, int buffered)
+{
+  int rate, run, off;
+
+  jb->frames++;
+  jb->depth = buffered;
+  if (buffered <= 0)
+    {
+      jb->stalls++;
+      jb->credit = 0;
+      jb->average = 0;
+      return 0;
+    }
+
+  // How far off target the buffer has been lately, less a whole tic so
+  // arrivals landing either side of a frame don't move the rate
+  jb->average += (buffered * JB_UNIT - jb->average) / 8;
+  off = jb->average - JB_Target(jb) * JB_UNIT;
+  if (off > JB_UNIT)
+    off -= JB_UNIT;
+  else if (off < -JB_UNIT)
+    off += JB_UNIT;
+  else
+    off = 0;
+  rate = JB_UNIT + off * JB_GAIN / JB_UNIT;
+  if (rate < JB_SLOWEST)
+    rate = JB_SLOWEST;
+  if (rate > JB_FASTEST)
+    rate = JB_FASTEST;
+  jb->rate = rate;
+
+  jb->credit += rate;
+  run = jb->credit / JB_UNIT;
+  if (run > buffered)
+    run = buffered;
+  jb->credit -= run * JB_UNIT;
+  if (jb->credit > JB_UNIT)     // don't save up a burst while starved
+    jb->credit = JB_UNIT;
+
+  if (!run)
+    jb->stretched++;
+  else if (run > 1)
+    jb->shrunk++;
+  return run;
+}
+
+int JB_Lead(const jitterbuffer_t *jb, int pingtics)
+{
+  return JB_Target(jb) + pingtics + JB_SLACK;
+}
+
+//
+// Simulation
+//
+// A sender makes a tic every JB_SIMTIC usec, unless it is too far ahead
+// of what the receiver has reported running, and sends its newest tic
+// every time. The receiver runs frames at the same rate give or take
+// clock drift, and reports back every frame. Packets are delayed by a
+// fixed time, an exponential amount on top and the odd long spike, and
+// some are lost; none overtake each other.
+//
+
+#define JB_SIMTIC      33333    /* usec, the 30Hz of the iPhone async tic */
+#define JB_SIMSTEP     250
+#define JB_SIMPACKETS  256
+#define JB_SIMLEAD     12       /* netBuffer */
+#define JB_SIMMAXMS    2000
+
+typedef struct {
+  const char *name;
+  int basems, jitterms;         /* fixed delay, and mean of the random part */
+  int spikes, spikems;          /* per 1000 packets, and how long */
+  int loss;                     /* per 1000 packets */
+  int driftppm;                 /* receiver frames this much faster */
+} jbnetwork_t;
+
+static const jbnetwork_t jbnetworks[] = {
+  {"lan",        2,  2,  0,   0,  0,  300},
+  {"wifi",       6, 10, 10, 120, 10, -300},
+  {"busy wifi", 15, 25, 30, 250, 30,  500},
+  {"bluetooth", 25, 15,  5, 150, 20,    0},
+};
+
+typedef struct {
+  uint_64_t arrive, sent;
+  uint_64_t acked;              /* when the packet this answers was sent */
+  int tic;
+} jbpacket_t;
+
+typedef struct {
+  jbpacket_t p[JB_SIMPACKETS];
+  unsigned head, tail;
+  uint_64_t last;
+} jbpipe_t;
+
+static unsigned jbseed;
+
+static double JB_Random(void)
+{
+  jbseed = jbseed * 1103515245 + 12345;
+  return ((jbseed >> 8) + 0.5) / (1 << 24);
+}
+
+static void JB_Send(jbpipe_t *pipe, const jbnetwork_t *net, uint_64_t now, int tic, uint_64_t acked)
+{
+  jbpacket_t *p;
+  double delay;
+
+  if (JB_Random() * 1000 < net->loss || pipe->head - pipe->tail == JB_SIMPACKETS)
+    return;
+  delay = net->basems - net->jitterms * log(JB_Random());
+  if (JB_Random() * 1000 < net->spikes)
+    delay += net->spikems;
+  p = &pipe->p[pipe->head++ % JB_SIMPACKETS];
+  p->sent = now;
+  p->arrive = now + (uint_64_t)(delay * 1000);
+  if (p->arrive < pipe->last)   // one behind another, as on a radio link
+    p->arrive = pipe->last;
+  pipe->last = p->arrive;
+  p->tic = tic;
+  p->acked = acked;
+}
+
+static const jbpacket_t *JB_Receive(jbpipe_t *pipe, uint_64_t now)
+{
+  if (pipe->tail == pipe->head || pipe->p[pipe->tail % JB_SIMPACKETS].arrive > now)
+    return NULL;
+  return &pipe->p[pipe->tail++ % JB_SIMPACKETS];
+}
+
+static void JB_SimulateNetwork(const jbnetwork_t *net, boolean adaptive, int seconds)
+{
+  static uint_64_t maketime[JB_SIMPACKETS];
+  static unsigned latency[JB_SIMMAXMS + 1];
+  jbpipe_t *out = calloc(1, sizeof *out), *back = calloc(1, sizeof *back);
+  jitterbuffer_t receiver, sender;
+  const uint_64_t end = (uint_64_t)seconds * 1000000;
+  const uint_64_t framelen = JB_SIMTIC - (int_64_t)JB_SIMTIC * net->driftppm / 1000000;
+  uint_64_t now, nexttic = 0, nextframe = JB_SIMTIC / 2, acked = 0, ran = 0, total = 0;
+  int maketic = 0, reported = 0, pingtics = 0, received = 0, gametic = 0;
+  unsigned throttled = 0, frames = 0, stalls = 0, targets = 0, worst = 0, i;
+  double p99 = 0;
+
+  jbseed = 1;
+  memset(latency, 0, sizeof latency);
+  JB_Init(&receiver, JB_SIMTIC / 1000);
+  JB_Init(&sender, JB_SIMTIC / 1000);
+
+  for (now = 0; now < end; now += JB_SIMSTEP)
+    {
+      const jbpacket_t *p;
+
+      if (now >= nexttic)
+        {
+          const int lead = adaptive && JB_Lead(&sender, pingtics) < JB_SIMLEAD ?
+            JB_Lead(&sender, pingtics) : JB_SIMLEAD;
+
+          nexttic += JB_SIMTIC;
+          if (maketic - reported < lead)
+            maketime[maketic++ % JB_SIMPACKETS] = now;
+          else
+            throttled++;
+          JB_Send(out, net, now, maketic, 0);
+        }
+
+      while ((p = JB_Receive(out, now)))
+        {
+          if (p->tic > received)
+            received = p->tic;
+          acked = p->sent;
+          JB_Arrival(&receiver, (int)((p->arrive - p->sent) / 1000));
+        }
+
+      if (now >= nextframe)
+        {
+          const int buffered = received - gametic;
+          int run;
+
+          nextframe += framelen;
+          frames++;
+          if (adaptive)
+            run = JB_Playout(&receiver, buffered);
+          else  // leave one tic buffered if that still runs one
+            run = buffered > 1 ? buffered - 1 : buffered;
+          if (!buffered)
+            stalls++;
+          targets += adaptive ? JB_Target(&receiver) : 1;
+          while (run--)
+            {
+              unsigned ms = (unsigned)((now - maketime[gametic++ % JB_SIMPACKETS]) / 1000);
+
+              latency[ms < JB_SIMMAXMS ? ms : JB_SIMMAXMS]++;
+              total += ms;
+              ran++;
+              if (ms > worst)
+                worst = ms;
+            }
+          JB_Send(back, net, now, gametic, acked);
+        }
+
+      while ((p = JB_Receive(back, now)))
+        {
+          if (p->tic > reported)
+            reported = p->tic;
+          pingtics = (int)((now - p->acked + JB_SIMTIC - 1) / JB_SIMTIC);
+          JB_Arrival(&sender, (int)((p->arrive - p->sent) / 1000));
+        }
+    }
+
+  for (i = 0, ran = ran ? ran : 1; i <= JB_SIMMAXMS; i++)
+    if ((p99 += latency[i]) >= ran * 0.99)
+      break;
+  lprintf(LO_INFO, "%-10s %-8s %7.1f %7.1f %6u %6u %6.2f %7.1f %7.1f %8.1f\n",
+          net->name, adaptive ? "adaptive" : "fixed",
+          stalls * 60.0 / seconds, (double)total / ran, i, worst,
+          (double)targets / (frames ? frames : 1),
+          adaptive ? receiver.stretched * 60.0 / seconds : 0.0,
+          adaptive ? receiver.shrunk * 60.0 / seconds : 0.0,
+          throttled * 60.0 / seconds);
+  free(out);
+  free(back);
+}
+
+int JB_Simulate(int seconds)
+{
+  int n;
+
+  lprintf(LO_INFO, "JB_Simulate: %d seconds of each network, per minute:\n"
+          "network    buffer    stalls  avg ms p99 ms max ms target stretch  shrink throttled\n",
+          seconds);
+  for (n = 0; n < (int)(sizeof jbnetworks / sizeof *jbnetworks); n++)
+    {
+      JB_SimulateNetwork(&jbnetworks[n], false, seconds);
+      JB_SimulateNetwork(&jbnetworks[n], true, seconds);
+    }
+  return 0;
+}
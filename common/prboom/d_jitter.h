@@ -0,0 +1,86 @@
+/* Emacs style mode select   -*- C++ -*-
+ *-----------------------------------------------------------------------------
+ *
+ *
+ *  PrBoom: a Doom port merged with LxDoom and LSDLDoom
+ *  based on BOOM, a modified and improved DOOM engine
+ *  Copyright (C) 1999 by
+ *  id Software, Chi Hoang, Lee Killough, Jim Flynn, Rand Phares, Ty Halderman
+ *  Copyright (C) 1999-2000 by
+ *  Jess Haas, Nicolas Kalkhof, Colin Phipps, Florian Schulze
+ *  Copyright 2005, 2006 by
+ *  Florian Schulze, Colin Phipps, Neil Stevens, Andrey Budko
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ *  02111-1307, USA.
+ *
+ * DESCRIPTION:
+ *      Adaptive playout buffer for tics arriving over a network. It
+ *      measures how much a peer's packet delay varies, sizes the number
+ *      of tics to hold back from that, and paces the game slightly
+ *      faster or slower than real time to bring the buffer to that size,
+ *      instead of running tics in bursts or stopping outright.
+ *
+ *-----------------------------------------------------------------------------*/
+
+#ifndef __D_JITTER__
+#define __D_JITTER__
+
+#include "doomtype.h"
+
+#define JB_UNIT 256             /* playout rate of one tic per frame */
+#define JB_SCALE 16             /* delay and deviation are msec/JB_SCALE */
+
+/* JB_Arrival is called by whatever reads the peer's packets and
+ * JB_Playout by the thread running the game; target is the only field
+ * both touch, and it is stored and loaded atomically. */
+typedef struct {
+  int msecpertic;
+
+  /* arrivals */
+  int arrivals;
+  int delay;                    /* smoothed one way delay, JB_SCALE */
+  int deviation;                /* smoothed mean deviation of it, JB_SCALE */
+  int target;                   /* tics the buffer should hold */
+  int hold;                     /* arrivals before target may come down */
+
+  /* playout */
+  int depth;                    /* tics buffered at the last JB_Playout */
+  int average;                  /* of depth, JB_UNITs */
+  int rate;                     /* JB_UNIT is real time */
+  int credit;                   /* fraction of a tic owed, JB_UNITs */
+  unsigned frames, stalls, stretched, shrunk;
+} jitterbuffer_t;
+
+void JB_Init(jitterbuffer_t *jb, int msecpertic);
+
+/* A packet arrived with a one way delay of delay msec, measured from any
+ * fixed point, as UpdatePeerTiming does against the lowest it has seen */
+void JB_Arrival(jitterbuffer_t *jb, int delay);
+
+/* How many of the buffered tics to run this frame */
+int JB_Playout(jitterbuffer_t *jb, int buffered);
+
+int JB_Target(const jitterbuffer_t *jb);
+
+/* How many tics a sender may get ahead of a peer that is pingtics of
+ * round trip away and buffering like jb */
+int JB_Lead(const jitterbuffer_t *jb, int pingtics);
+
+/* Plays simulated networks through both the adaptive buffer and a fixed
+ * one, and prints stalls and latency for each */
+int JB_Simulate(int seconds);
+
+#endif
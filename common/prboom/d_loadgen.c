@@ -0,0 +1,587 @@
+/* Emacs style mode select   -*- C++ -*-
+ *-----------------------------------------------------------------------------
+ *
+ *
+ *  PrBoom: a Doom port merged with LxDoom and LSDLDoom
+ *  based on BOOM, a modified and improved DOOM engine
+ *  Copyright (C) 1999 by
+ *  id Software, Chi Hoang, Lee Killough, Jim Flynn, Rand Phares, Ty Halderman
+ *  Copyright (C) 1999-2000 by
+ *  Jess Haas, Nicolas Kalkhof, Colin Phipps, Florian Schulze
+ *  Copyright 2005, 2006 by
+ *  Florian Schulze, Colin Phipps, Neil Stevens, Andrey Budko
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ *  02111-1307, USA.
+ *
+ * DESCRIPTION:
+ *  Load generator for the game server: simulated clients that join games
+ *  and send tics like d_client.c, measuring how long the server takes to
+ *  return each tic to its sender, and how long clients stall waiting for
+ *  tics when packets are dropped
+ *-----------------------------------------------------------------------------
+ */
+
+#ifdef __linux__
+#define _GNU_SOURCE /* recvmmsg */
+#endif
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "doomtype.h"
+#include "protocol.h"
+
+#ifndef __linux__
+
+int main(void)
+{
+  fprintf(stderr, PACKAGE "-loadgen: Linux only\n");
+  return 1;
+}
+
+#else
+
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+
+#define MAXPLAYERS  4
+#define BACKUPTICS  12      // as d_net.h, which limits how far ahead clients get
+#define TICRATE     35
+#define TICHISTORY  256     // tics remembered for matching replies
+#define RECVBATCH   16
+#define MAXPACKET   10000
+#define INIT_US     500000
+#define GO_US       100000
+#define WARMUP_US   30000000
+#define MAXPHASES   16
+
+// Latency histogram, 10us buckets up to one second
+#define BUCKET_US   10
+#define NUMBUCKETS  100000
+
+typedef enum { lg_joining, lg_waiting, lg_playing, lg_down } lgstate_t;
+
+typedef struct {
+  int       fd;
+  lgstate_t state;
+  int       player;
+  long long lastsent;           // INIT or GO, while joining
+  long long start;              // tic 0 of the game
+  int       lastmadetic;
+  int       maketic, remotetic, remotesend;
+  int       xtratics, serverxtratics;
+  int       aheadfrom, aheadto;     // tics received past missed ones
+  long long retranstime;
+  unsigned  ticsreceived;
+  long long lastupdate;
+  long long senttime[TICHISTORY];   // when each tic was first sent
+  byte      cmds[TICHISTORY][sizeof(ticcmd_t)];
+} lgclient_t;
+
+static lgclient_t *lgclients;
+static int        numclients;
+static unsigned   rngstate = 1, lossstate = 2;
+static unsigned   lossrate;   // per 10000 packets, each way
+
+static struct {
+  unsigned long tics, packetsin, packetsout, retrans, backoffs, bad, mismatched;
+  unsigned long lost, ticspackets, repeated;
+  unsigned long histogram[NUMBUCKETS + 1];  // last is one second or more
+  long long     worst, stalled;
+} stats;
+
+static boolean measuring;
+
+static long long LG_Now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+static unsigned LG_Random(void)
+{
+  rngstate = rngstate * 1103515245 + 12345;
+  return rngstate >> 8;
+}
+
+// Whether to drop a packet, to simulate a lossy network
+static boolean LG_Lose(void)
+{
+  if (!lossrate)
+    return false;
+  lossstate = lossstate * 1103515245 + 12345;
+  if ((lossstate >> 8) % 10000 >= lossrate)
+    return false;
+  stats.lost++;
+  return true;
+}
+
+static byte LG_Sum(const byte *p, size_t len)
+{
+  byte sum = 0;
+
+  while (len--)
+    sum += *p++;
+  return sum;
+}
+
+static void LG_Send(lgclient_t *c, packet_header_t *packet, size_t len)
+{
+  packet->checksum = LG_Sum((byte *)packet + 1, len - 1);
+  if (LG_Lose())
+    stats.packetsout++;
+  else if (send(c->fd, packet, len, 0) == (ssize_t)len)
+    stats.packetsout++;
+}
+
+static void LG_SendHeader(lgclient_t *c, enum packet_type_e type, unsigned long tic, int extra)
+{
+  byte buf[sizeof(packet_header_t) + 1];
+  packet_header_t *packet = (void*)buf;
+  size_t len = sizeof *packet;
+
+  packet_set(packet, type, tic);
+  if (extra >= 0)
+    buf[len++] = extra;
+  LG_Send(c, packet, len);
+}
+
+// Hands out the tics made so far, as NetUpdate does
+static void LG_Update(lgclient_t *c, long long now)
+{
+  int newtics;
+
+  if (c->state == lg_joining && now - c->lastsent >= INIT_US) {
+    struct { packet_header_t head; short pn; } PACKEDATTR initpacket;
+
+    packet_set(&initpacket.head, PKT_INIT, 0);
+    initpacket.pn = doom_htons(-1);   // any free place
+    LG_Send(c, &initpacket.head, sizeof initpacket);
+    c->lastsent = now;
+  }
+  if (c->state == lg_waiting && now - c->lastsent >= GO_US) {
+    LG_SendHeader(c, PKT_GO, 0, c->player);
+    c->lastsent = now;
+  }
+  if (c->state != lg_playing)
+    return;
+
+  // Stalled while the oldest tic not back is more than a tic old
+  if (c->remotetic < c->maketic && measuring) {
+    long long stall = c->senttime[c->remotetic % TICHISTORY] + 1000000 / TICRATE;
+
+    if (stall < c->lastupdate)
+      stall = c->lastupdate;
+    if (now > stall)
+      stats.stalled += now - stall;
+  }
+  c->lastupdate = now;
+
+  // As TryRunTics does when it has waited too long for a tic
+  if (c->remotetic < c->maketic && now - c->retranstime > 10 * 1000000 / TICRATE &&
+      now - c->senttime[c->remotetic % TICHISTORY] > 10 * 1000000 / TICRATE) {
+    c->remotesend--;
+    LG_SendHeader(c, PKT_RETRANS, c->remotetic, c->player);
+    c->retranstime = now;
+    stats.retrans++;
+  }
+
+  newtics = (now - c->start) * TICRATE / 1000000 - c->lastmadetic;
+  newtics = (newtics > 0 ? newtics : 0);
+  c->lastmadetic += newtics;
+  while (newtics--) {
+    byte *cmd = c->cmds[c->maketic % TICHISTORY];
+    int i;
+
+    if (c->maketic - c->remotetic > BACKUPTICS/2) break;
+    for (i=0; i<(int)sizeof(ticcmd_t); i++)
+      cmd[i] = LG_Random();
+    c->senttime[c->maketic++ % TICHISTORY] = now;
+  }
+  if (c->maketic > c->remotesend) { // Send the tics to the server
+    byte buf[sizeof(packet_header_t) + 2 + 255 * sizeof(ticcmd_t)];
+    packet_header_t *packet = (void*)buf;
+    int sendtics;
+    byte *p = buf + sizeof *packet;
+
+    c->remotesend -= c->xtratics > c->serverxtratics ? c->xtratics : c->serverxtratics;
+    if (c->remotesend < 0) c->remotesend = 0;
+    sendtics = c->maketic - c->remotesend;
+    if (sendtics > 255) sendtics = 255;
+    packet_set(packet, PKT_TICC, c->remotesend);
+    packet_set_count(packet, c->ticsreceived);
+    *p++ = sendtics;
+    *p++ = c->player;
+    while (sendtics--) {
+      memcpy(p, c->cmds[c->remotesend++ % TICHISTORY], sizeof(ticcmd_t));
+      p += sizeof(ticcmd_t);
+    }
+    LG_Send(c, packet, p - buf);
+  }
+}
+
+// Copies the tics of a PKT_TICS from tic up to limit, checking that our
+// own commands came back as they were sent
+static int LG_StoreTics(lgclient_t *c, int tic, int tics, const byte *p, const byte *end, int limit)
+{
+  while (tics-- && tic < limit) {
+    int players;
+
+    if (p >= end) { stats.bad++; break; }
+    players = *p++;
+    if (p + players * (1 + sizeof(ticcmd_t)) > end) { stats.bad++; break; }
+    while (players--) {
+      if (*p == c->player && tic < c->maketic && tic >= c->maketic - TICHISTORY &&
+	  memcmp(p + 1, c->cmds[tic % TICHISTORY], sizeof(ticcmd_t)))
+	stats.mismatched++;
+      p += 1 + sizeof(ticcmd_t);
+    }
+    tic++;
+  }
+  return tic;
+}
+
+// The tics up to tic can now be run
+static void LG_RunTo(lgclient_t *c, int tic, long long now)
+{
+  for (; c->remotetic < tic; c->remotetic++) {
+    const int t = c->remotetic;
+
+    if (t >= c->maketic - TICHISTORY && t < c->maketic && measuring) {
+      long long latency = now - c->senttime[t % TICHISTORY];
+      int bucket = latency / BUCKET_US;
+
+      stats.histogram[bucket < NUMBUCKETS ? bucket : NUMBUCKETS]++;
+      if (latency > stats.worst) stats.worst = latency;
+      stats.tics++;
+    }
+  }
+}
+
+// As NetUpdate handles PKT_TICS
+static void LG_ReadTics(lgclient_t *c, const packet_header_t *packet, size_t len, long long now)
+{
+  const byte *p = (const byte *)(packet+1), *end = (const byte *)packet + len;
+  unsigned long ptic = doom_ntohl(packet->tic);
+  int tics = *p++, to;
+
+  c->ticsreceived++;
+  c->serverxtratics = packet->reserved[0];
+  stats.ticspackets++;
+  stats.repeated += packet->reserved[0];
+  if (ptic > (unsigned)c->remotetic) { // Missed some
+    to = LG_StoreTics(c, ptic, tics, p, end, c->remotetic + BACKUPTICS);
+    if (c->aheadto <= c->remotetic || (int)ptic > c->aheadto || to < c->aheadfrom) {
+      c->aheadfrom = ptic; c->aheadto = to;
+    } else {
+      if ((int)ptic < c->aheadfrom) c->aheadfrom = ptic;
+      if (to > c->aheadto) c->aheadto = to;
+    }
+    if (now - c->retranstime > 2 * 1000000 / TICRATE) {
+      byte buf[sizeof(packet_header_t) + 2];
+      const int missing = c->aheadfrom - c->remotetic;
+
+      packet_set((packet_header_t *)buf, PKT_RETRANS, c->remotetic);
+      buf[sizeof(packet_header_t)] = c->player;
+      buf[sizeof(packet_header_t) + 1] = missing < 255 ? missing : 255;
+      LG_Send(c, (packet_header_t *)buf, sizeof buf);
+      c->retranstime = now;
+      stats.retrans++;
+    }
+    return;
+  }
+  if (ptic + tics <= (unsigned)c->remotetic) return; // Will not improve things
+  to = LG_StoreTics(c, ptic, tics, p, end, INT_MAX);
+  if (c->aheadfrom <= to && c->aheadto > to) // Gap filled
+    to = c->aheadto;
+  LG_RunTo(c, to, now);
+  if (c->remotetic >= c->aheadto) c->retranstime = 0;
+}
+
+static void LG_ReadPacket(lgclient_t *c, packet_header_t *packet, size_t len, long long now)
+{
+  if (len < sizeof *packet || (packet->checksum &&
+      packet->checksum != LG_Sum((byte *)packet + 1, len - 1))) {
+    stats.bad++;
+    return;
+  }
+  stats.packetsin++;
+  switch (packet->type) {
+  case PKT_SETUP:
+    if (c->state == lg_joining && len > sizeof *packet + 1) {
+      c->player = ((struct setup_packet_s *)(packet+1))->yourplayer;
+      c->xtratics = ((struct setup_packet_s *)(packet+1))->extratic;
+      c->state = lg_waiting;
+      c->lastsent = 0;
+    }
+    break;
+  case PKT_GO:
+    if (c->state == lg_waiting) {
+      c->state = lg_playing;
+      c->start = c->lastupdate = now;
+    }
+    break;
+  case PKT_TICS:
+    if (c->state == lg_playing && len > sizeof *packet)
+      LG_ReadTics(c, packet, len, now);
+    break;
+  case PKT_RETRANS:
+    c->remotesend = doom_ntohl(packet->tic);
+    break;
+  case PKT_BACKOFF:
+    c->lastmadetic++;
+    stats.backoffs++;
+    break;
+  case PKT_DOWN:
+    c->state = lg_down;
+    break;
+  default:
+    break;
+  }
+}
+
+static void LG_Receive(lgclient_t *c)
+{
+  static byte buffers[RECVBATCH][MAXPACKET];
+  static struct mmsghdr msgs[RECVBATCH];
+  static struct iovec iovs[RECVBATCH];
+  int i, n;
+
+  do {
+    long long now;
+
+    for (i=0; i<RECVBATCH; i++) {
+      iovs[i].iov_base = buffers[i];
+      iovs[i].iov_len = MAXPACKET;
+      memset(&msgs[i].msg_hdr, 0, sizeof msgs[i].msg_hdr);
+      msgs[i].msg_hdr.msg_iov = &iovs[i];
+      msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    if ((n = recvmmsg(c->fd, msgs, RECVBATCH, MSG_DONTWAIT, NULL)) <= 0)
+      break;
+    now = LG_Now();
+    for (i=0; i<n; i++)
+      if (!LG_Lose())
+	LG_ReadPacket(c, (packet_header_t *)buffers[i], msgs[i].msg_len, now);
+  } while (n == RECVBATCH);
+}
+
+// User plus system time of a process, in clock ticks
+static long long LG_ProcessTime(int pid)
+{
+  char name[64], buf[1024], *p;
+  unsigned long utime, stime;
+  FILE *f;
+  int ok;
+
+  snprintf(name, sizeof name, "/proc/%d/stat", pid);
+  if (!(f = fopen(name, "r")))
+    return -1;
+  ok = fgets(buf, sizeof buf, f) && (p = strrchr(buf, ')')) &&
+    sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu", &utime, &stime) == 2;
+  fclose(f);
+  return ok ? (long long)(utime + stime) : -1;
+}
+
+static double LG_Percentile(double fraction)
+{
+  unsigned long want = stats.tics * fraction, seen = 0;
+  int i;
+
+  for (i=0; i<=NUMBUCKETS; i++)
+    if ((seen += stats.histogram[i]) > want)
+      return (i + 0.5) * BUCKET_US / 1000.0;
+  return 0;
+}
+
+// What one measurement found
+static void LG_Report(double loss, int seconds, int numgames, int serverpid, long long cpu)
+{
+  printf("\n%g%% loss each way: %.1f tics per client per second (%d is real time),"
+	 " stalled %.0fms per client per minute\n", loss,
+	 (double)stats.tics / seconds / numclients, TICRATE,
+	 stats.stalled / 1000.0 / numclients * 60 / seconds);
+  printf("%lu packets sent, %lu received, %lu lost, %lu bad, %lu retransmit requests,"
+	 " %lu backoffs\n", stats.packetsout, stats.packetsin, stats.lost, stats.bad,
+	 stats.retrans, stats.backoffs);
+  printf("%.2f tics repeated per PKT_TICS, %lu commands came back changed\n",
+	 stats.ticspackets ? (double)stats.repeated / stats.ticspackets : 0.0,
+	 stats.mismatched);
+  if (stats.tics)
+    printf("tic latency ms: p50 %.2f  p90 %.2f  p99 %.2f  p99.9 %.2f  max %.2f\n",
+	   LG_Percentile(0.5), LG_Percentile(0.9), LG_Percentile(0.99),
+	   LG_Percentile(0.999), stats.worst / 1000.0);
+  if (serverpid && cpu >= 0) {
+    double used = (double)cpu / sysconf(_SC_CLK_TCK) / seconds;
+
+    printf("server cpu %.1f%%", used * 100);
+    if (used > 0)
+      printf(", about %.0f games per core", numgames / used);
+    printf("\n");
+  }
+  fflush(stdout);
+}
+
+static void LG_Usage(const char *name)
+{
+  fprintf(stderr, "Usage: %s [-h host] [-p port] [-s games] [-N players]"
+	  " [-t seconds] [-P serverpid] [-l loss%%[,loss%%...]]\n", name);
+  exit(1);
+}
+
+int main(int argc, char **argv)
+{
+  const char *host = "127.0.0.1";
+  int port = 5030, numgames = 100, numplayers = 2, seconds = 10, serverpid = 0;
+  double losses[MAXPHASES] = {0};
+  int numphases = 1, phase = -1;
+  long long settle = 1000000;   // for the games to settle between measurements
+  struct addrinfo hints, *server;
+  char portname[16];
+  int epfd, i, opt;
+  long long now, started, measurestart = 0, measureend = 0, cpustart = 0;
+
+  while ((opt = getopt(argc, argv, "h:p:s:N:t:P:l:")) != EOF)
+    switch (opt) {
+    case 'h': host = optarg; break;
+    case 'p': port = atoi(optarg); break;
+    case 's': numgames = atoi(optarg); break;
+    case 'N': numplayers = atoi(optarg); break;
+    case 't': seconds = atoi(optarg); break;
+    case 'P': serverpid = atoi(optarg); break;
+    case 'l':
+      { // A measurement at each loss rate, long enough for the server to adapt
+	char *p = optarg;
+
+	for (numphases = 0; numphases < MAXPHASES && *p; numphases++) {
+	  losses[numphases] = strtod(p, &p);
+	  if (*p == ',') p++;
+	}
+	settle = 5000000;
+      }
+      break;
+    default: LG_Usage(argv[0]);
+    }
+  if (numgames < 1 || numplayers < 1 || numplayers > MAXPLAYERS || seconds < 1 || !numphases)
+    LG_Usage(argv[0]);
+  numclients = numgames * numplayers;
+
+  memset(&hints, 0, sizeof hints);
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_DGRAM;
+  snprintf(portname, sizeof portname, "%d", port);
+  if (getaddrinfo(host, portname, &hints, &server)) {
+    fprintf(stderr, "%s: can't resolve %s\n", argv[0], host);
+    return 1;
+  }
+
+  { // A socket per client
+    struct rlimit rl;
+
+    if (!getrlimit(RLIMIT_NOFILE, &rl) && rl.rlim_cur < (rlim_t)numclients + 64) {
+      rl.rlim_cur = rl.rlim_max;
+      setrlimit(RLIMIT_NOFILE, &rl);
+    }
+  }
+  started = LG_Now();
+  epfd = epoll_create1(0);
+  lgclients = calloc(numclients, sizeof *lgclients);
+  for (i=0; i<numclients; i++) {
+    lgclient_t *c = &lgclients[i];
+    struct epoll_event ev;
+
+    if ((c->fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP)) < 0 ||
+	connect(c->fd, server->ai_addr, server->ai_addrlen) < 0) {
+      perror("socket");
+      return 1;
+    }
+    fcntl(c->fd, F_SETFL, O_NONBLOCK);
+    ev.events = EPOLLIN;
+    ev.data.u32 = i;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, c->fd, &ev);
+    // Join one at a time, so the server fills games in order
+    LG_Update(c, LG_Now());
+  }
+  freeaddrinfo(server);
+  printf("%d clients joining %d games of %d players on %s:%d\n",
+	 numclients, numgames, numplayers, host, port);
+
+  while (phase < numphases) {
+    struct epoll_event events[256];
+    int n = epoll_wait(epfd, events, 256, 1);
+
+    for (i=0; i<n; i++)
+      LG_Receive(&lgclients[events[i].data.u32]);
+    now = LG_Now();
+    for (i=0; i<numclients; i++)
+      LG_Update(&lgclients[i], now);
+
+    if (phase < 0) {
+      int playing = 0;
+
+      for (i=0; i<numclients; i++)
+	playing += lgclients[i].state == lg_playing;
+      if (playing == numclients || now - started > WARMUP_US) {
+	if (playing < numclients)
+	  printf("Only %d of %d clients playing, measuring anyway\n", playing, numclients);
+	lossrate = losses[phase = 0] * 100;
+	measurestart = now + settle;
+      }
+    } else if (!measuring && now >= measurestart) {
+      memset(&stats, 0, sizeof stats);
+      measuring = true;
+      measureend = now + seconds * 1000000LL;
+      if (serverpid) cpustart = LG_ProcessTime(serverpid);
+    } else if (measuring && now >= measureend) {
+      long long cpu = serverpid ? LG_ProcessTime(serverpid) - cpustart : -1;
+
+      measuring = false;
+      LG_Report(losses[phase], seconds, numgames, serverpid, cpustart < 0 ? -1 : cpu);
+      if (++phase < numphases) {
+	lossrate = losses[phase] * 100;
+	measurestart = now + settle;
+      }
+    }
+  }
+
+  lossrate = 0;
+  for (i=0; i<numclients; i++) { // Leave, as D_QuitNetGame
+    lgclient_t *c = &lgclients[i];
+    int j;
+
+    if (c->state != lg_down)
+      for (j=0; j<4; j++)
+	LG_SendHeader(c, PKT_QUIT, c->remotetic, c->player);
+  }
+  return 0;
+}
+
+#endif // __linux__
@@ -81,6 +81,9 @@
 #include "d_main.h"
 #include "d_deh.h"  // Ty 04/08/98 - Externalizations
 #include "lprintf.h"  // jff 08/03/98 - declaration of lprintf
+#include "m_profile.h"
+#include "p_tick.h"
+#include "p_map.h"
 #include "am_map.h"
 
 void GetFirstMap(int *ep, int *map); // Ty 08/29/98 - add "-warp x" functionality
@@ -210,6 +213,7 @@ void D_Display (void)
   static gamestate_t oldgamestate = -1;
   boolean wipe;
   boolean viewactive = false, isborder = false;
+  PROF_BEGIN(D_Display);
 
   if (nodrawers)                    // for comparative timing / profiling
     return;
@@ -274,11 +278,22 @@ void D_Display (void)
 
     // Now do the drawing
 	  if (viewactive) {
+		  uint_64_t t = timingdemo ? I_GetTime_US() : 0;
+#ifdef IPHONE
 		  if ( testNewRenderer ) {	// JDC
 			  IR_RenderPlayerView (&players[displayplayer]);
- 		  } else {
+ 		  } else
+#endif
+		  {
 			  R_RenderPlayerView (&players[displayplayer]);
 		  }
+		  if (timingdemo) {
+			  t = I_GetTime_US() - t;
+			  demotiming.frames++;
+			  demotiming.render += t;
+			  if (t > demotiming.rendermax)
+				  demotiming.rendermax = t;
+		  }
 	  }
 	  if (automapmode & am_active) {
       AM_Drawer();
@@ -318,6 +333,7 @@ void D_Display (void)
   }
 
   I_EndDisplay();
+  PROF_END(D_Display);
 
   //e6y: don't thrash cpu during pausing
   if (paused) {
@@ -341,9 +357,10 @@ static const char *auto_shot_fname;
 //  calls I_GetTime, I_StartFrame, and I_StartTic
 //
 
-// This function is unused on iOS.
+// This function is unused on iOS, the headless benchmark
+// build (HEADLESS/i_main.c) drives the game with it.
 #ifndef IPHONE
-static void D_DoomLoop(void)
+void D_DoomLoop(void)
 {
   for (;;)
     {
@@ -740,17 +757,18 @@ static void NormalizeSlashes(char *str)
 #ifndef IPHONE
 static char *FindIWADFile(void)
 {
+  static char iwad[PATH_MAX+1];
   int   i;
-  char  * iwad  = NULL;
 
+  iwad[0] = '\0';
   i = M_CheckParm("-iwad");
   if (i && (++i < myargc)) {
-    iwad = I_FindFile(myargv[i], ".wad");
+    I_FindFile(myargv[i], ".wad", iwad);
   } else {
-    for (i=0; !iwad && i<nstandard_iwads; i++)
-      iwad = I_FindFile(standard_iwads[i], ".wad");
+    for (i=0; !*iwad && i<nstandard_iwads; i++)
+      I_FindFile(standard_iwads[i], ".wad", iwad);
   }
-  return iwad;
+  return *iwad ? iwad : NULL;
 }
 #endif
 
@@ -812,6 +830,10 @@ static void IdentifyVersion ( const char * iwad )
 
   //iwad = FindIWADFile();
   //iwad = iphoneFindIWADFile();
+#ifndef IPHONE
+  if (!iwad)
+    iwad = FindIWADFile();  // headless build searches -iwad and the standard names
+#endif
 	
 #if (defined(GL_DOOM) && defined(_DEBUG))
   // proff 11/99: used for debugging
@@ -1169,7 +1191,9 @@ void iphoneAddPWADFiles(void);
   
     numwadfiles = 0;
     R_FlushAllPatches();
+#ifdef GL_DOOM
     gld_CleanMemory();
+#endif
     
     
   L_SetupConsoleMasks();
@@ -1514,8 +1538,9 @@ void iphoneAddPWADFiles(void);
   if (!(p = M_CheckParm("-playdemo")) || p >= myargc-1) {   /* killough */
     if ((p = M_CheckParm ("-fastdemo")) && p < myargc-1)    /* killough */
       fastdemo = true;             // run at fastest speed possible
-    else
-      p = M_CheckParm ("-timedemo");
+    else if (!(p = M_CheckParm ("-timedemo")) || p >= myargc-1)
+      if (!(p = M_CheckParm ("-seekbench")) || p >= myargc-1)
+        p = M_CheckParm ("-predictbench");
   }
 
   if (p && p < myargc-1)
@@ -1544,6 +1569,10 @@ void iphoneAddPWADFiles(void);
 
   //jff 9/3/98 use logical output routine
   lprintf(LO_INFO,"W_Init: Init WADfiles.\n");
+  // read every lump into the zone instead of using the mapped wads
+  if (M_CheckParm ("-nowadmmap"))
+    wad_mmap = false;
+
   W_Init(); // CPhipps - handling of wadfiles init changed
 
   lprintf(LO_INFO,"\n");     // killough 3/6/98: add a newline, by popular demand :)
@@ -1633,6 +1662,80 @@ void iphoneAddPWADFiles(void);
       P_RecordChecksum (myargv[p]);
     }
 
+  // record the hot path zones, written as a Chrome trace at exit
+  if ((p = M_CheckParm ("-profile")) && ++p < myargc)
+    {
+      M_ProfStart (myargv[p]);
+    }
+
+  // work out monster sight checks on worker threads before the thinkers run
+  if ((p = M_CheckParm ("-thinkerthreads")) && ++p < myargc)
+    {
+      thinker_threads = atoi(myargv[p]);
+    }
+#ifdef GL_DOOM
+  // sector triangulations saved next to the savegames
+  if (M_CheckParm ("-nolevelcache"))
+    gl_levelcache = 0;
+  if (M_CheckParm ("-levelcacheverify"))
+    gl_levelcache = 2;
+#endif
+
+  // threads for the blockmap and the sector tesselation when a level loads
+  if ((p = M_CheckParm ("-loadthreads")) && ++p < myargc)
+    {
+      load_threads = atoi(myargv[p]);
+    }
+
+  // split the software renderer's view into strips, one per thread
+  if ((p = M_CheckParm ("-renderthreads")) && ++p < myargc)
+    {
+      render_threads = atoi(myargv[p]);
+    }
+  // draw the software view in 64x64 tiles, see r_draw.h
+  if (M_CheckParm ("-tiledview"))
+    render_tiled = true;
+  if (M_CheckParm ("-thinkerverify"))
+    thinker_verify = true;
+  if (M_CheckParm ("-nosightcache"))
+    sight_cache = false;
+  if ((p = M_CheckParm ("-snapshotcheck")) && ++p < myargc)
+    snapshot_check = atoi(myargv[p]);
+  if ((p = M_CheckParm ("-keyframes")) && ++p < myargc)
+    demo_keyframes = atoi(myargv[p]);
+
+  if (M_CheckParm ("-loadbench"))
+    {
+      G_BenchmarkLoads(startskill);
+      exit(0);
+    }
+
+  if (M_CheckParm ("-renderbench"))
+    {
+      G_BenchmarkRender(startskill, startepisode, startmap);
+      exit(0);
+    }
+
+  if ((p = M_CheckParm ("-seekbench")) && ++p < myargc)
+    {
+      int seeks = 0, s = M_CheckParm ("-seeks");
+
+      if (s && ++s < myargc)
+        seeks = atoi(myargv[s]);
+      if (!M_CheckParm ("-keyframes"))
+        demo_keyframes = DEMO_KEYFRAMES;
+      G_BenchmarkSeeks(myargv[p], seeks);
+      exit(0);
+    }
+
+  if ((p = M_CheckParm ("-predictbench")) && ++p < myargc)
+    {
+      int r = M_CheckParm ("-rtts");
+
+      G_BenchmarkPrediction(myargv[p], r && ++r < myargc ? myargv[r] : NULL);
+      exit(0);
+    }
+
   if ((p = M_CheckParm ("-fastdemo")) && ++p < myargc)
     {                                 // killough
       fastdemo = true;                // run at fastest speed possible
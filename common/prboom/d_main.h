@@ -69,6 +69,9 @@ void D_PageTicker(void);
 void D_StartTitle(void);
 void D_DoomMainSetup( const char * iwad, const char * pwad );
 void D_DoomMain(void);
+#ifndef IPHONE
+void D_DoomLoop(void);  // never returns
+#endif
 void D_AddFile (const char *file, wad_source_t source);
 
 /* cph - MBF-like wad/deh/bex autoload code */
@@ -125,6 +125,7 @@ typedef enum {
   // Leave space, so low values corresponding to normal netgame setup packets can be ignored
   nm_plcolour = 3,
   nm_savegamename = 4,
+  nm_statehash = 5,     // a tic and its state hash, see P_StateHashCheck
 } netmisctype_t;
 
 typedef struct
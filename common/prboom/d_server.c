@@ -30,9 +30,14 @@
  *  Network game server code
  *  New for LxDoom, but drawing ideas and code fragments from the
  *  earlier net code
+ *  Hosts many independent games at once from one epoll loop (Linux only)
  *-----------------------------------------------------------------------------
  */
 
+#ifdef __linux__
+#define _GNU_SOURCE /* recvmmsg and sendmmsg */
+#endif
+
 #ifdef HAVE_CONFIG_H
 #include "config.h"
 #endif
@@ -48,33 +53,36 @@
 #include <stdarg.h>
 #include <fcntl.h>
 #include <signal.h>
+#include <errno.h>
 #include <sys/types.h>
 
-#ifdef USE_SDL_NET
- #include "SDL.h"
-#endif
-
 #include "doomtype.h"
 #include "protocol.h"
-#include "i_network.h"
 #ifndef PRBOOM_SERVER
 #include "m_fixed.h"
 #endif
-#include "i_system.h"
 #include "m_swap.h"
 
-#ifndef HAVE_NET
+#if !defined(HAVE_NET) || defined(USE_SDL_NET) || !defined(__linux__)
 
 int main(void)
 {
   fprintf(stderr,
-      PACKAGE "-server: You must compile with networking enabled!\n");
+      PACKAGE "-server: You must compile with networking enabled, on Linux!\n");
   exit(1);
   return 1;
 }
 
 #else
 
+#include <stdint.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
 #ifndef HAVE_GETOPT
 /* The following code for getopt is from the libc-source of FreeBSD,
  * it might be changed a little bit.
@@ -209,39 +217,98 @@ getopt(nargc, nargv, ostr)
 #define MAXPLAYERS 4
 #define BACKUPTICS 12
 
-// Dummies to forfill l_udp.c unused client stuff
-int M_CheckParm(const char* p) { p = NULL; return 1; }
-int myargc;
-char** myargv;
+/* Each game is a session_t. Clients are told apart by address, so they
+ * keep speaking the one game protocol of protocol.h: a PKT_INIT from an
+ * unknown address joins the first game still waiting for players, or
+ * opens a new one. Everything else is driven by one epoll loop that reads
+ * packets a batch at a time with recvmmsg, runs the games they were for,
+ * and sends what those games queued with sendmmsg.
+ */
 
-void NORETURN I_Error(const char *error, ...) // killough 3/20/98: add const
-{
-  va_list argptr;
-  va_start(argptr,error);
-  vfprintf(stderr,error,argptr);
-  va_end(argptr);
-  exit(-1);
-}
+#define TICHISTORY  128     // tics kept for PKT_TICS, per game
+#define TICRECORD   (1 + MAXPLAYERS * (1 + sizeof(ticcmd_t)))
+#define RECVBATCH   64      // packets read by one recvmmsg
+#define SENDBATCH   256     // and sent by one sendmmsg
+#define MAXPACKET   10000
+#define CONFIRM_MS  2000    // for the players to confirm they are ready
+#define IDLE_MS     60000   // games not heard from for this long are dropped
+#define TIMER_MS    100
+#define STATUS_MS   10000
+#define LOSSWINDOW  100     // PKT_TICS between estimates of a player's loss
+#define RESIDUAL    1e-4    // chance of a lost tic still needing a round trip
 
-int playerjoingame[MAXPLAYERS], playerleftgame[MAXPLAYERS];
-UDP_CHANNEL remoteaddr[MAXPLAYERS];
-enum { pc_unused, pc_connected, pc_ready, pc_confirmedready, pc_playing, pc_quit } playerstate[MAXPLAYERS];
-int displaycounter;
+typedef enum {
+  pc_unused, pc_connected, pc_ready, pc_confirmedready, pc_playing, pc_quit
+} playerstate_t;
 
-boolean n_players_in_state(int n, int ps) {
-	int i,j;
-	for (i=j=0;i<MAXPLAYERS;i++)
-		if (playerstate[i] == ps) j++;
-	return (j == n);
-}
+typedef struct session_s {
+  int           id;
+  boolean       ingame;
+  boolean       closing;      // freed once the packets queued for it are sent
+  boolean       queued;       // on the list of games to run
+  struct session_s *next;
+  int           seed;
+  int           curplayers;
+  unsigned      confirming;   // when the confirmation ends, 0 if none
+  unsigned      lastheard;
+  playerstate_t playerstate[MAXPLAYERS];
+  struct sockaddr_in remoteaddr[MAXPLAYERS];
+  int           playerjoingame[MAXPLAYERS], playerleftgame[MAXPLAYERS];
+  int           remoteticfrom[MAXPLAYERS], remoteticto[MAXPLAYERS];
+  int           backoffcounter[MAXPLAYERS];
 
-void BroadcastPacket(packet_header_t *packet, size_t len)
-{
-  int i;
-  for (i=0; i<MAXPLAYERS; i++)
-    if (playerstate[i] != pc_unused && playerstate[i] != pc_quit)
-      I_SendPacketTo(packet, len, &remoteaddr[i]);
-}
+  // Tics repeated in each PKT_TICS, from the loss each player reports
+  int           redundancy[MAXPLAYERS];
+  int           loss[MAXPLAYERS];         // per 10000, smoothed
+  unsigned      ticssent[MAXPLAYERS];
+  unsigned      marksent[MAXPLAYERS];
+  int           markreceived[MAXPLAYERS]; // -1 until the first report
+  byte          netcmds[MAXPLAYERS][BACKUPTICS][sizeof(ticcmd_t)]; // as received
+
+  // Tics [firsttic,lowtic) written once the way PKT_TICS carries them, so
+  // the packet to each player is a header and a slice of this buffer
+  byte          tics[2 * TICHISTORY * TICRECORD];
+  size_t        ticend;
+  size_t        ticoffset[TICHISTORY];
+  byte          ticsum[TICHISTORY];  // byte sum of the buffer before each tic
+  byte          endsum;
+  int           firsttic, lowtic;
+} session_t;
+
+typedef struct {
+  struct sockaddr_in addr;
+  session_t     *session;     // NULL if the slot is free
+  int           player;
+} client_t;
+
+static int              sock;
+static unsigned         now;          // milliseconds, see SV_Now
+
+static session_t        **sessions;
+static int              maxsessions = 1024, numsessions, nextsessionid;
+static session_t        *runqueue;
+
+static client_t         *clients;     // open addressed on the address
+static unsigned         clientmask;
+
+static int              numplayers = 2, xtratics = 0, maxredundancy = 8;
+static byte             *setupinfo;   // struct setup_packet_s and wad names
+static size_t           setuplength;
+static char             **wadname, **wadget;
+static int              numwads;
+
+static struct mmsghdr     outmsg[SENDBATCH];
+static struct iovec       outiov[SENDBATCH][2];
+static struct sockaddr_in outaddr[SENDBATCH];
+static byte               *outbuf;    // SENDBATCH packets of outsize bytes
+static size_t             outsize;
+static int                numout;
+
+static struct {
+  unsigned long packetsin, packetsout, dropped, bad;
+} stats;
+
+int verbose;
 
 byte def_game_options[GAME_OPTIONS_SIZE] = \
 { // cf g_game.c:G_WriteOptions()
@@ -272,49 +339,11 @@ nosuch,nosuch, // distfriend
 
 const int num_gameopts = sizeof gameopt_config_names / sizeof gameopt_config_names[0];
 
-int verbose;
-
-void NORETURN sig_handler(int signum)
-{
-  char buf[80];
-  I_SigString(buf,80,signum);
-  printf("Received signal: %s\n", buf);
-
-  // Any signal is fatal
-  exit(1);
-}
-
-void doexit(void)
-{
-  packet_header_t packet;
-
-  // Send "downed" packet
-  packet_set(&packet, PKT_DOWN, 0);
-  BroadcastPacket(&packet, sizeof packet);
-}
-
-#ifndef USE_SDL_NET
-static void I_InitSockets(int v4port)
-{
-  v4socket = socket(PF_INET, SOCK_DGRAM, IPPROTO_UDP);
-  I_SetupSocket(v4socket, v4port, AF_INET);
-}
-#else
-static void I_InitSockets(Uint16 port)
-{
-  I_InitNetwork();
-  udp_socket = I_Socket(port);
-  if (!udp_socket) I_Error("I_InitSockets: failed to open UDP port %d\n",port);
-}
-#endif
-
 long int ptic(packet_header_t* p)
 {
     return doom_ntohl(p->tic);
 }
 
-
-
 void read_config_file(FILE* fp, struct setup_packet_s* sp)
 {
   byte* gameopt = sp->game_options;
@@ -345,31 +374,759 @@ void read_config_file(FILE* fp, struct setup_packet_s* sp)
 
 static int badplayer(int n) { return (n < 0 || n >= MAXPLAYERS); }
 
+static unsigned SV_Now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000u + ts.tv_nsec / 1000000;
+}
+
+static const char *SV_Address(const struct sockaddr_in *addr)
+{
+  static char buf[32];
+
+  snprintf(buf, sizeof buf, "%s:%d", inet_ntoa(addr->sin_addr), ntohs(addr->sin_port));
+  return buf;
+}
+
+// Byte sum as I_SendPacket puts it in packet_header_t.checksum, which
+// leaves out the checksum byte itself
+static byte SV_Sum(const byte *p, size_t len)
+{
+  byte sum = 0;
+
+  while (len--)
+    sum += *p++;
+  return sum;
+}
+
+static boolean SV_CheckPacket(const packet_header_t *packet, size_t len)
+{
+  return len >= sizeof *packet && (!packet->checksum ||
+    packet->checksum == SV_Sum((const byte *)packet + 1, len - 1));
+}
+
+//
+// Clients by address
+//
+
+static unsigned SV_HashAddress(const struct sockaddr_in *addr)
+{
+  return (addr->sin_addr.s_addr * 2654435761u ^ addr->sin_port * 40503u) & clientmask;
+}
+
+static boolean SV_SameAddress(const struct sockaddr_in *a, const struct sockaddr_in *b)
+{
+  return a->sin_addr.s_addr == b->sin_addr.s_addr && a->sin_port == b->sin_port;
+}
+
+static client_t *SV_FindClient(const struct sockaddr_in *addr)
+{
+  unsigned i;
+
+  for (i = SV_HashAddress(addr); clients[i].session; i = (i + 1) & clientmask)
+    if (SV_SameAddress(&clients[i].addr, addr))
+      return &clients[i];
+  return NULL;
+}
+
+static void SV_AddClient(const struct sockaddr_in *addr, session_t *s, int player)
+{
+  unsigned i = SV_HashAddress(addr);
+
+  while (clients[i].session)
+    i = (i + 1) & clientmask;
+  clients[i].addr = *addr;
+  clients[i].session = s;
+  clients[i].player = player;
+}
+
+// Backward shift deletion, so lookups never need tombstones
+static void SV_RemoveClient(const struct sockaddr_in *addr)
+{
+  client_t *c = SV_FindClient(addr);
+  unsigned i, j;
+
+  if (!c)
+    return;
+  i = c - clients;
+  c->session = NULL;
+  for (j = (i + 1) & clientmask; clients[j].session; j = (j + 1) & clientmask)
+    {
+      const unsigned home = SV_HashAddress(&clients[j].addr);
+
+      if (((j - home) & clientmask) >= ((j - i) & clientmask))
+        {
+          clients[i] = clients[j];
+          clients[j].session = NULL;
+          i = j;
+        }
+    }
+}
+
+//
+// Sending
+//
+
+static void SV_Flush(void)
+{
+  int sent = 0;
+
+  while (sent < numout)
+    {
+      const int n = sendmmsg(sock, outmsg + sent, numout - sent, 0);
+
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0)   // give up on this one and carry on with the rest
+        {
+          stats.dropped++;
+          sent++;
+          continue;
+        }
+      sent += n;
+    }
+  stats.packetsout += numout;
+  numout = 0;
+}
+
+// Returns room for a packet of up to outsize bytes to to, which
+// SV_SendPacket completes before the next one is started.
+static packet_header_t *SV_NewPacket(const struct sockaddr_in *to)
+{
+  struct msghdr *msg;
+
+  if (numout == SENDBATCH)
+    SV_Flush();
+  outaddr[numout] = *to;
+  msg = &outmsg[numout].msg_hdr;
+  memset(msg, 0, sizeof *msg);
+  msg->msg_name = &outaddr[numout];
+  msg->msg_namelen = sizeof *to;
+  msg->msg_iov = outiov[numout];
+  msg->msg_iovlen = 1;
+  outiov[numout][0].iov_base = outbuf + numout * outsize;
+  return outiov[numout++][0].iov_base;
+}
+
+// The packet is its first len bytes followed by the sharedlen bytes at
+// shared, which are not copied and sum to sharedsum.
+static void SV_SendPacket(size_t len, const byte *shared, size_t sharedlen, byte sharedsum)
+{
+  struct iovec *iov = outiov[numout-1];
+  packet_header_t *packet = iov[0].iov_base;
+
+  iov[0].iov_len = len;
+  if (sharedlen)
+    {
+      iov[1].iov_base = (void *)shared;
+      iov[1].iov_len = sharedlen;
+      outmsg[numout-1].msg_hdr.msg_iovlen = 2;
+    }
+  packet->checksum = SV_Sum((byte *)packet + 1, len - 1) + sharedsum;
+}
+
+static void SV_SendHeader(const struct sockaddr_in *to, enum packet_type_e type, unsigned long tic)
+{
+  packet_set(SV_NewPacket(to), type, tic);
+  SV_SendPacket(sizeof(packet_header_t), NULL, 0, 0);
+}
+
+// Passes on a packet just received, until the next recvmmsg reuses it
+static void SV_Broadcast(session_t *s, const packet_header_t *packet, size_t len)
+{
+  int i;
+
+  for (i=0; i<MAXPLAYERS; i++)
+    if (s->playerstate[i] != pc_unused && s->playerstate[i] != pc_quit)
+      {
+        SV_NewPacket(&s->remoteaddr[i]);
+        outiov[numout-1][0].iov_base = (void *)packet;
+        outiov[numout-1][0].iov_len = len;
+      }
+}
+
+static void SV_BroadcastHeader(session_t *s, enum packet_type_e type, unsigned long tic)
+{
+  int i;
+
+  for (i=0; i<MAXPLAYERS; i++)
+    if (s->playerstate[i] != pc_unused && s->playerstate[i] != pc_quit)
+      SV_SendHeader(&s->remoteaddr[i], type, tic);
+}
+
+static void SV_SendSetup(session_t *s, int n)
+{
+  packet_header_t *packet = SV_NewPacket(&s->remoteaddr[n]);
+  struct setup_packet_s *sinfo = (void*)(packet+1);
+  int rngseed = s->seed;
+
+  packet_set(packet, PKT_SETUP, 0);
+  memcpy(sinfo, setupinfo, setuplength);
+  sinfo->yourplayer = n;
+  /* Random number seed
+   * Mirrors the corresponding code in G_ReadOptions */
+  sinfo->game_options[13] = rngseed & 0xff;
+  rngseed >>= 8;
+  sinfo->game_options[12] = rngseed & 0xff;
+  rngseed >>= 8;
+  sinfo->game_options[11] = rngseed & 0xff;
+  rngseed >>= 8;
+  sinfo->game_options[10] = rngseed & 0xff;
+  SV_SendPacket(sizeof *packet + setuplength, NULL, 0, 0);
+}
+
+//
+// Games
+//
+
+static void SV_Queue(session_t *s)
+{
+  if (!s->queued)
+    {
+      s->queued = true;
+      s->next = runqueue;
+      runqueue = s;
+    }
+}
+
+// The first game with a free place that hasn't started, or a new one
+static session_t *SV_OpenSession(void)
+{
+  session_t *s;
+  int i, n;
+
+  for (i=0; i<numsessions; i++)
+    if (!sessions[i]->ingame && !sessions[i]->closing)
+      for (n=0; n<numplayers; n++)
+        if (sessions[i]->playerstate[n] == pc_unused)
+          return sessions[i];
+
+  if (numsessions == maxsessions)
+    return NULL;
+  s = calloc(1, sizeof *s);
+  s->id = nextsessionid++;
+  s->seed = (int)time(NULL) + s->id;
+  s->lastheard = now;
+  for (i=0; i<MAXPLAYERS; i++) {
+    s->playerjoingame[i] = INT_MAX;
+    s->playerleftgame[i] = 0;
+    s->playerstate[i] = pc_unused;
+    s->markreceived[i] = -1;
+  }
+  sessions[numsessions++] = s;
+  if (verbose) printf("Game %d opened, %d running\n", s->id, numsessions);
+  return s;
+}
+
+static void SV_FreeSession(session_t *s)
+{
+  int i;
+
+  for (i=0; i<MAXPLAYERS; i++)
+    if (s->playerstate[i] != pc_unused)
+      SV_RemoveClient(&s->remoteaddr[i]);
+  for (i=0; sessions[i] != s; i++)
+    ;
+  sessions[i] = sessions[--numsessions];
+  if (verbose) printf("Game %d closed, %d running\n", s->id, numsessions);
+  free(s);
+}
+
+static void SV_Join(client_t *c, const struct sockaddr_in *from,
+                    const packet_header_t *packet, size_t len)
+{
+  session_t *s;
+  short n = -1;
+
+  if (c) { // Sent again because the setup packet was lost
+    if (!c->session->ingame)
+      SV_SendSetup(c->session, c->player);
+    return;
+  }
+  if (!(s = SV_OpenSession()))
+    return; // Full
+
+  /* Find player number and add to the game */
+  if (len >= sizeof *packet + sizeof n) {
+    memcpy(&n, packet+1, sizeof n);
+    n = doom_ntohs(n);
+  }
+  if (badplayer(n) || n >= numplayers || s->playerstate[n] != pc_unused)
+    for (n=0; n<numplayers; n++)
+      if (s->playerstate[n] == pc_unused) break;
+
+  s->playerstate[n] = pc_connected;
+  s->remoteaddr[n] = *from;
+  s->lastheard = now;
+  SV_AddClient(from, s, n);
+  if (verbose) printf("Join by %s as player %d of game %d\n", SV_Address(from), n, s->id);
+
+  // Send setup packet, twice as it is easily lost
+  SV_SendSetup(s, n);
+  SV_SendSetup(s, n);
+}
+
+static void SV_SendWad(const struct sockaddr_in *from, const packet_header_t *packet, size_t len)
+{
+  char name[256];
+  packet_header_t *reply;
+  int i;
+
+  if (len < sizeof *packet + 2)
+    return;
+  len -= sizeof *packet + 1;
+  if (len >= sizeof name)
+    len = sizeof name - 1;
+  memcpy(name, (const byte *)(packet+1) + 1, len);
+  name[len] = 0;
+
+  if (verbose) printf("Request for %s ", name);
+  for (i=0; i<numwads; i++)
+    if (!strcasecmp(name, wadname[i]))
+      break;
+
+  reply = SV_NewPacket(from);
+  packet_set(reply, PKT_WAD, 0);
+  if ((i==numwads) || !wadget[i]) {
+    if (verbose) printf("n/a\n");
+    *(char*)(reply+1) = 0;
+    SV_SendPacket(sizeof *reply + 1, NULL, 0, 0);
+  } else {
+    strcpy((char*)(reply+1), wadname[i]);
+    strcpy((char*)(reply+1) + strlen(wadname[i]) + 1, wadget[i]);
+    printf("sending %s\n", wadget[i]);
+    SV_SendPacket(sizeof *reply + strlen(wadname[i]) + strlen(wadget[i]) + 2, NULL, 0, 0);
+  }
+}
+
+// Sends player i the tics [from,to) as a header and a slice of the
+// game's tic buffer, saying k of them are repeated in every packet
+static void SV_SendSlice(session_t *s, int i, int from, int to, int k)
+{
+  packet_header_t *packet;
+  size_t start, end;
+  byte sum;
+
+  start = s->ticoffset[from % TICHISTORY];
+  if (to == s->lowtic) {
+    end = s->ticend;
+    sum = s->endsum;
+  } else {
+    end = s->ticoffset[to % TICHISTORY];
+    sum = s->ticsum[to % TICHISTORY];
+  }
+  sum -= s->ticsum[from % TICHISTORY];
+
+  packet = SV_NewPacket(&s->remoteaddr[i]);
+  packet_set(packet, PKT_TICS, from);
+  packet->reserved[0] = k;
+  *(byte*)(packet+1) = to - from;
+  SV_SendPacket(sizeof *packet + 1, s->tics + start, end - start, sum);
+  s->ticssent[i]++;
+}
+
+// Estimates how many PKT_TICS player n loses from the count it says it
+// has received, and from that how many tics to repeat in each so that a
+// lost tic needs a round trip only about RESIDUAL of the time. Bursts
+// longer than that still need PKT_RETRANS.
+static void SV_CountLoss(session_t *s, int n, int count)
+{
+  const unsigned sent = s->ticssent[n] - s->marksent[n];
+  const int received = (count - s->markreceived[n]) & (TICS_COUNTED - 1);  // 15 bits, wrapping
+
+  if (s->markreceived[n] >= 0) {
+    int lost, k;
+    double p, r;
+
+    if (sent < LOSSWINDOW || received > (int)sent + LOSSWINDOW)
+      return; // too soon, or an old report arriving late
+    lost = received < (int)sent ? (sent - received) * 10000 / sent : 0;
+    s->loss[n] = (s->loss[n] + lost) / 2;
+    for (p = r = s->loss[n] / 10000.0, k = 0; r > RESIDUAL && k < maxredundancy; k++)
+      r *= p;
+    if (verbose && k != s->redundancy[n])
+      printf("player %d of game %d loses %d.%02d%%, repeating %d tics\n",
+	     n, s->id, s->loss[n] / 100, s->loss[n] % 100, k);
+    s->redundancy[n] = k;
+  }
+  s->marksent[n] = s->ticssent[n];
+  s->markreceived[n] = count;
+}
+
+static void SV_ReadPacket(packet_header_t *packet, size_t len, const struct sockaddr_in *from)
+{
+  client_t *c = SV_FindClient(from);
+  session_t *s;
+  int n;
+
+  stats.packetsin++;
+  if (packet->type == PKT_INIT) {
+    SV_Join(c, from, packet, len);
+    return;
+  }
+  if (packet->type == PKT_WAD) {
+    SV_SendWad(from, packet, len);
+    return;
+  }
+  if (!c) // Not in any game
+    return;
+
+  // The player is who the address joined as, whatever the packet says
+  s = c->session;
+  n = c->player;
+  s->lastheard = now;
+  SV_Queue(s);
+
+  if (verbose>2) printf("Received packet:");
+  switch (packet->type) {
+  case PKT_GO:
+    if (!s->ingame) {
+      if (s->confirming) {
+	if (s->playerstate[n] != pc_confirmedready) s->curplayers++;
+	s->playerstate[n] = pc_confirmedready;
+      } else
+	s->playerstate[n] = pc_ready;
+    } else if (s->playerstate[n] == pc_playing) // Missed the start
+      SV_SendHeader(from, PKT_GO, 0);
+    break;
+  case PKT_TICC:
+    {
+      byte tics;
+      const byte *newtic = (const byte*)(packet+1) + 2;
+
+      if (len < sizeof *packet + 2) break;
+      if (packet_get_count(packet) >= 0)
+	SV_CountLoss(s, n, packet_get_count(packet));
+      tics = *(byte*)(packet+1);
+      if (len < sizeof *packet + 2 + tics * sizeof(ticcmd_t)) break;
+
+      if (verbose>2)
+	printf("tics %ld - %ld from %d\n", ptic(packet), ptic(packet) + tics - 1, n);
+      if (ptic(packet) > s->remoteticfrom[n]) {
+	// Missed tics, so request a resend
+	SV_SendHeader(from, PKT_RETRANS, s->remoteticfrom[n]);
+      } else {
+	if (ptic(packet) + tics < s->remoteticfrom[n]) break; // Won't help
+	s->remoteticfrom[n] = ptic(packet);
+	while (tics--) {
+	  memcpy(s->netcmds[n][s->remoteticfrom[n]++%BACKUPTICS], newtic, sizeof(ticcmd_t));
+	  newtic += sizeof(ticcmd_t);
+	}
+      }
+    }
+    break;
+  case PKT_RETRANS:
+    if (len >= sizeof *packet + 2 && ((byte*)(packet+1))[1]) {
+      // Only the tics missing, without holding up the ones after them
+      const int from = ptic(packet), to = from + ((byte*)(packet+1))[1];
+
+      if (verbose>2) printf("%d requests tics %d - %d\n", n, from, to - 1);
+      if (from >= s->firsttic && from < s->lowtic) {
+	SV_SendSlice(s, n, from, to < s->lowtic ? to : s->lowtic, 0);
+	break;
+      }
+    }
+    if (verbose>2) printf("%d requests resend from %ld\n", n, ptic(packet));
+    s->remoteticto[n] = ptic(packet);
+    break;
+  case PKT_QUIT:
+    if (!s->ingame && s->playerstate[n] != pc_unused) {
+      // If we already got a PKT_GO, we have to remove this player from the count of ready players. And we then flag this player slot as vacant.
+      if (verbose) printf("player %d pulls out of game %d\n", n, s->id);
+      if (s->playerstate[n] == pc_confirmedready) s->curplayers--;
+      s->playerstate[n] = pc_unused;
+      SV_RemoveClient(from);
+    } else
+    if (s->playerleftgame[n] == INT_MAX) { // In the game
+      s->playerleftgame[n] = ptic(packet);
+      --s->curplayers;
+      if (verbose) printf("%d quits game %d at %ld (%d left)\n", n, s->id, ptic(packet), s->curplayers);
+      if (s->ingame && !s->curplayers) s->closing = true; // All players have exited
+    }
+    // Fall through and broadcast it
+  case PKT_EXTRA:
+    SV_Broadcast(s, packet, len);
+    if (packet->type == PKT_EXTRA) {
+      if (verbose>2) printf("misc from %d\n", n);
+    }
+    break;
+  default:
+    if (verbose) printf("Unrecognised packet type %d\n", packet->type);
+    break;
+  }
+}
+
+// Writes the tics up to lowtic, which every player has sent, into the
+// buffer the PKT_TICS for this game are sliced from
+static void SV_WriteTics(session_t *s, int lowtic)
+{
+  for (; s->lowtic < lowtic; s->lowtic++) {
+    const int t = s->lowtic;
+    byte *p, *q;
+    int j;
+
+    if (t - s->firsttic == TICHISTORY)
+      s->firsttic++;
+    if (s->ticend + TICRECORD > sizeof s->tics) {
+      // move the tics kept back to the start, once nothing queued points here
+      const size_t first = s->ticoffset[s->firsttic % TICHISTORY];
+
+      SV_Flush();
+      memmove(s->tics, s->tics + first, s->ticend - first);
+      s->ticend -= first;
+      for (j = s->firsttic; j < t; j++)
+	s->ticoffset[j % TICHISTORY] -= first;
+    }
+    s->ticoffset[t % TICHISTORY] = s->ticend;
+    s->ticsum[t % TICHISTORY] = s->endsum;
+
+    p = q = s->tics + s->ticend;
+    p++;
+    for (j=0; j<MAXPLAYERS; j++)
+      if ((s->playerjoingame[j] <= t) && (s->playerleftgame[j] > t)) {
+	*p++ = j;
+	memcpy(p, s->netcmds[j][t%BACKUPTICS], sizeof(ticcmd_t));
+	p += sizeof(ticcmd_t);
+      }
+    *q = (p - q - 1) / (1 + sizeof(ticcmd_t));
+    s->endsum += SV_Sum(q, p - q);
+    s->ticend = p - s->tics;
+  }
+}
+
+static void SV_SendTics(session_t *s)
+{
+  int lowtic = INT_MAX;
+  int i;
+
+  for (i=0; i<MAXPLAYERS; i++)
+    if (s->playerstate[i] == pc_playing || s->playerstate[i] == pc_quit) {
+      if (s->remoteticfrom[i] < s->playerleftgame[i]-1 && s->remoteticfrom[i]<lowtic)
+	lowtic = s->remoteticfrom[i];
+    }
+  if (lowtic == INT_MAX)
+    return;
+
+  if (verbose>1) printf("%d new tics can be run\n", lowtic - s->lowtic);
+  SV_WriteTics(s, lowtic);
+
+  // Now send all tics up to lowtic
+  for (i=0; i<MAXPLAYERS; i++)
+    if (s->playerstate[i] == pc_playing) {
+      const int k = s->redundancy[i] > xtratics ? s->redundancy[i] : xtratics;
+      int from, to;
+
+      if (s->lowtic <= s->remoteticto[i]) continue;
+      // Repeat the last k tics sent, in case the packets with them were lost
+      if ((from = s->remoteticto[i] - k) < s->firsttic) from = s->firsttic;
+      to = from + 255 < s->lowtic ? from + 255 : s->lowtic;
+      if (verbose>1) printf("sending %d tics to %d\n", to - from, i);
+      SV_SendSlice(s, i, from, to, k);
+      s->remoteticto[i] = to;
+
+      if (s->remoteticfrom[i] == s->remoteticto[i]) {
+	s->backoffcounter[i] = 0;
+      } else if (s->remoteticfrom[i] > s->remoteticto[i]+1) {
+	if ((s->backoffcounter[i] += s->remoteticfrom[i] - s->remoteticto[i] - 1) > 35) {
+	  SV_SendHeader(&s->remoteaddr[i], PKT_BACKOFF, s->remoteticto[i]);
+	  s->backoffcounter[i] = 0;
+	  if (verbose) printf("telling client %d of game %d to back off\n", i, s->id);
+	}
+      }
+    }
+}
+
+static boolean n_players_in_state(const session_t *s, int n, playerstate_t ps) {
+	int i,j;
+	for (i=j=0;i<MAXPLAYERS;i++)
+		if (s->playerstate[i] == ps) j++;
+	return (j == n);
+}
+
+static void SV_RunSession(session_t *s)
+{
+  if (s->closing)
+    return;
+  if (!s->ingame && n_players_in_state(s, numplayers, pc_confirmedready)) {
+    int i;
+    s->ingame = true;
+    s->confirming = 0;
+    if (verbose) printf("All players joined, beginning game %d.\n", s->id);
+    for (i=0; i<MAXPLAYERS; i++) {
+      if (s->playerstate[i] == pc_confirmedready) {
+	s->playerjoingame[i] = 0;
+	s->playerleftgame[i] = INT_MAX;
+	s->playerstate[i] = pc_playing;
+      }
+    }
+    SV_BroadcastHeader(s, PKT_GO, 0);
+    SV_BroadcastHeader(s, PKT_GO, 0);
+  }
+  if (!s->ingame && !s->confirming && n_players_in_state(s, numplayers, pc_ready)) {
+    if (verbose) printf("All players ready in game %d, now confirming.\n", s->id);
+    s->confirming = (now + CONFIRM_MS) | 1;
+  }
+  if (s->ingame)
+    SV_SendTics(s);
+}
+
+// Runs the games that had packets, sends what they queued, then frees
+// the games that ended now that nothing queued points into them
+static void SV_RunQueue(void)
+{
+  session_t *s;
+
+  for (s = runqueue; s; s = s->next)
+    SV_RunSession(s);
+  SV_Flush();
+  while ((s = runqueue)) {
+    runqueue = s->next;
+    s->queued = false;
+    if (s->closing)
+      SV_FreeSession(s);
+  }
+}
+
+static void SV_Receive(void)
+{
+  static byte buffers[RECVBATCH][MAXPACKET];
+  static struct mmsghdr msgs[RECVBATCH];
+  static struct iovec iovs[RECVBATCH];
+  static struct sockaddr_in addrs[RECVBATCH];
+  int i, n;
+
+  do {
+    for (i=0; i<RECVBATCH; i++) {
+      iovs[i].iov_base = buffers[i];
+      iovs[i].iov_len = MAXPACKET;
+      msgs[i].msg_hdr.msg_name = &addrs[i];
+      msgs[i].msg_hdr.msg_namelen = sizeof addrs[i];
+      msgs[i].msg_hdr.msg_iov = &iovs[i];
+      msgs[i].msg_hdr.msg_iovlen = 1;
+      msgs[i].msg_hdr.msg_control = NULL;
+      msgs[i].msg_hdr.msg_controllen = 0;
+      msgs[i].msg_hdr.msg_flags = 0;
+    }
+    if ((n = recvmmsg(sock, msgs, RECVBATCH, MSG_DONTWAIT, NULL)) <= 0) {
+      if (n < 0 && errno == EINTR) continue;
+      break;
+    }
+    now = SV_Now();
+    for (i=0; i<n; i++) {
+      packet_header_t *packet = (void*)buffers[i];
+      const size_t len = msgs[i].msg_len;
+
+      if (msgs[i].msg_hdr.msg_namelen == sizeof addrs[i] && SV_CheckPacket(packet, len))
+	SV_ReadPacket(packet, len, &addrs[i]);
+      else
+	stats.bad++;
+    }
+    // before the next recvmmsg, as forwarded packets still point at buffers
+    SV_RunQueue();
+  } while (n == RECVBATCH);
+}
+
+// Confirmations that ran out, games gone quiet, and the status line
+static void SV_Timer(void)
+{
+  static unsigned laststatus;
+  int i, j;
+
+  now = SV_Now();
+  for (i=0; i<numsessions; i++) {
+    session_t *s = sessions[i];
+
+    if (s->confirming && (int)(now - s->confirming) >= 0 && !s->ingame) {
+      s->confirming = 0;
+      s->curplayers = 0;
+      for (j=0; j<MAXPLAYERS; j++) {
+	if (s->playerstate[j] == pc_ready) {
+	  s->playerstate[j] = pc_unused;
+	  SV_RemoveClient(&s->remoteaddr[j]);
+	  if (verbose) printf("Player %d dropped from game %d, no PKT_GO received in confirmation\n", j, s->id);
+	}
+	if (s->playerstate[j] == pc_confirmedready) s->playerstate[j] = pc_ready;
+      }
+      SV_Queue(s);
+    }
+    if (now - s->lastheard > IDLE_MS && !s->closing) {
+      if (verbose) printf("Game %d timed out\n", s->id);
+      SV_BroadcastHeader(s, PKT_DOWN, 0);
+      s->closing = true;
+      SV_Queue(s);
+    }
+  }
+  SV_RunQueue();
+
+  if (now - laststatus >= STATUS_MS) {
+    int ingame = 0, players = 0, repeated = 0;
+
+    for (i=0; i<numsessions; i++) {
+      ingame += sessions[i]->ingame;
+      for (j=0; j<MAXPLAYERS; j++) {
+	players += sessions[i]->playerstate[j] != pc_unused;
+	repeated += sessions[i]->redundancy[j];
+      }
+    }
+    fprintf(stderr, "%d games (%d started), %d players repeating %.2f tics;"
+	    " %lu packets in, %lu out, %lu bad, %lu unsent\n", numsessions, ingame,
+	    players, players ? (double)repeated / players : 0.0,
+	    stats.packetsin, stats.packetsout, stats.bad, stats.dropped);
+    laststatus = now;
+  }
+}
+
+static void SV_Shutdown(void)
+{
+  int i;
+
+  // Send "downed" packet
+  for (i=0; i<numsessions; i++)
+    SV_BroadcastHeader(sessions[i], PKT_DOWN, 0);
+  SV_Flush();
+}
+
+static void SV_InitSocket(int port)
+{
+  struct sockaddr_in addr;
+  int size = 4 << 20;   // room for a burst from every game
+
+  if ((sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP)) < 0) {
+    perror("socket");
+    exit(1);
+  }
+  setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &size, sizeof size);
+  setsockopt(sock, SOL_SOCKET, SO_SNDBUF, &size, sizeof size);
+  memset(&addr, 0, sizeof addr);
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(port);
+  if (bind(sock, (struct sockaddr *)&addr, sizeof addr) < 0) {
+    perror("bind");
+    exit(1);
+  }
+}
+
 int main(int argc, char** argv)
 {
-#ifndef USE_SDL_NET
   int localport = 5030;
-#else
-  Uint16 localport = 5030;
-#endif
-  int numplayers = 2, xtratics = 0, ticdup = 1;
-  int exectics = 0; // gametics completed
-  struct setup_packet_s setupinfo = { 2, 0, 1, 1, 1, 0, best_compatibility, 0, 0};
-  char**wadname = NULL;
-  char**wadget = NULL;
-  int numwads = 0;
+  int ticdup = 1;
+  struct setup_packet_s setupinfo_ = { 2, 0, 1, 1, 1, 0, best_compatibility, 0, 0};
+  int epfd, tfd, sfd;
   {
     int opt;
-    byte *gameopt = setupinfo.game_options;
+    byte *gameopt = setupinfo_.game_options;
 
-    memcpy(gameopt, &def_game_options, sizeof (setupinfo.game_options));
-    while ((opt = getopt(argc, argv, "c:t:x:p:e:l:adrfns:N:vw:")) != EOF)
+    memcpy(gameopt, &def_game_options, sizeof (setupinfo_.game_options));
+    while ((opt = getopt(argc, argv, "c:t:x:p:e:l:adrfns:N:S:K:vw:")) != EOF)
       switch (opt) {
       case 'c':
         {
 	  FILE *cf = fopen(optarg,"r");
 	  if (!cf) { perror("fopen"); return -1; }
-	  read_config_file(cf,&setupinfo);
+	  read_config_file(cf,&setupinfo_);
 	  fclose(cf);
 	}
 	break;
@@ -383,31 +1140,37 @@ int main(int argc, char** argv)
   if (optarg) localport = atoi(optarg);
   break;
       case 'e':
-  if (optarg) setupinfo.episode = atoi(optarg);
+  if (optarg) setupinfo_.episode = atoi(optarg);
   break;
       case 'l':
-  if (optarg) setupinfo.level = atoi(optarg);
+  if (optarg) setupinfo_.level = atoi(optarg);
   break;
       case 'a':
-  setupinfo.deathmatch = 2;
+  setupinfo_.deathmatch = 2;
   break;
       case 'd':
-  setupinfo.deathmatch = 1;
+  setupinfo_.deathmatch = 1;
   break;
       case 'r':
-  setupinfo.game_options[6] = 1;
+  setupinfo_.game_options[6] = 1;
   break;
       case 'f':
-  setupinfo.game_options[7] = 1;
+  setupinfo_.game_options[7] = 1;
   break;
       case 'n':
-  setupinfo.game_options[8] = 1;
+  setupinfo_.game_options[8] = 1;
   break;
       case 's':
-  if (optarg) setupinfo.skill = atoi(optarg)-1;
+  if (optarg) setupinfo_.skill = atoi(optarg)-1;
   break;
       case 'N':
-  if (optarg) setupinfo.players = numplayers = atoi(optarg);
+  if (optarg) setupinfo_.players = numplayers = atoi(optarg);
+  break;
+      case 'S':
+  if (optarg) maxsessions = atoi(optarg);
+  break;
+      case 'K':
+  if (optarg) maxredundancy = atoi(optarg);
   break;
       case 'v':
   verbose++;
@@ -425,329 +1188,94 @@ int main(int argc, char** argv)
   break;
       }
   }
-
-  setupinfo.ticdup = ticdup; setupinfo.extratic = xtratics;
-  { /* Random number seed
-     * Mirrors the corresponding code in G_ReadOptions */
-    int rngseed = (int)time(NULL);
-    setupinfo.game_options[13] = rngseed & 0xff;
-    rngseed >>= 8;
-    setupinfo.game_options[12] = rngseed & 0xff;
-    rngseed >>= 8;
-    setupinfo.game_options[11] = rngseed & 0xff;
-    rngseed >>= 8;
-    setupinfo.game_options[10] = rngseed & 0xff;
+  if (numplayers < 1 || numplayers > MAXPLAYERS || maxsessions < 1) {
+    fprintf(stderr, "%s: -N must be 1 to %d and -S at least 1\n", argv[0], MAXPLAYERS);
+    return 1;
   }
-  I_InitSockets(localport);
-
-  printf("Listening on port %d, waiting for %d players\n", localport, numplayers);
 
-  { // no players initially
+  setupinfo_.ticdup = ticdup; setupinfo_.extratic = xtratics;
+  { // the setup packet, less the player number and seed that each game sets
     int i;
-    for (i=0; i<MAXPLAYERS; i++) {
-      playerjoingame[i] = INT_MAX;
-      playerleftgame[i] = 0;
-      playerstate[i] = pc_unused;
-    }
-
-    // Print wads
-    for (i=0; i<numwads; i++)
-      printf("Wad %s (%s)\n", wadname[i], wadget[i] ? wadget[i] : "");
-  }
-
-  // Exit and signal handling
-  atexit(doexit); // heh
-  signal(SIGTERM, sig_handler);
-  signal(SIGINT , sig_handler);
-#ifndef USE_SDL_NET
-  signal(SIGQUIT, sig_handler);
-  signal(SIGKILL, sig_handler);
-  signal(SIGHUP , sig_handler);
-#endif
-
-  {
-    int remoteticfrom[MAXPLAYERS] = { 0, 0, 0, 0 };
-    int remoteticto[MAXPLAYERS] = { 0, 0, 0, 0 };
-    int backoffcounter[MAXPLAYERS] = { 0, 0, 0, 0 };
-    int curplayers = 0;
-    int confirming = 0;
-    boolean ingame = false;
-    ticcmd_t netcmds[MAXPLAYERS][BACKUPTICS];
-
-    while (1) {
-  packet_header_t *packet = malloc(10000);
-  size_t len;
-
-  I_WaitForPacket(120*1000);
-  while ((len = I_GetPacket(packet, 10000))) {
-    if (verbose>2) printf("Received packet:");
-    switch (packet->type) {
-    case PKT_INIT:
-      if (!ingame) {
-        {
-    int n;
-    struct setup_packet_s *sinfo = (void*)(packet+1);
-
-    /* Find player number and add to the game */
-    n = *(short*)(packet+1);
+    size_t extrabytes = 0, wadbytes = 0;
 
-    if (badplayer(n) || playerstate[n] != pc_unused)
-     for (n=0; n<numplayers; n++)
-      if (playerstate[n] == pc_unused) break;
-
-    if (n == numplayers) break; // Full game
-    playerstate[n] = pc_connected;
-#ifndef USE_SDL_NET
-    remoteaddr[n] = sentfrom;
-#else
-    if (sentfrom==-1)
-      remoteaddr[n]=I_RegisterPlayer(&sentfrom_addr);
-#endif
-
-    printf("Join by ");
-    I_PrintAddress(stdout, &remoteaddr[n]);
-#ifdef USE_SDL_NET
-    printf(" (channel %d)",remoteaddr[n]);
-#endif
-    printf(" as player %d\n",n);
-    {
-      int i;
-      size_t extrabytes = 0;
-      // Send setup packet
-      packet_set(packet, PKT_SETUP, 0);
-      memcpy(sinfo, &setupinfo, sizeof setupinfo);
-      sinfo->yourplayer = n;
-      sinfo->numwads = numwads;
-      for (i=0; i<numwads; i++) {
-        strcpy(sinfo->wadnames + extrabytes, wadname[i]);
-        extrabytes += strlen(wadname[i]) + 1;
-      }
-      I_SendPacketTo(packet, sizeof *packet + sizeof setupinfo + extrabytes,
-         remoteaddr+n);
-      I_uSleep(10000);
-      I_SendPacketTo(packet, sizeof *packet + sizeof setupinfo + extrabytes,
-         remoteaddr+n);
+    setupinfo_.numwads = numwads;
+    for (i=0; i<numwads; i++) {
+      extrabytes += strlen(wadname[i]) + 1;
+      if (wadget[i] && strlen(wadname[i]) + strlen(wadget[i]) + 2 > wadbytes)
+	wadbytes = strlen(wadname[i]) + strlen(wadget[i]) + 2;
+    }
+    setuplength = sizeof setupinfo_ + extrabytes;
+    setupinfo = calloc(1, setuplength);
+    memcpy(setupinfo, &setupinfo_, sizeof setupinfo_);
+    for (extrabytes = 0, i=0; i<numwads; i++) {
+      strcpy((char*)((struct setup_packet_s*)setupinfo)->wadnames + extrabytes, wadname[i]);
+      extrabytes += strlen(wadname[i]) + 1;
     }
-        }
-      }
-      break;
-    case PKT_GO:
-      if (!ingame) {
-        int from = *(byte*)(packet+1);
-
-	if (badplayer(from) || playerstate[from] == pc_unused) break;
-	if (confirming) {
-		if (playerstate[from] != pc_confirmedready) curplayers++;
-		playerstate[from] = pc_confirmedready;
-	} else
-		playerstate[from] = pc_ready;
-      }
-      break;
-    case PKT_TICC:
-      {
-        byte tics = *(byte*)(packet+1);
-        int from = *(((byte*)(packet+1))+1);
-
-	if (badplayer(from)) break;
-
-        if (verbose>2)
-            printf("tics %ld - %ld from %d\n", ptic(packet), ptic(packet) + tics - 1, from);
-        if (ptic(packet) > remoteticfrom[from]) {
-            // Missed tics, so request a resend
-            packet_set(packet, PKT_RETRANS, remoteticfrom[from]);
-            I_SendPacketTo(packet, sizeof *packet, remoteaddr+from);
-        } else {
-            ticcmd_t *newtic = (void*)(((byte*)(packet+1))+2);
-            if (ptic(packet) + tics < remoteticfrom[from]) break; // Won't help
-            remoteticfrom[from] = ptic(packet);
-            while (tics--)
-              netcmds[from][remoteticfrom[from]++%BACKUPTICS] =  *newtic++;
-        }
-      }
-      break;
-    case PKT_RETRANS:
-      {
-        int from = *(byte*)(packet+1);
-	if (badplayer(from)) break;
 
-        if (verbose>2) printf("%d requests resend from %d\n", from, ptic(packet));
-        remoteticto[from] = ptic(packet);
-      }
-      break;
-    case PKT_QUIT:
-      {
-        int from = *(byte*)(packet+1);
-	if (badplayer(from)) break;
-
-	if (!ingame && playerstate[from] != pc_unused) {
-	  // If we already got a PKT_GO, we have to remove this player frmo the count of ready players. And we then flag this player slot as vacant.
-	  printf("player %d pulls out\n", from);
-	  if (playerstate[from] == pc_confirmedready) curplayers--;
-	  playerstate[from] = pc_unused;
-	} else
-        if (playerleftgame[from] == INT_MAX) { // In the game
-	  playerleftgame[from] = ptic(packet);
-	  --curplayers;
-	  if (verbose) printf("%d quits at %d (%d left)\n", from, ptic(packet),curplayers);
-	  if (ingame && !curplayers) exit(0); // All players have exited
-        }
-      }
-      // Fall through and broadcast it
-    case PKT_EXTRA:
-      BroadcastPacket(packet, len);
-      if (packet->type == PKT_EXTRA) {
-        if (verbose>2) printf("misc from %d\n", *(((byte*)(packet+1))+1));
-      }
-      break;
-    case PKT_WAD:
-      {
-        int i;
-        int from = *(byte*)(packet+1);
-        char *name = 1 + (char*)(packet+1);
-        size_t size = sizeof(packet_header_t);
-        packet_header_t *reply;
+    outsize = sizeof(packet_header_t) + (setuplength > wadbytes ? setuplength : wadbytes) + 1;
+    outbuf = malloc(SENDBATCH * outsize);
+  }
 
-	if (badplayer(from) || playerstate[from] != pc_unused) break;
+  sessions = malloc(maxsessions * sizeof *sessions);
+  for (clientmask = 1; clientmask < (unsigned)maxsessions * MAXPLAYERS * 2; clientmask <<= 1)
+    ;
+  clients = calloc(clientmask--, sizeof *clients);
 
-        if (verbose) printf("Request for %s ", name);
-        for (i=0; i<numwads; i++)
-    if (!strcasecmp(name, wadname[i]))
-      break;
+  SV_InitSocket(localport);
 
-        if ((i==numwads) || !wadget[i]) {
-    if (verbose) printf("n/a\n");
-    *(char*)(packet+1) = 0;
-    I_SendPacketTo(packet, size+1, remoteaddr + from);
-        } else {
-    size += strlen(wadname[i]) + strlen(wadget[i]) + 2;
-    reply = malloc(size);
-    packet_set(reply, PKT_WAD, 0);
-    strcpy((char*)(reply+1), wadname[i]);
-    strcpy((char*)(reply+1) + strlen(wadname[i]) + 1, wadget[i]);
-    printf("sending %s\n", wadget[i]);
-    I_SendPacketTo(reply, size, remoteaddr + from);
-    free(reply);
-        }
-      }
-      break;
-    default:
-      printf("Unrecognised packet type %d\n", packet->type);
-      break;
-    }
-  }
-  free(packet);
-  if (!ingame && n_players_in_state(numplayers,pc_confirmedready)) {
-    int i;
-    packet_header_t gopacket;
-    packet = &gopacket;
-    ingame=true;
-    printf("All players joined, beginning game.\n");
-    for (i=0; i<MAXPLAYERS; i++) {
-      if (playerstate[i] == pc_confirmedready) {
-	      playerjoingame[i] = 0;
-	      playerleftgame[i] = INT_MAX;
-	      playerstate[i] = pc_playing;
-      }
-    }
-    packet_set(packet, PKT_GO, 0);
-    BroadcastPacket(packet, sizeof *packet);
-    I_uSleep(10000);
-    BroadcastPacket(packet, sizeof *packet);
-    I_uSleep(10000);
-  }
-  if (confirming && !--confirming && !ingame) {
+  printf("Listening on port %d for up to %d games of %d players\n", localport, maxsessions, numplayers);
+  {
     int i;
-    curplayers = 0;
-    for (i=0; i<MAXPLAYERS; i++) {
-      if (playerstate[i] == pc_ready) {
-	      playerstate[i] = pc_unused;
-	      printf("Player %d dropped, no PKT_GO received in confirmation\n", i);
-      }
-      if (playerstate[i] == pc_confirmedready) playerstate[i] = pc_ready;
-    }
-  }
-  if (!ingame && n_players_in_state(numplayers,pc_ready)) {
-	  printf("All players ready, now confirming.\n");
-	  confirming = 100;
+    // Print wads
+    for (i=0; i<numwads; i++)
+      printf("Wad %s (%s)\n", wadname[i], wadget[i] ? wadget[i] : "");
   }
 
-  if (ingame) { // Run some tics
-  int lowtic = INT_MAX;
-  int i;
-  for (i=0; i<MAXPLAYERS; i++)
-    if (playerstate[i] == pc_playing || playerstate[i] == pc_quit) {
-      if (remoteticfrom[i] < playerleftgame[i]-1 && remoteticfrom[i]<lowtic)
-        lowtic = remoteticfrom[i];
-    }
+  { // Exit and signal handling, through the loop so games hear of it
+    sigset_t mask;
+    struct itimerspec timer = {{0, TIMER_MS * 1000000}, {0, TIMER_MS * 1000000}};
+    struct epoll_event ev;
 
-  if (verbose>1) printf("%d new tics can be run\n", lowtic - exectics);
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGTERM);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGQUIT);
+    sigaddset(&mask, SIGHUP);
+    sigprocmask(SIG_BLOCK, &mask, NULL);
+    sfd = signalfd(-1, &mask, 0);
+    tfd = timerfd_create(CLOCK_MONOTONIC, 0);
+    timerfd_settime(tfd, 0, &timer, NULL);
 
-  if (lowtic > exectics)
-    exectics = lowtic; // count exec'ed tics
-  // Now send all tics up to lowtic
-  for (i=0; i<MAXPLAYERS; i++)
-    if (playerstate[i] == pc_playing) {
-      int tics;
-      if (lowtic <= remoteticto[i]) continue;
-      if ((remoteticto[i] -= xtratics) < 0) remoteticto[i] = 0;
-      tics = lowtic - remoteticto[i];
-      {
-        byte *p;
-        packet = malloc(sizeof(packet_header_t) + 1 +
-         tics * (1 + numplayers * (1 + sizeof(ticcmd_t))));
-        p = (void*)(packet+1);
-        packet_set(packet, PKT_TICS, remoteticto[i]);
-        *p++ = tics;
-        if (verbose>1) printf("sending %d tics to %d\n", tics, i);
-        while (tics--) {
-    int j, playersthistic = 0;
-    byte *q = p++;
-    for (j=0; j<MAXPLAYERS; j++)
-      if ((playerjoingame[j] <= remoteticto[i]) &&
-          (playerleftgame[j] > remoteticto[i])) {
-        *p++ = j;
-        memcpy(p, &netcmds[j][remoteticto[i]%BACKUPTICS], sizeof(ticcmd_t));
-        p += sizeof(ticcmd_t);
-        playersthistic++;
-      }
-    *q = playersthistic;
-    remoteticto[i]++;
-        }
-        I_SendPacketTo(packet, p - ((byte*)packet), remoteaddr+i);
-        free(packet);
-      }
-      {
-        if (remoteticfrom[i] == remoteticto[i]) {
-	  backoffcounter[i] = 0;
-	} else if (remoteticfrom[i] > remoteticto[i]+1) {
-	  if ((backoffcounter[i] += remoteticfrom[i] - remoteticto[i] - 1) > 35) {
-	    packet_header_t *packet = malloc(sizeof(packet_header_t));
-	    packet_set(packet, PKT_BACKOFF, remoteticto[i]);
-	    I_SendPacketTo(packet,sizeof *packet,remoteaddr+i);
-	    backoffcounter[i] = 0;
-	    if (verbose) printf("telling client %d to back off\n",i);
-	    free(packet);
-	  }
-	}
-      }
-    }
+    epfd = epoll_create1(0);
+    ev.events = EPOLLIN;
+    ev.data.fd = sock;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, sock, &ev);
+    ev.data.fd = tfd;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, tfd, &ev);
+    ev.data.fd = sfd;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, sfd, &ev);
   }
-      if (!((ingame ? 0xff : 0xf) & displaycounter++)) { 
-        int i;
-        fprintf(stderr,"Player states: [");
-        for (i=0;i<MAXPLAYERS;i++) {
-            switch (playerstate[i]) {
-                case pc_unused: fputc(' ',stderr); break;
-                case pc_connected: fputc('c',stderr); break;
-                case pc_ready: fputc('r',stderr); break;
-                case pc_confirmedready: fputc('g',stderr); break;
-                case pc_playing: fputc('p',stderr); break;
-                case pc_quit: fputc('x',stderr); break;
-            }
-        }
-        fprintf(stderr,"]\n");
+
+  now = SV_Now();
+  while (1) {
+    struct epoll_event events[3];
+    int i, n = epoll_wait(epfd, events, 3, -1);
+
+    for (i=0; i<n; i++)
+      if (events[i].data.fd == sock)
+	SV_Receive();
+      else if (events[i].data.fd == tfd) {
+	uint64_t expirations;
+	if (read(tfd, &expirations, sizeof expirations) > 0)
+	  SV_Timer();
+      } else if (events[i].data.fd == sfd) {
+	struct signalfd_siginfo si;
+	if (read(sfd, &si, sizeof si) == sizeof si)
+	  printf("Received signal: %s\n", strsignal(si.ssi_signo));
+	// Any signal is fatal
+	SV_Shutdown();
+	return 1;
       }
-    }
   }
 }
 
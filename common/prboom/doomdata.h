@@ -62,6 +62,15 @@ enum {
   ML_BLOCKMAP           // LUT, motion clipping, walls/grid element
 };
 
+// The GL nodes that go with a map, from GL_ExMx or GL_MAPxx
+enum {
+  ML_GL_LABEL,          // A separator name, GL_ExMx or GL_MAPxx
+  ML_GL_VERTS,          // Extra Vertices
+  ML_GL_SEGS,           // Segs, from linedefs & minisegs
+  ML_GL_SSECT,          // SubSectors, list of segs
+  ML_GL_NODES           // GL BSP nodes
+};
+
 #ifdef _MSC_VER // proff: This is the same as __attribute__ ((packed)) in GNUC
 #pragma pack(push)
 #pragma pack(1)
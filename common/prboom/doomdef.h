@@ -107,8 +107,10 @@ typedef enum {
 // when multiple screen sizes are supported
 
 // proff 08/17/98: Changed for high-res
-#define MAX_SCREENWIDTH  2048
-#define MAX_SCREENHEIGHT 1536
+// Visplanes are sized to SCREENWIDTH when they are made (r_plane.c), so
+// what is left of these are the per column and per row arrays.
+#define MAX_SCREENWIDTH  7680
+#define MAX_SCREENHEIGHT 4320
 
 
 // SCREENWIDTH and SCREENHEIGHT define the visible size
@@ -63,7 +63,9 @@
 #include "p_saveg.h"
 #include "p_tick.h"
 #include "p_map.h"
+#include "p_maputl.h"
 #include "p_checksum.h"
+#include "p_predict.h"
 #include "d_main.h"
 #include "wi_stuff.h"
 #include "hu_stuff.h"
@@ -78,14 +80,19 @@
 #include "sounds.h"
 #include "r_data.h"
 #include "r_sky.h"
+#include "r_plane.h"
 #include "d_deh.h"              // Ty 3/27/98 deh declarations
 #include "p_inter.h"
 #include "g_game.h"
 #include "lprintf.h"
+#include "m_profile.h"
 #include "i_main.h"
 #include "i_system.h"
 #include "r_demo.h"
 #include "r_fps.h"
+#include "v_video.h"
+#include "md5.h"
+#include <pthread.h>
 
 void iphoneStartLevel();
 void iphoneIntermission();
@@ -115,6 +122,7 @@ static boolean command_loadgame = false;
 
 boolean         usergame;      // ok to save / end game
 boolean         timingdemo;    // if true, exit with report on completion
+demotiming_t    demotiming;    // per-tic and per-frame times for the report
 boolean         fastdemo;      // if true, run at full speed -- killough
 boolean         nodrawers;     // for comparative timing purposes
 boolean         noblit;        // for comparative timing purposes
@@ -263,6 +271,12 @@ int    bodyqueslot, bodyquesize;        // killough 2/8/98
 mobj_t **bodyque = 0;                   // phares 8/10/98
 
 /* JDC: removed static */ void G_DoSaveGame (boolean menu);
+static void G_SnapshotName(char *name, size_t size, int slot);
+static void G_CheckSnapshot(void);
+static void G_DemoKeyframe(void);
+static void G_FreeKeyframes(void);
+static size_t G_RebuildSnapshot(const byte *base, size_t baselength,
+                                const byte *snapshot, size_t length);
 static const byte* G_ReadDemoHeader(const byte* demo_p, size_t size, boolean failonerror);
 
 //
@@ -763,6 +777,7 @@ void G_Ticker (void)
 {
   int i;
   static gamestate_t prevgamestate;
+  PROF_BEGIN(G_Ticker);
 
   // CPhipps - player colour changing
   if (!demoplayback && mapcolor_plyr[consoleplayer] != mapcolor_me) {
@@ -818,6 +833,10 @@ void G_Ticker (void)
         }
     }
 
+  // keep the game every so often for G_DemoSeek
+  if (demoplayback && demo_keyframes && gamestate == GS_LEVEL)
+    G_DemoKeyframe();
+
   if (paused & 2 || (!demoplayback && menuactive && !netgame))
     basetic++;  // For revenant tracers and RNG -- we must maintain sync
   else {
@@ -939,7 +958,22 @@ void G_Ticker (void)
   switch (gamestate)
     {
     case GS_LEVEL:
-      P_Ticker ();
+      if (timingdemo)
+        {
+          uint_64_t t = I_GetTime_US();
+          if (!demotiming.start)
+            demotiming.start = t;
+          P_Ticker ();
+          t = I_GetTime_US() - t;
+          demotiming.tics++;
+          demotiming.ticker += t;
+          if (t > demotiming.tickermax)
+            demotiming.tickermax = t;
+        }
+      else
+        P_Ticker ();
+      if (snapshot_check && !(leveltime % snapshot_check))
+        G_CheckSnapshot();
       ST_Ticker ();
       AM_Ticker ();
       HU_Ticker ();
@@ -957,6 +991,8 @@ void G_Ticker (void)
       D_PageTicker ();
       break;
     }
+
+  PROF_END(G_Ticker);
 }
 
 //
@@ -1421,10 +1457,13 @@ void G_WorldDone (void)
     gameaction = ga_victory; // cph - after ExM8 summary screen, show victory stuff
 }
 
+#ifdef IPHONE
 extern float   *freeLevelOfWeek; // actually cvar, but value is first element
 extern boolean	levelHasBeenLoaded;
+#endif
 void G_DoWorldDone (void)
 { 
+#ifdef IPHONE
     // JAF Added Free level of Week Check.
     if( *freeLevelOfWeek == 1 ) {
         gameaction = ga_nothing;
@@ -1432,6 +1471,7 @@ void G_DoWorldDone (void)
         iphoneMainMenu();
         return;
     }
+#endif
     
   idmusnum = -1;             //jff 3/17/98 allow new level's music to be loaded
   gamestate = GS_LEVEL;
@@ -1586,6 +1626,7 @@ boolean G_SaveGameValid() {
     char name[PATH_MAX+1];     // killough 3/22/98
     //int savegame_compatibility = -1;
     
+    G_WaitSnapshotWrite();
     G_SaveGameName(name,sizeof(name),savegameslot, demoplayback);
     
     gameaction = ga_nothing;
@@ -1599,20 +1640,17 @@ boolean G_SaveGameValid() {
     
 }
 
-void G_DoLoadGame(void)
+//
+// G_UnArchiveGame
+// Loads the level of the savegame in savebuffer and restores the game
+// from it. Returns false, with savebuffer freed, if the player has to
+// confirm loading it first.
+//
+static boolean G_UnArchiveGame(void)
 {
-  int  length, i;
-  // CPhipps - do savegame filename stuff here
-  char name[PATH_MAX+1];     // killough 3/22/98
+  int i;
   int savegame_compatibility = -1;
 
-  G_SaveGameName(name,sizeof(name),savegameslot, demoplayback);
-
-  gameaction = ga_nothing;
-
-  length = M_ReadFile(name, &savebuffer);
-  if (length<=0)
-    I_Error("Couldn't read file %s: %s", name, "(Unknown Error)");
   save_p = savebuffer + SAVESTRINGSIZE;
 
   // CPhipps - read the description field, compare with supported ones
@@ -1631,7 +1669,7 @@ void G_DoLoadGame(void)
       savegame_compatibility = MAX_COMPATIBILITY_LEVEL-1;
     } else {
       G_LoadGameErr("Unrecognised savegame version!\nAre you sure? (y/n) ");
-      return;
+      return false;
     }
   }
 
@@ -1653,7 +1691,7 @@ void G_DoLoadGame(void)
         strcat(msg, "\nAre you sure?");
         G_LoadGameErr(msg);
         free(msg);
-        return;
+        return false;
       } else
   lprintf(LO_WARN, "G_DoLoadGame: Incompatible savegame\n");
     }
@@ -1713,9 +1751,51 @@ void G_DoLoadGame(void)
 
   if (*save_p != 0xe6)
     I_Error ("G_DoLoadGame: Bad savegame");
+  return true;
+}
+
+void G_DoLoadGame(void)
+{
+  int  length;
+  // CPhipps - do savegame filename stuff here
+  char name[PATH_MAX+1];     // killough 3/22/98
+  boolean rebuilt = false;   // savebuffer came from malloc, not M_ReadFile
+
+  G_WaitSnapshotWrite();
+  G_SaveGameName(name,sizeof(name),savegameslot, demoplayback);
+
+  gameaction = ga_nothing;
+
+  length = M_ReadFile(name, &savebuffer);
+  if (length<=0)
+    I_Error("Couldn't read file %s: %s", name, "(Unknown Error)");
+
+  { // a snapshot taken against this savegame supersedes it
+    byte *base = savebuffer, *snapshot = NULL;
+    int  snapshotlength;
+
+    G_SnapshotName(name, sizeof(name), savegameslot);
+    if ((snapshotlength = M_ReadFile(name, &snapshot)) > 0)
+      {
+        if (G_RebuildSnapshot(base, length, snapshot, snapshotlength))
+          {
+            rebuilt = true;
+            Z_Free(base);
+          }
+        else
+          savebuffer = base;
+        Z_Free(snapshot);
+      }
+  }
+  if (!G_UnArchiveGame())
+    return;
 
   // done
-  Z_Free (savebuffer);
+  if (rebuilt)
+    free(savebuffer);
+  else
+    Z_Free (savebuffer);
+  savebuffer = save_p = NULL;
 
   if (setsizeneeded)
     R_ExecuteSetViewSize ();
@@ -1798,22 +1878,16 @@ void G_SaveGameName(char *name, size_t size, int slot, boolean isDemoplayback)
 #endif
 }
 
-/* JDC: removed static */ void G_DoSaveGame (boolean menu)
+// Writes the savegame header, everything G_DoLoadGame reads before the
+// players, at save_p.
+static void G_ArchiveHeader(void)
 {
-  char name[PATH_MAX+1];
   char name2[VERSIONSIZE];
   char *description;
-  int  length, i;
-
-  gameaction = ga_nothing; // cph - cancel savegame at top of this function,
-    // in case later problems cause a premature exit
-
-  G_SaveGameName(name,sizeof(name),savegameslot, demoplayback && !menu);
+  int  i;
 
   description = savedescription;
 
-  save_p = savebuffer = malloc(savegamesize);
-
   CheckSaveGame(SAVESTRINGSIZE+VERSIONSIZE+sizeof(uint_64_t));
   memcpy (save_p, description, SAVESTRINGSIZE);
   save_p += SAVESTRINGSIZE;
@@ -1883,6 +1957,76 @@ void G_SaveGameName(char *name, size_t size, int slot, boolean isDemoplayback)
 
   // killough 11/98: save revenant tracer state
   *save_p++ = (gametic-basetic) & 255;
+}
+
+//
+// Snapshots
+//
+// A full savegame of a slot is kept as the base of later snapshots, which
+// only store the header and players, the world records changed since the
+// base (see P_ArchiveWorldDelta), the mobjs spawned, removed and changed
+// since (see P_ArchiveMobjDelta), the sectors with soundtargets and the
+// specials. They are written next to the base as a .dsd file, and
+// G_DoLoadGame rebuilds the full savegame from the two when the base they
+// were taken against is still in place.
+//
+
+#define SNAPSHOT_MAGIC "PRBMSNP2"
+
+typedef struct {
+  byte     *data;         // the base savegame, as written to disk
+  size_t   length;
+  size_t   prefix;        // header and players
+  size_t   world;         // archived world, after its padding
+  size_t   worldlength;
+  int      slot;
+  unsigned char md5[16];
+} savebase_t;
+
+typedef struct {
+  char     magic[8];
+  unsigned char md5[16];  // of the base savegame
+  unsigned baselength;
+  unsigned prefix, world, worldlength; // as laid out in the base
+  unsigned delta;         // lengths of the parts following the header
+  unsigned mobjs;         // and soundtargets
+  unsigned rest;
+} snapshotheader_t;
+
+static savebase_t savebase;
+static const savebase_t *worldbase;  // the base the world changes are kept against
+
+// the background write of the last base or snapshot
+static struct {
+  pthread_t thread;
+  boolean   running;
+  boolean   failed;
+  char      name[PATH_MAX+1];
+  char      stale[PATH_MAX+1];  // removed once name is in place
+  byte      *data;
+  size_t    length;
+  boolean   owned;              // data is freed once the write is waited for
+} snapshotwrite;
+
+int             snapshot_check;
+snapshotstats_t snapshotstats;
+
+static void G_SnapshotName(char *name, size_t size, int slot)
+{
+  G_SaveGameName(name, size, slot, false);
+  name[strlen(name)-1] = 'd';  // doomsav0.dsg -> doomsav0.dsd
+}
+
+//
+// G_ArchiveGame
+// Serializes the game into savebuffer and returns its length, noting
+// where the players end and the world lies for snapshots.
+//
+static size_t G_ArchiveGame(savebase_t *layout)
+{
+  save_p = savebuffer = malloc(savegamesize);
+
+  G_ArchiveHeader();
 
   // killough 3/22/98: add Z_CheckHeap after each call to ensure consistency
   Z_CheckHeap();
@@ -1895,7 +2039,10 @@ void G_SaveGameName(char *name, size_t size, int slot, boolean isDemoplayback)
   // caused a sound, referenced by sector_t->soundtarget.
   P_ThinkerToIndex();
 
+  layout->prefix = save_p - savebuffer;
+  layout->world = (layout->prefix + 3) & ~3;  // P_ArchiveWorld pads first
   P_ArchiveWorld();
+  layout->worldlength = save_p - savebuffer - layout->world;
   Z_CheckHeap();
   P_ArchiveThinkers();
 
@@ -1912,15 +2059,362 @@ void G_SaveGameName(char *name, size_t size, int slot, boolean isDemoplayback)
 
   *save_p++ = 0xe6;   // consistancy marker
 
-  length = save_p - savebuffer;
-
   Z_CheckHeap();
-  doom_printf( "%s", M_WriteFile(name, savebuffer, length)
+  return save_p - savebuffer;
+}
+
+//
+// G_ArchiveSnapshot
+// Serializes the game as a snapshot against base and returns it in a new
+// buffer, or NULL if the base no longer lines up with the game.
+//
+static byte *G_ArchiveSnapshot(const savebase_t *base, size_t *length)
+{
+  snapshotheader_t header;
+  size_t mobjs, rest, delta;
+  byte *snapshot, *out;
+
+  save_p = savebuffer = malloc(savegamesize);
+
+  G_ArchiveHeader();
+  P_ArchivePlayers();
+
+  if ((size_t)(save_p - savebuffer) != base->prefix)
+    {
+      free(savebuffer);
+      savebuffer = save_p = NULL;
+      return NULL;
+    }
+
+  // Everything after the world is written where a full save would put it,
+  // so P_ArchiveSpecials pads the same way. The mobj delta is a multiple
+  // of 4 bytes; where a full save would pad the mobjs, G_RebuildSnapshot
+  // does the padding when it writes them.
+  CheckSaveGame(base->world + base->worldlength - base->prefix);
+  save_p = savebuffer + base->world + base->worldlength;
+  mobjs = save_p - savebuffer;
+  P_ArchiveMobjDelta();
+  rest = save_p - savebuffer;
+  P_ArchiveSpecials();
+  P_ArchiveRNG();
+  P_ArchiveMap();
+  CheckSaveGame(1);
+  *save_p++ = 0xe6;
+  delta = save_p - savebuffer;
+  P_ArchiveWorldDelta();
+
+  memcpy(header.magic, SNAPSHOT_MAGIC, sizeof header.magic);
+  memcpy(header.md5, base->md5, sizeof header.md5);
+  header.baselength = base->length;
+  header.prefix = base->prefix;
+  header.world = base->world;
+  header.worldlength = base->worldlength;
+  header.delta = save_p - savebuffer - delta;
+  header.mobjs = rest - mobjs;
+  header.rest = delta - rest;
+
+  *length = sizeof header + header.prefix + header.delta + header.mobjs +
+    header.rest;
+  out = snapshot = malloc(*length);
+  memcpy(out, &header, sizeof header);
+  out += sizeof header;
+  memcpy(out, savebuffer, header.prefix);
+  out += header.prefix;
+  memcpy(out, savebuffer + delta, header.delta);
+  out += header.delta;
+  memcpy(out, savebuffer + mobjs, delta - mobjs);  // mobjs to 0xe6
+
+  free(savebuffer);
+  savebuffer = save_p = NULL;
+  return snapshot;
+}
+
+//
+// G_RebuildSnapshot
+// Turns a snapshot and the base it was taken against back into the full
+// savegame, left in savebuffer. Returns its length, or 0 if the snapshot
+// does not belong to this base.
+//
+static size_t G_RebuildSnapshot(const byte *base, size_t baselength,
+                                const byte *snapshot, size_t length)
+{
+  snapshotheader_t header;
+  struct MD5Context md5;
+  unsigned char digest[16];
+  const byte *p;
+
+  if (length < sizeof header)
+    return 0;
+  memcpy(&header, snapshot, sizeof header);
+  if (memcmp(header.magic, SNAPSHOT_MAGIC, sizeof header.magic) ||
+      header.baselength != baselength ||
+      header.world != ((header.prefix + 3) & ~3u) ||
+      header.world + header.worldlength > baselength ||
+      length - sizeof header < (size_t)header.prefix + header.delta +
+        header.mobjs + header.rest)
+    return 0;
+
+  MD5Init(&md5);
+  MD5Update(&md5, base, baselength);
+  MD5Final(digest, &md5);
+  if (memcmp(digest, header.md5, sizeof digest))
+    return 0;
+
+  p = snapshot + sizeof header;
+  save_p = savebuffer = malloc(savegamesize);
+  CheckSaveGame(header.world + header.worldlength);
+  memcpy(save_p, p, header.prefix);
+  memcpy(save_p + header.prefix, base + header.prefix,
+         header.world + header.worldlength - header.prefix);
+  p += header.prefix;
+  if (P_PatchWorld(save_p + header.world, header.worldlength,
+                   p, p + header.delta) != p + header.delta)
+    goto corrupt;
+  p += header.delta;
+  save_p += header.world + header.worldlength;
+  if (P_PatchMobjs(base + header.world + header.worldlength, base + baselength,
+                   p, p + header.mobjs) != p + header.mobjs)
+    goto corrupt;
+  p += header.mobjs;
+  CheckSaveGame(header.rest);
+  memcpy(save_p, p, header.rest);
+  save_p += header.rest;
+  return save_p - savebuffer;
+
+ corrupt:
+  free(savebuffer);
+  savebuffer = save_p = NULL;
+  return 0;
+}
+
+// The game was just archived into savebuffer by G_ArchiveGame: keep it as
+// the base for the next snapshots taken against this slot.
+static void G_SetSnapshotBase(savebase_t *base, const savebase_t *layout,
+                              size_t length, int slot)
+{
+  struct MD5Context md5;
+
+  free(base->data);
+  *base = *layout;
+  base->data = savebuffer;
+  base->length = length;
+  base->slot = slot;
+  MD5Init(&md5);
+  MD5Update(&md5, base->data, base->length);
+  MD5Final(base->md5, &md5);
+  savebuffer = save_p = NULL;
+  P_MarkWorldBase();
+  worldbase = base;
+}
+
+static boolean G_SnapshotBaseValid(const savebase_t *base, int slot)
+{
+  return base->data && base->slot == slot && worldbase == base &&
+    P_WorldBaseValid();
+}
+
+static void *G_SnapshotWriter(void *arg)
+{
+  char temp[PATH_MAX+8];
+  boolean ok = false;
+  FILE *fp;
+
+  (void)arg;
+  snprintf(temp, sizeof temp, "%s.tmp", snapshotwrite.name);
+  if ((fp = fopen(temp, "wb")))
+    {
+      ok = fwrite(snapshotwrite.data, 1, snapshotwrite.length, fp)
+        == snapshotwrite.length;
+      ok &= !fclose(fp);
+      if (ok)   // replace the old file only once the new one is complete
+        ok = !rename(temp, snapshotwrite.name);
+      if (!ok)
+        remove(temp);
+    }
+  if (ok && snapshotwrite.stale[0])
+    remove(snapshotwrite.stale);
+  snapshotwrite.failed = !ok;
+  return NULL;
+}
+
+// The buffer came from the zone, which only the game thread may touch.
+static void G_FreeSnapshotWrite(void)
+{
+  if (snapshotwrite.owned)
+    free(snapshotwrite.data);
+  snapshotwrite.data = NULL;
+  snapshotwrite.owned = false;
+}
+
+// Hands the file to the writer thread, or writes it here if no thread
+// can be started.
+static void G_StartSnapshotWrite(const char *name, const char *stale,
+                                 byte *data, size_t length, boolean owned)
+{
+  snprintf(snapshotwrite.name, sizeof snapshotwrite.name, "%s", name);
+  snprintf(snapshotwrite.stale, sizeof snapshotwrite.stale, "%s", stale);
+  snapshotwrite.data = data;
+  snapshotwrite.length = length;
+  snapshotwrite.owned = owned;
+  snapshotwrite.running =
+    !pthread_create(&snapshotwrite.thread, NULL, G_SnapshotWriter, NULL);
+  if (!snapshotwrite.running)
+    {
+      G_SnapshotWriter(NULL);
+      G_FreeSnapshotWrite();
+    }
+}
+
+//
+// G_WaitSnapshotWrite
+// Blocks until the last snapshot is on disk; false if writing it failed.
+// Anything that reads or rewrites the savegame files waits here first.
+//
+boolean G_WaitSnapshotWrite(void)
+{
+  if (snapshotwrite.running)
+    {
+      pthread_join(snapshotwrite.thread, NULL);
+      snapshotwrite.running = false;
+      G_FreeSnapshotWrite();
+      if (snapshotwrite.failed)
+        doom_printf("Game save failed!");
+    }
+  return !snapshotwrite.failed;
+}
+
+//
+// G_DoSnapshotGame
+// Saves to savegameslot like G_DoSaveGame, but as a snapshot against the
+// slot's base when there is one, and leaves writing it to another thread.
+// A new base is written instead when there is none for this level, or when
+// so much has changed that the snapshot would be half the size of a base.
+//
+void G_DoSnapshotGame(void)
+{
+  char name[PATH_MAX+1], delta[PATH_MAX+1];
+  savebase_t layout;
+  size_t length;
+
+  gameaction = ga_nothing;
+  G_WaitSnapshotWrite();  // the writer may still be using the base
+
+  G_SaveGameName(name, sizeof(name), savegameslot, false);
+  G_SnapshotName(delta, sizeof(delta), savegameslot);
+
+  if (G_SnapshotBaseValid(&savebase, savegameslot))
+    {
+      byte *snapshot = G_ArchiveSnapshot(&savebase, &length);
+
+      if (snapshot && length * 2 < savebase.length)
+        {
+          G_StartSnapshotWrite(delta, "", snapshot, length, true);
+          savedescription[0] = 0;
+          return;
+        }
+      free(snapshot);
+    }
+
+  length = G_ArchiveGame(&layout);
+  G_SetSnapshotBase(&savebase, &layout, length, savegameslot);
+  G_StartSnapshotWrite(name, delta, savebase.data, savebase.length, false);
+  savedescription[0] = 0;
+}
+
+//
+// G_CheckSnapshot
+// -snapshotcheck: rebuilds a snapshot against its base and compares it with
+// a full save of the same tic. The first call of each level takes the base.
+//
+static void G_CheckSnapshot(void)
+{
+  savebase_t layout;
+  size_t length, fulllength, rebuilt;
+  uint_64_t t;
+  byte *snapshot, *full;
+  thinker_t *th;
+
+  if (!G_SnapshotBaseValid(&savebase, -1))
+    {
+      length = G_ArchiveGame(&layout);
+      G_SetSnapshotBase(&savebase, &layout, length, -1);
+      return;
+    }
+
+  t = I_GetTime_US();
+  snapshot = G_ArchiveSnapshot(&savebase, &length);
+  snapshotstats.snaptime += I_GetTime_US() - t;
+  if (!snapshot)
+    {
+      lprintf(LO_WARN, "G_CheckSnapshot: base no longer lines up at tic %d\n", gametic);
+      snapshotstats.mismatches++;
+      return;
+    }
+
+  snapshotstats.snapmobjs += P_DirtyMobjs();
+  for (th = thinkercap.next; th != &thinkercap; th = th->next)
+    snapshotstats.mobjs += th->function == P_MobjThinker;
+
+  t = I_GetTime_US();
+  fulllength = G_ArchiveGame(&layout);
+  snapshotstats.fulltime += I_GetTime_US() - t;
+  full = savebuffer;
+  savebuffer = save_p = NULL;
+
+  rebuilt = G_RebuildSnapshot(savebase.data, savebase.length, snapshot, length);
+  if (rebuilt != fulllength || memcmp(savebuffer, full, fulllength))
+    {
+      size_t i = 0;
+
+      while (i < rebuilt && i < fulllength && savebuffer[i] == full[i])
+        i++;
+      lprintf(LO_WARN, "G_CheckSnapshot: tic %d differs at byte %lu of %lu"
+              " (world %lu-%lu)\n", gametic, (unsigned long)i,
+              (unsigned long)fulllength, (unsigned long)layout.world,
+              (unsigned long)(layout.world + layout.worldlength));
+      snapshotstats.mismatches++;
+    }
+  snapshotstats.snapshots++;
+  snapshotstats.snapbytes += length;
+  snapshotstats.fullbytes += fulllength;
+
+  free(savebuffer);
+  savebuffer = save_p = NULL;
+  free(snapshot);
+  free(full);
+}
+
+/* JDC: removed static */ void G_DoSaveGame (boolean menu)
+{
+  char name[PATH_MAX+1], delta[PATH_MAX+1];
+  savebase_t layout;
+  int  length;
+  boolean ok;
+
+  gameaction = ga_nothing; // cph - cancel savegame at top of this function,
+    // in case later problems cause a premature exit
+
+  G_WaitSnapshotWrite();
+  G_SaveGameName(name,sizeof(name),savegameslot, demoplayback && !menu);
+  G_SnapshotName(delta, sizeof(delta), savegameslot);
+
+  length = G_ArchiveGame(&layout);
+
+  ok = M_WriteFile(name, savebuffer, length);
+  doom_printf( "%s", ok
          ? s_GGSAVED /* Ty - externalised */
          : "Game save failed!"); // CPhipps - not externalised
 
-  free(savebuffer);  // killough
-  savebuffer = save_p = NULL;
+  if (ok)
+    {
+      remove(delta);  // any snapshot belongs to the save just replaced
+      G_SetSnapshotBase(&savebase, &layout, length, savegameslot);
+    }
+  else
+    {
+      free(savebuffer);  // killough
+      savebuffer = save_p = NULL;
+    }
 
   savedescription[0] = 0;
 }
@@ -2924,6 +3418,8 @@ void G_DoPlayDemo(void)
   ExtractFileBase(defdemoname,basename);           // killough
   basename[8] = 0;
 
+  G_FreeKeyframes();
+
   /* cph - store lump number for unlocking later */
   demolumpnum = W_GetNumForName(basename);
   demobuffer = W_CacheLumpNum(demolumpnum);
@@ -2940,6 +3436,670 @@ void G_DoPlayDemo(void)
   starttime = I_GetTime_RealTime ();
 }
 
+//
+// Demo keyframes
+//
+// While a demo plays, the game is kept every demo_keyframes tics so that
+// G_DemoSeek can go back to the nearest keyframe and play on from there
+// instead of from the start. The first keyframe of a level is a full
+// savegame and the ones after it are snapshots against it, like those of
+// G_DoSnapshotGame, until one would be half its size and a new full
+// keyframe is taken instead.
+//
+
+typedef struct keyframe_s {
+  int        tic;         // gametic the game was kept at
+  size_t     demooffset;  // of the ticcmds for that tic
+  const struct keyframe_s *base; // the full keyframe of a snapshot, or NULL
+  savebase_t save;        // the savegame; only data and length for a snapshot
+  byte       *order;      // see P_ArchiveThinkerOrder
+  size_t     orderlength;
+} keyframe_t;
+
+#define KEYFRAME_SLOT   (-2)        // neither a savegame slot nor -snapshotcheck's
+#define KEYFRAME_MEMORY (32 << 20)  // snapshots are thinned out to stay below
+
+int demo_keyframes;                 // -keyframes, DEMO_KEYFRAMES for -seekbench
+
+static keyframe_t **keyframes;
+static int numkeyframes, maxkeyframes;
+static int keyframeinterval;        // demo_keyframes, doubled by each thinning
+static size_t keyframememory;
+static keyframe_t *keyframebase;    // the last full keyframe
+
+static void G_FreeKeyframes(void)
+{
+  if (keyframebase && worldbase == &keyframebase->save)
+    worldbase = NULL;
+  while (numkeyframes)
+    {
+      keyframe_t *k = keyframes[--numkeyframes];
+
+      free(k->save.data);
+      free(k->order);
+      free(k);
+    }
+  keyframebase = NULL;
+  keyframememory = 0;
+  keyframeinterval = demo_keyframes;
+}
+
+// Drops every other snapshot, keeping the full keyframes they are against,
+// and takes the following ones half as often.
+static void G_ThinKeyframes(void)
+{
+  int i, n = 0;
+
+  for (i = 0; i < numkeyframes; i++)
+    {
+      keyframe_t *k = keyframes[i];
+
+      if (k->base && (i & 1))
+        {
+          keyframememory -= k->save.length + k->orderlength;
+          free(k->save.data);
+          free(k->order);
+          free(k);
+        }
+      else
+        keyframes[n++] = k;
+    }
+  numkeyframes = n;
+  keyframeinterval *= 2;
+}
+
+//
+// G_DemoKeyframe
+// Called by G_Ticker before the ticcmds of a level tic are read. A tic
+// that was played before, and seeked back over since, is already covered.
+//
+static void G_DemoKeyframe(void)
+{
+  const keyframe_t *last = numkeyframes ? keyframes[numkeyframes-1] : NULL;
+  byte *snapshot = NULL;
+  keyframe_t *k;
+  size_t length;
+
+  if (last && (gametic <= last->tic ||
+               (gametic - last->tic < keyframeinterval && leveltime)))
+    return;
+
+  if (keyframebase && G_SnapshotBaseValid(&keyframebase->save, KEYFRAME_SLOT))
+    {
+      snapshot = G_ArchiveSnapshot(&keyframebase->save, &length);
+      if (snapshot && length * 2 >= keyframebase->save.length)
+        {
+          free(snapshot);
+          snapshot = NULL;
+        }
+    }
+
+  k = calloc(1, sizeof *k);
+  k->tic = gametic;
+  k->demooffset = demo_p - demobuffer;
+  if (snapshot)
+    {
+      k->base = keyframebase;
+      k->save.data = snapshot;
+      k->save.length = length;
+    }
+  else
+    {
+      savebase_t layout;
+
+      length = G_ArchiveGame(&layout);
+      savebuffer = realloc(savebuffer, length);
+      G_SetSnapshotBase(&k->save, &layout, length, KEYFRAME_SLOT);
+      keyframebase = k;
+    }
+
+  save_p = savebuffer = malloc(savegamesize);
+  P_ArchiveThinkerOrder();
+  k->orderlength = save_p - savebuffer;
+  k->order = realloc(savebuffer, k->orderlength);
+  savebuffer = save_p = NULL;
+
+  if (numkeyframes == maxkeyframes)
+    keyframes = realloc(keyframes, (maxkeyframes = maxkeyframes ? maxkeyframes*2 : 64)
+                        * sizeof *keyframes);
+  keyframes[numkeyframes++] = k;
+  keyframememory += k->save.length + k->orderlength;
+  if (keyframememory > KEYFRAME_MEMORY)
+    G_ThinKeyframes();
+}
+
+// Puts the game back as it was kept in k. Returns false if it can't be.
+static boolean G_RestoreKeyframe(const keyframe_t *k)
+{
+  const int tic = gametic;
+
+  if (k->base)
+    {
+      if (!G_RebuildSnapshot(k->base->save.data, k->base->save.length,
+                             k->save.data, k->save.length))
+        return false;
+    }
+  else
+    {
+      savebuffer = malloc(k->save.length);
+      memcpy(savebuffer, k->save.data, k->save.length);
+    }
+
+  gametic = k->tic;      // for basetic
+  if (!G_UnArchiveGame())
+    {
+      gametic = tic;
+      return false;
+    }
+  free(savebuffer);
+  savebuffer = NULL;
+  usergame = false;      // G_InitNew set it
+
+  save_p = k->order;
+  P_UnArchiveThinkerOrder();
+  save_p = NULL;
+  demo_p = demobuffer + k->demooffset;
+  return true;
+}
+
+static boolean G_DemoFinished(void)
+{
+  return demo_p >= demobuffer + demolength || *demo_p == DEMOMARKER;
+}
+
+//
+// G_DemoSeek
+// Takes the demo being played to gametic tic: from the last keyframe at or
+// before it if that is nearer than where the demo is, then by running the
+// ticcmds up to it without drawing or sound. Returns the tic reached, which
+// is short of tic if the demo ends first.
+//
+int G_DemoSeek(int tic)
+{
+  const boolean nosfx = nosfxparm;
+  int lo = 0, hi = numkeyframes;
+
+  if (!demoplayback || !demobuffer)
+    return gametic;
+
+  while (lo < hi)   // the first keyframe after tic
+    {
+      const int mid = (lo + hi) / 2;
+
+      if (keyframes[mid]->tic <= tic)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+
+  nosfxparm = true;
+  if (numkeyframes && tic < gametic)  // nothing is kept before the first level
+    G_RestoreKeyframe(keyframes[lo ? lo-1 : 0]);
+  else if (lo && keyframes[lo-1]->tic > gametic)
+    G_RestoreKeyframe(keyframes[lo-1]);
+
+  while (gametic < tic && demoplayback && !G_DemoFinished())
+    {
+      G_Ticker();
+      gametic++;
+    }
+  nosfxparm = nosfx;
+
+  maketic = gametic;  // or TryRunTics would run the tics skipped over
+  R_FillBackScreen();
+  return gametic;
+}
+
+/* G_BenchmarkLoads
+ *
+ * -loadbench: loads every map in the wads twice, once with lumps read into
+ * the zone and once through the mapped wad, with the lump cache flushed
+ * before each load so both start from the same place.
+ */
+void G_BenchmarkLoads(skill_t skill)
+{
+  static const char *const modes[2] = {"zone copies", "mapped wad"};
+  const boolean oldmmap = wad_mmap;
+  uint_64_t time[2] = {0, 0}, timemax[2] = {0, 0};
+  size_t copied[2] = {0, 0}, mapped[2] = {0, 0}, zonepeak[2] = {0, 0};
+  int episode, map, mode, maps = 0;
+
+  for (episode = 1; episode <= (gamemode == commercial ? 1 : 4); episode++)
+    for (map = 1; map <= (gamemode == commercial ? 32 : 9); map++)
+      {
+        char name[9];
+
+        if (gamemode == commercial)
+          sprintf(name, "MAP%02d", map);
+        else
+          sprintf(name, "E%dM%d", episode, map);
+        if (W_CheckNumForName(name) == -1)
+          continue;
+
+        // alternate so neither one always gets the colder OS cache
+        for (mode = maps & 1; mode < 2 + (maps & 1); mode++)
+          {
+            const int m = mode & 1;
+            const wadcachestats_t before = wadcachestats;
+            size_t zone, inmap;
+            uint_64_t t;
+
+            wad_mmap = m;
+            W_FlushCache();
+            t = I_GetTime_US();
+            G_InitNew(skill, episode, map);
+            t = I_GetTime_US() - t;
+
+            time[m] += t;
+            if (t > timemax[m])
+              timemax[m] = t;
+            copied[m] += wadcachestats.bytescopied - before.bytescopied;
+            mapped[m] += wadcachestats.bytesmapped - before.bytesmapped;
+            W_CacheUsage(&zone, &inmap);
+            if (zone > zonepeak[m])
+              zonepeak[m] = zone;
+          }
+        maps++;
+      }
+  wad_mmap = oldmmap;
+
+  if (!maps)
+    return;
+  for (mode = 0; mode < 2; mode++)
+    lprintf(LO_INFO, "%-12s %d maps: %.2f ms avg, %.2f ms max, %lu KB read, "
+            "%lu KB mapped, %lu KB of lumps in the zone at most\n",
+            modes[mode], maps, time[mode] / 1000.0 / maps, timemax[mode] / 1000.0,
+            (unsigned long)(copied[mode] >> 10), (unsigned long)(mapped[mode] >> 10),
+            (unsigned long)(zonepeak[mode] >> 10));
+}
+
+/* G_BenchmarkRender
+ *
+ * -renderbench: draws the start of the -warp map in eight directions with
+ * 1, 2, 4 and 8 render threads, then into a tiled view (-tiledview) with 1
+ * and 8. Every frame is checked byte for byte against the same direction
+ * drawn by one thread; set the resolution with -width and -height.
+ */
+#define RENDERBENCH_FRAMES 16
+
+void G_BenchmarkRender(skill_t skill, int episode, int map)
+{
+  static const struct {
+    int threads, tiled;
+  } runs[] = {{1, false}, {2, false}, {4, false}, {8, false}, {1, true}, {8, true}};
+  const int oldthreads = render_threads;
+  const int oldtiled = render_tiled;
+  const size_t size = SCREENHEIGHT * screens[0].byte_pitch;
+  player_t *player = &players[consoleplayer];
+  uint_64_t single = 0;
+  byte *reference;
+  angle_t angle;
+  int i;
+
+  G_InitNew(skill, episode, map);
+  if (setsizeneeded)
+    R_ExecuteSetViewSize();
+  angle = player->mo->angle;
+  reference = malloc(size * 8);
+
+  lprintf(LO_INFO, "G_BenchmarkRender: %dx%d, view %dx%d, %d frames each\n",
+          SCREENWIDTH, SCREENHEIGHT, viewwidth, viewheight, RENDERBENCH_FRAMES * 8);
+  for (i = 0; i < (int)(sizeof runs / sizeof *runs); i++)
+    {
+      const int threads = runs[i].threads;
+      uint_64_t time = 0;
+      int frame, dir, mismatches = 0;
+
+      render_threads = threads;
+      if (render_tiled != runs[i].tiled)
+        {
+          render_tiled = runs[i].tiled;
+          R_InitBuffer(scaledviewwidth, viewheight);
+        }
+      for (frame = 0; frame < RENDERBENCH_FRAMES; frame++)
+        for (dir = 0; dir < 8; dir++)
+          {
+            byte *ref = reference + dir * size;
+            uint_64_t t;
+
+            player->mo->angle = angle + (angle_t)dir * ANG45;
+            t = I_GetTime_US();
+            R_RenderPlayerView(player);
+            time += I_GetTime_US() - t;
+
+            if (!i && !frame)
+              memcpy(ref, screens[0].data, size);
+            else if (memcmp(ref, screens[0].data, size))
+              mismatches++;
+          }
+      if (!i)
+        single = time;
+
+      lprintf(LO_INFO, "%d thread%s%s: %.3f ms/frame, %.2fx, %d frame%s differ%s\n",
+              threads, threads > 1 ? "s" : "", runs[i].tiled ? ", tiled" : "",
+              time / 1000.0 / (RENDERBENCH_FRAMES * 8),
+              time ? (double)single / time : 0.0,
+              mismatches, mismatches == 1 ? "" : "s", mismatches == 1 ? "s" : "");
+    }
+
+  player->mo->angle = angle;
+  render_threads = oldthreads;
+  render_tiled = oldtiled;
+  R_InitBuffer(scaledviewwidth, viewheight);
+  free(reference);
+}
+
+// What G_BenchmarkSeeks compares: the RNG, the players and their mobjs,
+// the mobjs in the order they think and the sector heights and lights.
+static void G_HashGame(unsigned char digest[16])
+{
+  struct MD5Context md5;
+  thinker_t *th;
+  int i, j;
+
+  MD5Init(&md5);
+  MD5Update(&md5, (const md5byte *)&rng, sizeof rng);
+  MD5Update(&md5, (const md5byte *)&leveltime, sizeof leveltime);
+  for (i = 0; i < MAXPLAYERS; i++)
+    if (playeringame[i])
+      {
+        const player_t *p = &players[i];
+        const mobj_t *mo = p->mo;
+
+        // the runs of plain numbers, leaving out pointers and padding
+        MD5Update(&md5, (const md5byte *)&p->playerstate,
+                  (const byte *)(&p->secretcount + 1) - (const byte *)&p->playerstate);
+        MD5Update(&md5, (const md5byte *)&p->damagecount,
+                  (const byte *)(&p->bonuscount + 1) - (const byte *)&p->damagecount);
+        MD5Update(&md5, (const md5byte *)&p->extralight,
+                  (const byte *)(&p->colormap + 1) - (const byte *)&p->extralight);
+        for (j = 0; j < NUMPSPRITES; j++)
+          {
+            const pspdef_t *psp = &p->psprites[j];
+            const int v[] = {
+              psp->state ? (int)(psp->state - states) : -1, psp->tics, psp->sx, psp->sy
+            };
+
+            MD5Update(&md5, (const md5byte *)v, sizeof v);
+          }
+        if (mo)
+          {
+            const int v[] = {
+              mo->x, mo->y, mo->z, mo->momx, mo->momy, mo->momz, (int)mo->angle,
+              mo->floorz, mo->ceilingz, mo->dropoffz, mo->flags, mo->intflags & ~MIF_DIRTY,
+              mo->health, mo->tics, (int)(mo->state - states), mo->reactiontime,
+              mo->radius, mo->height
+            };
+
+            MD5Update(&md5, (const md5byte *)v, sizeof v);
+          }
+      }
+  for (th = thinkercap.next; th != &thinkercap; th = th->next)
+    if (th->function == P_MobjThinker)
+      {
+        const mobj_t *mo = (const mobj_t *)th;
+        const int v[] = {
+          mo->x, mo->y, mo->z, mo->momx, mo->momy, mo->momz, (int)mo->angle,
+          mo->type, mo->flags, mo->health, mo->tics, (int)(mo->state - states)
+        };
+
+        MD5Update(&md5, (const md5byte *)v, sizeof v);
+      }
+  for (i = 0; i < numsectors; i++)
+    {
+      const int v[] = {
+        sectors[i].floorheight, sectors[i].ceilingheight, sectors[i].lightlevel
+      };
+
+      MD5Update(&md5, (const md5byte *)v, sizeof v);
+    }
+  MD5Final(digest, &md5);
+}
+
+/* G_BenchmarkSeeks
+ *
+ * -seekbench: plays the demo through once, keeping keyframes as it goes and
+ * hashing the game every SEEKBENCH_STRIDE tics, then seeks to that many of
+ * the hashed tics in random order and checks the game arrived at, failing
+ * if any differs. Set the keyframe interval with -keyframes, DEMO_KEYFRAMES
+ * tics if not given.
+ */
+#define SEEKBENCH_STRIDE 37
+
+void G_BenchmarkSeeks(const char *name, int seeks)
+{
+  unsigned char (*hashes)[16] = NULL;
+  int *tics = NULL;
+  int numhashes = 0, maxhashes = 0, start, i, mismatches = 0, full = 0;
+  uint_64_t t, played, time = 0, timemax = 0;
+  double replay = 0;
+  unsigned seed = 1;
+
+  nosfxparm = true;
+  G_DeferedPlayDemo(name);
+  G_DoPlayDemo();
+  start = gametic;
+
+  t = I_GetTime_US();
+  while (demoplayback && !G_DemoFinished())
+    {
+      if (!((gametic - start) % SEEKBENCH_STRIDE))
+        {
+          if (numhashes == maxhashes)
+            {
+              maxhashes = maxhashes ? maxhashes*2 : 256;
+              hashes = realloc(hashes, maxhashes * sizeof *hashes);
+              tics = realloc(tics, maxhashes * sizeof *tics);
+            }
+          tics[numhashes] = gametic;
+          G_HashGame(hashes[numhashes++]);
+        }
+      G_Ticker();
+      gametic++;
+    }
+  played = I_GetTime_US() - t;
+
+  for (i = 0; i < numkeyframes; i++)
+    full += !keyframes[i]->base;
+  lprintf(LO_INFO, "G_BenchmarkSeeks: %d tics played in %.0f ms; %d keyframes"
+          " (%d full) in %lu KB, every %d tics\n", gametic - start, played / 1000.0,
+          numkeyframes, full, (unsigned long)(keyframememory >> 10), keyframeinterval);
+  if (!numhashes || gametic == start)
+    return;
+
+  if (seeks <= 0)
+    seeks = 100;
+  for (i = 0; i < seeks; i++)
+    {
+      unsigned char digest[16];
+      int n;
+
+      seed = seed * 1103515245 + 12345;  // not M_Random, which is game state
+      n = (seed >> 8) % numhashes;
+      t = I_GetTime_US();
+      G_DemoSeek(tics[n]);
+      t = I_GetTime_US() - t;
+      time += t;
+      if (t > timemax)
+        timemax = t;
+      replay += (double)played * (tics[n] - start) / (gametic - start + 1);
+
+      G_HashGame(digest);
+      if (gametic != tics[n] || memcmp(digest, hashes[n], sizeof digest))
+        mismatches++;
+    }
+
+  lprintf(LO_INFO, "%d seeks: %.2f ms avg, %.2f ms max, against %.2f ms avg to play"
+          " from the start; %d arrived at a different game\n", seeks,
+          time / 1000.0 / seeks, timemax / 1000.0, replay / 1000.0 / seeks, mismatches);
+  free(hashes);
+  free(tics);
+  if (mismatches)
+    I_Error("G_BenchmarkSeeks: %d of %d seeks arrived at a different game",
+            mismatches, seeks);
+}
+
+/* G_BenchmarkPrediction
+ *
+ * -predictbench: how old the local player's view looks with and without
+ * P_PredictPlayer, as if each command took rtt tics to come back from the
+ * server. The demo is played once to record where the player was after
+ * every tic and what it was told to do, then again; after each tic the
+ * player is predicted through its next rtt commands and compared with
+ * where it really got to. A view is as old as the number of tics back the
+ * recorded views have to go to find it, so without prediction it is rtt
+ * old whenever the player is moving.
+ */
+#define PREDICTBENCH_MAXRTTS 8
+
+typedef struct {
+  fixed_t x, y, viewz;
+  angle_t angle;
+  int leveltime;
+} predictview_t;
+
+static boolean G_PredictView(predictview_t *v)
+{
+  const player_t *player = &players[consoleplayer];
+
+  if (gamestate != GS_LEVEL || !player->mo)
+    return false;
+  v->x = player->mo->x;
+  v->y = player->mo->y;
+  v->viewz = player->viewz;
+  v->angle = player->mo->angle;
+  v->leveltime = leveltime;
+  return true;
+}
+
+static int G_PredictViewAge(const predictview_t *views, int tic, const predictview_t *v, int maxage)
+{
+  int age;
+
+  for (age = 0; age < maxage && age <= tic; age++)
+    {
+      const predictview_t *w = &views[tic - age];
+
+      if (w->x == v->x && w->y == v->y && w->viewz == v->viewz && w->angle == v->angle)
+        break;
+    }
+  return age;
+}
+
+void G_BenchmarkPrediction(const char *name, const char *rttlist)
+{
+  int rtts[PREDICTBENCH_MAXRTTS], numrtts = 0, numtics = 0, maxtics = 0, start, t, r;
+  struct {
+    unsigned samples, exact;
+    uint_64_t age, predictedage, error;
+    fixed_t errormax;
+  } stats[PREDICTBENCH_MAXRTTS];
+  predictview_t *views = NULL;
+  ticcmd_t *cmds = NULL;
+  boolean *valid = NULL;
+  unsigned desyncs = 0;
+  const char *p = rttlist;
+
+  while (p && *p && numrtts < PREDICTBENCH_MAXRTTS)
+    {
+      int rtt = strtol(p, (char **)&p, 10);
+
+      if (rtt > 0)
+        rtts[numrtts++] = rtt;
+      while (*p && (*p < '0' || *p > '9'))
+        p++;
+    }
+  if (!numrtts)
+    {
+      static const int defaults[] = { 2, 4, 8, 16 };
+
+      for (; numrtts < (int)(sizeof defaults / sizeof *defaults); numrtts++)
+        rtts[numrtts] = defaults[numrtts];
+    }
+  memset(stats, 0, sizeof stats);
+
+  nosfxparm = true;
+  G_DeferedPlayDemo(name);
+  G_DoPlayDemo();
+  start = gametic;
+  while (demoplayback && !G_DemoFinished())
+    {
+      G_Ticker();
+      gametic++;
+      if (numtics == maxtics)
+        {
+          maxtics = maxtics ? maxtics*2 : 4096;
+          views = realloc(views, maxtics * sizeof *views);
+          cmds = realloc(cmds, maxtics * sizeof *cmds);
+          valid = realloc(valid, maxtics * sizeof *valid);
+        }
+      valid[numtics] = G_PredictView(&views[numtics]);
+      cmds[numtics++] = players[consoleplayer].cmd;
+    }
+
+  G_DeferedPlayDemo(name);
+  G_DoPlayDemo();
+  for (t = 0; t < numtics && demoplayback && !G_DemoFinished(); t++)
+    {
+      predictview_t now, v;
+
+      G_Ticker();
+      gametic++;
+      if (!valid[t])
+        continue;
+      if (!G_PredictView(&now) || memcmp(&now, &views[t], sizeof now))
+        {
+          desyncs++;   // the second play went differently, nothing to compare
+          continue;
+        }
+
+      for (r = 0; r < numrtts; r++)
+        {
+          const int rtt = rtts[r];
+          const predictview_t *ideal = &views[t + rtt];
+          fixed_t error;
+
+          // only while the level carries on for the whole round trip
+          if (t + rtt >= numtics || !valid[t + rtt] || ideal->leveltime != now.leveltime + rtt)
+            continue;
+          if (!P_PredictPlayer(&players[consoleplayer], &cmds[t + 1], rtt))
+            continue;
+          G_PredictView(&v);
+          P_UnpredictPlayer();
+
+          stats[r].samples++;
+          stats[r].age += G_PredictViewAge(views, t + rtt, &now, rtt);
+          stats[r].predictedage += G_PredictViewAge(views, t + rtt, &v, rtt);
+          error = P_AproxDistance(v.x - ideal->x, v.y - ideal->y);
+          stats[r].error += error;
+          if (error > stats[r].errormax)
+            stats[r].errormax = error;
+          stats[r].exact += !error && v.angle == ideal->angle;
+        }
+    }
+
+  lprintf(LO_INFO, "G_BenchmarkPrediction: %d tics of the local player, view age in ms\n"
+          "   rtt  without  predicted   exact  error avg  error max\n",
+          gametic - start);
+  for (r = 0; r < numrtts; r++)
+    {
+      const double n = stats[r].samples ? stats[r].samples : 1;
+
+      lprintf(LO_INFO, "%6.0f %8.1f %10.1f %6.1f%% %10.2f %10.2f\n",
+              rtts[r] * 1000.0 / TICRATE,
+              stats[r].age * 1000.0 / TICRATE / n,
+              stats[r].predictedage * 1000.0 / TICRATE / n,
+              stats[r].exact * 100.0 / n,
+              stats[r].error / n / FRACUNIT,
+              (double)stats[r].errormax / FRACUNIT);
+    }
+  if (desyncs)
+    lprintf(LO_WARN, "%u tics played differently the second time\n", desyncs);
+  free(views);
+  free(cmds);
+  free(valid);
+}
+
 /* G_CheckDemoStatus
  *
  * Called after a death or level completion to allow demos to be cleaned up
@@ -2962,6 +4122,45 @@ boolean G_CheckDemoStatus (void)
       int endtime = I_GetTime_RealTime ();
       // killough -- added fps information and made it work for longer demos:
       unsigned realtics = endtime-starttime;
+      if (demotiming.tics)
+        {
+          double secs = (I_GetTime_US() - demotiming.start) / 1000000.0;
+          lprintf(LO_INFO, "Timed %u tics in %.3f seconds = %.1f tics per second\n",
+                  demotiming.tics, secs, secs > 0 ? demotiming.tics / secs : 0.0);
+          lprintf(LO_INFO, "P_Ticker: %.1f us avg, %u us max per tic\n",
+                  (double)demotiming.ticker / demotiming.tics,
+                  (unsigned)demotiming.tickermax);
+          if (demotiming.frames)
+            lprintf(LO_INFO, "R_RenderPlayerView: %.1f us avg, %u us max per frame over %u frames"
+                    " (%d render thread%s)\n",
+                    (double)demotiming.render / demotiming.frames,
+                    (unsigned)demotiming.rendermax, demotiming.frames,
+                    render_threads, render_threads > 1 ? "s" : "");
+          if (planestats.frames && planestats.lookups)
+            lprintf(LO_INFO, "Visplanes%s: %.1f avg, %u max per frame, %.1f%% split off;"
+                    " hash chains %.2f avg, %u max\n",
+                    render_threads > 1 ? " (main thread's strip)" : "",
+                    (double)planestats.planes / planestats.frames, planestats.planesmax,
+                    planestats.planes ? 100.0 * planestats.dups / planestats.planes : 0.0,
+                    (double)planestats.probes / planestats.lookups, planestats.chainmax);
+          if (thinker_threads > 1)
+            lprintf(LO_INFO, "Sight prepass on %d threads: %u hits, %u stale, %u misses\n",
+                    thinker_threads, sightjob_hits, sightjob_stale, sightjob_misses);
+          if (sight_cache)
+            lprintf(LO_INFO, "Sight cache: %u hits (%u after a mover), %u misses\n",
+                    sightcache_hits, sightcache_rechecked, sightcache_misses);
+          if (snapshotstats.snapshots)
+            lprintf(LO_INFO, "Snapshots: %u checked, %u mismatched; %.1f us, %.0f bytes"
+                    " and %.0f mobjs avg against %.1f us, %.0f bytes and %.0f mobjs"
+                    " for full saves\n",
+                    snapshotstats.snapshots, snapshotstats.mismatches,
+                    (double)snapshotstats.snaptime / snapshotstats.snapshots,
+                    (double)snapshotstats.snapbytes / snapshotstats.snapshots,
+                    (double)snapshotstats.snapmobjs / snapshotstats.snapshots,
+                    (double)snapshotstats.fulltime / snapshotstats.snapshots,
+                    (double)snapshotstats.fullbytes / snapshotstats.snapshots,
+                    (double)snapshotstats.mobjs / snapshotstats.snapshots);
+        }
       I_Error ("Timed %u gametics in %u realtics = %-.1f frames per second",
                (unsigned) gametic,realtics,
                (unsigned) gametic * (double) TICRATE / realtics);
@@ -2972,6 +4171,7 @@ boolean G_CheckDemoStatus (void)
       if (singledemo)
         exit(0);  // killough
 
+      G_FreeKeyframes();
       if (demolumpnum != -1) {
   // cph - unlock the demo lump
   W_UnlockLumpNum(demolumpnum);
@@ -48,12 +48,18 @@ boolean G_CheckDemoStatus(void);
 void G_DeathMatchSpawnPlayer(int playernum);
 void G_InitNew(skill_t skill, int episode, int map);
 void G_DeferedInitNew(skill_t skill, int episode, int map);
+void G_BenchmarkLoads(skill_t skill);
+void G_BenchmarkRender(skill_t skill, int episode, int map);
+void G_BenchmarkSeeks(const char *name, int seeks);
+void G_BenchmarkPrediction(const char *name, const char *rttlist);
 void G_DeferedPlayDemo(const char *demo); // CPhipps - const
 void G_LoadGame(int slot, boolean is_command); // killough 5/15/98
 void G_ForcedLoadGame(void);           // killough 5/15/98: forced loadgames
 boolean G_SaveGameValid(void);
 void G_DoLoadGame(void);
 void G_SaveGame(int slot, const char *description); // Called by M_Responder.
+void G_DoSnapshotGame(void);   // incremental save, written in the background
+boolean G_WaitSnapshotWrite(void);
 void G_BeginRecording(void);
 // CPhipps - const on these string params
 void G_RecordDemo(const char *name);          // Only called by startup code.
@@ -82,6 +88,42 @@ void G_BuildTiccmd (ticcmd_t* cmd); // CPhipps - move decl to header
 void G_ChangedPlayerColour(int pn, int cl); // CPhipps - On-the-fly player colour changing
 void G_MakeSpecialEvent(buttoncode_t bc, ...); /* cph - new event stuff */
 
+// -timedemo statistics, reported by G_CheckDemoStatus
+typedef struct {
+  uint_64_t start;      // I_GetTime_US at the first timed tic
+  unsigned  tics;       // gametics run through P_Ticker
+  uint_64_t ticker;     // total and worst microseconds spent in P_Ticker
+  uint_64_t tickermax;
+  unsigned  frames;     // frames rendered by R_RenderPlayerView
+  uint_64_t render;     // total and worst microseconds spent rendering
+  uint_64_t rendermax;
+} demotiming_t;
+
+extern demotiming_t demotiming;
+
+// -snapshotcheck: every snapshot_check tics, a snapshot is rebuilt against
+// its base and compared with a full save of the same tic
+typedef struct {
+  unsigned  snapshots;  // snapshots compared
+  unsigned  mismatches; // rebuilt snapshots that differ from the full save
+  uint_64_t snaptime;   // total microseconds building snapshots
+  uint_64_t fulltime;   //  and the full saves they were compared with
+  uint_64_t snapbytes;  // total bytes of snapshots and full saves
+  uint_64_t fullbytes;
+  uint_64_t snapmobjs;  // total mobjs written by snapshots
+  uint_64_t mobjs;      //  and in the map when they were taken
+} snapshotstats_t;
+
+extern int snapshot_check;
+extern snapshotstats_t snapshotstats;
+
+// Demo keyframes, kept every demo_keyframes tics of playback so that
+// G_DemoSeek doesn't have to play the demo from the start. Off unless
+// asked for, as keeping them costs time and memory in every playback.
+#define DEMO_KEYFRAMES (10*TICRATE)
+extern int demo_keyframes;
+int G_DemoSeek(int tic);
+
 // killough 1/18/98: Doom-style printf;   killough 4/25/98: add gcc attributes
 // CPhipps - renames to doom_printf to avoid name collision with glibc
 void doom_printf(const char *, ...) __attribute__((format(printf,1,2)));
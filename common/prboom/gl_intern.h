@@ -186,6 +186,27 @@ typedef struct
 
 extern GLSector *sectorloops;
 
+/* The triangulation of one sector. It is built without touching the zone
+ * or any globals, so gld_PreprocessSectors can run sectors on several
+ * threads; gld_AddSectorTess then appends the results to sectorloops and
+ * gld_vertexes in sector order, which gives the same arrays as doing the
+ * sectors one after another. Everything in it is libc memory.
+ */
+typedef struct
+	{
+		int numloops, maxloops;
+		GLLoopDef *loops; // vertexindex counts from the sector's first vertex
+		int numverts, maxverts;
+		vertex_t **verts;
+	} gld_sectortess_t;
+
+/* gl_levelcache.c: sector triangulations saved per map, see gl_struct.h */
+boolean gld_LevelCacheValid(void);
+void gld_CachedSectorTess(int num, gld_sectortess_t *st);
+void gld_CheckLevelCache(const gld_sectortess_t *tess);
+void gld_StoreLevelCache(const gld_sectortess_t *tess);
+void gld_CloseLevelCache(void);
+
 typedef struct drawVert_s {		// JDC
 	float	xyz[3];				// TODO: adjust MAP_SCALE, make shorts
 	float	st[2];				// TODO: set texture matrix, make shorts
@@ -0,0 +1,393 @@
+/* Emacs style mode select   -*- C++ -*-
+ *-----------------------------------------------------------------------------
+ *
+ *
+ *  PrBoom: a Doom port merged with LxDoom and LSDLDoom
+ *  based on BOOM, a modified and improved DOOM engine
+ *  Copyright (C) 1999 by
+ *  id Software, Chi Hoang, Lee Killough, Jim Flynn, Rand Phares, Ty Halderman
+ *  Copyright (C) 1999-2000 by
+ *  Jess Haas, Nicolas Kalkhof, Colin Phipps, Florian Schulze
+ *  Copyright 2005, 2006 by
+ *  Florian Schulze, Colin Phipps, Neil Stevens, Andrey Budko
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ *  02111-1307, USA.
+ *
+ * DESCRIPTION:
+ *   On-disk cache of the GLU sector triangulation.
+ *
+ *   The output of gld_PrecalculateSector only depends on the map lumps,
+ *   so it is written to <savegame dir>/<md5 of the lumps>.glc after the
+ *   first load and memory mapped on the next one. The file holds vertex
+ *   numbers rather than coordinates, so the map's own vertexes are used
+ *   and nothing has to be converted.
+ *
+ *---------------------------------------------------------------------
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "z_zone.h"
+#include "SDL_opengl.h"
+#include "doomtype.h"
+#include "w_wad.h"
+#include "v_video.h"
+#include "doomstat.h"
+#include "r_main.h"
+#include "md5.h"
+#include "lprintf.h"
+#include "gl_intern.h"
+#include "gl_struct.h"
+
+int gl_levelcache = 1;
+
+#ifdef USE_GLU_TESS
+
+#define LEVELCACHE_MAGIC    0x434c4744  // "DGLC"
+#define LEVELCACHE_VERSION  1           // bump when the tesselation changes
+
+extern char basesavegame[];
+
+// The file is the header, then numsectors gld_cachesector_t, then
+// numloops gld_cacheloop_t, then numverts vertex numbers, all native
+// endian: the cache never leaves the device that wrote it.
+
+typedef struct
+{
+  int magic;
+  int version;
+  unsigned char md5[16];
+  int numsectors;
+  int numvertexes;
+  int numloops;
+  int numverts;
+} gld_cacheheader_t;
+
+typedef struct
+{
+  int firstloop, numloops;
+  int firstvert, numverts;
+} gld_cachesector_t;
+
+typedef struct
+{
+  int mode;
+  int vertexcount;
+} gld_cacheloop_t;
+
+static struct
+{
+  char path[PATH_MAX+1];
+  unsigned char md5[16];
+  boolean open;                   // a key was computed for this level
+  const byte *data;               // the mapping, NULL on a miss
+  size_t size;
+  const gld_cacheheader_t *header;
+  const gld_cachesector_t *sectors;
+  const gld_cacheloop_t *loops;
+  const int *verts;
+} levelcache;
+
+//
+// gld_OpenLevelCache
+//
+// Called by P_SetupLevel before gld_PreprocessLevel with the lumps it
+// loaded. Maps the cache file for them if there is a usable one.
+//
+
+void gld_OpenLevelCache(int lumpnum, int gl_lumpnum)
+{
+  struct MD5Context md5;
+  const gld_cacheheader_t *header;
+  struct stat st;
+  int i, len, fd;
+
+  gld_CloseLevelCache();
+  if (!gl_levelcache || !*basesavegame)
+    return;
+
+  MD5Init(&md5);
+  for (i=0; i<=ML_BLOCKMAP && lumpnum+i<numlumps; i++)
+  {
+    len = W_LumpLength(lumpnum+i);
+    MD5Update(&md5, (md5byte const *)&len, sizeof len);
+    MD5Update(&md5, W_CacheLumpNum(lumpnum+i), len);
+    W_UnlockLumpNum(lumpnum+i);
+  }
+  // the GL nodes change the vertex list, so they are part of the key
+  if (gl_lumpnum != -1)
+    for (i=0; i<=ML_GL_NODES && gl_lumpnum+i<numlumps; i++)
+    {
+      len = W_LumpLength(gl_lumpnum+i);
+      MD5Update(&md5, (md5byte const *)&len, sizeof len);
+      MD5Update(&md5, W_CacheLumpNum(gl_lumpnum+i), len);
+      W_UnlockLumpNum(gl_lumpnum+i);
+    }
+  MD5Final(levelcache.md5, &md5);
+
+  len = snprintf(levelcache.path, sizeof levelcache.path, "%s/", basesavegame);
+  for (i=0; i<16; i++)
+    len += snprintf(levelcache.path+len, sizeof levelcache.path-len, "%02x", levelcache.md5[i]);
+  snprintf(levelcache.path+len, sizeof levelcache.path-len, ".glc");
+  levelcache.open = true;
+
+#ifndef _WIN32
+  if ((fd = open(levelcache.path, O_RDONLY)) == -1)
+    return;
+  if (fstat(fd, &st) || st.st_size < (off_t)sizeof(*header))
+  {
+    close(fd);
+    return;
+  }
+  levelcache.size = st.st_size;
+  levelcache.data = mmap(NULL, levelcache.size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (levelcache.data == MAP_FAILED)
+  {
+    levelcache.data = NULL;
+    return;
+  }
+
+  header = (const gld_cacheheader_t *)levelcache.data;
+  if (header->magic != LEVELCACHE_MAGIC || header->version != LEVELCACHE_VERSION ||
+      memcmp(header->md5, levelcache.md5, sizeof header->md5) ||
+      header->numsectors < 0 || header->numloops < 0 || header->numverts < 0 ||
+      levelcache.size != sizeof(*header) + header->numsectors*sizeof(gld_cachesector_t) +
+      header->numloops*sizeof(gld_cacheloop_t) + header->numverts*sizeof(int))
+  {
+    // it gets rewritten after the tesselation
+    lprintf(LO_WARN, "gld_OpenLevelCache: ignoring stale %s\n", levelcache.path);
+    munmap((void *)levelcache.data, levelcache.size);
+    levelcache.data = NULL;
+    return;
+  }
+  levelcache.header = header;
+  levelcache.sectors = (const gld_cachesector_t *)(header+1);
+  levelcache.loops = (const gld_cacheloop_t *)(levelcache.sectors + header->numsectors);
+  levelcache.verts = (const int *)(levelcache.loops + header->numloops);
+#endif
+}
+
+//
+// gld_LevelCacheValid
+//
+// True if the mapped cache matches the level that has been loaded.
+//
+
+boolean gld_LevelCacheValid(void)
+{
+  return levelcache.header &&
+    levelcache.header->numsectors == numsectors &&
+    levelcache.header->numvertexes == numvertexes;
+}
+
+//
+// gld_CachedSectorTess
+//
+// Fills st the way gld_PrecalculateSector would have.
+//
+
+void gld_CachedSectorTess(int num, gld_sectortess_t *st)
+{
+  const gld_cachesector_t *cs = &levelcache.sectors[num];
+  int i;
+
+  memset(st, 0, sizeof(*st));
+  if (cs->firstloop < 0 || cs->numloops < 0 || cs->firstloop+cs->numloops > levelcache.header->numloops ||
+      cs->firstvert < 0 || cs->numverts < 0 || cs->firstvert+cs->numverts > levelcache.header->numverts)
+    I_Error("gld_CachedSectorTess: %s is corrupt", levelcache.path);
+
+  st->numloops = st->maxloops = cs->numloops;
+  st->loops = (malloc)(cs->numloops*sizeof(GLLoopDef) + 1);
+  st->numverts = st->maxverts = cs->numverts;
+  st->verts = (malloc)(cs->numverts*sizeof(vertex_t *) + 1);
+  if (!st->loops || !st->verts)
+    I_Error("gld_CachedSectorTess: Not enough memory");
+
+  for (i=0; i<cs->numloops; i++)
+  {
+    const gld_cacheloop_t *cl = &levelcache.loops[cs->firstloop+i];
+
+    st->loops[i].mode = cl->mode;
+    st->loops[i].vertexcount = cl->vertexcount;
+    st->loops[i].vertexindex = i ? st->loops[i-1].vertexindex+st->loops[i-1].vertexcount : 0;
+  }
+  for (i=0; i<cs->numverts; i++)
+  {
+    int v = levelcache.verts[cs->firstvert+i];
+
+    if (v < 0 || v >= numvertexes)
+      I_Error("gld_CachedSectorTess: %s is corrupt", levelcache.path);
+    st->verts[i] = &vertexes[v];
+  }
+}
+
+//
+// gld_SameSectorTess
+//
+
+static boolean gld_SameSectorTess(const gld_sectortess_t *a, const gld_sectortess_t *b)
+{
+  int i;
+
+  if (a->numloops != b->numloops || a->numverts != b->numverts)
+    return false;
+  for (i=0; i<a->numloops; i++)
+    if (a->loops[i].mode != b->loops[i].mode ||
+        a->loops[i].vertexcount != b->loops[i].vertexcount ||
+        a->loops[i].vertexindex != b->loops[i].vertexindex)
+      return false;
+  return !memcmp(a->verts, b->verts, a->numverts*sizeof(*a->verts));
+}
+
+//
+// gld_CheckLevelCache
+//
+// gl_levelcache 2: tess is a fresh tesselation of every sector, compare it
+// with the cache and say where they differ.
+//
+
+void gld_CheckLevelCache(const gld_sectortess_t *tess)
+{
+  gld_sectortess_t cached;
+  int i, bad = 0;
+
+  if (!gld_LevelCacheValid())
+    return;
+  for (i=0; i<numsectors; i++)
+  {
+    gld_CachedSectorTess(i, &cached);
+    if (!gld_SameSectorTess(&cached, &tess[i]))
+    {
+      if (bad++ < 10)
+        lprintf(LO_WARN, "gld_CheckLevelCache: sector %i: %i loops %i vertexes cached, %i loops %i vertexes now\n",
+                i, cached.numloops, cached.numverts, tess[i].numloops, tess[i].numverts);
+    }
+    (free)(cached.loops);
+    (free)(cached.verts);
+  }
+  lprintf(bad ? LO_WARN : LO_INFO, "gld_CheckLevelCache: %i of %i sectors differ from %s\n",
+          bad, numsectors, levelcache.path);
+}
+
+//
+// gld_StoreLevelCache
+//
+// Writes the cache for the current level. It goes to a temporary file
+// that is renamed into place, so a reader never maps half a file.
+//
+
+void gld_StoreLevelCache(const gld_sectortess_t *tess)
+{
+  gld_cacheheader_t header;
+  char tmp[PATH_MAX+1];
+  FILE *f;
+  int i, j;
+
+  if (!levelcache.open || gld_LevelCacheValid())
+    return;
+
+  header.magic = LEVELCACHE_MAGIC;
+  header.version = LEVELCACHE_VERSION;
+  memcpy(header.md5, levelcache.md5, sizeof header.md5);
+  header.numsectors = numsectors;
+  header.numvertexes = numvertexes;
+  header.numloops = header.numverts = 0;
+  for (i=0; i<numsectors; i++)
+  {
+    header.numloops += tess[i].numloops;
+    header.numverts += tess[i].numverts;
+    // a combined vertex that isn't one of the map's can't be stored
+    for (j=0; j<tess[i].numverts; j++)
+      if (tess[i].verts[j] < vertexes || tess[i].verts[j] >= vertexes+numvertexes)
+        return;
+  }
+
+  snprintf(tmp, sizeof tmp, "%s.tmp", levelcache.path);
+  if (!(f = fopen(tmp, "wb")))
+    return;
+  fwrite(&header, sizeof header, 1, f);
+  for (i=0, header.numloops=header.numverts=0; i<numsectors; i++)
+  {
+    gld_cachesector_t cs;
+
+    cs.firstloop = header.numloops;
+    cs.numloops = tess[i].numloops;
+    cs.firstvert = header.numverts;
+    cs.numverts = tess[i].numverts;
+    fwrite(&cs, sizeof cs, 1, f);
+    header.numloops += cs.numloops;
+    header.numverts += cs.numverts;
+  }
+  for (i=0; i<numsectors; i++)
+    for (j=0; j<tess[i].numloops; j++)
+    {
+      gld_cacheloop_t cl;
+
+      cl.mode = tess[i].loops[j].mode;
+      cl.vertexcount = tess[i].loops[j].vertexcount;
+      fwrite(&cl, sizeof cl, 1, f);
+    }
+  for (i=0; i<numsectors; i++)
+    for (j=0; j<tess[i].numverts; j++)
+    {
+      int v = tess[i].verts[j] - vertexes;
+      fwrite(&v, sizeof v, 1, f);
+    }
+  if (ferror(f) | fclose(f) || rename(tmp, levelcache.path))
+  {
+    lprintf(LO_WARN, "gld_StoreLevelCache: couldn't write %s\n", levelcache.path);
+    remove(tmp);
+  }
+}
+
+//
+// gld_CloseLevelCache
+//
+
+void gld_CloseLevelCache(void)
+{
+#ifndef _WIN32
+  if (levelcache.data)
+    munmap((void *)levelcache.data, levelcache.size);
+#endif
+  memset(&levelcache, 0, sizeof levelcache);
+}
+
+#else /* USE_GLU_TESS */
+
+void gld_OpenLevelCache(int lumpnum, int gl_lumpnum)
+{
+}
+
+#endif /* USE_GLU_TESS */
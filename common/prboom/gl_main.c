@@ -61,8 +61,15 @@
 #include "p_maputl.h"
 #include "m_bbox.h"
 #include "lprintf.h"
+#include "m_profile.h"
 #include "gl_intern.h"
 #include "gl_struct.h"
+#include "p_setup.h"
+#include "i_system.h"
+#ifdef USE_GLU_TESS
+#include <pthread.h>
+#include <stdint.h>
+#endif
 
 void IR_InitLevel();
 
@@ -1179,13 +1186,11 @@ static void gld_CarveFlats(int bspnode, int numdivlines, divline_t *divlines, bo
 
 #ifdef USE_GLU_TESS
 
-static int currentsector; // the sector which is currently tesselated
-
 // ntessBegin
 //
 // called when the tesselation of a new loop starts
 
-static void CALLBACK ntessBegin( GLenum type )
+static void CALLBACK ntessBegin( GLenum type, gld_sectortess_t *st )
 {
 #ifdef _DEBUG
   if (levelinfo)
@@ -1202,23 +1207,23 @@ static void CALLBACK ntessBegin( GLenum type )
       fprintf(levelinfo, "\t\tBegin: unknown\n");
   }
 #endif
-  // increase loopcount for currentsector
-  sectorloops[ currentsector ].loopcount++;
-  // reallocate to get space for another loop
-  // PU_LEVEL is used, so this gets freed before a new level is loaded
-  sectorloops[ currentsector ].loops=Z_Realloc(sectorloops[currentsector].loops,sizeof(GLLoopDef)*sectorloops[currentsector].loopcount, PU_LEVEL, 0);
-  // set initial values for current loop
-  // currentloop is -> sectorloops[currentsector].loopcount-1
-  sectorloops[ currentsector ].loops[ sectorloops[currentsector].loopcount-1 ].mode=type;
-  sectorloops[ currentsector ].loops[ sectorloops[currentsector].loopcount-1 ].vertexcount=0;
-  sectorloops[ currentsector ].loops[ sectorloops[currentsector].loopcount-1 ].vertexindex=gld_num_vertexes;
+  // get space for another loop
+  if (st->numloops == st->maxloops)
+  {
+    st->maxloops = st->maxloops ? st->maxloops*2 : 4;
+    st->loops = (realloc)(st->loops, st->maxloops*sizeof(GLLoopDef));
+  }
+  st->loops[st->numloops].mode=type;
+  st->loops[st->numloops].vertexcount=0;
+  st->loops[st->numloops].vertexindex=st->numverts;
+  st->numloops++;
 }
 
 // ntessError
 //
 // called when the tesselation failes (DEBUG only)
 
-static void CALLBACK ntessError(GLenum error)
+static void CALLBACK ntessError(GLenum error, gld_sectortess_t *st)
 {
 #ifdef _DEBUG
   const GLubyte *estring;
@@ -1231,7 +1236,7 @@ static void CALLBACK ntessError(GLenum error)
 //
 // called when the two or more vertexes are on the same coordinate
 
-static void CALLBACK ntessCombine( GLdouble coords[3], vertex_t *vert[4], GLfloat w[4], void **dataOut )
+static void CALLBACK ntessCombine( GLdouble coords[3], vertex_t *vert[4], GLfloat w[4], void **dataOut, gld_sectortess_t *st )
 {
 #ifdef _DEBUG
   if (levelinfo)
@@ -1251,55 +1256,77 @@ static void CALLBACK ntessCombine( GLdouble coords[3], vertex_t *vert[4], GLfloa
 //
 // called when a vertex is found
 
-static void CALLBACK ntessVertex( vertex_t *vert )
+static void CALLBACK ntessVertex( vertex_t *vert, gld_sectortess_t *st )
 {
 #ifdef _DEBUG
   if (levelinfo)
     fprintf(levelinfo, "\t\tVertex : x %10i, y %10i\n", vert->x>>FRACBITS, vert->y>>FRACBITS);
 #endif
   // increase vertex count
-  sectorloops[ currentsector ].loops[ sectorloops[currentsector].loopcount-1 ].vertexcount++;
+  st->loops[st->numloops-1].vertexcount++;
 
-  // increase vertex count
-  gld_AddGlobalVertexes(1);
   // add the new vertex (vert is the second argument of gluTessVertex)
-  gld_texcoords[gld_num_vertexes].u=( (float)vert->x/(float)FRACUNIT)/64.0f;
-  gld_texcoords[gld_num_vertexes].v=(-(float)vert->y/(float)FRACUNIT)/64.0f;
-  gld_vertexes[gld_num_vertexes].x=-(float)vert->x/MAP_SCALE;
-  gld_vertexes[gld_num_vertexes].y=0.0f;
-  gld_vertexes[gld_num_vertexes].z= (float)vert->y/MAP_SCALE;
-  gld_num_vertexes++;
+  if (st->numverts == st->maxverts)
+  {
+    st->maxverts = st->maxverts ? st->maxverts*2 : 64;
+    st->verts = (realloc)(st->verts, st->maxverts*sizeof(vertex_t *));
+  }
+  st->verts[st->numverts++] = vert;
 }
 
 // ntessEnd
 //
 // called when the tesselation of a the current loop ends (DEBUG only)
 
-static void CALLBACK ntessEnd( void )
+static void CALLBACK ntessEnd( gld_sectortess_t *st )
 {
 #ifdef _DEBUG
   if (levelinfo)
-    fprintf(levelinfo, "\t\tEnd loopcount %i vertexcount %i\n", sectorloops[currentsector].loopcount, sectorloops[ currentsector ].loops[ sectorloops[currentsector].loopcount-1 ].vertexcount);
+    fprintf(levelinfo, "\t\tEnd loopcount %i vertexcount %i\n", st->numloops, st->loops[st->numloops-1].vertexcount);
 #endif
 }
 
-// gld_PrecalculateSector
-//
-// this calculates the loops for the sector "num"
+// gld_AddSectorTess
 //
-// how does it work?
-// first I have to credit Michael 'Kodak' Ryssen for the usage of the
-// glu tesselation functions. the rest of this stuff is entirely done by me (proff).
-// if there are any similarities, then they are implications of the algorithm.
-//
-// I'm starting with the first line of the current sector. I take it's ending vertex and
-// add it to the tesselator. the current line is marked as used. then I'm searching for
-// the next line which connects to the current line. if there is more than one line, I
-// choose the one with the smallest angle to the current. if there is no next line, I
-// start a new loop and take the first unused line in the sector. after all lines are
-// processed, the polygon is tesselated.
-
-static void gld_PrecalculateSector(int num)
+// appends a sector's loops to sectorloops and its vertexes to the global
+// vertex list, then frees the tesselation
+
+static void gld_AddSectorTess(int num, gld_sectortess_t *st)
+{
+  int l, i;
+
+  for (l=0; l<st->numloops; l++)
+  {
+    const GLLoopDef *loop = &st->loops[l];
+
+    // increase loopcount for the sector
+    sectorloops[ num ].loopcount++;
+    // reallocate to get space for another loop
+    // PU_LEVEL is used, so this gets freed before a new level is loaded
+    sectorloops[ num ].loops=Z_Realloc(sectorloops[num].loops,sizeof(GLLoopDef)*sectorloops[num].loopcount, PU_LEVEL, 0);
+    sectorloops[ num ].loops[ sectorloops[num].loopcount-1 ].mode=loop->mode;
+    sectorloops[ num ].loops[ sectorloops[num].loopcount-1 ].vertexcount=loop->vertexcount;
+    sectorloops[ num ].loops[ sectorloops[num].loopcount-1 ].vertexindex=gld_num_vertexes;
+
+    for (i=loop->vertexindex; i<loop->vertexindex+loop->vertexcount; i++)
+    {
+      const vertex_t *vert = st->verts[i];
+
+      gld_AddGlobalVertexes(1);
+      gld_texcoords[gld_num_vertexes].u=( (float)vert->x/(float)FRACUNIT)/64.0f;
+      gld_texcoords[gld_num_vertexes].v=(-(float)vert->y/(float)FRACUNIT)/64.0f;
+      gld_vertexes[gld_num_vertexes].x=-(float)vert->x/MAP_SCALE;
+      gld_vertexes[gld_num_vertexes].y=0.0f;
+      gld_vertexes[gld_num_vertexes].z= (float)vert->y/MAP_SCALE;
+      gld_num_vertexes++;
+    }
+  }
+  (free)(st->loops);
+  (free)(st->verts);
+  memset(st, 0, sizeof(*st));
+}
+
+static void gld_PrecalculateSector(int num, gld_sectortess_t *st)
 {
   int i;
   boolean *lineadded=NULL;
@@ -1320,8 +1347,7 @@ static void gld_PrecalculateSector(int num)
   int maxvertexnum;
   int vertexnum;
 
-  currentsector=num;
-  lineadded=Z_Malloc(sectors[num].linecount*sizeof(boolean),PU_LEVEL,0);
+  lineadded=(malloc)(sectors[num].linecount*sizeof(boolean));
   if (!lineadded)
   {
     if (levelinfo) fclose(levelinfo);
@@ -1332,15 +1358,15 @@ static void gld_PrecalculateSector(int num)
   if (!tess)
   {
     if (levelinfo) fclose(levelinfo);
-    Z_Free(lineadded);
+    (free)(lineadded);
     return;
   }
-  // set callbacks
-  gluTessCallback(tess, GLU_TESS_BEGIN, ntessBegin);
-  gluTessCallback(tess, GLU_TESS_VERTEX, ntessVertex);
-  gluTessCallback(tess, GLU_TESS_ERROR, ntessError);
-  gluTessCallback(tess, GLU_TESS_COMBINE, ntessCombine);
-  gluTessCallback(tess, GLU_TESS_END, ntessEnd);
+  // set callbacks, they get st as the polygon data
+  gluTessCallback(tess, GLU_TESS_BEGIN_DATA, ntessBegin);
+  gluTessCallback(tess, GLU_TESS_VERTEX_DATA, ntessVertex);
+  gluTessCallback(tess, GLU_TESS_ERROR_DATA, ntessError);
+  gluTessCallback(tess, GLU_TESS_COMBINE_DATA, ntessCombine);
+  gluTessCallback(tess, GLU_TESS_END_DATA, ntessEnd);
   if (levelinfo) fprintf(levelinfo, "sector %i, %i lines in sector\n", num, sectors[num].linecount);
   // remove any line which has both sides in the same sector (i.e. Doom2 Map01 Sector 1)
   for (i=0; i<sectors[num].linecount; i++)
@@ -1366,7 +1392,7 @@ static void gld_PrecalculateSector(int num)
   maxvertexnum=0;
   // start tesselator
   if (levelinfo) fprintf(levelinfo, "gluTessBeginPolygon\n");
-  gluTessBeginPolygon(tess, NULL);
+  gluTessBeginPolygon(tess, st);
   if (levelinfo) fprintf(levelinfo, "\tgluTessBeginContour\n");
   gluTessBeginContour(tess);
   while (linecount)
@@ -1427,7 +1453,7 @@ static void gld_PrecalculateSector(int num)
     if (vertexnum>=maxvertexnum)
     {
       maxvertexnum+=512;
-      v=Z_Realloc(v,maxvertexnum*3*sizeof(double),PU_LEVEL,0);
+      v=(realloc)(v,maxvertexnum*3*sizeof(double));
     }
     // calculate coordinates for the glu tesselation functions
     v[vertexnum*3+0]=-(double)currentvertex->x/(double)MAP_SCALE;
@@ -1508,8 +1534,8 @@ static void gld_PrecalculateSector(int num)
   gluTessEndPolygon(tess);
   // clean memory
   gluDeleteTess(tess);
-  Z_Free(v);
-  Z_Free(lineadded);
+  (free)(v);
+  (free)(lineadded);
 }
 
 #endif /* USE_GLU_TESS */
@@ -1548,7 +1574,7 @@ void gld_GetSubSectorVertices(boolean *sectorclosed)
       sectorloops[currentsectorid].loops = Z_Realloc(sectorloops[currentsectorid].loops,sizeof(GLLoopDef)*sectorloops[currentsectorid].loopcount, PU_LEVEL, 0);
       sectorloops[currentsectorid].loops[sectorloops[currentsectorid].loopcount-1].mode    = GL_TRIANGLE_FAN;
       sectorloops[currentsectorid].loops[sectorloops[currentsectorid].loopcount-1].vertexcount = numedgepoints;
-      sectorloops[currentsectorid].loops[sectorloops[currentsector].loopcount-1].vertexindex = gld_num_vertexes;
+      sectorloops[currentsectorid].loops[sectorloops[currentsectorid].loopcount-1].vertexindex = gld_num_vertexes;
       for(j = 0;  j < numedgepoints; j++)
       {
         gld_texcoords[gld_num_vertexes].u =( (float)(segs[ssector->firstline + j].v1->x)/FRACUNIT)/64.0f;
@@ -1739,6 +1765,145 @@ void BuildIndexedTriangles() {
 }
 
 
+#ifdef USE_GLU_TESS
+// gld_SectorClosed
+//
+// checks that every vertex of the sector starts one of its lines and ends
+// another. vertexcheck has to be all zero, and is left that way.
+
+static boolean gld_SectorClosed(int i, char *vertexcheck)
+{
+  boolean closed = true;
+  int v1num;
+  int v2num;
+  int j;
+
+  for (j=0; j<sectors[i].linecount; j++)
+  {
+    v1num=sectors[i].lines[j]->v1-vertexes;
+    v2num=sectors[i].lines[j]->v2-vertexes;
+    if ((v1num>=numvertexes) || (v2num>=numvertexes))
+      continue;
+    if (sectors[i].lines[j]->sidenum[0]!=NO_INDEX)
+      if (sides[sectors[i].lines[j]->sidenum[0]].sector==&sectors[i])
+      {
+        vertexcheck[v1num]|=1;
+        vertexcheck[v2num]|=2;
+      }
+    if (sectors[i].lines[j]->sidenum[1]!=NO_INDEX)
+      if (sides[sectors[i].lines[j]->sidenum[1]].sector==&sectors[i])
+      {
+        vertexcheck[v1num]|=2;
+        vertexcheck[v2num]|=1;
+      }
+  }
+  if (sectors[i].linecount<3)
+  {
+#ifdef _DEBUG
+    lprintf(LO_ERROR, "sector %i is not closed! %i lines in sector\n", i, sectors[i].linecount);
+#endif
+    if (levelinfo) fprintf(levelinfo, "sector %i is not closed! %i lines in sector\n", i, sectors[i].linecount);
+    closed=false;
+  }
+  // only the vertexes of this sector's lines can have been marked, so
+  // there is no need to scan the whole array
+  for (j=0; j<sectors[i].linecount; j++)
+  {
+    v1num=sectors[i].lines[j]->v1-vertexes;
+    v2num=sectors[i].lines[j]->v2-vertexes;
+    if ((v1num>=numvertexes) || (v2num>=numvertexes))
+      continue;
+    if ((vertexcheck[v1num]==1) || (vertexcheck[v1num]==2) ||
+        (vertexcheck[v2num]==1) || (vertexcheck[v2num]==2))
+    {
+      if (closed && sectors[i].linecount>=3)
+      {
+#ifdef _DEBUG
+        lprintf(LO_ERROR, "sector %i is not closed at line %i ! %i lines in sector\n", i, j, sectors[i].linecount);
+#endif
+        if (levelinfo) fprintf(levelinfo, "sector %i is not closed at line %i ! %i lines in sector\n", i, j, sectors[i].linecount);
+      }
+      closed=false;
+    }
+  }
+  for (j=0; j<sectors[i].linecount; j++)
+  {
+    v1num=sectors[i].lines[j]->v1-vertexes;
+    v2num=sectors[i].lines[j]->v2-vertexes;
+    if (v1num<numvertexes)
+      vertexcheck[v1num]=0;
+    if (v2num<numvertexes)
+      vertexcheck[v2num]=0;
+  }
+  return closed;
+}
+
+// The tesselation of a sector only reads the map, so the sectors are
+// shared out between load_threads threads. Each one writes its own
+// entries of tess and sectorclosed.
+
+#define MAXLOADTHREADS 8
+
+static struct
+{
+  boolean *sectorclosed;
+  gld_sectortess_t *tess;
+  int numthreads;
+} tessjob;
+
+static void gld_TesselateSlice(int id)
+{
+  char *vertexcheck;
+  int i;
+
+  vertexcheck=(calloc)(numvertexes, sizeof(char));
+  if (!vertexcheck)
+    I_Error("gld_PreprocessSectors: Not enough memory for array vertexcheck");
+  for (i=id; i<numsectors; i+=tessjob.numthreads)
+  {
+    tessjob.sectorclosed[i]=gld_SectorClosed(i, vertexcheck);
+    // figgi -- adapted for glnodes
+//!@# JDC seeing if this is necessary    if (sectorclosed[i])
+      gld_PrecalculateSector(i, &tessjob.tess[i]);
+  }
+  (free)(vertexcheck);
+}
+
+static void *gld_TesselateThread(void *arg)
+{
+  gld_TesselateSlice((int)(intptr_t)arg);
+  return NULL;
+}
+
+static void gld_TesselateSectors(int numthreads)
+{
+  pthread_t threads[MAXLOADTHREADS];
+  int started, i;
+
+  if (numthreads > MAXLOADTHREADS)
+    numthreads = MAXLOADTHREADS;
+  if (numthreads > numsectors)
+    numthreads = numsectors;
+  if (numthreads < 1)
+    numthreads = 1;
+  tessjob.numthreads = numthreads;
+
+  // the main thread does the first slice itself
+  for (started=1; started<numthreads; started++)
+    if (pthread_create(&threads[started], NULL, gld_TesselateThread, (void *)(intptr_t)started))
+      break;
+  if (started < numthreads)
+  {
+    // couldn't get them all, so do the remaining slices here as well
+    for (i=started; i<numthreads; i++)
+      gld_TesselateSlice(i);
+  }
+  gld_TesselateSlice(0);
+  for (i=1; i<started; i++)
+    pthread_join(threads[i], NULL);
+}
+#endif /* USE_GLU_TESS */
+
 // gld_PreprocessLevel
 //
 // this checks all sectors if they are closed and calls gld_PrecalculateSector to
@@ -1765,12 +1930,6 @@ void gld_PreprocessSectors(void)
 {
   boolean *sectorclosed;
   int i;
-#ifdef USE_GLU_TESS // figgi
-  char *vertexcheck;
-  int v1num;
-  int v2num;
-  int j;
-#endif
 
 	// JDC: E3M8 has a map error that has a couple lines that should
 	// be part of sector 1 instead orphaned off in sector 2.  I could
@@ -1823,64 +1982,41 @@ void gld_PreprocessSectors(void)
   gld_AddGlobalVertexes(numvertexes*2);
 
 #ifdef USE_GLU_TESS
-  vertexcheck=Z_Malloc(numvertexes*sizeof(char),PU_LEVEL,0);
-  if (!vertexcheck)
   {
-    if (levelinfo) fclose(levelinfo);
-    I_Error("gld_PreprocessSectors: Not enough memory for array vertexcheck");
-    return;
-  }
+    uint_64_t start = I_GetTime_US();
+    int numthreads = levelinfo ? 1 : load_threads;
 
-  for (i=0; i<numsectors; i++)
-  {
-    memset(vertexcheck,0,numvertexes*sizeof(char));
-    for (j=0; j<sectors[i].linecount; j++)
+    tessjob.sectorclosed = sectorclosed;
+    tessjob.tess = (calloc)(numsectors, sizeof(gld_sectortess_t));
+    if (!tessjob.tess)
     {
-      v1num=((int)sectors[i].lines[j]->v1-(int)vertexes)/sizeof(vertex_t);
-      v2num=((int)sectors[i].lines[j]->v2-(int)vertexes)/sizeof(vertex_t);
-      if ((v1num>=numvertexes) || (v2num>=numvertexes))
-        continue;
-      if (sectors[i].lines[j]->sidenum[0]!=NO_INDEX)
-        if (sides[sectors[i].lines[j]->sidenum[0]].sector==&sectors[i])
-        {
-          vertexcheck[v1num]|=1;
-          vertexcheck[v2num]|=2;
-        }
-      if (sectors[i].lines[j]->sidenum[1]!=NO_INDEX)
-        if (sides[sectors[i].lines[j]->sidenum[1]].sector==&sectors[i])
-        {
-          vertexcheck[v1num]|=2;
-          vertexcheck[v2num]|=1;
-        }
+      if (levelinfo) fclose(levelinfo);
+      I_Error("gld_PreprocessSectors: Not enough memory for array tess");
+      return;
     }
-    if (sectors[i].linecount<3)
+    if (gld_LevelCacheValid() && gl_levelcache != 2)
     {
-#ifdef _DEBUG
-      lprintf(LO_ERROR, "sector %i is not closed! %i lines in sector\n", i, sectors[i].linecount);
-#endif
-      if (levelinfo) fprintf(levelinfo, "sector %i is not closed! %i lines in sector\n", i, sectors[i].linecount);
-      sectorclosed[i]=false;
+      // the closed check only matters to gld_CarveFlats, which is off
+      for (i=0; i<numsectors; i++)
+        gld_CachedSectorTess(i, &tessjob.tess[i]);
     }
     else
     {
-      sectorclosed[i]=true;
-      for (j=0; j<numvertexes; j++)
-      {
-        if ((vertexcheck[j]==1) || (vertexcheck[j]==2))
-        {
-#ifdef _DEBUG
-          lprintf(LO_ERROR, "sector %i is not closed at vertex %i ! %i lines in sector\n", i, j, sectors[i].linecount);
-#endif
-          if (levelinfo) fprintf(levelinfo, "sector %i is not closed at vertex %i ! %i lines in sector\n", i, j, sectors[i].linecount);
-          sectorclosed[i]=false;
-        }
-      }
+      gld_TesselateSectors(numthreads);
+      if (gl_levelcache == 2)
+        gld_CheckLevelCache(tessjob.tess);
+      gld_StoreLevelCache(tessjob.tess);
     }
-    // figgi -- adapted for glnodes
-//!@# JDC seeing if this is necessary    if (sectorclosed[i])
-      gld_PrecalculateSector(i);
+    gld_CloseLevelCache();
+
+    // add the loops in sector order, so the vertex array is the same
+    // however many threads were used
+    for (i=0; i<numsectors; i++)
+      gld_AddSectorTess(i, &tessjob.tess[i]);
+    (free)(tessjob.tess);
+    tessjob.tess = NULL;
+    loadstagetime[LS_TESSELATE] += I_GetTime_US() - start;
   }
-  Z_Free(vertexcheck);
 #endif /* USE_GLU_TESS */
 
   for (i=0; i<numsectors; i++)
@@ -2786,6 +2922,7 @@ void gld_DrawScene(player_t *player)
 {
   int i,j,k,count;
   fixed_t max_scale;
+  PROF_BEGIN(gld_DrawScene);
   
 	glDisable(GL_CULL_FACE);
 	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
@@ -2936,6 +3073,7 @@ void gld_DrawScene(player_t *player)
   }
 // JDC  glDisableClientState(GL_TEXTURE_COORD_ARRAY);
 // JDC  glDisableClientState(GL_VERTEX_ARRAY);
+  PROF_END(gld_DrawScene);
 }
 
 void gld_PreprocessLevel(void)
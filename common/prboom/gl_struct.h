@@ -54,6 +54,13 @@ unsigned char *gld_ReadScreen (void);
 void gld_CleanMemory(void);
 void gld_PreprocessLevel(void);
 
+/* The sector triangulation for a map is saved next to the savegames,
+ * keyed by the MD5 of its lumps. 0 never uses the cache, 1 uses it,
+ * 2 tesselates anyway and reports any sector the cache disagrees with.
+ */
+extern int gl_levelcache;
+void gld_OpenLevelCache(int lumpnum, int gl_lumpnum);
+
 void gld_Set2DMode();
 void gld_InitDrawScene(void);
 void gld_StartDrawScene(void);
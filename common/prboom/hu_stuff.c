@@ -45,7 +45,9 @@
 #include "g_game.h"
 #include "r_main.h"
 
+#ifdef IPHONE
 #include "doomiphone.h"
+#endif
 
 #include <stdbool.h>
 
@@ -34,6 +34,8 @@
 #ifndef __I_SYSTEM__
 #define __I_SYSTEM__
 
+#include "m_fixed.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -48,6 +50,17 @@ fixed_t I_GetTimeFrac (void);
 #endif
 void I_GetTime_SaveMS(void);
 
+/* I_GetTime_US - monotonic microsecond clock, only used for timing
+ * the game and renderer (-timedemo report, profiling)
+ */
+uint_64_t I_GetTime_US(void);
+
+/* I_ReadMemCounters - the calling thread's last level cache and data TLB
+ * misses so far, from the hardware counters, for the renderer benchmarks.
+ * false where there are none to read
+ */
+boolean I_ReadMemCounters(uint_64_t *cachemisses, uint_64_t *tlbmisses);
+
 unsigned long I_GetRandomTimeSeed(void); /* cphipps */
 
 void I_uSleep(unsigned long usecs);
@@ -379,10 +379,14 @@ void I_Error(const char *error, ...)
   }
 #endif
  
+#ifdef PRBOOM_HEADLESS
+    I_SafeExit(-1);
+#else
     while( true ) {
         printf( " SAFE EXIT \n" );
         
         usleep(1000);
     }
+#endif
     
 }
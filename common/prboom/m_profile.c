@@ -0,0 +1,171 @@
+/* Emacs style mode select   -*- C++ -*-
+ *-----------------------------------------------------------------------------
+ *
+ *
+ *  PrBoom: a Doom port merged with LxDoom and LSDLDoom
+ *  based on BOOM, a modified and improved DOOM engine
+ *  Copyright (C) 1999 by
+ *  id Software, Chi Hoang, Lee Killough, Jim Flynn, Rand Phares, Ty Halderman
+ *  Copyright (C) 1999-2000 by
+ *  Jess Haas, Nicolas Kalkhof, Colin Phipps, Florian Schulze
+ *  Copyright 2005, 2006 by
+ *  Florian Schulze, Colin Phipps, Neil Stevens, Andrey Budko
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ *  02111-1307, USA.
+ *
+ * DESCRIPTION:
+ *  Hot path profiler, see m_profile.h.
+ *
+ *  Zones are appended to a fixed ring with an atomic increment, so any
+ *  thread may record without taking a lock. Each slot carries the index
+ *  it was written for, and the dumper skips slots that are mid-write or
+ *  were lapped.
+ *
+ *-----------------------------------------------------------------------------*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "doomstat.h"
+#include "lprintf.h"
+#include "m_profile.h"
+
+#define PROF_RINGSIZE 65536   // events, must be a power of two
+
+typedef struct {
+  uint_64_t     start;  // I_GetTime_US
+  unsigned int  dur;    // microseconds
+  unsigned int  seq;    // ring index + 1 once the slot is complete
+  unsigned int  thread;
+  unsigned short zone;
+  int           tic;    // gametic when the zone ended
+} profevent_t;
+
+static const char *const prof_zonenames[NUMPROFZONES] = {
+  "G_Ticker",
+  "P_Ticker",
+  "P_RunThinkers",
+  "D_Display",
+  "R_RenderBSPNode",
+  "IR_RenderBSPNode",
+  "gld_DrawScene",
+  "S_UpdateSounds",
+  "W_CacheLumpNum",
+};
+
+volatile int prof_active;
+
+static profevent_t *prof_ring;
+static volatile unsigned int prof_head;
+static uint_64_t prof_base;
+static const char *prof_dumpfile;
+
+//
+// M_ProfRecord
+// Called by PROF_END with the time PROF_BEGIN took.
+//
+void M_ProfRecord(profzone_t zone, uint_64_t start)
+{
+  uint_64_t now = I_GetTime_US();
+  unsigned int i = __sync_fetch_and_add(&prof_head, 1);
+  profevent_t *ev = &prof_ring[i & (PROF_RINGSIZE-1)];
+
+  ev->seq = 0;
+  __sync_synchronize();
+  ev->start = start;
+  ev->dur = (unsigned int)(now - start);
+  ev->thread = (unsigned int)((size_t)pthread_self() >> 4);
+  ev->zone = zone;
+  ev->tic = gametic;
+  __sync_synchronize();
+  ev->seq = i+1;
+}
+
+static void M_ProfAtExit(void)
+{
+  if (prof_dumpfile)
+    M_ProfDump(prof_dumpfile);
+}
+
+void M_ProfStart(const char *dumpfile)
+{
+  static boolean atexit_set;
+
+  prof_active = 0;
+  if (!prof_ring && !(prof_ring = calloc(PROF_RINGSIZE, sizeof *prof_ring)))
+    I_Error("M_ProfStart: Couldn't allocate %d events", PROF_RINGSIZE);
+
+  prof_head = 0;
+  prof_base = I_GetTime_US();
+  if (dumpfile) {
+    prof_dumpfile = dumpfile;
+    if (!atexit_set) {
+      atexit_set = true;
+      atexit(M_ProfAtExit);
+    }
+  }
+  __sync_synchronize();
+  prof_active = 1;
+  lprintf(LO_INFO, "M_ProfStart: recording %d zones\n", NUMPROFZONES);
+}
+
+void M_ProfStop(void)
+{
+  prof_active = 0;
+}
+
+//
+// M_ProfDump
+// Writes the ring, oldest first, as Chrome trace "complete" events.
+// Nesting is recovered by the viewer from the times on each thread.
+//
+int M_ProfDump(const char *filename)
+{
+  unsigned int head = prof_head;
+  unsigned int i = head > PROF_RINGSIZE ? head - PROF_RINGSIZE : 0;
+  int count = 0;
+  FILE *f;
+
+  if (!prof_ring)
+    return 0;
+  if (!(f = fopen(filename, "w"))) {
+    lprintf(LO_WARN, "M_ProfDump: couldn't open %s\n", filename);
+    return -1;
+  }
+
+  fprintf(f, "{\"traceEvents\":[\n");
+  for (; i != head; i++) {
+    const profevent_t *ev = &prof_ring[i & (PROF_RINGSIZE-1)];
+
+    if (ev->seq != i+1 || ev->start < prof_base)
+      continue;     // being written, or lapped by a newer event
+    fprintf(f, "%s{\"name\":\"%s\",\"cat\":\"prboom\",\"ph\":\"X\","
+            "\"ts\":%u,\"dur\":%u,\"pid\":1,\"tid\":%u,\"args\":{\"tic\":%d}}",
+            count ? ",\n" : "", prof_zonenames[ev->zone],
+            (unsigned int)(ev->start - prof_base), ev->dur, ev->thread, ev->tic);
+    count++;
+  }
+  fprintf(f, "\n],\"displayTimeUnit\":\"ms\"}\n");
+  fclose(f);
+
+  lprintf(LO_INFO, "M_ProfDump: wrote %d events to %s\n", count, filename);
+  return count;
+}
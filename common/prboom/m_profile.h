@@ -0,0 +1,78 @@
+/* Emacs style mode select   -*- C++ -*-
+ *-----------------------------------------------------------------------------
+ *
+ *
+ *  PrBoom: a Doom port merged with LxDoom and LSDLDoom
+ *  based on BOOM, a modified and improved DOOM engine
+ *  Copyright (C) 1999 by
+ *  id Software, Chi Hoang, Lee Killough, Jim Flynn, Rand Phares, Ty Halderman
+ *  Copyright (C) 1999-2000 by
+ *  Jess Haas, Nicolas Kalkhof, Colin Phipps, Florian Schulze
+ *  Copyright 2005, 2006 by
+ *  Florian Schulze, Colin Phipps, Neil Stevens, Andrey Budko
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ *  02111-1307, USA.
+ *
+ * DESCRIPTION:
+ *  Hot path profiler. Scoped timers around the big subsystems are
+ *  recorded into a ring buffer and dumped as a Chrome trace
+ *  (chrome://tracing, about:tracing) JSON file.
+ *
+ *-----------------------------------------------------------------------------*/
+
+#ifndef __M_PROFILE__
+#define __M_PROFILE__
+
+#include "doomtype.h"
+#include "i_system.h"
+
+// Zones that can be timed. Keep prof_zonenames in m_profile.c in sync.
+typedef enum {
+  PZ_G_Ticker,
+  PZ_P_Ticker,
+  PZ_P_RunThinkers,
+  PZ_D_Display,
+  PZ_R_RenderBSPNode,
+  PZ_IR_RenderBSPNode,
+  PZ_gld_DrawScene,
+  PZ_S_UpdateSounds,
+  PZ_W_CacheLumpNum,
+  NUMPROFZONES
+} profzone_t;
+
+// Nonzero while recording. Tested inline so an idle zone costs one branch.
+extern volatile int prof_active;
+
+//
+// PROF_BEGIN / PROF_END
+// Time a zone in the enclosing block. PROF_BEGIN is a declaration, so it
+// has to come first in the block.
+//
+#define PROF_BEGIN(z) uint_64_t prof_start_##z = prof_active ? I_GetTime_US() : 0
+#define PROF_END(z) if (prof_start_##z) M_ProfRecord(PZ_##z, prof_start_##z)
+
+void M_ProfRecord(profzone_t zone, uint_64_t start);
+
+// Start recording, clearing the ring. If dumpfile is non-NULL the trace is
+// written there at exit.
+void M_ProfStart(const char *dumpfile);
+void M_ProfStop(void);
+
+// Write everything still in the ring as a Chrome trace. Returns the number
+// of events written, or -1 if the file could not be opened.
+int M_ProfDump(const char *filename);
+
+#endif
@@ -6,6 +6,9 @@
 #include "p_checksum.h"
 #include "md5.h"
 #include "doomstat.h" /* players{,ingame} */
+#include "m_random.h" /* rng */
+#include "r_state.h"  /* sectors */
+#include "p_tick.h"   /* thinkercap */
 #include "lprintf.h"
 
 /* forward decls */
@@ -98,3 +101,254 @@ void checksum_gamestate(int tic) {
 
     fprintf(outfile,"\n");
 }
+
+/*
+ * The incremental state hash
+ *
+ * Unlike the MD5 above, this is cheap enough to keep during a net game.
+ * Nothing is walked for it that the tic doesn't walk anyway: each mobj is
+ * folded into its subsystem's hash by P_MobjThinker once it has moved,
+ * and the sector heights are an XOR of one term per sector that
+ * T_MovePlane swaps as it moves a plane, so only moving sectors cost
+ * anything. P_StateHashTic adds the rng and the players and keeps the
+ * result, which peers exchange every statehash_tics tics and compare with
+ * P_StateHashCheck, so a desync shows up at the tic it happened.
+ */
+
+#define SH_BASIS 2166136261u                /* FNV-1a, a word at a time */
+#define SH_MIX(h, v) (((h) ^ (unsigned)(v)) * 16777619u)
+
+int statehash_tics = 8;
+int statehash_desync = -1;
+const char *statehash_dumpdir = ".";
+
+static const char *const statehash_names[NUMSTATEHASHES] = {
+    "rng", "players", "monsters", "missiles", "things", "floors", "ceilings"
+};
+
+static statehash_t tichash;                 /* the tic being run */
+static unsigned sectorhash[2];              /* floors and ceilings */
+static statehash_t history[STATEHASH_HISTORY];
+static statehash_t pending[MAXPLAYERS][STATEHASH_HISTORY]; /* ahead of us */
+static int lasttic = -1;                    /* the newest tic in history */
+
+/* spreads a sector's term over all the bits, so the XOR of them is sound */
+static unsigned sectorterm(int i, fixed_t height) {
+    unsigned h = SH_MIX(SH_MIX(SH_BASIS, i), height);
+
+    h ^= h >> 16; h *= 0x85ebca6bu;
+    h ^= h >> 13; h *= 0xc2b2ae35u;
+    return h ^ (h >> 16);
+}
+
+static statehash_e mobjclass(const mobj_t *mo) {
+    if (mo->player)
+        return sh_players;
+    if (mo->flags & MF_COUNTKILL)
+        return sh_monsters;
+    if (mo->flags & MF_MISSILE)
+        return sh_missiles;
+    return sh_things;
+}
+
+/*
+ * P_StateHashLevel
+ * Recounts the sector heights, which are loaded rather than moved, after
+ * P_SetupLevel and P_UnArchiveWorld, and forgets what is out of date.
+ */
+void P_StateHashLevel(void) {
+    static boolean ready;
+    int i, p;
+
+    sectorhash[0] = sectorhash[1] = 0;
+    for (i = 0; i < numsectors; i++) {
+        sectorhash[0] ^= sectorterm(i, sectors[i].floorheight);
+        sectorhash[1] ^= sectorterm(i, sectors[i].ceilingheight);
+    }
+
+    /* a loaded game or a demo seek can go back, keep what is still ahead */
+    for (i = 0; i < STATEHASH_HISTORY; i++) {
+        if (!ready || history[i].tic >= gametic)
+            history[i].tic = -1;
+        for (p = 0; p < MAXPLAYERS; p++)
+            if (!ready || pending[p][i].tic < gametic)
+                pending[p][i].tic = -1;
+    }
+    for (i = 0; i < NUMSTATEHASHES; i++)
+        tichash.hash[i] = SH_BASIS;
+    lasttic = gametic - 1;
+    ready = true;
+}
+
+/* called by P_MobjThinker once the mobj has moved for the tic */
+void P_StateHashMobj(const mobj_t *mo) {
+    unsigned *h = &tichash.hash[mobjclass(mo)];
+
+    *h = SH_MIX(*h, mo->x);
+    *h = SH_MIX(*h, mo->y);
+    *h = SH_MIX(*h, mo->z);
+    *h = SH_MIX(*h, mo->health);
+    *h = SH_MIX(*h, mo->state - states);
+}
+
+/* called by T_MovePlane before and after it moves sec, which swaps the
+ * terms for the old heights for those of the new */
+void P_StateHashSector(const sector_t *sec) {
+    const int i = sec - sectors;
+
+    sectorhash[0] ^= sectorterm(i, sec->floorheight);
+    sectorhash[1] ^= sectorterm(i, sec->ceilingheight);
+}
+
+static void P_StateHashReport(const statehash_t *local,
+                              const statehash_t *remote, int player) {
+    int i;
+
+    if (statehash_desync == -1)
+        statehash_desync = remote->tic;
+    lprintf(LO_WARN, "P_StateHash: desync with player %d at tic %d\n",
+            player + 1, remote->tic);
+    for (i = 0; i < NUMSTATEHASHES; i++)
+        lprintf(LO_WARN, "  %-9s %08x %08x%s\n", statehash_names[i],
+                local->hash[i], remote->hash[i],
+                local->hash[i] != remote->hash[i] ? "  differs" : "");
+
+    if (statehash_dumpdir) {
+        char name[PATH_MAX+1];
+        FILE *f;
+
+        snprintf(name, sizeof name, "%s/desync-%d-p%d.txt",
+                 statehash_dumpdir, remote->tic, consoleplayer + 1);
+        if ((f = fopen(name, "w"))) {
+            fprintf(f, "desync with player %d at tic %d\n",
+                    player + 1, remote->tic);
+            for (i = 0; i < NUMSTATEHASHES; i++)
+                fprintf(f, "%-9s %08x %08x%s\n", statehash_names[i],
+                        local->hash[i], remote->hash[i],
+                        local->hash[i] != remote->hash[i] ? "  differs" : "");
+            P_StateHashDump(f);
+            fclose(f);
+            lprintf(LO_WARN, "  state written to %s\n", name);
+        }
+    }
+}
+
+static boolean P_StateHashCompare(const statehash_t *local,
+                                  const statehash_t *remote, int player) {
+    if (!memcmp(local->hash, remote->hash, sizeof local->hash))
+        return true;
+    if (statehash_desync == -1)     /* the first is all that matters */
+        P_StateHashReport(local, remote, player);
+    return false;
+}
+
+/*
+ * P_StateHashTic
+ * Finishes the hash of the tic P_Ticker has just run, and checks it
+ * against any a peer had already sent for it.
+ */
+void P_StateHashTic(int tic) {
+    statehash_t *h = &history[tic % STATEHASH_HISTORY];
+    unsigned rh = SH_BASIS;
+    int i;
+
+    rh = SH_MIX(rh, rng.rndindex);
+    rh = SH_MIX(rh, rng.prndindex);
+    for (i = 0; i < NUMPRCLASS; i++)
+        rh = SH_MIX(rh, rng.seed[i]);
+    tichash.hash[sh_rng] = rh;
+
+    for (i = 0; i < MAXPLAYERS; i++)
+        if (playeringame[i]) {
+            unsigned *ph = &tichash.hash[sh_players];
+
+            *ph = SH_MIX(*ph, i);
+            *ph = SH_MIX(*ph, players[i].health);
+            *ph = SH_MIX(*ph, players[i].armorpoints);
+            *ph = SH_MIX(*ph, players[i].readyweapon);
+            *ph = SH_MIX(*ph, players[i].killcount);
+        }
+
+    tichash.hash[sh_floors] = sectorhash[0];
+    tichash.hash[sh_ceilings] = sectorhash[1];
+    tichash.tic = tic;
+    *h = tichash;
+    lasttic = tic;
+
+    for (i = 0; i < NUMSTATEHASHES; i++)   /* the next tic starts afresh */
+        tichash.hash[i] = SH_BASIS;
+
+    for (i = 0; i < MAXPLAYERS; i++) {
+        statehash_t *r = &pending[i][tic % STATEHASH_HISTORY];
+
+        if (r->tic == tic) {
+            P_StateHashCompare(h, r, i);
+            r->tic = -1;
+        }
+    }
+}
+
+/* the hash kept for tic, or NULL if it is not kept (any more) */
+const statehash_t *P_StateHashAt(int tic) {
+    const statehash_t *h = &history[tic % STATEHASH_HISTORY];
+
+    return tic >= 0 && h->tic == tic ? h : NULL;
+}
+
+/*
+ * P_StateHashCheck
+ * Compares the hash player had for a tic with ours. One for a tic we
+ * haven't run yet is held until P_StateHashTic gets there. Returns false
+ * if they differ, after reporting the first time that happens.
+ */
+boolean P_StateHashCheck(const statehash_t *remote, int player) {
+    const statehash_t *local;
+
+    if (remote->tic < 0 || player < 0 || player >= MAXPLAYERS)
+        return true;
+    if ((local = P_StateHashAt(remote->tic)))
+        return P_StateHashCompare(local, remote, player);
+    if (remote->tic > lasttic && remote->tic - lasttic <= STATEHASH_HISTORY)
+        pending[player][remote->tic % STATEHASH_HISTORY] = *remote;
+    return true;
+}
+
+/*
+ * P_StateHashDump
+ * Writes out what the hashes are made from, subsystem by subsystem and in
+ * the order they are hashed in, so that the dumps two peers wrote at the
+ * same tic can be diffed.
+ */
+void P_StateHashDump(FILE *f) {
+    static const char *const classes[] = { "", "player", "monster", "missile", "thing" };
+    thinker_t *th;
+    int i;
+
+    fprintf(f, "\nstate at tic %d, leveltime %d\n", gametic, leveltime);
+
+    fprintf(f, "\n[rng]\nrndindex %d prndindex %d\n", rng.rndindex, rng.prndindex);
+    for (i = 0; i < NUMPRCLASS; i++)
+        fprintf(f, "seed %d %lu\n", i, rng.seed[i]);
+
+    fprintf(f, "\n[players]\n");
+    for (i = 0; i < MAXPLAYERS; i++)
+        if (playeringame[i])
+            fprintf(f, "player %d health %d armor %d weapon %d kills %d\n",
+                    i + 1, players[i].health, players[i].armorpoints,
+                    players[i].readyweapon, players[i].killcount);
+
+    fprintf(f, "\n[mobjs]\n");
+    for (th = thinkercap.next; th != &thinkercap; th = th->next)
+        if (th->function == P_MobjThinker) {
+            const mobj_t *mo = (const mobj_t *)th;
+
+            fprintf(f, "%-7s type %d x %d y %d z %d health %d state %d\n",
+                    classes[mobjclass(mo)], mo->type, mo->x, mo->y, mo->z,
+                    mo->health, (int)(mo->state - states));
+        }
+
+    fprintf(f, "\n[sectors]\n");
+    for (i = 0; i < numsectors; i++)
+        fprintf(f, "sector %d floor %d ceiling %d\n",
+                i, sectors[i].floorheight, sectors[i].ceilingheight);
+}
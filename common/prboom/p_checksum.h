@@ -1,4 +1,46 @@
+#ifndef __P_CHECKSUM__
+#define __P_CHECKSUM__
+
+#include "r_defs.h"
+
 extern void (*P_Checksum)(int);
 extern void P_ChecksumFinal(void);
 void P_RecordChecksum(const char *file);
 //void P_VerifyChecksum(const char *file);
+
+/*
+ * Incremental state hash, for finding the tic a net game desyncs at.
+ * Each subsystem has its own 32 bit hash so that a mismatch says where
+ * to look, not only that something differs.
+ */
+typedef enum {
+    sh_rng,         /* rng indices and seeds */
+    sh_players,     /* player_t and the players' mobjs */
+    sh_monsters,    /* MF_COUNTKILL */
+    sh_missiles,    /* MF_MISSILE */
+    sh_things,      /* every other mobj */
+    sh_floors,      /* sector floor heights */
+    sh_ceilings,    /* sector ceiling heights */
+    NUMSTATEHASHES
+} statehash_e;
+
+typedef struct {
+    int tic;        /* the state after this gametic has run, -1 if unused */
+    unsigned hash[NUMSTATEHASHES];
+} statehash_t;
+
+#define STATEHASH_HISTORY 64    /* tics kept, and remote hashes held for */
+
+extern int statehash_tics;          /* tics between hashes peers exchange */
+extern int statehash_desync;        /* first tic found to differ, or -1 */
+extern const char *statehash_dumpdir; /* where desync dumps go, NULL for none */
+
+void P_StateHashLevel(void);
+void P_StateHashMobj(const mobj_t *mo);
+void P_StateHashSector(const sector_t *sec);
+void P_StateHashTic(int tic);
+const statehash_t *P_StateHashAt(int tic);
+boolean P_StateHashCheck(const statehash_t *remote, int player);
+void P_StateHashDump(FILE *f);
+
+#endif
@@ -34,6 +34,7 @@
 #include "doomstat.h"
 #include "p_spec.h"
 #include "p_tick.h"
+#include "p_saveg.h"
 #include "s_sound.h"
 #include "sounds.h"
 #include "r_main.h"
@@ -614,6 +615,7 @@ int EV_VerticalDoor
     case 33:
     case 34:
       door->type = open;
+      P_MarkLineDirty(line);
       line->special = 0;
       break;
 
@@ -623,6 +625,7 @@ int EV_VerticalDoor
       break;
     case 118: // blazing door open
       door->type = blazeOpen;
+      P_MarkLineDirty(line);
       line->special = 0;
       door->speed = VDOORSPEED*4;
       break;
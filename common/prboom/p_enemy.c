@@ -46,6 +46,7 @@
 #include "g_game.h"
 #include "p_enemy.h"
 #include "p_tick.h"
+#include "p_saveg.h"
 #include "m_bbox.h"
 #include "lprintf.h"
 
@@ -94,6 +95,7 @@ static void P_RecursiveSound(sector_t *sec, int soundblocks,
   sec->validcount = validcount;
   sec->soundtraversed = soundblocks+1;
   P_SetTarget(&sec->soundtarget, soundtarget);
+  P_MarkSoundTarget(sec);
 
   for (i=0; i<sec->linecount; i++)
     {
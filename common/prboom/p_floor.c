@@ -37,8 +37,10 @@
 #include "p_map.h"
 #include "p_spec.h"
 #include "p_tick.h"
+#include "p_saveg.h"
 #include "s_sound.h"
 #include "sounds.h"
+#include "p_checksum.h"
 
 ///////////////////////////////////////////////////////////////////////
 //
@@ -62,7 +64,7 @@
 //  pastdest - plane moved normally and is now at destination height
 //  crushed - plane encountered an obstacle, is holding until removed
 //
-result_e T_MovePlane
+static result_e P_MovePlane
 ( sector_t*     sector,
   fixed_t       speed,
   fixed_t       dest,
@@ -75,6 +77,9 @@ result_e T_MovePlane
   fixed_t       destheight; //jff 02/04/98 used to keep floors/ceilings
                             // from moving thru each other
 
+  sectorheightgen++;        // remembered sight results may be out of date
+  P_MarkSectorDirty(sector);
+
   switch(floorOrCeiling)
   {
     case 0:
@@ -219,6 +224,22 @@ result_e T_MovePlane
   return ok;
 }
 
+result_e T_MovePlane
+( sector_t*     sector,
+  fixed_t       speed,
+  fixed_t       dest,
+  boolean       crush,
+  int           floorOrCeiling,
+  int           direction )
+{
+  result_e      res;
+
+  P_StateHashSector(sector);  // take the old heights out of the state hash
+  res = P_MovePlane(sector, speed, dest, crush, floorOrCeiling, direction);
+  P_StateHashSector(sector);  // and put the new ones in
+  return res;
+}
+
 //
 // T_MoveFloor()
 //
@@ -556,6 +577,7 @@ int EV_DoFloor
         floor->sector = sec;
         floor->speed = FLOORSPEED;
         floor->floordestheight = floor->sector->floorheight + 24 * FRACUNIT;
+        P_MarkSectorDirty(sec);
         sec->floorpic = line->frontsector->floorpic;
         sec->special = line->frontsector->special;
         //jff 3/14/98 transfer both old and new special
@@ -662,6 +684,7 @@ int EV_DoChange
     sec = &sectors[secnum];
 
     rtn = 1;
+    P_MarkSectorDirty(sec);
 
     // handle trigger or numeric change type
     switch(changetype)
@@ -36,6 +36,7 @@
 #include "r_main.h"
 #include "p_spec.h"
 #include "p_tick.h"
+#include "p_saveg.h"
 #include "m_random.h"
 #include "s_sound.h"
 #include "sounds.h"
@@ -805,7 +806,10 @@ manual_stair:
   }
   // retriggerable generalized stairs build up or down alternately
   if (rtn)
+  {
+    P_MarkLineDirty(line);
     line->special ^= StairDirection; // alternate dir on succ activations
+  }
   return rtn;
 }
 
@@ -44,13 +44,16 @@
 
 #include "p_inter.h"
 #include "p_enemy.h"
+#include "p_saveg.h"
 
 #ifdef __GNUG__
 #pragma implementation "p_inter.h"
 #endif
 #include "p_inter.h"
 
+#ifdef IPHONE
 #include "doomiphone.h"
+#endif
 
 #define BONUSADD        6
 
@@ -756,6 +759,8 @@ void P_DamageMobj(mobj_t *target,mobj_t *inflictor, mobj_t *source, int damage)
   if (target->health <= 0)
     return;
 
+  P_MarkMobjDirty(target);
+
   if (target->flags & MF_SKULLFLY)
     target->momx = target->momy = target->momz = 0;
 
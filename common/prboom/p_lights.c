@@ -39,6 +39,7 @@
 #include "r_main.h"
 #include "p_spec.h"
 #include "p_tick.h"
+#include "p_saveg.h"
 
 //////////////////////////////////////////////////////////
 //
@@ -62,6 +63,7 @@ void T_FireFlicker (fireflicker_t* flick)
     return;
 
   amount = (P_Random(pr_lights)&3)*16;
+  P_MarkSectorDirty(flick->sector);
 
   if (flick->sector->lightlevel - amount < flick->minlight)
     flick->sector->lightlevel = flick->minlight;
@@ -83,6 +85,7 @@ void T_LightFlash (lightflash_t* flash)
 {
   if (--flash->count)
     return;
+  P_MarkSectorDirty(flash->sector);
 
   if (flash->sector->lightlevel == flash->maxlight)
   {
@@ -109,6 +112,7 @@ void T_StrobeFlash (strobe_t*   flash)
 {
   if (--flash->count)
     return;
+  P_MarkSectorDirty(flash->sector);
 
   if (flash->sector->lightlevel == flash->minlight)
   {
@@ -133,6 +137,7 @@ void T_StrobeFlash (strobe_t*   flash)
 
 void T_Glow(glow_t* g)
 {
+  P_MarkSectorDirty(g->sector);
   switch(g->direction)
   {
     case -1:
@@ -321,6 +326,9 @@ int EV_StartLightStrobing(line_t* line)
     if (P_SectorActive(lighting_special,sec)) //jff 2/22/98
       continue;
 
+    // the spawn clears the special now, the strobe's first change
+    // may be tics away
+    P_MarkSectorDirty(sec);
     P_SpawnStrobeFlash (sec,SLOWDARK, 0);
   }
   return 1;
@@ -352,6 +360,7 @@ int EV_TurnTagLightsOff(line_t* line)
   if ((tsec = getNextSector(sector->lines[i], sector)) &&
       tsec->lightlevel < min)
     min = tsec->lightlevel;
+      P_MarkSectorDirty(sector);
       sector->lightlevel = min;
     }
   return 1;
@@ -388,6 +397,7 @@ int EV_LightTurnOn(line_t *line, int bright)
         temp->lightlevel > tbright)
       tbright = temp->lightlevel;
 
+      P_MarkSectorDirty(sector);
       sector->lightlevel = tbright;
 
       //jff 5/17/98 unless compatibility optioned
@@ -435,6 +445,7 @@ int EV_LightTurnOnPartway(line_t *line, fixed_t level)
         min = temp->lightlevel;
     }
 
+      P_MarkSectorDirty(sector);
       sector->lightlevel =   // Set level in-between extremes
   (level * bright + (FRACUNIT-level) * min) >> FRACBITS;
     }
@@ -45,6 +45,8 @@
 #include "m_random.h"
 #include "m_bbox.h"
 #include "lprintf.h"
+#include "p_predict.h"
+#include "p_saveg.h"
 
 static mobj_t    *tmthing;
 static fixed_t   tmx;
@@ -508,6 +510,7 @@ static boolean PIT_CheckThing(mobj_t *thing) // killough 3/26/98: make static
    */
 
   if (thing->flags & MF_TOUCHY &&                  // touchy object
+      !predicting &&                               // not a predicted move
       tmthing->flags & MF_SOLID &&                 // solid object touches it
       thing->health > 0 &&                         // touchy object is alive
       (thing->intflags & MIF_ARMED ||              // Thing is an armed mine
@@ -605,7 +608,7 @@ static boolean PIT_CheckThing(mobj_t *thing) // killough 3/26/98: make static
   if (thing->flags & MF_SPECIAL)
     {
       uint_64_t solid = thing->flags & MF_SOLID;
-      if (tmthing->flags & MF_PICKUP)
+      if (tmthing->flags & MF_PICKUP && !predicting)
   P_TouchSpecialThing(thing, tmthing); // can remove thing
       return !solid;
     }
@@ -849,9 +852,12 @@ boolean P_TryMove(mobj_t* thing,fixed_t x,fixed_t y,
     }
 
   // the move is ok,
-  // so unlink from the old position and link into the new position
+  // so unlink from the old position and link into the new position.
+  // A predicted move leaves the links alone, so the blockmap and sector
+  // lists keep their order; only the subsector has to follow.
 
-  P_UnsetThingPosition (thing);
+  if (!predicting)
+    P_UnsetThingPosition (thing);
 
   oldx = thing->x;
   oldy = thing->y;
@@ -861,7 +867,13 @@ boolean P_TryMove(mobj_t* thing,fixed_t x,fixed_t y,
   thing->x = x;
   thing->y = y;
 
-  P_SetThingPosition (thing);
+  if (!predicting)
+    P_SetThingPosition (thing);
+  else
+    {
+      thing->subsector = R_PointInSubsector(x, y);
+      return true;
+    }
 
   // if any special lines were hit, do the effect
 
@@ -1872,6 +1884,7 @@ boolean PIT_ChangeSector (mobj_t* thing)
   {
   mobj_t* mo;
 
+  P_MarkMobjDirty(thing);  // its heights at least are about to change
   if (P_ThingHeightClip (thing))
     return true; // keep checking
 
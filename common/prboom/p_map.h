@@ -54,6 +54,40 @@ void    P_SlideMove(mobj_t *mo);
 boolean P_CheckSight(mobj_t *t1, mobj_t *t2);
 void    P_UseLines(player_t *player);
 
+// Sight worked out ahead of the thinkers by the P_RunThinkers prepass.
+// The answer is reused by P_CheckSight only if the mobjs and every sector
+// height the traversal looked at are still the same, so the result is
+// always what the serial traversal would have returned.
+#define MAXSIGHTDEPS 32
+
+typedef struct {
+  mobj_t  *t1, *t2;
+  int     worker;                   // which prepass thread runs it
+  fixed_t x1, y1, z1, height1;      // inputs the result was worked out from
+  fixed_t x2, y2, z2, height2;
+  int     numdeps;                  // -1 if there were too many to keep
+  struct {
+    const sector_t *sector;
+    fixed_t floorheight, ceilingheight;
+  } deps[MAXSIGHTDEPS];
+  boolean result;
+} sightjob_t;
+
+boolean P_NeedSightJob(mobj_t *t1, mobj_t *t2);
+void    P_RunSightJob(sightjob_t *job, int *linemarks, int mark);
+void    P_SetSightJobs(sightjob_t *jobs, int numjobs);  // NULL to stop using them
+
+extern unsigned int sightjob_hits, sightjob_stale, sightjob_misses;
+
+// Sight results kept across calls, keyed by the subsectors and positions
+// of the two mobjs. sectorheightgen is bumped by every plane mover; an
+// entry from an older generation is reused only after the heights it
+// depends on have been checked again.
+extern boolean sight_cache;
+extern unsigned int sectorheightgen;
+extern unsigned int sightcache_hits, sightcache_rechecked, sightcache_misses;
+void    P_ClearSightCache(void);
+
 // killough 8/2/98: add 'mask' argument to prevent friends autoaiming at others
 fixed_t P_AimLineAttack(mobj_t *t1,angle_t angle,fixed_t distance, uint_64_t mask);
 
@@ -40,6 +40,7 @@
 #include "p_maputl.h"
 #include "p_map.h"
 #include "p_setup.h"
+#include "p_saveg.h"
 
 //
 // P_AproxDistance
@@ -284,6 +285,7 @@ void P_UnsetThingPosition (mobj_t *thing)
 void P_SetThingPosition(mobj_t *thing)
 {                                                      // link into subsector
   subsector_t *ss = thing->subsector = R_PointInSubsector(thing->x, thing->y);
+  P_MarkMobjDirty(thing);
   if (!(thing->flags & MF_NOSECTOR))
     {
       // invisible things don't go into the sector links
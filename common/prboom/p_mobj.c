@@ -47,6 +47,9 @@
 #include "p_inter.h"
 #include "lprintf.h"
 #include "r_demo.h"
+#include "p_predict.h"
+#include "p_checksum.h"
+#include "p_saveg.h"
 
 //
 // P_SetMobjState
@@ -66,6 +69,8 @@ boolean P_SetMobjState(mobj_t* mobj,statenum_t state)
   boolean ret = true;                         // return value
   statenum_t tempstate[NUMSTATES];            // for use with recursion
 
+  P_MarkMobjDirty(mobj);
+
   if (recursion++)                            // if recursion detected,
     memset(seenstate=tempstate,0,sizeof tempstate); // clear state table
 
@@ -135,7 +140,7 @@ void P_ExplodeMissile (mobj_t* mo)
 // Attempts to move something if it has momentum.
 //
 
-static void P_XYMovement (mobj_t* mo)
+void P_XYMovement (mobj_t* mo)
   {
   player_t *player;
   fixed_t xmove, ymove;
@@ -414,7 +419,7 @@ static void P_XYMovement (mobj_t* mo)
 //
 // Attempt vertical movement.
 
-static void P_ZMovement (mobj_t* mo)
+void P_ZMovement (mobj_t* mo)
 {
   /* killough 7/11/98:
    * BFG fireballs bounced on floors and ceilings in Pre-Beta Doom
@@ -568,7 +573,7 @@ floater:
 
         mo->player->deltaviewheight = mo->momz>>3;
         /* cph - prevent "oof" when dead */
-        if (comp[comp_sound] || mo->health > 0)
+        if ((comp[comp_sound] || mo->health > 0) && !predicting)
           S_StartSound (mo, sfx_oof);
       }
   mo->momz = 0;
@@ -733,6 +738,15 @@ void P_MobjThinker (mobj_t* mobj)
   mobj->PrevY = mobj->y;
   mobj->PrevZ = mobj->z;
 
+  // things at rest in a state that never ends, most of what a map holds,
+  // run through here without changing; anything else is saved by snapshots,
+  // as is any player's, which P_PlayerThink turns without moving
+  if (mobj->player || mobj->tics != -1 || mobj->momx | mobj->momy | mobj->momz ||
+      mobj->z != mobj->floorz || mobj->z > mobj->dropoffz || mobj->gear ||
+      mobj->flags & MF_SKULLFLY || (mobj->flags & MF_COUNTKILL && respawnmonsters) ||
+      (mobj->intflags & (MIF_FALLING | MIF_ARMED)) != MIF_ARMED)
+    P_MarkMobjDirty(mobj);
+
   // momentum movement
   if (mobj->momx | mobj->momy || mobj->flags & MF_SKULLFLY)
     {
@@ -763,6 +777,8 @@ void P_MobjThinker (mobj_t* mobj)
     mobj->intflags &= ~MIF_FALLING, mobj->gear = 0;  // Reset torque
       }
 
+  P_StateHashMobj(mobj);   // it has moved for this tic
+
   // cycle through states,
   // calling action functions at transitions
 
@@ -871,6 +887,7 @@ mobj_t* P_SpawnMobj(fixed_t x,fixed_t y,fixed_t z,mobjtype_t type)
 
   mobj->target = mobj->tracer = mobj->lastenemy = NULL;
   P_AddThinker (&mobj->thinker);
+  P_MarkMobjSpawned(mobj);
   if (!((mobj->flags ^ MF_COUNTKILL) & (MF_FRIEND | MF_COUNTKILL)))
     totallive++;
   return mobj;
@@ -936,6 +953,8 @@ void P_RemoveMobj (mobj_t* mobj)
     P_SetTarget(&mobj->tracer,    NULL);
     P_SetTarget(&mobj->lastenemy, NULL);
   }
+  P_MarkMobjRemoved(mobj);
+
   // free block
 
   P_RemoveThinker (&mobj->thinker);
@@ -224,6 +224,7 @@
 enum {
   MIF_FALLING = 1,      // Object is falling
   MIF_ARMED = 2,        // Object is armed (for MF_TOUCHY objects)
+  MIF_DIRTY = 4,        // changed since the snapshot base, see P_MarkMobjDirty
 };
 
 // Map Object definition.
@@ -351,7 +352,8 @@ typedef struct mobj_s
     fixed_t             PrevY;
     fixed_t             PrevZ;
 
-    fixed_t             pad; // cph - needed so I can get the size unambiguously on amd64
+    // cph - this was a pad, needed so I can get the size unambiguously on amd64
+    int                 serial; // snapshots key the mobj on it, see p_saveg.c
 
     // SEE WARNING ABOVE ABOUT POINTER FIELDS!!!
 } mobj_t;
@@ -390,6 +392,8 @@ mobj_t  *P_SpawnMobj(fixed_t x, fixed_t y, fixed_t z, mobjtype_t type);
 void    P_RemoveMobj(mobj_t *th);
 boolean P_SetMobjState(mobj_t *mobj, statenum_t state);
 void    P_MobjThinker(mobj_t *mobj);
+void    P_XYMovement(mobj_t *mo);     // P_MobjThinker's movement, for p_predict.c
+void    P_ZMovement(mobj_t *mo);
 void    P_SpawnPuff(fixed_t x, fixed_t y, fixed_t z);
 void    P_SpawnBlood(fixed_t x, fixed_t y, fixed_t z, int damage);
 mobj_t  *P_SpawnMissile(mobj_t *source, mobj_t *dest, mobjtype_t type);
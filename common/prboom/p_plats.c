@@ -36,6 +36,7 @@
 #include "r_main.h"
 #include "p_spec.h"
 #include "p_tick.h"
+#include "p_saveg.h"
 #include "s_sound.h"
 #include "sounds.h"
 
@@ -238,6 +239,7 @@ int EV_DoPlat
     {
       case raiseToNearestAndChange:
         plat->speed = PLATSPEED/2;
+        P_MarkSectorDirty(sec);
         sec->floorpic = sides[line->sidenum[0]].sector->floorpic;
         plat->high = P_FindNextHighestFloor(sec,sec->floorheight);
         plat->wait = 0;
@@ -251,6 +253,7 @@ int EV_DoPlat
 
       case raiseAndChange:
         plat->speed = PLATSPEED/2;
+        P_MarkSectorDirty(sec);
         sec->floorpic = sides[line->sidenum[0]].sector->floorpic;
         plat->high = sec->floorheight + amount*FRACUNIT;
         plat->wait = 0;
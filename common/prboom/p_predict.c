@@ -0,0 +1,108 @@
+/* Emacs style mode select   -*- C++ -*-
+ *-----------------------------------------------------------------------------
+ *
+ *
+ *  PrBoom: a Doom port merged with LxDoom and LSDLDoom
+ *  based on BOOM, a modified and improved DOOM engine
+ *  Copyright (C) 1999 by
+ *  id Software, Chi Hoang, Lee Killough, Jim Flynn, Rand Phares, Ty Halderman
+ *  Copyright (C) 1999-2000 by
+ *  Jess Haas, Nicolas Kalkhof, Colin Phipps, Florian Schulze
+ *  Copyright 2005, 2006 by
+ *  Florian Schulze, Colin Phipps, Neil Stevens, Andrey Budko
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ *  02111-1307, USA.
+ *
+ * DESCRIPTION:
+ *      Client side prediction of the local player, see p_predict.h.
+ *
+ *      A predicted tic is the player's part of P_PlayerThink followed by
+ *      the movement half of P_MobjThinker, in the order P_Ticker runs
+ *      them. The player and its mobj are copied aside first, and since
+ *      prediction never relinks the mobj, copying them back is all
+ *      P_UnpredictPlayer has to do.
+ *
+ *-----------------------------------------------------------------------------*/
+
+#include <string.h>
+
+#include "doomstat.h"
+#include "p_mobj.h"
+#include "p_user.h"
+#include "p_predict.h"
+
+boolean predicting;
+
+extern boolean onground;        // p_user.c
+
+static player_t *predicted;
+static player_t savedplayer;
+static mobj_t savedmo;
+
+boolean P_PredictPlayer(player_t *player, const ticcmd_t *cmds, int count)
+{
+  mobj_t *mo = player->mo;
+  const int savedleveltime = leveltime;
+  const boolean savedonground = onground;
+  int i;
+
+  if (predicted)
+    P_UnpredictPlayer();
+  if (!mo || player->playerstate != PST_LIVE || count <= 0)
+    return false;
+
+  predicted = player;
+  savedplayer = *player;
+  savedmo = *mo;
+
+  predicting = true;
+  for (i = 0; i < count; i++, leveltime++)
+    {
+      player->cmd = cmds[i];
+
+      if (player->cheats & CF_NOCLIP)
+        mo->flags |= MF_NOCLIP;
+      else
+        mo->flags &= ~MF_NOCLIP;
+      if (mo->reactiontime)
+        mo->reactiontime--;
+      else
+        P_MovePlayer(player);
+      P_CalcHeight(player);
+
+      mo->PrevX = mo->x;
+      mo->PrevY = mo->y;
+      mo->PrevZ = mo->z;
+      if (mo->momx | mo->momy)
+        P_XYMovement(mo);
+      if (mo->z != mo->floorz || mo->momz)
+        P_ZMovement(mo);
+    }
+  predicting = false;
+
+  leveltime = savedleveltime;
+  onground = savedonground;
+  return true;
+}
+
+void P_UnpredictPlayer(void)
+{
+  if (!predicted)
+    return;
+  *predicted->mo = savedmo;
+  *predicted = savedplayer;
+  predicted = NULL;
+}
@@ -0,0 +1,56 @@
+/* Emacs style mode select   -*- C++ -*-
+ *-----------------------------------------------------------------------------
+ *
+ *
+ *  PrBoom: a Doom port merged with LxDoom and LSDLDoom
+ *  based on BOOM, a modified and improved DOOM engine
+ *  Copyright (C) 1999 by
+ *  id Software, Chi Hoang, Lee Killough, Jim Flynn, Rand Phares, Ty Halderman
+ *  Copyright (C) 1999-2000 by
+ *  Jess Haas, Nicolas Kalkhof, Colin Phipps, Florian Schulze
+ *  Copyright 2005, 2006 by
+ *  Florian Schulze, Colin Phipps, Neil Stevens, Andrey Budko
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ *  02111-1307, USA.
+ *
+ * DESCRIPTION:
+ *      Client side prediction of the local player. The game keeps
+ *      running only the tics everyone has agreed on; before a frame is
+ *      drawn the local player is moved on through the commands that
+ *      haven't come back yet, and put back as it was afterwards.
+ *
+ *-----------------------------------------------------------------------------*/
+
+#ifndef __P_PREDICT__
+#define __P_PREDICT__
+
+#include "d_player.h"
+#include "d_ticcmd.h"
+
+/* Set while predicted tics run. Movement still clips against the world
+ * as it stands, but doesn't pick things up, trigger lines, make noise or
+ * relink the player's mobj, so nothing outside the player changes. */
+extern boolean predicting;
+
+/* Runs count predicted tics of cmds on player, starting from wherever
+ * the game has it now. Returns false, changing nothing, if the player
+ * can't be predicted (dead, not spawned, or no commands). */
+boolean P_PredictPlayer(player_t *player, const ticcmd_t *cmds, int count);
+
+/* Puts the player back as the game left it */
+void P_UnpredictPlayer(void);
+
+#endif
@@ -41,12 +41,18 @@
 #include "am_map.h"
 #include "p_enemy.h"
 #include "lprintf.h"
+#include "p_checksum.h"
+#include "g_game.h"
+#include "p_setup.h"
 
 byte *save_p;
 
 // Pads save_p to a 4-byte boundary
 //  so that the load/save works on SGI&Gecko.
-#define PADSAVEP()    do { save_p += (4 - ((int) save_p & 3)) & 3; } while (0)
+// The pad bytes are zeroed, so two saves of the same state are identical
+// byte for byte -- snapshot deltas are checked against full saves that way.
+#define PADSAVEP()    do { int pad_ = (4 - ((int) save_p & 3)) & 3; \
+                           memset(save_p, 0, pad_); save_p += pad_; } while (0)
 //
 // P_ArchivePlayers
 //
@@ -102,31 +108,76 @@ void P_UnArchivePlayers (void)
 }
 
 
+// Sizes of the records P_ArchiveWorld writes for each sector, each line
+// and each sidedef of a line. Snapshots patch records of these sizes.
+#define SECTOR_RECORD (sizeof(short)*5 + 2*sizeof(fixed_t))
+#define LINE_RECORD   (sizeof(short)*3)
+#define SIDE_RECORD   (sizeof(short)*3 + 2*sizeof(fixed_t))
+
+static short *P_ArchiveSector(short *put, const sector_t *sec)
+{
+  // killough 10/98: save full floor & ceiling heights, including fraction
+  memcpy(put, &sec->floorheight, sizeof sec->floorheight);
+  put = (void *)((char *) put + sizeof sec->floorheight);
+  memcpy(put, &sec->ceilingheight, sizeof sec->ceilingheight);
+  put = (void *)((char *) put + sizeof sec->ceilingheight);
+
+  *put++ = sec->floorpic;
+  *put++ = sec->ceilingpic;
+  *put++ = sec->lightlevel;
+  *put++ = sec->special;            // needed?   yes -- transfer types
+  *put++ = sec->tag;                // needed?   need them -- killough
+  return put;
+}
+
+static short *P_ArchiveSide(short *put, const side_t *si)
+{
+  // killough 10/98: save full sidedef offsets,
+  // preserving fractional scroll offsets
+
+  memcpy(put, &si->textureoffset, sizeof si->textureoffset);
+  put = (void *)((char *) put + sizeof si->textureoffset);
+  memcpy(put, &si->rowoffset, sizeof si->rowoffset);
+  put = (void *)((char *) put + sizeof si->rowoffset);
+
+  *put++ = si->toptexture;
+  *put++ = si->bottomtexture;
+  *put++ = si->midtexture;
+  return put;
+}
+
+static short *P_ArchiveLine(short *put, const line_t *li)
+{
+  int j;
+
+  *put++ = li->flags;
+  *put++ = li->special;
+  *put++ = li->tag;
+
+  for (j=0; j<2; j++)
+    if (li->sidenum[j] != NO_INDEX)
+      put = P_ArchiveSide(put, &sides[li->sidenum[j]]);
+  return put;
+}
+
 //
 // P_ArchiveWorld
 //
 void P_ArchiveWorld (void)
 {
   int            i;
-  const sector_t *sec;
-  const line_t   *li;
-  const side_t   *si;
   short          *put;
 
   // killough 3/22/98: fix bug caused by hoisting save_p too early
   // killough 10/98: adjust size for changes below
-  size_t size =
-    (sizeof(short)*5 + sizeof sec->floorheight + sizeof sec->ceilingheight)
-    * numsectors + sizeof(short)*3*numlines + 4;
+  size_t size = SECTOR_RECORD * numsectors + LINE_RECORD * numlines + 4;
 
   for (i=0; i<numlines; i++)
     {
       if (lines[i].sidenum[0] != NO_INDEX)
-        size +=
-    sizeof(short)*3 + sizeof si->textureoffset + sizeof si->rowoffset;
+        size += SIDE_RECORD;
       if (lines[i].sidenum[1] != NO_INDEX)
-  size +=
-    sizeof(short)*3 + sizeof si->textureoffset + sizeof si->rowoffset;
+        size += SIDE_RECORD;
     }
 
   CheckSaveGame(size); // killough
@@ -136,53 +187,16 @@ void P_ArchiveWorld (void)
   put = (short *)save_p;
 
   // do sectors
-  for (i=0, sec = sectors ; i<numsectors ; i++,sec++)
-    {
-      // killough 10/98: save full floor & ceiling heights, including fraction
-      memcpy(put, &sec->floorheight, sizeof sec->floorheight);
-      put = (void *)((char *) put + sizeof sec->floorheight);
-      memcpy(put, &sec->ceilingheight, sizeof sec->ceilingheight);
-      put = (void *)((char *) put + sizeof sec->ceilingheight);
-
-      *put++ = sec->floorpic;
-      *put++ = sec->ceilingpic;
-      *put++ = sec->lightlevel;
-      *put++ = sec->special;            // needed?   yes -- transfer types
-      *put++ = sec->tag;                // needed?   need them -- killough
-    }
+  for (i=0 ; i<numsectors ; i++)
+    put = P_ArchiveSector(put, &sectors[i]);
 
   // do lines
-  for (i=0, li = lines ; i<numlines ; i++,li++)
-    {
-      int j;
-
-      *put++ = li->flags;
-      *put++ = li->special;
-      *put++ = li->tag;
-
-      for (j=0; j<2; j++)
-        if (li->sidenum[j] != NO_INDEX)
-          {
-      si = &sides[li->sidenum[j]];
-
-      // killough 10/98: save full sidedef offsets,
-      // preserving fractional scroll offsets
+  for (i=0 ; i<numlines ; i++)
+    put = P_ArchiveLine(put, &lines[i]);
 
-      memcpy(put, &si->textureoffset, sizeof si->textureoffset);
-      put = (void *)((char *) put + sizeof si->textureoffset);
-      memcpy(put, &si->rowoffset, sizeof si->rowoffset);
-      put = (void *)((char *) put + sizeof si->rowoffset);
-
-            *put++ = si->toptexture;
-            *put++ = si->bottomtexture;
-            *put++ = si->midtexture;
-          }
-    }
   save_p = (byte *) put;
 }
 
-
-
 //
 // P_UnArchiveWorld
 //
@@ -244,6 +258,249 @@ void P_UnArchiveWorld (void)
           }
     }
   save_p = (byte *) get;
+  P_StateHashLevel();
+}
+
+//
+// Snapshots
+//
+// A snapshot is a full savegame, the base, plus the sector, line and
+// sidedef records and the mobjs changed since the base was written, so its
+// cost follows what moved rather than the size of the map. Everything that
+// changes a field P_ArchiveWorld saves marks the record; changes made while
+// the level is set up come before any base and need no marking.
+//
+
+typedef struct {
+  unsigned *bits;
+  int      *list;
+  int      count;
+} dirtyset_t;
+
+static dirtyset_t dirtysectors, dirtylines, dirtysides;
+static dirtyset_t soundsectors;  // sectors given a soundtarget this level
+static boolean    worldbase;     // the dirty sets are relative to a base
+static int        *lineoffset;   // offset of each line record in the world
+static int        *slotoffset;   // offset of each line's sidedef records
+static int        *slotnext;     // next line slot sharing the same sidedef
+static int        *sideslot;     // first line slot of each sidedef, or -1
+
+// Mobjs are kept by serial, not by their place among the thinkers, which
+// every spawn and removal shifts. The ones changed or spawned since the
+// base are on dirtymobjs, marked MIF_DIRTY, and the serials of the base's
+// mobjs removed since are on removedmobjs.
+static mobj_t     **dirtymobjs;
+static int        numdirtymobjs, maxdirtymobjs;
+static int        *removedmobjs;
+static int        numremovedmobjs, maxremovedmobjs;
+static int        mobjserial;    // the last serial given out
+static int        baseserial;    // the first one given out since the base
+
+static void P_InitDirtySet(dirtyset_t *set, int count)
+{
+  set->bits = Z_Calloc((count + 32) / 32, sizeof *set->bits, PU_LEVEL, 0);
+  set->list = Z_Malloc((count + 1) * sizeof *set->list, PU_LEVEL, 0);
+  set->count = 0;
+}
+
+static void P_ClearDirtySet(dirtyset_t *set)
+{
+  while (set->count)
+    {
+      const int i = set->list[--set->count];
+      set->bits[i >> 5] &= ~(1u << (i & 31));
+    }
+}
+
+static void P_MarkDirty(dirtyset_t *set, int i)
+{
+  const unsigned bit = 1u << (i & 31);
+
+  if (set->bits && !(set->bits[i >> 5] & bit))
+    {
+      set->bits[i >> 5] |= bit;
+      set->list[set->count++] = i;
+    }
+}
+
+//
+// P_InitWorldDirty
+// Called by P_SetupLevel once the map is loaded. Drops any base.
+//
+void P_InitWorldDirty(void)
+{
+  P_InitDirtySet(&dirtysectors, numsectors);
+  P_InitDirtySet(&dirtylines, numlines);
+  P_InitDirtySet(&dirtysides, numsides);
+  P_InitDirtySet(&soundsectors, numsectors);
+  lineoffset = slotoffset = slotnext = sideslot = NULL;
+  dirtymobjs = NULL;
+  removedmobjs = NULL;
+  numdirtymobjs = maxdirtymobjs = numremovedmobjs = maxremovedmobjs = 0;
+  worldbase = false;
+}
+
+void P_MarkSectorDirty(const sector_t *sec)
+{
+  P_MarkDirty(&dirtysectors, sec - sectors);
+}
+
+void P_MarkLineDirty(const line_t *line)
+{
+  P_MarkDirty(&dirtylines, line - lines);
+}
+
+void P_MarkSideDirty(const side_t *side)
+{
+  P_MarkDirty(&dirtysides, side - sides);
+}
+
+void P_MarkSoundTarget(const sector_t *sec)
+{
+  P_MarkDirty(&soundsectors, sec - sectors);
+}
+
+boolean P_WorldBaseValid(void)
+{
+  return worldbase;
+}
+
+//
+// P_MarkWorldBase
+// The world just archived becomes the base later deltas patch. The record
+// offsets only depend on the map, so they are worked out once per level.
+//
+void P_MarkWorldBase(void)
+{
+  if (!lineoffset)
+    {
+      int i, offset = SECTOR_RECORD * numsectors;
+
+      lineoffset = Z_Malloc((numlines + 1) * sizeof *lineoffset, PU_LEVEL, 0);
+      slotoffset = Z_Malloc((2*numlines + 1) * sizeof *slotoffset, PU_LEVEL, 0);
+      slotnext = Z_Malloc((2*numlines + 1) * sizeof *slotnext, PU_LEVEL, 0);
+      sideslot = Z_Malloc((numsides + 1) * sizeof *sideslot, PU_LEVEL, 0);
+      memset(sideslot, -1, (numsides + 1) * sizeof *sideslot);
+
+      for (i = 0; i < numlines; i++)
+        {
+          int j;
+
+          lineoffset[i] = offset;
+          offset += LINE_RECORD;
+          for (j = 0; j < 2; j++)
+            if (lines[i].sidenum[j] != NO_INDEX)
+              {
+                const int side = lines[i].sidenum[j];
+
+                slotoffset[i*2+j] = offset;
+                slotnext[i*2+j] = sideslot[side];
+                sideslot[side] = i*2+j;
+                offset += SIDE_RECORD;
+              }
+        }
+    }
+
+  P_ClearDirtySet(&dirtysectors);
+  P_ClearDirtySet(&dirtylines);
+  P_ClearDirtySet(&dirtysides);
+  while (numdirtymobjs)
+    dirtymobjs[--numdirtymobjs]->intflags &= ~MIF_DIRTY;
+  numremovedmobjs = 0;
+  baseserial = mobjserial + 1;
+  worldbase = true;
+}
+
+static void P_WritePatch(int offset, const short *rec, const short *end)
+{
+  const int length = (const char *) end - (const char *) rec;
+
+  memcpy(save_p, &offset, sizeof offset);
+  save_p += sizeof offset;
+  memcpy(save_p, &length, sizeof length);
+  save_p += sizeof length;
+  memcpy(save_p, rec, length);
+  save_p += length;
+}
+
+//
+// P_ArchiveWorldDelta
+// Writes every record changed since the base as an (offset, length, bytes)
+// patch against the base's archived world, preceded by the patch count.
+//
+void P_ArchiveWorldDelta(void)
+{
+  short rec[(LINE_RECORD + 2*SIDE_RECORD) / sizeof(short)];
+  int   count = dirtysectors.count + dirtylines.count;
+  int   i, slot;
+
+  for (i = 0; i < dirtysides.count; i++)
+    for (slot = sideslot[dirtysides.list[i]]; slot != -1; slot = slotnext[slot])
+      count++;
+
+  CheckSaveGame(sizeof count + count * 2*sizeof(int) +
+                dirtysectors.count * SECTOR_RECORD +
+                (dirtylines.count + dirtysides.count) * sizeof rec +
+                (count - dirtysectors.count - dirtylines.count) * SIDE_RECORD);
+
+  memcpy(save_p, &count, sizeof count);
+  save_p += sizeof count;
+
+  for (i = 0; i < dirtysectors.count; i++)
+    {
+      const int sec = dirtysectors.list[i];
+      P_WritePatch(sec * SECTOR_RECORD, rec, P_ArchiveSector(rec, &sectors[sec]));
+    }
+
+  for (i = 0; i < dirtylines.count; i++)
+    {
+      const int line = dirtylines.list[i];
+      P_WritePatch(lineoffset[line], rec, P_ArchiveLine(rec, &lines[line]));
+    }
+
+  for (i = 0; i < dirtysides.count; i++)
+    {
+      const int side = dirtysides.list[i];
+      const short *end = P_ArchiveSide(rec, &sides[side]);
+
+      for (slot = sideslot[side]; slot != -1; slot = slotnext[slot])
+        P_WritePatch(slotoffset[slot], rec, end);
+    }
+}
+
+//
+// P_PatchWorld
+// Applies the patches P_ArchiveWorldDelta wrote to a copy of the base's
+// archived world. Returns the end of the patches, or NULL if they do not
+// fit the world.
+//
+const byte *P_PatchWorld(byte *world, size_t length,
+                         const byte *delta, const byte *end)
+{
+  int count;
+
+  if ((size_t)(end - delta) < sizeof count)
+    return NULL;
+  memcpy(&count, delta, sizeof count);
+  delta += sizeof count;
+
+  while (count-- > 0)
+    {
+      int offset, size;
+
+      if ((size_t)(end - delta) < sizeof offset + sizeof size)
+        return NULL;
+      memcpy(&offset, delta, sizeof offset);
+      delta += sizeof offset;
+      memcpy(&size, delta, sizeof size);
+      delta += sizeof size;
+      if (offset < 0 || size < 0 || (size_t) offset + size > length ||
+          end - delta < size)
+        return NULL;
+      memcpy(world + offset, delta, size);
+      delta += size;
+    }
+  return delta;
 }
 
 //
@@ -288,11 +545,85 @@ void P_IndexToThinker(void)
   }
 
 //
-// P_ArchiveThinkers
+// P_ArchiveMobjs
 //
 // 2/14/98 killough: substantially modified to fix savegame bugs
 
-void P_ArchiveThinkers (void)
+/* cph 2006/07/30 -
+ * The end of mobj_t changed from
+ *  boolean invisible;
+ *  mobj_t* lastenemy;
+ *  mobj_t* above_monster;
+ *  mobj_t* below_monster;
+ *  void* touching_sectorlist;
+ * to
+ *  mobj_t* lastenemy;
+ *  void* touching_sectorlist;
+ *  fixed_t PrevX, PrevY, PrevZ, padding;
+ * at prboom 2.4.4. There is code here to preserve the savegame format.
+ *
+ * touching_sectorlist is reconstructed anyway, so we now leave off the
+ * last 2 words of mobj_t, write 5 words of 0 and then write lastenemy
+ * into the second of these. The mobj's serial goes in the third.
+ */
+#define MOBJ_HEAD   (sizeof(mobj_t) - 2*sizeof(void*) - 4*sizeof(fixed_t))
+#define MOBJ_RECORD (MOBJ_HEAD + 5*sizeof(void*))
+#define MOBJ_LASTENEMY (MOBJ_HEAD + sizeof(void*))
+#define MOBJ_SERIAL    (MOBJ_HEAD + 2*sizeof(void*))
+
+// Pointers to mobjs are saved as the index P_ThinkerToIndex gave the mobj,
+// or as its serial in snapshot deltas, and as NULL if the thinker pointed
+// to is not a mobj any more.
+static boolean mobjserials;
+
+static mobj_t *P_MobjIndex(const mobj_t *mo)
+{
+  if (!mo || mo->thinker.function != P_MobjThinker)
+    return NULL;
+  return mobjserials ? (mobj_t *)(size_t) mo->serial : (mobj_t *) mo->thinker.prev;
+}
+
+static void P_WriteMobj(const mobj_t *th)
+{
+  mobj_t *mobj = (mobj_t *)save_p, *lastenemy;
+
+  memcpy (mobj, th, MOBJ_HEAD);
+  mobj->state = (state_t *)(mobj->state - states);
+
+  // killough 2/14/98: convert pointers into indices.
+  // Fixes many savegame problems, by properly saving
+  // target and tracer fields. Note: we store NULL if
+  // the thinker pointed to by these fields is not a
+  // mobj thinker.
+
+  mobj->target = P_MobjIndex(th->target);
+  mobj->tracer = P_MobjIndex(th->tracer);
+  if (mobj->player)
+    mobj->player = (player_t *)((mobj->player-players) + 1);
+
+  // Links, counts and flags that are rebuilt on loading, so that an
+  // unchanged mobj saves the same bytes however the others moved.
+  memset(&mobj->thinker, 0, sizeof mobj->thinker);
+  mobj->snext = mobj->bnext = NULL;
+  mobj->sprev = mobj->bprev = NULL;
+  mobj->subsector = NULL;
+  mobj->info = NULL;
+  mobj->validcount = 0;
+  mobj->lastenemy = NULL;
+  mobj->intflags &= ~MIF_DIRTY;
+
+  // killough 2/14/98: new field: save last known enemy. Prevents
+  // monsters from going to sleep after killing monsters and not
+  // seeing player anymore.
+
+  memset (save_p + MOBJ_HEAD, 0, 5*sizeof(void*));
+  lastenemy = P_MobjIndex(th->lastenemy);
+  memcpy (save_p + MOBJ_LASTENEMY, &lastenemy, sizeof lastenemy);
+  memcpy (save_p + MOBJ_SERIAL, &th->serial, sizeof th->serial);
+  save_p += MOBJ_RECORD;
+}
+
+static void P_ArchiveMobjs (void)
 {
   thinker_t *th;
 
@@ -314,67 +645,22 @@ void P_ArchiveThinkers (void)
   for (th = thinkercap.next ; th != &thinkercap ; th=th->next)
     if (th->function == P_MobjThinker)
       {
-        mobj_t *mobj;
-
         *save_p++ = tc_mobj;
         PADSAVEP();
-        mobj = (mobj_t *)save_p;
-	/* cph 2006/07/30 - 
-	 * The end of mobj_t changed from
-	 *  boolean invisible;
-	 *  mobj_t* lastenemy;
-	 *  mobj_t* above_monster;
-	 *  mobj_t* below_monster;
-	 *  void* touching_sectorlist;
-	 * to
-	 *  mobj_t* lastenemy;
-	 *  void* touching_sectorlist;
-         *  fixed_t PrevX, PrevY, PrevZ, padding;
-	 * at prboom 2.4.4. There is code here to preserve the savegame format.
-	 *
-	 * touching_sectorlist is reconstructed anyway, so we now leave off the
-	 * last 2 words of mobj_t, write 5 words of 0 and then write lastenemy
-	 * into the second of these.
-	 */
-        memcpy (mobj, th, sizeof(*mobj) - 2*sizeof(void*));
-        save_p += sizeof(*mobj) - 2*sizeof(void*) - 4*sizeof(fixed_t);
-        memset (save_p, 0, 5*sizeof(void*));
-        mobj->state = (state_t *)(mobj->state - states);
-
-        // killough 2/14/98: convert pointers into indices.
-        // Fixes many savegame problems, by properly saving
-        // target and tracer fields. Note: we store NULL if
-        // the thinker pointed to by these fields is not a
-        // mobj thinker.
-
-        if (mobj->target)
-          mobj->target = mobj->target->thinker.function ==
-            P_MobjThinker ?
-            (mobj_t *) mobj->target->thinker.prev : NULL;
-
-        if (mobj->tracer)
-          mobj->tracer = mobj->tracer->thinker.function ==
-            P_MobjThinker ?
-            (mobj_t *) mobj->tracer->thinker.prev : NULL;
-
-        // killough 2/14/98: new field: save last known enemy. Prevents
-        // monsters from going to sleep after killing monsters and not
-        // seeing player anymore.
-
-        if (((mobj_t*)th)->lastenemy && ((mobj_t*)th)->lastenemy->thinker.function == P_MobjThinker) {
-          memcpy (save_p + sizeof(void*), &(((mobj_t*)th)->lastenemy->thinker.prev), sizeof(void*));
-	}
-
-        // killough 2/14/98: end changes
-
-        save_p += 5*sizeof(void*);
-
-        if (mobj->player)
-          mobj->player = (player_t *)((mobj->player-players) + 1);
+        P_WriteMobj((mobj_t *) th);
       }
 
   // add a terminating marker
   *save_p++ = tc_end;
+}
+
+//
+// P_ArchiveThinkers
+//
+
+void P_ArchiveThinkers (void)
+{
+  P_ArchiveMobjs();
 
   // killough 9/14/98: save soundtargets
   {
@@ -382,19 +668,341 @@ void P_ArchiveThinkers (void)
     CheckSaveGame(numsectors * sizeof(mobj_t *));       // killough 9/14/98
     for (i = 0; i < numsectors; i++)
     {
-      mobj_t *target = sectors[i].soundtarget;
       // Fix crash on reload when a soundtarget points to a removed corpse
       // (prboom bug #1590350)
-      if (target && target->thinker.function == P_MobjThinker)
-        target = (mobj_t *) target->thinker.prev;
-      else
-        target = NULL;
+      mobj_t *target = P_MobjIndex(sectors[i].soundtarget);
       memcpy(save_p, &target, sizeof target);
       save_p += sizeof target;
     }
   }
 }
 
+//
+// Mobjs in snapshots
+//
+
+void P_MarkMobjDirty(mobj_t *mo)
+{
+  if (worldbase && !(mo->intflags & MIF_DIRTY))
+    {
+      if (numdirtymobjs == maxdirtymobjs)
+        dirtymobjs = Z_Realloc(dirtymobjs, (maxdirtymobjs = maxdirtymobjs ?
+                               maxdirtymobjs*2 : 256) * sizeof *dirtymobjs, PU_LEVEL, 0);
+      mo->intflags |= MIF_DIRTY;
+      dirtymobjs[numdirtymobjs++] = mo;
+    }
+}
+
+// P_SpawnMobj gives every mobj a serial; one spawned since the base is
+// written whole by every snapshot.
+void P_MarkMobjSpawned(mobj_t *mo)
+{
+  mo->serial = ++mobjserial;
+  P_MarkMobjDirty(mo);
+}
+
+// Called by P_RemoveMobj. The mobj's memory may be reused before the next
+// snapshot, so it comes off the dirty list; the most recently spawned are
+// removed most, and are at the end.
+void P_MarkMobjRemoved(mobj_t *mo)
+{
+  if (!worldbase)
+    return;
+  if (mo->intflags & MIF_DIRTY)
+    {
+      int i = numdirtymobjs;
+
+      while (dirtymobjs[--i] != mo)
+        ;
+      dirtymobjs[i] = dirtymobjs[--numdirtymobjs];
+      mo->intflags &= ~MIF_DIRTY;
+    }
+  if (mo->serial < baseserial)
+    {
+      if (numremovedmobjs == maxremovedmobjs)
+        removedmobjs = Z_Realloc(removedmobjs, (maxremovedmobjs = maxremovedmobjs ?
+                                 maxremovedmobjs*2 : 64) * sizeof *removedmobjs, PU_LEVEL, 0);
+      removedmobjs[numremovedmobjs++] = mo->serial;
+    }
+}
+
+int P_DirtyMobjs(void)
+{
+  return numdirtymobjs;
+}
+
+//
+// P_ArchiveMobjDelta
+//
+// Writes the mobjs as changed since the base: the boss brain, the serials
+// of the base's mobjs removed since, and each dirty mobj as its serial and
+// its record, pointers saved as serials. Then the soundtargets, as serials,
+// of the few sectors that have one.
+//
+
+void P_ArchiveMobjDelta (void)
+{
+  int i, count = 0;
+
+  CheckSaveGame(sizeof brain + 2*sizeof(int) + numremovedmobjs*sizeof(int) +
+                numdirtymobjs*(sizeof(int) + MOBJ_RECORD));
+  memcpy(save_p, &brain, sizeof brain);
+  save_p += sizeof brain;
+  memcpy(save_p, &numremovedmobjs, sizeof numremovedmobjs);
+  save_p += sizeof numremovedmobjs;
+  memcpy(save_p, removedmobjs, numremovedmobjs*sizeof(int));
+  save_p += numremovedmobjs*sizeof(int);
+  memcpy(save_p, &numdirtymobjs, sizeof numdirtymobjs);
+  save_p += sizeof numdirtymobjs;
+
+  mobjserials = true;
+  for (i = 0; i < numdirtymobjs; i++)
+    {
+      memcpy(save_p, &dirtymobjs[i]->serial, sizeof(int));
+      save_p += sizeof(int);
+      P_WriteMobj(dirtymobjs[i]);
+    }
+
+  CheckSaveGame(2*sizeof(int) + soundsectors.count * 2*sizeof(int));
+  memcpy(save_p, &numsectors, sizeof numsectors);
+  save_p += sizeof numsectors;
+  for (i = 0; i < soundsectors.count; i++)
+    if (P_MobjIndex(sectors[soundsectors.list[i]].soundtarget))
+      count++;
+  memcpy(save_p, &count, sizeof count);
+  save_p += sizeof count;
+
+  for (i = 0; i < soundsectors.count; i++)
+    {
+      const int sec = soundsectors.list[i];
+      const int serial = (int)(size_t) P_MobjIndex(sectors[sec].soundtarget);
+
+      if (serial)
+        {
+          memcpy(save_p, &sec, sizeof sec);
+          save_p += sizeof sec;
+          memcpy(save_p, &serial, sizeof serial);
+          save_p += sizeof serial;
+        }
+    }
+  mobjserials = false;
+}
+
+//
+// P_PatchMobjs
+//
+// Writes at save_p the mobjs and soundtargets P_ArchiveThinkers would have
+// saved, from the base's (starting with the boss brain) and a delta from
+// P_ArchiveMobjDelta. The base's mobjs keep their order, less the removed
+// ones, and those spawned since follow in the order of their serials, as
+// P_AddThinker put them. Returns the end of the delta, or NULL if either
+// is corrupt.
+//
+
+typedef struct {
+  int        serial;
+  int        index;   // in the savegame being rebuilt, from 1
+  const byte *record; // the delta's, or NULL
+} mobjpatch_t;
+
+static int P_CompareMobjPatches(const void *a, const void *b)
+{
+  const int x = ((const mobjpatch_t *) a)->serial;
+  const int y = ((const mobjpatch_t *) b)->serial;
+  return x < y ? -1 : x > y;
+}
+
+static mobjpatch_t *P_FindMobjPatch(mobjpatch_t *patches, int count, int serial)
+{
+  mobjpatch_t key;
+
+  key.serial = serial;
+  return bsearch(&key, patches, count, sizeof key, P_CompareMobjPatches);
+}
+
+static int P_CompareSerials(const void *a, const void *b)
+{
+  const int x = *(const int *) a, y = *(const int *) b;
+  return x < y ? -1 : x > y;
+}
+
+// The index saved in place of a pointer in a base record or, as a serial,
+// in a delta record, turned into the index in the savegame being rebuilt.
+static mobj_t *P_PatchMobjIndex(mobj_t *saved, const int *baseserials, int numbase,
+                                mobjpatch_t *index, int count)
+{
+  int serial = (int)(size_t) saved;
+  mobjpatch_t *p;
+
+  if (baseserials)
+    {
+      if (serial < 0 || serial > numbase)
+        return (mobj_t *) -1;
+      serial = serial ? baseserials[serial-1] : 0;
+    }
+  p = serial ? P_FindMobjPatch(index, count, serial) : NULL;
+  return (mobj_t *)(size_t)(p ? p->index : 0);
+}
+
+static boolean P_PatchMobj(const byte *record, const int *baseserials, int numbase,
+                           mobjpatch_t *index, int count)
+{
+  mobj_t *mobj, *lastenemy;
+
+  *save_p++ = tc_mobj;
+  PADSAVEP();
+  mobj = (mobj_t *) save_p;
+  memcpy(save_p, record, MOBJ_RECORD);
+  memcpy(&lastenemy, save_p + MOBJ_LASTENEMY, sizeof lastenemy);
+  mobj->target = P_PatchMobjIndex(mobj->target, baseserials, numbase, index, count);
+  mobj->tracer = P_PatchMobjIndex(mobj->tracer, baseserials, numbase, index, count);
+  lastenemy = P_PatchMobjIndex(lastenemy, baseserials, numbase, index, count);
+  memcpy(save_p + MOBJ_LASTENEMY, &lastenemy, sizeof lastenemy);
+  save_p += MOBJ_RECORD;
+  return mobj->target != (mobj_t *) -1 && mobj->tracer != (mobj_t *) -1 &&
+    lastenemy != (mobj_t *) -1;
+}
+
+const byte *P_PatchMobjs (const byte *base, const byte *baseend,
+                          const byte *delta, const byte *end)
+{
+  const byte **baserecords, *p, *ret = NULL;
+  int *baseserials, *removed = NULL;
+  mobjpatch_t *patches = NULL, *order = NULL, *byserial = NULL;
+  int numbase = 0, numremoved, numpatches, count = 0, sectorcount, targets, i, b;
+
+  // the base's records, and the serials saved in them
+  if ((size_t)(baseend - base) < sizeof brain)
+    return NULL;
+  for (p = base + sizeof brain; p < baseend && *p == tc_mobj; numbase++)
+    {
+      p++;
+      p += (4 - ((size_t) p & 3)) & 3;  // as PADSAVEP did
+      p += MOBJ_RECORD;
+    }
+  if (p >= baseend || *p != tc_end)
+    return NULL;
+  baserecords = malloc(numbase * sizeof *baserecords + 1);
+  baseserials = malloc(numbase * sizeof *baseserials + 1);
+  for (i = 0, p = base + sizeof brain; i < numbase; i++)
+    {
+      p++;
+      p += (4 - ((size_t) p & 3)) & 3;
+      baserecords[i] = p;
+      memcpy(&baseserials[i], p + MOBJ_SERIAL, sizeof(int));
+      p += MOBJ_RECORD;
+    }
+
+  // the delta's removed serials and records
+  if ((size_t)(end - delta) < sizeof brain + 2*sizeof(int))
+    goto done;
+  p = delta + sizeof brain;
+  memcpy(&numremoved, p, sizeof numremoved);
+  p += sizeof numremoved;
+  if (numremoved < 0 || (size_t)(end - p) < (numremoved + 1)*sizeof(int))
+    goto done;
+  removed = malloc(numremoved * sizeof *removed + 1);
+  memcpy(removed, p, numremoved * sizeof *removed);
+  p += numremoved * sizeof *removed;
+  qsort(removed, numremoved, sizeof *removed, P_CompareSerials);
+
+  memcpy(&numpatches, p, sizeof numpatches);
+  p += sizeof numpatches;
+  if (numpatches < 0 || (size_t)(end - p) / (sizeof(int) + MOBJ_RECORD) < (size_t) numpatches)
+    goto done;
+  patches = malloc(numpatches * sizeof *patches + 1);
+  for (i = 0; i < numpatches; i++)
+    {
+      memcpy(&patches[i].serial, p, sizeof(int));
+      patches[i].index = 0;
+      patches[i].record = p + sizeof(int);
+      p += sizeof(int) + MOBJ_RECORD;
+    }
+  qsort(patches, numpatches, sizeof *patches, P_CompareMobjPatches);
+
+  // where each mobj ends up: the base's in their order, then the new ones
+  order = malloc((numbase + numpatches) * sizeof *order + 1);
+  for (i = 0; i < numbase; i++)
+    if (!bsearch(&baseserials[i], removed, numremoved, sizeof *removed, P_CompareSerials))
+      {
+        mobjpatch_t *patch = P_FindMobjPatch(patches, numpatches, baseserials[i]);
+
+        order[count].serial = baseserials[i];
+        order[count].record = patch ? patch->record : NULL;
+        order[count].index = count + 1;
+        count++;
+        if (patch)
+          patch->index = -1;  // not a new one
+      }
+  for (i = 0; i < numpatches; i++)
+    if (!patches[i].index)
+      {
+        order[count] = patches[i];
+        order[count].index = count + 1;
+        count++;
+      }
+  byserial = malloc(count * sizeof *byserial + 1);
+  memcpy(byserial, order, count * sizeof *byserial);
+  qsort(byserial, count, sizeof *byserial, P_CompareMobjPatches);
+
+  CheckSaveGame(sizeof brain + count*(MOBJ_RECORD+4) + 1);
+  memcpy(save_p, delta, sizeof brain);
+  save_p += sizeof brain;
+  for (i = b = 0; i < count; i++)
+    if (order[i].record)
+      {
+        if (!P_PatchMobj(order[i].record, NULL, 0, byserial, count))
+          goto done;
+      }
+    else
+      {
+        while (baseserials[b] != order[i].serial)
+          b++;
+        if (!P_PatchMobj(baserecords[b++], baseserials, numbase, byserial, count))
+          goto done;
+      }
+  *save_p++ = tc_end;
+
+  // the soundtargets, for every sector
+  if ((size_t)(end - p) < 2*sizeof(int))
+    goto done;
+  memcpy(&sectorcount, p, sizeof sectorcount);
+  p += sizeof sectorcount;
+  memcpy(&targets, p, sizeof targets);
+  p += sizeof targets;
+  if (sectorcount < 0 || targets < 0 ||
+      (size_t)(end - p) / (2*sizeof(int)) < (size_t) targets)
+    goto done;
+
+  CheckSaveGame(sectorcount * sizeof(mobj_t *));
+  memset(save_p, 0, sectorcount * sizeof(mobj_t *));
+  while (targets--)
+    {
+      int sec, serial;
+      mobj_t *target;
+
+      memcpy(&sec, p, sizeof sec);
+      p += sizeof sec;
+      memcpy(&serial, p, sizeof serial);
+      p += sizeof serial;
+      if (sec < 0 || sec >= sectorcount)
+        goto done;
+      target = P_PatchMobjIndex((mobj_t *)(size_t) serial, NULL, 0, byserial, count);
+      memcpy(save_p + sec * sizeof target, &target, sizeof target);
+    }
+  save_p += sectorcount * sizeof(mobj_t *);
+  ret = p;
+
+ done:
+  free(baserecords);
+  free(baseserials);
+  free(removed);
+  free(patches);
+  free(order);
+  free(byserial);
+  return ret;
+}
+
 /*
  * killough 11/98
  *
@@ -495,9 +1103,16 @@ void P_UnArchiveThinkers (void)
       memcpy (mobj, save_p, sizeof(mobj_t)-2*sizeof(void*)-4*sizeof(fixed_t));
       save_p += sizeof(mobj_t)-sizeof(void*)-4*sizeof(fixed_t);
       memcpy (&(mobj->lastenemy), save_p, sizeof(void*));
+      memcpy (&mobj->serial, save_p + sizeof(void*), sizeof mobj->serial);
       save_p += 4*sizeof(void*);
       mobj->state = states + (int) mobj->state;
 
+      // savegames from before serials have none
+      if (mobj->serial <= 0)
+        mobj->serial = ++mobjserial;
+      else if (mobj->serial > mobjserial)
+        mobjserial = mobj->serial;
+
       if (mobj->player)
         (mobj->player = &players[(int) mobj->player - 1]) -> mo = mobj;
 
@@ -543,6 +1158,8 @@ void P_UnArchiveThinkers (void)
       save_p += sizeof target;
       // Must verify soundtarget. See P_ArchiveThinkers.
       P_SetNewTarget(&sectors[i].soundtarget, mobj_p[P_GetMobj(target,size)]);
+      if (sectors[i].soundtarget)
+        P_MarkSoundTarget(&sectors[i]);
     }
   }
 
@@ -587,6 +1204,36 @@ enum {
 // T_FireFlicker                                            // killough 10/4/98
 //
 
+// Bytes P_ArchiveSpecials takes for a thinker, or 0 if it does not save it
+static size_t P_SpecialSize(thinker_t *th)
+{
+  if (!th->function)
+    {
+      platlist_t *pl;
+      ceilinglist_t *cl;     //jff 2/22/98 need this for ceilings too now
+      for (pl=activeplats; pl; pl=pl->next)
+        if (pl->plat == (plat_t *) th)   // killough 2/14/98
+          return 4+sizeof(plat_t);
+      for (cl=activeceilings; cl; cl=cl->next) // search for activeceiling
+        if (cl->ceiling == (ceiling_t *) th)   //jff 2/22/98
+          return 4+sizeof(ceiling_t);
+      return 0;
+    }
+  return
+    th->function==T_MoveCeiling  ? 4+sizeof(ceiling_t) :
+    th->function==T_VerticalDoor ? 4+sizeof(vldoor_t)  :
+    th->function==T_MoveFloor    ? 4+sizeof(floormove_t):
+    th->function==T_PlatRaise    ? 4+sizeof(plat_t)    :
+    th->function==T_LightFlash   ? 4+sizeof(lightflash_t):
+    th->function==T_StrobeFlash  ? 4+sizeof(strobe_t)  :
+    th->function==T_Glow         ? 4+sizeof(glow_t)    :
+    th->function==T_MoveElevator ? 4+sizeof(elevator_t):
+    th->function==T_Scroll       ? 4+sizeof(scroll_t)  :
+    th->function==T_Pusher       ? 4+sizeof(pusher_t)  :
+    th->function==T_FireFlicker? 4+sizeof(fireflicker_t) :
+  0;
+}
+
 void P_ArchiveSpecials (void)
 {
   thinker_t *th;
@@ -595,38 +1242,7 @@ void P_ArchiveSpecials (void)
   // save off the current thinkers (memory size calculation -- killough)
 
   for (th = thinkercap.next ; th != &thinkercap ; th=th->next)
-    if (!th->function)
-      {
-        platlist_t *pl;
-        ceilinglist_t *cl;     //jff 2/22/98 need this for ceilings too now
-        for (pl=activeplats; pl; pl=pl->next)
-          if (pl->plat == (plat_t *) th)   // killough 2/14/98
-            {
-              size += 4+sizeof(plat_t);
-              goto end;
-            }
-        for (cl=activeceilings; cl; cl=cl->next) // search for activeceiling
-          if (cl->ceiling == (ceiling_t *) th)   //jff 2/22/98
-            {
-              size += 4+sizeof(ceiling_t);
-              goto end;
-            }
-      end:;
-      }
-    else
-      size +=
-        th->function==T_MoveCeiling  ? 4+sizeof(ceiling_t) :
-        th->function==T_VerticalDoor ? 4+sizeof(vldoor_t)  :
-        th->function==T_MoveFloor    ? 4+sizeof(floormove_t):
-        th->function==T_PlatRaise    ? 4+sizeof(plat_t)    :
-        th->function==T_LightFlash   ? 4+sizeof(lightflash_t):
-        th->function==T_StrobeFlash  ? 4+sizeof(strobe_t)  :
-        th->function==T_Glow         ? 4+sizeof(glow_t)    :
-        th->function==T_MoveElevator ? 4+sizeof(elevator_t):
-        th->function==T_Scroll       ? 4+sizeof(scroll_t)  :
-        th->function==T_Pusher       ? 4+sizeof(pusher_t)  :
-        th->function==T_FireFlicker? 4+sizeof(fireflicker_t) :
-      0;
+    size += P_SpecialSize(th);
 
   CheckSaveGame(size + 1);    // killough; cph: +1 for the tc_endspecials
 
@@ -972,6 +1588,439 @@ void P_UnArchiveRNG(void)
   save_p += sizeof rng;
 }
 
+//
+// P_ArchiveThinkerOrder
+// A savegame brings the mobjs back ahead of the specials, which changes the
+// order thinkers run in, and relinks every list of thinkers and things in
+// the order it loads them. Where those lists are walked in order, as by
+// P_RadiusAttack, P_LookForMonsters or P_ChangeSector, something that draws
+// a random number for each thing would draw them for other things, so a
+// loaded game plays on differently. This saves the order of the thinkers,
+// of the thinker classes, of the blockmap and sector thing lists and of the
+// sectors' touching things, and the body queue, so that
+// P_UnArchiveThinkerOrder can put a loaded game back exactly as it was.
+//
+// Thinkers are saved as their place in the thinker list, from 1; only the
+// mobjs and the specials P_ArchiveSpecials saves are counted.
+//
+
+static void P_WriteOrderInt(int i)
+{
+  memcpy(save_p, &i, sizeof i);
+  save_p += sizeof i;
+}
+
+static int P_ReadOrderInt(void)
+{
+  int i;
+
+  memcpy(&i, save_p, sizeof i);
+  save_p += sizeof i;
+  return i;
+}
+
+// the place of a mobj in the thinker list, once P_ArchiveThinkerOrder has
+// kept it in the mobj's prev pointer
+#define THINKER_ORDINAL(mo) ((mo) ? (int)(size_t)(mo)->thinker.prev : 0)
+
+void P_ArchiveThinkerOrder(void)
+{
+  thinker_t *th;
+  int count = 0, nodes = 0, bodies, i;
+
+  for (th = thinkercap.next ; th != &thinkercap ; th=th->next)
+    {
+      count++;
+      if (th->function == P_MobjThinker)
+        {
+          msecnode_t *node;
+
+          for (node = ((mobj_t *) th)->touching_sectorlist; node; node = node->m_tnext)
+            nodes++;
+        }
+    }
+  bodies = bodyquesize > 0 ? MIN(bodyqueslot, bodyquesize) : 0;
+  CheckSaveGame(sizeof count + count + (NUMTHCLASS + 3*count + 2*nodes + 2 + bodies)
+                * sizeof(int));
+  save_p += sizeof count;
+  count = 0;
+  for (th = thinkercap.next ; th != &thinkercap ; th=th->next)
+    if (th->function == P_MobjThinker)
+      save_p[count++] = 1;
+    else if (P_SpecialSize(th))
+      save_p[count++] = 0;
+  memcpy(save_p - sizeof count, &count, sizeof count);
+  save_p += count;
+
+  // number the thinkers saved, leaving the others at 0
+  count = 0;
+  for (th = thinkercap.next ; th != &thinkercap ; th=th->next)
+    th->prev = (thinker_t *)(size_t)
+      (th->function == P_MobjThinker || P_SpecialSize(th) ? ++count : 0);
+
+  for (i = 0; i < NUMTHCLASS; i++)
+    {
+      byte *countp = save_p;
+      int n = 0;
+
+      save_p += sizeof n;
+      for (th = thinkerclasscap[i].cnext; th != &thinkerclasscap[i]; th = th->cnext)
+        if (th->prev)
+          {
+            P_WriteOrderInt((int)(size_t) th->prev);
+            n++;
+          }
+      memcpy(countp, &n, sizeof n);
+    }
+
+  for (th = thinkercap.next ; th != &thinkercap ; th=th->next)
+    if (th->function == P_MobjThinker)
+      {
+        mobj_t *mo = (mobj_t *) th;
+        msecnode_t *node;
+        int n = 0;
+
+        P_WriteOrderInt(THINKER_ORDINAL(mo->bnext));
+        P_WriteOrderInt(THINKER_ORDINAL(mo->snext));
+        for (node = mo->touching_sectorlist; node; node = node->m_tnext)
+          n++;
+        P_WriteOrderInt(n);
+        for (node = mo->touching_sectorlist; node; node = node->m_tnext)
+          {
+            P_WriteOrderInt(node->m_sector - sectors);
+            P_WriteOrderInt(node->m_snext ? THINKER_ORDINAL(node->m_snext->m_thing) : 0);
+          }
+      }
+
+  P_WriteOrderInt(bodyqueslot);
+  P_WriteOrderInt(bodies);
+  for (i = 0; i < bodies; i++)
+    P_WriteOrderInt(THINKER_ORDINAL(bodyque[i]));
+
+  P_IndexToThinker();
+}
+
+// Relinks the thinker classes as saved, if the thinkers are the same.
+static void P_RelinkThinkerClasses(thinker_t **thinkers, int count, int **classes,
+                                   const int *classcount)
+{
+  byte *seen = calloc(count + 1, 1);
+  int i, j, total = 0;
+
+  for (i = 0; i < NUMTHCLASS; i++)
+    for (j = 0; j < classcount[i]; j++, total++)
+      if (classes[i][j] < 1 || classes[i][j] > count || seen[classes[i][j]]++)
+        goto done;
+  if (total != count)
+    goto done;
+
+  for (i = 0; i < NUMTHCLASS; i++)
+    {
+      thinker_t *cap = &thinkerclasscap[i], *prev = cap;
+
+      for (j = 0; j < classcount[i]; j++)
+        {
+          thinker_t *th = thinkers[classes[i][j]];
+
+          prev->cnext = th;
+          th->cprev = prev;
+          prev = th;
+        }
+      prev->cnext = cap;
+      cap->cprev = prev;
+    }
+
+ done:
+  free(seen);
+}
+
+static mobj_t **P_ThingNext(mobj_t *mo, boolean blocks)
+{
+  return blocks ? &mo->bnext : &mo->snext;
+}
+
+static mobj_t ***P_ThingPrev(mobj_t *mo, boolean blocks)
+{
+  return blocks ? &mo->bprev : &mo->sprev;
+}
+
+//
+// P_RelinkThings
+// Relinks the blockmap thing lists, or the sectors' ones, with each mobj
+// followed by the thinker numbered next[] for it. Does nothing unless each
+// list keeps the things it was loaded with.
+//
+static void P_RelinkThings(thinker_t **thinkers, int count, const int *next, boolean blocks)
+{
+  mobj_t ***slot = calloc(count + 1, sizeof *slot);
+  byte *linked = calloc(count + 1, 1);
+  const int numlists = blocks ? bmapwidth*bmapheight : numsectors;
+  int lists = 0, things = 0, heads = 0, walked = 0, i, j;
+
+  // the list each mobj was loaded into
+  for (i = 0; i < numlists; i++)
+    {
+      mobj_t **list = blocks ? &blocklinks[i] : &sectors[i].thinglist;
+      mobj_t *mo;
+
+      lists += *list != NULL;
+      for (mo = *list; mo; mo = *P_ThingNext(mo, blocks))
+        {
+          slot[THINKER_ORDINAL(mo)] = list;
+          things++;
+        }
+    }
+
+  for (i = 1; i <= count; i++)
+    if (next[i] && (next[i] < 1 || next[i] > count || !slot[i] ||
+                    slot[next[i]] != slot[i] || linked[next[i]]++))
+      goto done;
+  for (i = 1; i <= count; i++)
+    if (slot[i] && !linked[i])
+      for (heads++, j = i; j && walked <= things; j = next[j])
+        walked++;
+  if (heads != lists || walked != things)
+    goto done;
+
+  for (i = 1; i <= count; i++)
+    if (slot[i] && !linked[i])
+      {
+        mobj_t **link = slot[i];
+
+        for (j = i; j; j = next[j])
+          {
+            mobj_t *mo = (mobj_t *) thinkers[j];
+
+            *link = mo;
+            *P_ThingPrev(mo, blocks) = link;
+            link = P_ThingNext(mo, blocks);
+          }
+        *link = NULL;
+      }
+
+ done:
+  free(slot);
+  free(linked);
+}
+
+//
+// P_RelinkSecnodes
+// Relinks each mobj's sector nodes, and the sectors' lists of the things
+// touching them, in the order saved: for node k, its sector and the thinker
+// following it in that sector's list. first[] is each thinker's first node
+// and first[count+1] the end of the last's. Does nothing unless every mobj
+// touches the sectors it touched when saved.
+//
+static void P_RelinkSecnodes(thinker_t **thinkers, int count, const int *first,
+                             const int *nodesector, const int *nodenext)
+{
+  const int numnodes = first[count+1];
+  msecnode_t **nodes = calloc(numnodes + 1, sizeof *nodes);
+  int *next = calloc(numnodes + 1, sizeof *next);
+  byte *linked = calloc(numnodes + 1, 1);
+  int lists = 0, heads = 0, walked = 0, i, j, k;
+
+  // the node of each saved one, and the one that followed it
+  for (i = 1; i <= count; i++)
+    {
+      msecnode_t *node;
+      int n = 0;
+
+      if (first[i] == first[i+1])
+        continue;
+      if (thinkers[i]->function != P_MobjThinker)
+        goto done;
+      for (node = ((mobj_t *) thinkers[i])->touching_sectorlist; node; node = node->m_tnext)
+        {
+          for (k = first[i]; k < first[i+1]; k++)
+            if (node->m_sector == sectors + nodesector[k])
+              break;
+          if (k == first[i+1] || nodes[k])
+            goto done;
+          nodes[k] = node;
+          n++;
+        }
+      if (n != first[i+1] - first[i])
+        goto done;
+    }
+  for (i = 1; i <= count; i++)
+    if (thinkers[i]->function == P_MobjThinker && first[i] == first[i+1] &&
+        ((mobj_t *) thinkers[i])->touching_sectorlist)
+      goto done;
+  for (k = 0; k < numnodes; k++)
+    {
+      const int t = nodenext[k];
+
+      next[k] = -1;
+      if (!t)
+        continue;
+      if (t < 1 || t > count)
+        goto done;
+      for (j = first[t]; j < first[t+1]; j++)
+        if (nodesector[j] == nodesector[k])
+          break;
+      if (j == first[t+1] || linked[j]++)
+        goto done;
+      next[k] = j;
+    }
+  for (i = 0; i < numsectors; i++)
+    lists += sectors[i].touching_thinglist != NULL;
+  for (k = 0; k < numnodes; k++)
+    if (!linked[k])
+      for (heads++, j = k; j >= 0 && walked <= numnodes; j = next[j])
+        walked++;
+  if (heads != lists || walked != numnodes)
+    goto done;
+
+  for (i = 1; i <= count; i++)
+    if (first[i] < first[i+1])
+      {
+        msecnode_t *prev = NULL;
+
+        for (k = first[i]; k < first[i+1]; k++)
+          {
+            nodes[k]->m_tprev = prev;
+            if (prev)
+              prev->m_tnext = nodes[k];
+            else
+              ((mobj_t *) thinkers[i])->touching_sectorlist = nodes[k];
+            prev = nodes[k];
+          }
+        prev->m_tnext = NULL;
+      }
+  for (k = 0; k < numnodes; k++)
+    if (!linked[k])
+      {
+        msecnode_t *prev = NULL;
+
+        for (j = k; j >= 0; j = next[j])
+          {
+            nodes[j]->m_sprev = prev;
+            if (prev)
+              prev->m_snext = nodes[j];
+            else
+              nodes[j]->m_sector->touching_thinglist = nodes[j];
+            prev = nodes[j];
+          }
+        prev->m_snext = NULL;
+      }
+
+ done:
+  free(nodes);
+  free(next);
+  free(linked);
+}
+
+//
+// P_UnArchiveThinkerOrder
+// Relinks the thinkers of a game just loaded, and the lists above, in the
+// order saved by P_ArchiveThinkerOrder. Does nothing if the saved thinkers
+// do not fit the thinkers loaded, and leaves any list that does not fit
+// the way it was loaded.
+//
+void P_UnArchiveThinkerOrder(void)
+{
+  thinker_t *th, *prev, **mobjs, **specials, **thinkers;
+  int *classes[NUMTHCLASS], classcount[NUMTHCLASS];
+  int *bnext, *snext, *first, *nodesector = NULL, *nodenext = NULL;
+  int count, nummobjs = 0, numspecials = 0, numnodes = 0, m = 0, n = 0, i, j;
+
+  memcpy(&count, save_p, sizeof count);
+  save_p += sizeof count;
+
+  for (th = thinkercap.next ; th != &thinkercap ; th=th->next)
+    if (th->function == P_MobjThinker)
+      nummobjs++;
+    else
+      numspecials++;
+  for (i = 0; i < count; i++)
+    m += save_p[i];
+  if (m != nummobjs || count - m != numspecials)
+    return;  // nothing after this can be matched up
+
+  mobjs = malloc((count + 1) * sizeof *mobjs);
+  specials = mobjs + nummobjs;
+  m = 0;
+  for (th = thinkercap.next ; th != &thinkercap ; th=th->next)
+    if (th->function == P_MobjThinker)
+      mobjs[m++] = th;
+    else
+      specials[n++] = th;
+
+  thinkers = malloc((count + 2) * sizeof *thinkers);
+  prev = &thinkercap;
+  m = n = 0;
+  for (i = 0; i < count; i++)
+    {
+      th = *save_p++ ? mobjs[m++] : specials[n++];
+      prev->next = th;
+      th->prev = prev;
+      prev = th;
+      thinkers[i+1] = th;
+    }
+  prev->next = &thinkercap;
+  thinkercap.prev = prev;
+  free(mobjs);
+
+  for (i = 0; i < NUMTHCLASS; i++)
+    {
+      classcount[i] = P_ReadOrderInt();
+      classes[i] = malloc(classcount[i] * sizeof *classes[i] + 1);
+      memcpy(classes[i], save_p, classcount[i] * sizeof *classes[i]);
+      save_p += classcount[i] * sizeof *classes[i];
+    }
+
+  bnext = calloc(count + 1, sizeof *bnext);
+  snext = calloc(count + 1, sizeof *snext);
+  first = calloc(count + 2, sizeof *first);
+  for (i = 1; i <= count; i++)
+    {
+      first[i] = numnodes;
+      if (thinkers[i]->function != P_MobjThinker)
+        continue;
+      bnext[i] = P_ReadOrderInt();
+      snext[i] = P_ReadOrderInt();
+      n = P_ReadOrderInt();
+      nodesector = realloc(nodesector, (numnodes + n + 1) * sizeof *nodesector);
+      nodenext = realloc(nodenext, (numnodes + n + 1) * sizeof *nodenext);
+      for (j = 0; j < n; j++, numnodes++)
+        {
+          nodesector[numnodes] = P_ReadOrderInt();
+          nodenext[numnodes] = P_ReadOrderInt();
+          if (nodesector[numnodes] < 0 || nodesector[numnodes] >= numsectors)
+            nodesector[numnodes] = 0, nodenext[numnodes] = -1;  // fails below
+        }
+    }
+  first[count+1] = numnodes;
+
+  // number the thinkers for P_RelinkThings
+  for (i = 1; i <= count; i++)
+    thinkers[i]->prev = (thinker_t *)(size_t) i;
+  P_RelinkThings(thinkers, count, bnext, true);
+  P_RelinkThings(thinkers, count, snext, false);
+  P_IndexToThinker();
+  P_RelinkSecnodes(thinkers, count, first, nodesector, nodenext);
+  P_RelinkThinkerClasses(thinkers, count, classes, classcount);
+
+  bodyqueslot = P_ReadOrderInt();
+  n = P_ReadOrderInt();
+  for (i = 0; i < n; i++)
+    {
+      j = P_ReadOrderInt();
+      bodyque[i] = j >= 1 && j <= count && thinkers[j]->function == P_MobjThinker ?
+        (mobj_t *) thinkers[j] : NULL;
+    }
+
+  for (i = 0; i < NUMTHCLASS; i++)
+    free(classes[i]);
+  free(bnext);
+  free(snext);
+  free(first);
+  free(nodesector);
+  free(nodenext);
+  free(thinkers);
+}
+
 // killough 2/22/98: Save/restore automap state
 // killough 2/22/98: Save/restore automap state
 void P_ArchiveMap(void)
@@ -38,6 +38,8 @@
 #pragma interface
 #endif
 
+#include "r_defs.h"
+
 /* Persistent storage/archiving.
  * These are the load / save game routines. */
 void P_ArchivePlayers(void);
@@ -55,6 +57,36 @@ void P_IndexToThinker(void); /* phares 9/13/98: save soundtarget in savegame */
 void P_ArchiveRNG(void);
 void P_UnArchiveRNG(void);
 
+/* Snapshots: a base savegame plus the world records changed since.
+ * P_InitWorldDirty is called by P_SetupLevel; the P_Mark* calls go
+ * wherever the game changes something P_ArchiveWorld saves. */
+void P_InitWorldDirty(void);
+void P_MarkSectorDirty(const sector_t *sec);
+void P_MarkLineDirty(const line_t *line);
+void P_MarkSideDirty(const side_t *side);
+void P_MarkSoundTarget(const sector_t *sec);
+void P_MarkWorldBase(void);
+boolean P_WorldBaseValid(void);
+void P_ArchiveWorldDelta(void);
+const byte *P_PatchWorld(byte *world, size_t length,
+                         const byte *delta, const byte *end);
+
+/* Mobjs are kept by serial; those spawned, removed or marked since the
+ * base are saved by P_ArchiveMobjDelta. The P_MarkMobjDirty calls go
+ * wherever a mobj that may be at rest is changed by something else. */
+void P_MarkMobjDirty(mobj_t *mo);
+void P_MarkMobjSpawned(mobj_t *mo);
+void P_MarkMobjRemoved(mobj_t *mo);
+void P_ArchiveMobjDelta(void);
+int P_DirtyMobjs(void);  /* how many P_ArchiveMobjDelta writes */
+const byte *P_PatchMobjs(const byte *base, const byte *baseend,
+                         const byte *delta, const byte *end);
+
+/* The order of the thinkers and of the lists of things, which savegames
+ * do not keep */
+void P_ArchiveThinkerOrder(void);
+void P_UnArchiveThinkerOrder(void);
+
 /* 2/21/98 killough: add automap info to savegame */
 void P_ArchiveMap(void);
 void P_UnArchiveMap(void);
@@ -52,6 +52,10 @@
 #include "v_video.h"
 #include "r_demo.h"
 #include "r_fps.h"
+#include "i_system.h"
+#include "p_saveg.h"
+#include "p_checksum.h"
+#include <pthread.h>
 
 //
 // MAP related Lookup tables.
@@ -73,6 +77,11 @@ subsector_t *subsectors;
 int      numnodes;
 node_t   *nodes;
 
+// threads P_SetupLevel may use for the blockmap and sector tessellation,
+// and how long each part of the last level load took
+int      load_threads = 2;
+uint_64_t loadstagetime[NUMLOADSTAGES];
+
 int      numlines;
 line_t   *lines;
 
@@ -110,14 +119,6 @@ typedef struct
   fixed_t x,y;
 } mapglvertex_t;
 
-enum
-{
-   ML_GL_LABEL=0,  // A separator name, GL_ExMx or GL_MAPxx
-   ML_GL_VERTS,     // Extra Vertices
-   ML_GL_SEGS,     // Segs, from linedefs & minisegs
-   ML_GL_SSECT,    // SubSectors, list of segs
-   ML_GL_NODES     // GL BSP nodes
-};
 ////////////////////////////////////////////////////////////////////////////////////////////
 
 
@@ -898,7 +899,7 @@ static void AddBlockLine
   if (done[blockno])
     return;
 
-  l = malloc(sizeof(linelist_t));
+  l = (malloc)(sizeof(linelist_t));
   l->num = lineno;
   l->next = lists[blockno];
   lists[blockno] = l;
@@ -906,6 +907,19 @@ static void AddBlockLine
   done[blockno] = 1;
 }
 
+// P_CreateBlockMap can run on a worker thread while the BSP lumps load.
+// The zone isn't thread safe, so everything it allocates comes from the C
+// library (the parentheses get around the z_zone.h macros) and the result
+// is only copied into a PU_LEVEL block by P_FinishBlockMap.
+
+static struct {
+  long *lump;                    // header and lists, from the C library
+  long size;
+  boolean pending;               // built but not yet copied into the zone
+  boolean threaded;
+  pthread_t thread;
+} newblockmap;
+
 //
 // Actually construct the blockmap lump from the level data
 //
@@ -916,6 +930,7 @@ static void AddBlockLine
 
 static void P_CreateBlockMap(void)
 {
+  long *blockmaplump;
   int xorg,yorg;                 // blockmap origin (lower left)
   int nrows,ncols;               // blockmap dimensions
   linelist_t **blocklists=NULL;  // array of pointers to lists of lines
@@ -962,16 +977,16 @@ static void P_CreateBlockMap(void)
   // finally make an array in which we can mark blocks done per line
 
   // CPhipps - calloc's
-  blocklists = calloc(NBlocks,sizeof(linelist_t *));
-  blockcount = calloc(NBlocks,sizeof(int));
-  blockdone = malloc(NBlocks*sizeof(int));
+  blocklists = (calloc)(NBlocks,sizeof(linelist_t *));
+  blockcount = (calloc)(NBlocks,sizeof(int));
+  blockdone = (malloc)(NBlocks*sizeof(int));
 
   // initialize each blocklist, and enter the trailing -1 in all blocklists
   // note the linked list of lines grows backwards
 
   for (i=0;i<NBlocks;i++)
   {
-    blocklists[i] = malloc(sizeof(linelist_t));
+    blocklists[i] = (malloc)(sizeof(linelist_t));
     blocklists[i]->num = -1;
     blocklists[i]->next = NULL;
     blockcount[i]++;
@@ -1137,14 +1152,14 @@ static void P_CreateBlockMap(void)
 
   // Create the blockmap lump
 
-  blockmaplump = Z_Malloc(sizeof(*blockmaplump) * (4+NBlocks+linetotal),
-                          PU_LEVEL, 0);
+  newblockmap.size = 4+NBlocks+linetotal;
+  newblockmap.lump = blockmaplump = (malloc)(sizeof(*blockmaplump) * newblockmap.size);
   // blockmap header
 
-  blockmaplump[0] = bmaporgx = xorg << FRACBITS;
-  blockmaplump[1] = bmaporgy = yorg << FRACBITS;
-  blockmaplump[2] = bmapwidth  = ncols;
-  blockmaplump[3] = bmapheight = nrows;
+  blockmaplump[0] = xorg << FRACBITS;
+  blockmaplump[1] = yorg << FRACBITS;
+  blockmaplump[2] = ncols;
+  blockmaplump[3] = nrows;
 
   // offsets to lists and block lists
 
@@ -1161,16 +1176,22 @@ static void P_CreateBlockMap(void)
     {
       linelist_t *tmp = bl->next;
       blockmaplump[offs++] = bl->num;
-      free(bl);
+      (free)(bl);
       bl = tmp;
     }
   }
 
   // free all temporary storage
 
-  free (blocklists);
-  free (blockcount);
-  free (blockdone);
+  (free) (blocklists);
+  (free) (blockcount);
+  (free) (blockdone);
+}
+
+static void *P_BlockMapThread(void *arg)
+{
+  P_CreateBlockMap();
+  return NULL;
 }
 
 // jff 10/6/98
@@ -1191,7 +1212,14 @@ static void P_LoadBlockMap (int lump)
   long count;
 
   if (M_CheckParm("-blockmap") || W_LumpLength(lump)<8 || (count = W_LumpLength(lump)/2) >= 0x10000) //e6y
-    P_CreateBlockMap();
+    {
+      // finished by P_FinishBlockMap
+      newblockmap.pending = true;
+      newblockmap.threaded = load_threads > 1 &&
+        !pthread_create(&newblockmap.thread, NULL, P_BlockMapThread, NULL);
+      if (!newblockmap.threaded)
+        P_CreateBlockMap();
+    }
   else
     {
       long i;
@@ -1222,6 +1250,32 @@ static void P_LoadBlockMap (int lump)
       bmapwidth = blockmaplump[2];
       bmapheight = blockmaplump[3];
     }
+}
+
+//
+// P_FinishBlockMap
+//
+// Waits for a blockmap being built on a worker, moves it into the zone,
+// and sets up the mobj chains. Nothing that reads the blockmap may run
+// between P_LoadBlockMap and this.
+//
+
+static void P_FinishBlockMap(void)
+{
+  if (newblockmap.pending)
+    {
+      if (newblockmap.threaded)
+        pthread_join(newblockmap.thread, NULL);
+      blockmaplump = Z_Malloc(sizeof(*blockmaplump) * newblockmap.size, PU_LEVEL, 0);
+      memcpy(blockmaplump, newblockmap.lump, sizeof(*blockmaplump) * newblockmap.size);
+      (free)(newblockmap.lump);
+      memset(&newblockmap, 0, sizeof newblockmap);
+
+      bmaporgx = blockmaplump[0];
+      bmaporgy = blockmaplump[1];
+      bmapwidth = blockmaplump[2];
+      bmapheight = blockmaplump[3];
+    }
 
   // clear out mobj chains - CPhipps - use calloc
   blocklinks = Z_Calloc (bmapwidth*bmapheight,sizeof(*blocklinks),PU_LEVEL,0);
@@ -1493,6 +1547,115 @@ static void P_RemoveSlimeTrails(void)         // killough 10/98
   free(hit);
 }
 
+//
+// P_MapLumpNames
+//
+// The lumps P_SetupLevel loads for a map, and the matching GL nodes.
+//
+
+static void P_MapLumpNames(int episode, int map, char lumpname[9], char gl_lumpname[9])
+{
+  if (gamemode == commercial)
+  {
+      
+      // JAF - Doom 2 uses Map01-, but uses DOOM 1 selection (E1M8)
+      int tempMap = ( ( episode - 1 ) * 9) + map;
+      
+    sprintf(lumpname, "map%02d", tempMap);           // killough 1/24/98: simplify
+    sprintf(gl_lumpname, "gl_map%02d", tempMap);    // figgi
+  }
+  else
+  {
+    sprintf(lumpname, "E%dM%d", episode, map);   // killough 1/24/98: simplify
+    sprintf(gl_lumpname, "GL_E%iM%i", episode, map); // figgi
+  }
+}
+
+//
+// P_PrefetchLevel
+//
+// Called from the intermission with the map that comes next. A thread
+// reads that map's lumps so they are in the OS cache by the time
+// P_SetupLevel asks for them; nothing is cached in the zone.
+//
+
+static struct {
+  int lumps[ML_BLOCKMAP+1 + ML_GL_NODES+1];
+  int numlumps;
+  volatile boolean running;
+} prefetch;
+
+static void *P_PrefetchThread(void *arg)
+{
+  static byte buffer[65536];
+  int i;
+
+  for (i = 0; i < prefetch.numlumps; i++)
+    W_PrefetchLump(prefetch.lumps[i], buffer, sizeof buffer);
+  prefetch.running = false;
+  return NULL;
+}
+
+void P_PrefetchLevel(int episode, int map)
+{
+  char lumpname[9], gl_lumpname[9];
+  int lumpnum, gl_lumpnum, i;
+  pthread_t thread;
+
+  if (prefetch.running)
+    return;
+
+  P_MapLumpNames(episode, map, lumpname, gl_lumpname);
+  if ((lumpnum = W_CheckNumForName(lumpname)) == -1)
+    return;
+  gl_lumpnum = W_CheckNumForName(gl_lumpname);
+
+  prefetch.numlumps = 0;
+  for (i = 0; i <= ML_BLOCKMAP && lumpnum+i < numlumps; i++)
+    prefetch.lumps[prefetch.numlumps++] = lumpnum+i;
+  if (gl_lumpnum != -1)
+    for (i = 0; i <= ML_GL_NODES && gl_lumpnum+i < numlumps; i++)
+      prefetch.lumps[prefetch.numlumps++] = gl_lumpnum+i;
+  prefetch.running = true;
+  if (pthread_create(&thread, NULL, P_PrefetchThread, NULL))
+    prefetch.running = false;
+  else
+    pthread_detach(thread);
+}
+
+//
+// P_LoadStage
+//
+// Charges the time since start to a load stage and returns the time now.
+//
+
+static uint_64_t P_LoadStage(loadstage_t stage, uint_64_t start)
+{
+  uint_64_t now = I_GetTime_US();
+
+  loadstagetime[stage] += now - start;
+  return now;
+}
+
+void P_PrintLoadTimes(void)
+{
+  static const char *const names[NUMLOADSTAGES] = {
+    "map data", "BSP lumps", "blockmap wait", "group lines/reject",
+    "things/specials", "precache", "GL preprocess", "  sector tessellation",
+  };
+  uint_64_t total = 0;
+  int i;
+
+  for (i = 0; i < NUMLOADSTAGES; i++)
+    {
+      if (i != LS_TESSELATE)   // part of LS_GLPREPROCESS
+        total += loadstagetime[i];
+      lprintf(LO_INFO, "%-22s %8.2f ms\n", names[i], loadstagetime[i] / 1000.0);
+    }
+  lprintf(LO_INFO, "%-22s %8.2f ms (%d load threads)\n", "P_SetupLevel", total / 1000.0,
+          load_threads > 1 ? load_threads : 1);
+}
+
 //
 // P_SetupLevel
 //
@@ -1506,8 +1669,11 @@ void P_SetupLevel(int episode, int map, int playermask, skill_t skill)
 
   char  gl_lumpname[9];
   int   gl_lumpnum;
+  uint_64_t stagestart = I_GetTime_US();
 
+  memset(loadstagetime, 0, sizeof loadstagetime);
   R_StopAllInterpolations();
+  P_ClearSightCache();
 
   totallive = totalkills = totalitems = totalsecret = wminfo.maxfrags = 0;
   wminfo.partime = 180;
@@ -1534,20 +1700,7 @@ void P_SetupLevel(int episode, int map, int playermask, skill_t skill)
   //    W_Reload ();     killough 1/31/98: W_Reload obsolete
 
   // find map name
-  if (gamemode == commercial)
-  {
-      
-      // JAF - Doom 2 uses Map01-, but uses DOOM 1 selection (E1M8)
-      int tempMap = ( ( episode - 1 ) * 9) + map;
-      
-    sprintf(lumpname, "map%02d", tempMap);           // killough 1/24/98: simplify
-    sprintf(gl_lumpname, "gl_map%02d", tempMap);    // figgi
-  }
-  else
-  {
-    sprintf(lumpname, "E%dM%d", episode, map);   // killough 1/24/98: simplify
-    sprintf(gl_lumpname, "GL_E%iM%i", episode, map); // figgi
-  }
+  P_MapLumpNames(episode, map, lumpname, gl_lumpname);
 
   lumpnum = W_GetNumForName(lumpname);
   gl_lumpnum = W_CheckNumForName(gl_lumpname); // figgi
@@ -1579,7 +1732,9 @@ void P_SetupLevel(int episode, int map, int playermask, skill_t skill)
   P_LoadSideDefs2 (lumpnum+ML_SIDEDEFS);
   P_LoadLineDefs2 (lumpnum+ML_LINEDEFS);
   P_LoadBlockMap  (lumpnum+ML_BLOCKMAP);
+  stagestart = P_LoadStage(LS_MAPDATA, stagestart);
 
+  // if the blockmap has to be built, that is going on in the background
   if (nodesVersion > 0)
   {
     P_LoadSubsectors(gl_lumpnum + ML_GL_SSECT);
@@ -1592,6 +1747,10 @@ void P_SetupLevel(int episode, int map, int playermask, skill_t skill)
     P_LoadNodes(lumpnum + ML_NODES);
     P_LoadSegs(lumpnum + ML_SEGS);
   }
+  stagestart = P_LoadStage(LS_BSP, stagestart);
+
+  P_FinishBlockMap();
+  stagestart = P_LoadStage(LS_BLOCKMAP, stagestart);
 
 #else
 
@@ -1605,6 +1764,7 @@ void P_SetupLevel(int episode, int map, int playermask, skill_t skill)
   P_LoadSubsectors(lumpnum+ML_SSECTORS);
   P_LoadNodes     (lumpnum+ML_NODES);
   P_LoadSegs      (lumpnum+ML_SEGS);
+  P_FinishBlockMap();
 
 #endif
 
@@ -1617,6 +1777,9 @@ void P_SetupLevel(int episode, int map, int playermask, skill_t skill)
   // http://www.doomworld.com/vb/showthread.php?s=&postid=627257#post627257
   if (compatibility_level>=lxdoom_1_compatibility || M_CheckParm("-force_remove_slime_trails") > 0)
     P_RemoveSlimeTrails();    // killough 10/98: remove slime trails from wad
+  stagestart = P_LoadStage(LS_GROUPLINES, stagestart);
+
+  P_InitWorldDirty();       // start tracking changes for snapshots
 
   // Note: you don't need to clear player queue slots --
   // a much simpler fix is in g_game.c -- killough 10/98
@@ -1659,22 +1822,30 @@ void P_SetupLevel(int episode, int map, int playermask, skill_t skill)
 
   // set up world state
   P_SpawnSpecials();
+  P_StateHashLevel();
 
   P_MapEnd();
+  stagestart = P_LoadStage(LS_THINGS, stagestart);
 
   // preload graphics
   if (precache)
     R_PrecacheLevel();
+  stagestart = P_LoadStage(LS_PRECACHE, stagestart);
 
 #ifdef GL_DOOM
   if (V_GetMode() == VID_MODEGL)
   {
     // proff 11/99: calculate all OpenGL specific tables etc.
+    gld_OpenLevelCache(lumpnum, gl_lumpnum);
     gld_PreprocessLevel();
   }
 #endif
+  P_LoadStage(LS_GLPREPROCESS, stagestart);
 
   R_SmoothPlaying_Reset(NULL); // e6y
+
+  if (M_CheckParm("-loadtimes"))
+    P_PrintLoadTimes();
 }
 
 //
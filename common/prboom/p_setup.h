@@ -40,6 +40,27 @@
 void P_SetupLevel(int episode, int map, int playermask, skill_t skill);
 void P_Init(void);               /* Called by startup code. */
 
+/* Read the next map's lumps into the OS cache, from the intermission. */
+void P_PrefetchLevel(int episode, int map);
+
+/* Where the time in the last P_SetupLevel went. LS_TESSELATE is the part
+ * of LS_GLPREPROCESS spent triangulating sectors. */
+typedef enum {
+  LS_MAPDATA,
+  LS_BSP,
+  LS_BLOCKMAP,
+  LS_GROUPLINES,
+  LS_THINGS,
+  LS_PRECACHE,
+  LS_GLPREPROCESS,
+  LS_TESSELATE,
+  NUMLOADSTAGES
+} loadstage_t;
+
+extern int       load_threads;   /* 1 to do it all on the calling thread */
+extern uint_64_t loadstagetime[NUMLOADSTAGES];
+void P_PrintLoadTimes(void);
+
 extern const byte *rejectmatrix;   /* for fast sight rejection -  cph - const* */
 
 /* killough 3/1/98: change blockmap from "short" to "long" offsets: */
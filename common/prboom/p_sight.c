@@ -37,6 +37,7 @@
 #include "p_maputl.h"
 #include "p_setup.h"
 #include "m_bbox.h"
+#include "p_tick.h"
 #include "lprintf.h"
 
 //
@@ -51,10 +52,35 @@ typedef struct {
   fixed_t topslope, bottomslope;   // slopes to top and bottom of target
   fixed_t bbox[4];
   fixed_t maxz,minz;               // cph - z optimisations for 2sided lines
+  // prepass traversals run off the game thread, so they mark lines in a
+  // private array instead of line->validcount, and note the sectors whose
+  // heights the result depends on
+  int *linemarks;
+  int validcount;
+  sightjob_t *job;
 } los_t;
 
 static los_t los; // cph - made static
 
+// prepass results for the current P_RunThinkers, indexed by sightjobhash
+static sightjob_t *sightjobs;
+static int *sightjobhash, sightjobhashsize;
+unsigned int sightjob_hits, sightjob_stale, sightjob_misses;
+
+// results remembered from earlier traversals
+#define SIGHTCACHESIZE 512   // must be a power of 2
+
+typedef struct {
+  sightjob_t job;           // inputs, dependent sectors and the result
+  const subsector_t *ss1, *ss2;
+  unsigned int gen;         // sectorheightgen when the deps were last checked
+} sightcache_t;
+
+boolean sight_cache = true;
+unsigned int sectorheightgen;
+unsigned int sightcache_hits, sightcache_rechecked, sightcache_misses;
+static sightcache_t *sightcache;
+
 //
 // P_DivlineSide
 // Returns side 0 (front), 1 (back), or 2 (on).
@@ -79,7 +105,45 @@ inline static int P_DivlineSide(fixed_t x, fixed_t y, const divline_t *node)
 //
 // killough 4/19/98: made static and cleaned up
 
-static boolean P_CrossSubsector(int num)
+static void P_AddSightDep(sightjob_t *job, const sector_t *sector)
+{
+  int i;
+
+  if (job->numdeps < 0)
+    return;
+  for (i = 0; i < job->numdeps; i++)
+    if (job->deps[i].sector == sector)
+      return;
+  if (job->numdeps == MAXSIGHTDEPS) {
+    job->numdeps = -1;
+    return;
+  }
+  job->deps[i].sector = sector;
+  job->deps[i].floorheight = sector->floorheight;
+  job->deps[i].ceilingheight = sector->ceilingheight;
+  job->numdeps++;
+}
+
+inline static boolean P_SightCrossesLine(const los_t *los, const line_t *line, divline_t *divl)
+{
+  const vertex_t *v1,*v2;
+
+  v1 = line->v1;
+  v2 = line->v2;
+
+  if (P_DivlineSide(v1->x, v1->y, &los->strace) ==
+      P_DivlineSide(v2->x, v2->y, &los->strace))
+    return false;
+
+  divl->dx = v2->x - (divl->x = v1->x);
+  divl->dy = v2->y - (divl->y = v1->y);
+
+  // line isn't crossed?
+  return P_DivlineSide(los->strace.x, los->strace.y, divl) !=
+    P_DivlineSide(los->t2x, los->t2y, divl);
+}
+
+static boolean P_CrossSubsector(los_t *los, int num)
 {
   seg_t *seg = segs + subsectors[num].firstline;
   int count;
@@ -94,33 +158,41 @@ static boolean P_CrossSubsector(int num)
   for (count = subsectors[num].numlines; --count >= 0; seg++) { // check lines
     line_t *line = seg->linedef;
     divline_t divl;
+    int *mark;
 
    if(!line) // figgi -- skip minisegs
      continue;
 
     // allready checked other side?
-    if (line->validcount == validcount)
+    mark = los->linemarks ? &los->linemarks[line - lines] : &line->validcount;
+    if (*mark == los->validcount)
       continue;
 
-    line->validcount = validcount;
+    *mark = los->validcount;
 
     /* OPTIMIZE: killough 4/20/98: Added quick bounding-box rejection test
      * cph - this is causing demo desyncs on original Doom demos.
      *  Who knows why. Exclude test for those.
      */
     if (!demo_compatibility)
-    if (line->bbox[BOXLEFT  ] > los.bbox[BOXRIGHT ] ||
-  line->bbox[BOXRIGHT ] < los.bbox[BOXLEFT  ] ||
-  line->bbox[BOXBOTTOM] > los.bbox[BOXTOP   ] ||
-  line->bbox[BOXTOP]    < los.bbox[BOXBOTTOM])
+    if (line->bbox[BOXLEFT  ] > los->bbox[BOXRIGHT ] ||
+  line->bbox[BOXRIGHT ] < los->bbox[BOXLEFT  ] ||
+  line->bbox[BOXBOTTOM] > los->bbox[BOXTOP   ] ||
+  line->bbox[BOXTOP]    < los->bbox[BOXBOTTOM])
       continue;
 
     // cph - do what we can before forced to check intersection
     if (line->flags & ML_TWOSIDED) {
+      front = seg->frontsector;
+      back = seg->backsector;
+      // only the heights of lines the sight line crosses matter
+      if (los->job && P_SightCrossesLine(los, line, &divl)) {
+        P_AddSightDep(los->job, front);
+        P_AddSightDep(los->job, back);
+      }
 
       // no wall to block sight with?
-      if ((front = seg->frontsector)->floorheight ==
-    (back = seg->backsector)->floorheight   &&
+      if (front->floorheight == back->floorheight &&
     front->ceilingheight == back->ceilingheight)
   continue;
 
@@ -134,56 +206,41 @@ static boolean P_CrossSubsector(int num)
   front->floorheight : back->floorheight ;
 
       // cph - reject if does not intrude in the z-space of the possible LOS
-      if ((opentopheight >= los.maxz) && (openbottomheight <= los.minz))
+      if ((opentopheight >= los->maxz) && (openbottomheight <= los->minz))
   continue;
     }
 
-    { // Forget this line if it doesn't cross the line of sight
-      const vertex_t *v1,*v2;
-
-      v1 = line->v1;
-      v2 = line->v2;
-
-      if (P_DivlineSide(v1->x, v1->y, &los.strace) ==
-          P_DivlineSide(v2->x, v2->y, &los.strace))
-        continue;
-
-      divl.dx = v2->x - (divl.x = v1->x);
-      divl.dy = v2->y - (divl.y = v1->y);
-
-      // line isn't crossed?
-      if (P_DivlineSide(los.strace.x, los.strace.y, &divl) ==
-    P_DivlineSide(los.t2x, los.t2y, &divl))
-  continue;
-    }
+    // Forget this line if it doesn't cross the line of sight
+    if (!P_SightCrossesLine(los, line, &divl))
+      continue;
 
     // cph - if bottom >= top or top < minz or bottom > maxz then it must be
     // solid wrt this LOS
     if (!(line->flags & ML_TWOSIDED) || (openbottomheight >= opentopheight) ||
-  (opentopheight < los.minz) || (openbottomheight > los.maxz))
+  (opentopheight < los->minz) || (openbottomheight > los->maxz))
   return false;
 
     { // crosses a two sided line
       /* cph 2006/07/15 - oops, we missed this in 2.4.0 & .1;
        *  use P_InterceptVector2 for those compat levels only. */ 
       fixed_t frac = (compatibility_level == prboom_5_compatibility || compatibility_level == prboom_6_compatibility) ?
-		      P_InterceptVector2(&los.strace, &divl) : 
-		      P_InterceptVector(&los.strace, &divl);
+		      P_InterceptVector2(&los->strace, &divl) : 
+		      P_InterceptVector(&los->strace, &divl);
 
       if (front->floorheight != back->floorheight) {
-        fixed_t slope = FixedDiv(openbottomheight - los.sightzstart , frac);
-        if (slope > los.bottomslope)
-            los.bottomslope = slope;
+        fixed_t slope = FixedDiv(openbottomheight - los->sightzstart , frac);
+        if (slope > los->bottomslope)
+            los->bottomslope = slope;
       }
 
       if (front->ceilingheight != back->ceilingheight)
         {
-          fixed_t slope = FixedDiv(opentopheight - los.sightzstart , frac);
-          if (slope < los.topslope)
-            los.topslope = slope;
+          fixed_t slope = FixedDiv(opentopheight - los->sightzstart , frac);
+          if (slope < los->topslope)
+            los->topslope = slope;
         }
 
-      if (los.topslope <= los.bottomslope)
+      if (los->topslope <= los->bottomslope)
         return false;               // stop
     }
   }
@@ -201,65 +258,63 @@ static boolean P_CrossSubsector(int num)
 //  could return 2 which was ambigous, and the former is
 //  better optimised; also removes two casts :-)
 
-static boolean P_CrossBSPNode_LxDoom(int bspnum)
+static boolean P_CrossBSPNode_LxDoom(los_t *los, int bspnum)
 {
   while (!(bspnum & NF_SUBSECTOR))
     {
       register const node_t *bsp = nodes + bspnum;
       int side,side2;
-      side = R_PointOnSide(los.strace.x, los.strace.y, bsp);
-      side2 = R_PointOnSide(los.t2x, los.t2y, bsp);
+      side = R_PointOnSide(los->strace.x, los->strace.y, bsp);
+      side2 = R_PointOnSide(los->t2x, los->t2y, bsp);
       if (side == side2)
          bspnum = bsp->children[side]; // doesn't touch the other side
       else         // the partition plane is crossed here
-        if (!P_CrossBSPNode_LxDoom(bsp->children[side]))
+        if (!P_CrossBSPNode_LxDoom(los, bsp->children[side]))
           return 0;  // cross the starting side
         else
           bspnum = bsp->children[side^1];  // cross the ending side
     }
-  return P_CrossSubsector(bspnum == -1 ? 0 : bspnum & ~NF_SUBSECTOR);
+  return P_CrossSubsector(los, bspnum == -1 ? 0 : bspnum & ~NF_SUBSECTOR);
 }
 
-static boolean P_CrossBSPNode_PrBoom(int bspnum)
+static boolean P_CrossBSPNode_PrBoom(los_t *los, int bspnum)
 {
   while (!(bspnum & NF_SUBSECTOR))
     {
       register const node_t *bsp = nodes + bspnum;
       int side,side2;
-      side = P_DivlineSide(los.strace.x,los.strace.y,(const divline_t *)bsp)&1;
-      side2= P_DivlineSide(los.t2x, los.t2y, (const divline_t *) bsp);
+      side = P_DivlineSide(los->strace.x,los->strace.y,(const divline_t *)bsp)&1;
+      side2= P_DivlineSide(los->t2x, los->t2y, (const divline_t *) bsp);
       if (side == side2)
          bspnum = bsp->children[side]; // doesn't touch the other side
       else         // the partition plane is crossed here
-        if (!P_CrossBSPNode_PrBoom(bsp->children[side]))
+        if (!P_CrossBSPNode_PrBoom(los, bsp->children[side]))
           return 0;  // cross the starting side
         else
           bspnum = bsp->children[side^1];  // cross the ending side
     }
-  return P_CrossSubsector(bspnum == -1 ? 0 : bspnum & ~NF_SUBSECTOR);
+  return P_CrossSubsector(los, bspnum == -1 ? 0 : bspnum & ~NF_SUBSECTOR);
 }
 
 /* proff - Moved the compatibility check outside the functions
  * this gives a slight speedup
  */
-static boolean P_CrossBSPNode(int bspnum)
+static boolean P_CrossBSPNode(los_t *los, int bspnum)
 {
   /* cph - LxDoom used some R_* funcs here */
   if (compatibility_level == lxdoom_1_compatibility)
-    return P_CrossBSPNode_LxDoom(bspnum);
+    return P_CrossBSPNode_LxDoom(los, bspnum);
   else
-    return P_CrossBSPNode_PrBoom(bspnum);
+    return P_CrossBSPNode_PrBoom(los, bspnum);
 }
 
 //
-// P_CheckSight
-// Returns true
-//  if a straight line between t1 and t2 is unobstructed.
-// Uses REJECT.
+// P_CheckSightTrivial
+// Returns 0 or 1 if the REJECT table, fake floors or a shared subsector
+// decide the question, or -1 if the BSP has to be traversed.
 //
-// killough 4/20/98: cleaned up, made to use new LOS struct
 
-boolean P_CheckSight(mobj_t *t1, mobj_t *t2)
+static int P_CheckSightTrivial(mobj_t *t1, mobj_t *t2)
 {
   const sector_t *s1 = t1->subsector->sector;
   const sector_t *s2 = t2->subsector->sector;
@@ -295,44 +350,265 @@ boolean P_CheckSight(mobj_t *t1, mobj_t *t2)
       (compatibility_level >= mbf_compatibility))
     return true;
 
-  // An unobstructed LOS is possible.
-  // Now look from eyes of t1 to any part of t2.
+  return -1;
+}
 
-  validcount++;
+//
+// P_SightTrace
+// Look from the eyes of t1 to any part of t2 through the BSP.
+//
 
-  los.topslope = (los.bottomslope = t2->z - (los.sightzstart =
+static boolean P_SightTrace(los_t *los, mobj_t *t1, mobj_t *t2)
+{
+  los->topslope = (los->bottomslope = t2->z - (los->sightzstart =
                                              t1->z + t1->height -
                                              (t1->height>>2))) + t2->height;
-  los.strace.dx = (los.t2x = t2->x) - (los.strace.x = t1->x);
-  los.strace.dy = (los.t2y = t2->y) - (los.strace.y = t1->y);
+  los->strace.dx = (los->t2x = t2->x) - (los->strace.x = t1->x);
+  los->strace.dy = (los->t2y = t2->y) - (los->strace.y = t1->y);
 
   if (t1->x > t2->x)
-    los.bbox[BOXRIGHT] = t1->x, los.bbox[BOXLEFT] = t2->x;
+    los->bbox[BOXRIGHT] = t1->x, los->bbox[BOXLEFT] = t2->x;
   else
-    los.bbox[BOXRIGHT] = t2->x, los.bbox[BOXLEFT] = t1->x;
+    los->bbox[BOXRIGHT] = t2->x, los->bbox[BOXLEFT] = t1->x;
 
   if (t1->y > t2->y)
-    los.bbox[BOXTOP] = t1->y, los.bbox[BOXBOTTOM] = t2->y;
+    los->bbox[BOXTOP] = t1->y, los->bbox[BOXBOTTOM] = t2->y;
   else
-    los.bbox[BOXTOP] = t2->y, los.bbox[BOXBOTTOM] = t1->y;
+    los->bbox[BOXTOP] = t2->y, los->bbox[BOXBOTTOM] = t1->y;
 
   /* cph - calculate min and max z of the potential line of sight
    * For old demos, we disable this optimisation by setting them to
    * the extremes */
   switch (compatibility_level) {
   case lxdoom_1_compatibility:
-    if (los.sightzstart < t2->z) {
-      los.maxz = t2->z + t2->height; los.minz = los.sightzstart;
-    } else if (los.sightzstart > t2->z + t2->height) {
-      los.maxz = los.sightzstart; los.minz = t2->z;
+    if (los->sightzstart < t2->z) {
+      los->maxz = t2->z + t2->height; los->minz = los->sightzstart;
+    } else if (los->sightzstart > t2->z + t2->height) {
+      los->maxz = los->sightzstart; los->minz = t2->z;
     } else {
-      los.maxz = t2->z + t2->height; los.minz = t2->z;
+      los->maxz = t2->z + t2->height; los->minz = t2->z;
     }
     break;
   default:
-    los.maxz = INT_MAX; los.minz = INT_MIN;
+    los->maxz = INT_MAX; los->minz = INT_MIN;
   }
 
   // the head node is the last node output
-  return P_CrossBSPNode(numnodes-1);
+  return P_CrossBSPNode(los, numnodes-1);
+}
+
+//
+// P_NeedSightJob
+// True if P_CheckSight(t1, t2) would have to traverse the BSP, so it is
+// worth doing in the prepass.
+//
+
+boolean P_NeedSightJob(mobj_t *t1, mobj_t *t2)
+{
+  return P_CheckSightTrivial(t1, t2) < 0;
+}
+
+//
+// P_RunSightJob
+// Called on the prepass threads. Only reads the level; lines are marked
+// in the caller's linemarks, which must have room for numlines.
+//
+
+void P_RunSightJob(sightjob_t *job, int *linemarks, int mark)
+{
+  los_t l;
+  mobj_t *t1 = job->t1, *t2 = job->t2;
+
+  job->x1 = t1->x; job->y1 = t1->y; job->z1 = t1->z; job->height1 = t1->height;
+  job->x2 = t2->x; job->y2 = t2->y; job->z2 = t2->z; job->height2 = t2->height;
+  job->numdeps = 0;
+
+  l.linemarks = linemarks;
+  l.validcount = mark;
+  l.job = job;
+  job->result = P_SightTrace(&l, t1, t2);
+}
+
+static unsigned int P_SightJobKey(const mobj_t *t1, const mobj_t *t2)
+{
+  return (unsigned int)((size_t)t1 >> 3) * 31 + (unsigned int)((size_t)t2 >> 3);
+}
+
+//
+// P_SetSightJobs
+// Makes the prepass results visible to P_CheckSight.
+//
+
+void P_SetSightJobs(sightjob_t *jobs, int numjobs)
+{
+  int i, size;
+
+  sightjobs = NULL;
+  if (!jobs || !numjobs)
+    return;
+
+  for (size = 64; size < numjobs*2; size <<= 1)
+    ;
+  if (size > sightjobhashsize) {
+    free(sightjobhash);
+    sightjobhash = malloc(size * sizeof *sightjobhash);
+    sightjobhashsize = size;
+  }
+  for (i = 0; i < sightjobhashsize; i++)
+    sightjobhash[i] = -1;
+
+  for (i = 0; i < numjobs; i++) {
+    unsigned int h = P_SightJobKey(jobs[i].t1, jobs[i].t2);
+    while (sightjobhash[h & (sightjobhashsize-1)] != -1)
+      h++;
+    sightjobhash[h & (sightjobhashsize-1)] = i;
+  }
+  sightjobs = jobs;
+}
+
+static const sightjob_t *P_FindSightJob(const mobj_t *t1, const mobj_t *t2)
+{
+  unsigned int h = P_SightJobKey(t1, t2);
+  int i;
+
+  while ((i = sightjobhash[h & (sightjobhashsize-1)]) != -1) {
+    if (sightjobs[i].t1 == t1 && sightjobs[i].t2 == t2)
+      return &sightjobs[i];
+    h++;
+  }
+  return NULL;
+}
+
+static boolean P_SightJobInputs(const sightjob_t *job, const mobj_t *t1, const mobj_t *t2)
+{
+  return
+    job->numdeps >= 0 &&
+    t1->x == job->x1 && t1->y == job->y1 && t1->z == job->z1 && t1->height == job->height1 &&
+    t2->x == job->x2 && t2->y == job->y2 && t2->z == job->z2 && t2->height == job->height2;
+}
+
+static boolean P_SightJobDeps(const sightjob_t *job)
+{
+  int i;
+
+  for (i = 0; i < job->numdeps; i++)
+    if (job->deps[i].sector->floorheight != job->deps[i].floorheight ||
+        job->deps[i].sector->ceilingheight != job->deps[i].ceilingheight)
+        return false;
+  return true;
+}
+
+// the traversal only reads these, so if they match the result does too
+static boolean P_SightJobValid(const sightjob_t *job)
+{
+  return P_SightJobInputs(job, job->t1, job->t2) && P_SightJobDeps(job);
+}
+
+//
+// P_ClearSightCache
+// Called from P_SetupLevel, since entries point at the level's sectors.
+//
+
+void P_ClearSightCache(void)
+{
+  if (sightcache)
+    memset(sightcache, 0, SIGHTCACHESIZE * sizeof *sightcache);
+}
+
+static sightcache_t *P_SightCacheSlot(const mobj_t *t1, const mobj_t *t2)
+{
+  unsigned int h =
+    (t1->subsector - subsectors) * 31 + (t2->subsector - subsectors) +
+    (((t1->x ^ t2->y) >> FRACBITS) * 17) + (((t1->y ^ t2->x) >> FRACBITS) * 7) +
+    ((t1->z ^ t2->z) >> FRACBITS);
+
+  if (!sightcache)
+    sightcache = calloc(SIGHTCACHESIZE, sizeof *sightcache);
+  return &sightcache[h & (SIGHTCACHESIZE-1)];
+}
+
+// a remembered result for these mobjs, if it can be shown to be current
+static sightcache_t *P_FindSightCache(sightcache_t *sc, const mobj_t *t1, const mobj_t *t2)
+{
+  if (sc->ss1 != t1->subsector || sc->ss2 != t2->subsector ||
+      !P_SightJobInputs(&sc->job, t1, t2))
+    return NULL;
+  if (sc->gen != sectorheightgen) {
+    // something moved since; still good if none of our sectors did
+    if (!P_SightJobDeps(&sc->job))
+      return NULL;
+    sc->gen = sectorheightgen;
+    sightcache_rechecked++;
+  }
+  return sc;
+}
+
+//
+// P_CheckSight
+// Returns true
+//  if a straight line between t1 and t2 is unobstructed.
+// Uses REJECT.
+//
+// killough 4/20/98: cleaned up, made to use new LOS struct
+
+boolean P_CheckSight(mobj_t *t1, mobj_t *t2)
+{
+  int trivial = P_CheckSightTrivial(t1, t2);
+  const sightjob_t *job = NULL;
+  sightcache_t *sc = NULL;
+  boolean result;
+
+  if (trivial >= 0)
+    return trivial;
+
+  // An unobstructed LOS is possible.
+  // Now look from eyes of t1 to any part of t2.
+
+  validcount++;
+
+  if (sightjobs) {
+    if (!(job = P_FindSightJob(t1, t2)))
+      sightjob_misses++;
+    else if (!P_SightJobValid(job)) {
+      sightjob_stale++;
+      job = NULL;
+    } else {
+      sightjob_hits++;
+      if (!thinker_verify)
+        return job->result;
+    }
+  }
+
+  if (!job && sight_cache) {
+    sc = P_SightCacheSlot(t1, t2);
+    if (P_FindSightCache(sc, t1, t2)) {
+      sightcache_hits++;
+      if (!thinker_verify)
+        return sc->job.result;
+      job = &sc->job;
+    } else
+      sightcache_misses++;
+  }
+
+  los.linemarks = NULL;
+  los.validcount = validcount;
+  los.job = NULL;
+  if (sc && !job) {
+    // remember this one, along with the sectors it depends on
+    los.job = &sc->job;
+    sc->job.x1 = t1->x; sc->job.y1 = t1->y; sc->job.z1 = t1->z; sc->job.height1 = t1->height;
+    sc->job.x2 = t2->x; sc->job.y2 = t2->y; sc->job.z2 = t2->z; sc->job.height2 = t2->height;
+    sc->job.numdeps = 0;
+    sc->ss1 = t1->subsector;
+    sc->ss2 = t2->subsector;
+    sc->gen = sectorheightgen;
+  }
+  result = P_SightTrace(&los, t1, t2);
+  if (los.job)
+    los.job->result = result;
+
+  if (job && job->result != result)
+    I_Error("P_CheckSight: reused result %d, traversal %d at gametic %d",
+            job->result, result, gametic);
+  return result;
 }
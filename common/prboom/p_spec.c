@@ -43,6 +43,7 @@
 #include "p_spec.h"
 #include "p_tick.h"
 #include "p_setup.h"
+#include "p_saveg.h"
 #include "m_random.h"
 #include "d_englsh.h"
 #include "m_argv.h"
@@ -1112,6 +1113,8 @@ void P_CrossSpecialLine(line_t *line, int side, mobj_t *thing)
 {
   int         ok;
 
+  P_MarkLineDirty(line);    // most types clear the special once triggered
+
   //  Things that should never trigger lines
   if (!thing->player)
   {
@@ -2004,6 +2007,8 @@ void P_ShootSpecialLine
 ( mobj_t*       thing,
   line_t*       line )
 {
+  P_MarkLineDirty(line);
+
   //jff 02/04/98 add check here for generalized linedef
   if (!demo_compatibility)
   {
@@ -2229,6 +2234,7 @@ void P_PlayerInSpecialSector (player_t* player)
       case 9:
         // Tally player in secret sector, clear secret special
         player->secretcount++;
+        P_MarkSectorDirty(sector);
         sector->special = 0;
         break;
 
@@ -2277,6 +2283,7 @@ void P_PlayerInSpecialSector (player_t* player)
     if (sector->special&SECRET_MASK)
     {
       player->secretcount++;
+      P_MarkSectorDirty(sector);
       sector->special &= ~SECRET_MASK;
       if (sector->special<32) // if all extended bits clear,
         sector->special=0;    // sector is not special anymore
@@ -2364,6 +2371,7 @@ void P_UpdateSpecials (void)
       buttonlist[i].btimer--;
       if (!buttonlist[i].btimer)
       {
+        P_MarkSideDirty(&sides[buttonlist[i].line->sidenum[0]]);
         switch(buttonlist[i].where)
         {
           case top:
@@ -2639,6 +2647,7 @@ void T_Scroll(scroll_t *s)
 
     case sc_side:                   // killough 3/7/98: Scroll wall texture
         side = sides + s->affectee;
+        P_MarkSideDirty(side);
         side->textureoffset += dx;
         side->rowoffset += dy;
         break;
@@ -2675,6 +2684,7 @@ void T_Scroll(scroll_t *s)
           {
             // Move objects only if on floor or underwater,
             // non-floating, and clipped.
+            P_MarkMobjDirty(thing);
             thing->momx += dx;
             thing->momy += dy;
           }
@@ -3153,6 +3163,7 @@ static boolean PIT_PushThing(mobj_t* thing)
           if (tmpusher->source->type == MT_PUSH)
             pushangle += ANG180;    // away
           pushangle >>= ANGLETOFINESHIFT;
+          P_MarkMobjDirty(thing);
           thing->momx += FixedMul(speed,finecosine[pushangle]);
           thing->momy += FixedMul(speed,finesine[pushangle]);
         }
@@ -3282,6 +3293,7 @@ void T_Pusher(pusher_t *p)
                     yspeed = p->y_mag;
                     }
             }
+        P_MarkMobjDirty(thing);
         thing->momx += xspeed<<(FRACBITS-PUSH_FACTOR);
         thing->momy += yspeed<<(FRACBITS-PUSH_FACTOR);
         }
@@ -36,6 +36,7 @@
 #include "r_main.h"
 #include "p_spec.h"
 #include "g_game.h"
+#include "p_saveg.h"
 #include "s_sound.h"
 #include "sounds.h"
 #include "lprintf.h"
@@ -171,6 +172,8 @@ void P_ChangeSwitchTexture
   short   *texture, *ttop, *tmid, *tbot;
   bwhere_e position;
 
+  P_MarkLineDirty(line);
+  P_MarkSideDirty(&sides[line->sidenum[0]]);
   ttop = &sides[line->sidenum[0]].toptexture;
   tmid = &sides[line->sidenum[0]].midtexture;
   tbot = &sides[line->sidenum[0]].bottomtexture;
@@ -234,6 +237,7 @@ P_UseSpecialLine
   line_t*       line,
   int           side )
 {
+  P_MarkLineDirty(line);    // switch types clear the special once used
 
   // e6y
   // b.m. side test was broken in boom201
@@ -37,9 +37,21 @@
 #include "p_tick.h"
 #include "p_map.h"
 #include "r_fps.h"
+#include "m_profile.h"
+#include "p_setup.h"
+#include "p_maputl.h"
+#include "r_state.h"
+#include "lprintf.h"
+#include "p_checksum.h"
+#include <pthread.h>
 
 int leveltime;
 
+// sight prepass: above 1, P_RunThinkers first works out the line of sight
+// checks the monsters are about to make on this many threads
+int thinker_threads;
+boolean thinker_verify;  // recheck every prepass result P_CheckSight reuses
+
 static boolean newthinkerpresent;
 
 //
@@ -238,8 +250,156 @@ void P_SetTarget(mobj_t **mop, mobj_t *targ)
 // external and using P_RemoveThinkerDelayed() implicitly.
 //
 
+#define MAXTHINKERTHREADS 16
+
+static sightjob_t *sightjobs;
+static int numsightjobs, maxsightjobs;
+
+static int *sightmarks[MAXTHINKERTHREADS];  // per thread stand-ins for validcount
+static int sightmark[MAXTHINKERTHREADS];
+static int sightmarklines;
+
+static pthread_mutex_t sightlock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sightwake = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t sightdone = PTHREAD_COND_INITIALIZER;
+static int sightgeneration, sightbusy, sightworkers, sightthreads;
+
+static void P_RunSightJobs(int worker)
+{
+  int i;
+
+  for (i = 0; i < numsightjobs; i++)
+    if (sightjobs[i].worker == worker)
+      P_RunSightJob(&sightjobs[i], sightmarks[worker], ++sightmark[worker]);
+}
+
+static void *P_SightThread(void *arg)
+{
+  int worker = (int)(size_t)arg;
+  int generation = 0;
+
+  pthread_mutex_lock(&sightlock);
+  for (;;) {
+    while (generation == sightgeneration)
+      pthread_cond_wait(&sightwake, &sightlock);
+    generation = sightgeneration;
+    if (worker < sightworkers) {
+      pthread_mutex_unlock(&sightlock);
+      P_RunSightJobs(worker);
+      pthread_mutex_lock(&sightlock);
+      if (!--sightbusy)
+        pthread_cond_signal(&sightdone);
+    }
+  }
+  return NULL;
+}
+
+static void P_AddSightJob(mobj_t *t1, mobj_t *t2, int worker)
+{
+  if (!t2 || t2 == t1 || !P_NeedSightJob(t1, t2))
+    return;
+  if (numsightjobs == maxsightjobs) {
+    maxsightjobs = maxsightjobs ? maxsightjobs*2 : 128;
+    sightjobs = realloc(sightjobs, maxsightjobs * sizeof *sightjobs);
+  }
+  sightjobs[numsightjobs].t1 = t1;
+  sightjobs[numsightjobs].t2 = t2;
+  sightjobs[numsightjobs].worker = worker;
+  numsightjobs++;
+}
+
+//
+// P_PrepareSight
+//
+// Collects the P_CheckSight calls the monsters acting this tic are likely
+// to make (at their target, and at the players when looking for one) and
+// runs them on the thread pool before any thinker moves. The threads only
+// read the level. Jobs are dealt out by blockmap cell so each thread walks
+// one neighbourhood of the BSP; P_CheckSight then reuses an answer only if
+// nothing it was worked out from has changed since, so demo sync and
+// P_Checksum output are the same as with the prepass off.
+//
+
+static void P_PrepareSight(int threads)
+{
+  thinker_t *th;
+  int i;
+
+  if (threads > MAXTHINKERTHREADS)
+    threads = MAXTHINKERTHREADS;
+
+  if (sightmarklines != numlines) {
+    for (i = 0; i < MAXTHINKERTHREADS; i++) {
+      free(sightmarks[i]);
+      sightmarks[i] = NULL;
+      sightmark[i] = 0;
+    }
+    sightmarklines = numlines;
+  }
+  for (i = 0; i < threads; i++)
+    if (!sightmarks[i])
+      sightmarks[i] = calloc(numlines, sizeof *sightmarks[i]);
+
+  // the pool is workers 1..threads-1, this thread is worker 0
+  while (sightthreads < threads-1) {
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, P_SightThread, (void *)(size_t)(sightthreads+1))) {
+      lprintf(LO_WARN, "P_PrepareSight: could not start thread %d\n", sightthreads+1);
+      break;
+    }
+    pthread_detach(thread);
+    sightthreads++;
+  }
+  if (threads > sightthreads+1)
+    threads = sightthreads+1;
+
+  numsightjobs = 0;
+  for (th = thinkercap.next; th != &thinkercap; th = th->next) {
+    mobj_t *mo = (mobj_t *)th;
+    int cell;
+
+    // only monsters changing state this tic run an action that can look
+    if (th->function != P_MobjThinker || mo->player || mo->health <= 0 ||
+        mo->tics != 1 || mo->info->seestate == S_NULL)
+      continue;
+
+    cell = ((mo->y - bmaporgy) >> MAPBLOCKSHIFT) * bmapwidth +
+           ((mo->x - bmaporgx) >> MAPBLOCKSHIFT);
+    cell = (cell < 0 ? -cell : cell) % threads;
+
+    P_AddSightJob(mo, mo->target, cell);
+    for (i = 0; i < MAXPLAYERS; i++)
+      if (playeringame[i] && players[i].mo != mo->target &&
+          players[i].mo && players[i].health > 0)
+        P_AddSightJob(mo, players[i].mo, cell);
+  }
+  if (!numsightjobs)
+    return;
+
+  pthread_mutex_lock(&sightlock);
+  sightworkers = threads;
+  sightbusy = threads - 1;
+  sightgeneration++;
+  pthread_cond_broadcast(&sightwake);
+  pthread_mutex_unlock(&sightlock);
+
+  P_RunSightJobs(0);
+
+  pthread_mutex_lock(&sightlock);
+  while (sightbusy)
+    pthread_cond_wait(&sightdone, &sightlock);
+  pthread_mutex_unlock(&sightlock);
+
+  P_SetSightJobs(sightjobs, numsightjobs);
+}
+
 static void P_RunThinkers (void)
 {
+  PROF_BEGIN(P_RunThinkers);
+
+  if (thinker_threads > 1)
+    P_PrepareSight(thinker_threads);
+
   for (currentthinker = thinkercap.next;
        currentthinker != &thinkercap;
        currentthinker = currentthinker->next)
@@ -250,6 +410,8 @@ static void P_RunThinkers (void)
       currentthinker->function(currentthinker);
   }
   newthinkerpresent = false;
+  P_SetSightJobs(NULL, 0);
+  PROF_END(P_RunThinkers);
 }
 
 //
@@ -259,6 +421,7 @@ static void P_RunThinkers (void)
 void P_Ticker (void)
 {
   int i;
+  PROF_BEGIN(P_Ticker);
 
   /* pause if in menu and at least one tic has been run
    *
@@ -286,6 +449,8 @@ void P_Ticker (void)
   P_UpdateSpecials();
   P_RespawnSpecials();
   P_MapEnd();
+  P_StateHashTic(gametic);
   leveltime++;                       // for par times
+  PROF_END(P_Ticker);
 }
 
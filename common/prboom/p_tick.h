@@ -72,4 +72,9 @@ extern thinker_t thinkerclasscap[];
 /* cph 2002/01/13 - iterator for thinker lists */
 thinker_t* P_NextThinker(thinker_t*,th_class);
 
+/* threads for the P_RunThinkers sight prepass, and whether to recheck sight
+ * results reused from it or from the sight cache */
+extern int thinker_threads;
+extern boolean thinker_verify;
+
 #endif
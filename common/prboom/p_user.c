@@ -41,6 +41,7 @@
 #include "p_user.h"
 #include "r_demo.h"
 #include "r_fps.h"
+#include "p_predict.h"
 
 // Index of the special effects (INVUL inverse) map.
 
@@ -201,7 +202,7 @@ void P_MovePlayer (player_t* player)
   onground = mo->z <= mo->floorz;
 
   // e6y
-  if (demo_smoothturns && player == &players[displayplayer])
+  if (demo_smoothturns && player == &players[displayplayer] && !predicting)
     R_SmoothPlaying_Add(cmd->angleturn << 16);
 
   // killough 10/98:
@@ -58,6 +58,22 @@ typedef struct {
 static inline void packet_set(packet_header_t* p, enum packet_type_e t, unsigned long tic)
 { p->tic = doom_htonl(tic); p->type = t; p->reserved[0] = 0; p->reserved[1] = 0; }
 
+/* Tic redundancy
+ * PKT_TICC: reserved holds how many PKT_TICS the client has received, as
+ *  15 bits with the top bit set, so the server can measure its loss
+ * PKT_TICS: reserved[0] is how many tics already sent the server repeats
+ *  in each packet, which the client also repeats in its PKT_TICC
+ * PKT_RETRANS: a second byte after the player number asks for only that
+ *  many tics, as the client has those after them
+ */
+#define TICS_COUNTED 0x8000
+
+static inline void packet_set_count(packet_header_t* p, unsigned count)
+{ count |= TICS_COUNTED; p->reserved[0] = count & 0xff; p->reserved[1] = count >> 8; }
+
+static inline int packet_get_count(const packet_header_t* p)
+{ return p->reserved[1] & (TICS_COUNTED >> 8) ? (p->reserved[0] | p->reserved[1] << 8) & ~TICS_COUNTED : -1; }
+
 #ifndef GAME_OPTIONS_SIZE
 // From g_game.h
 #define GAME_OPTIONS_SIZE 64
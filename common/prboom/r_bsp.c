@@ -41,19 +41,19 @@
 #include "v_video.h"
 #include "lprintf.h"
 
-seg_t     *curline;
-side_t    *sidedef;
-line_t    *linedef;
-sector_t  *frontsector;
-sector_t  *backsector;
-drawseg_t *ds_p;
+R_THREADLOCAL seg_t     *curline;
+R_THREADLOCAL side_t    *sidedef;
+R_THREADLOCAL line_t    *linedef;
+R_THREADLOCAL sector_t  *frontsector;
+R_THREADLOCAL sector_t  *backsector;
+R_THREADLOCAL drawseg_t *ds_p;
 
 // killough 4/7/98: indicates doors closed wrt automap bugfix:
 // cph - replaced by linedef rendering flags - int      doorclosed;
 
 // killough: New code which removes 2s linedef limit
-drawseg_t *drawsegs;
-unsigned  maxdrawsegs;
+R_THREADLOCAL drawseg_t *drawsegs;
+R_THREADLOCAL unsigned  maxdrawsegs;
 // drawseg_t drawsegs[MAXDRAWSEGS];       // old code -- killough
 
 //
@@ -69,7 +69,7 @@ void R_ClearDrawSegs(void)
 // Instead of clipsegs, let's try using an array with one entry for each column,
 // indicating whether it's blocked by a solid wall yet or not.
 
-byte solidcol[MAX_SCREENWIDTH];
+R_THREADLOCAL byte solidcol[MAX_SCREENWIDTH];
 
 // CPhipps -
 // R_ClipWallSegment
@@ -112,9 +112,9 @@ void R_ClearClipSegs (void)
 // cph - converted to R_RecalcLineFlags. This recalculates all the flags for
 // a line, including closure and texture tiling.
 
-static void R_RecalcLineFlags(void)
+static int R_LineFlags(void)
 {
-  linedef->r_validcount = gametic;
+  int r_flags;
 
   /* First decide if the line is closed, normal, or invisible */
   if (!(linedef->flags & ML_TWOSIDED)
@@ -136,7 +136,7 @@ static void R_RecalcLineFlags(void)
         frontsector->ceilingpic!=skyflatnum)
     )
       )
-    linedef->r_flags = RF_CLOSED;
+    r_flags = RF_CLOSED;
   else {
     // Reject empty lines used for triggers
     //  and special events.
@@ -153,13 +153,13 @@ static void R_RecalcLineFlags(void)
       sizeof(frontsector->ceilingpic) + sizeof(frontsector->floorpic) +
       sizeof(frontsector->lightlevel) + sizeof(frontsector->floorlightsec) +
       sizeof(frontsector->ceilinglightsec))) {
-      linedef->r_flags = 0; return;
+      return 0;
     } else
-      linedef->r_flags = RF_IGNORE;
+      r_flags = RF_IGNORE;
   }
 
   /* cph - I'm too lazy to try and work with offsets in this */
-  if (curline->sidedef->rowoffset) return;
+  if (curline->sidedef->rowoffset) return r_flags;
 
   /* Now decide on texture tiling */
   if (linedef->flags & ML_TWOSIDED) {
@@ -168,19 +168,30 @@ static void R_RecalcLineFlags(void)
     /* Does top texture need tiling */
     if ((c = frontsector->ceilingheight - backsector->ceilingheight) > 0 &&
    (textureheight[texturetranslation[curline->sidedef->toptexture]] > c))
-      linedef->r_flags |= RF_TOP_TILE;
+      r_flags |= RF_TOP_TILE;
 
     /* Does bottom texture need tiling */
     if ((c = frontsector->floorheight - backsector->floorheight) > 0 &&
    (textureheight[texturetranslation[curline->sidedef->bottomtexture]] > c))
-      linedef->r_flags |= RF_BOT_TILE;
+      r_flags |= RF_BOT_TILE;
   } else {
     int c;
     /* Does middle texture need tiling */
     if ((c = frontsector->ceilingheight - frontsector->floorheight) > 0 &&
    (textureheight[texturetranslation[curline->sidedef->midtexture]] > c))
-      linedef->r_flags |= RF_MID_TILE;
+      r_flags |= RF_MID_TILE;
   }
+  return r_flags;
+}
+
+// Render threads can get here for the same line at once. They all work
+// out the same flags, and r_validcount only says they are done after
+// r_flags has been written.
+
+static void R_RecalcLineFlags(void)
+{
+  linedef->r_flags = R_LineFlags();
+  __atomic_store_n(&linedef->r_validcount, gametic, __ATOMIC_RELEASE);
 }
 
 //
@@ -300,7 +311,7 @@ static void R_AddLine (seg_t *line)
   angle_t  angle2;
   angle_t  span;
   angle_t  tspan;
-  static sector_t tempsec;     // killough 3/8/98: ceiling/water hack
+  static R_THREADLOCAL sector_t tempsec; // killough 3/8/98: ceiling/water hack
 
   curline = line;
 
@@ -362,7 +373,7 @@ static void R_AddLine (seg_t *line)
       {
         unsigned pos = ds_p - drawsegs; // jff 8/9/98 fix from ZDOOM1.14a
         unsigned newmax = maxdrawsegs ? maxdrawsegs*2 : 128; // killough
-        drawsegs = realloc(drawsegs,newmax*sizeof(*drawsegs));
+        drawsegs = (realloc)(drawsegs,newmax*sizeof(*drawsegs));
         //ds_p = drawsegs+maxdrawsegs;
         ds_p = drawsegs + pos;          // jff 8/9/98 fix from ZDOOM1.14a
         maxdrawsegs = newmax;
@@ -389,7 +400,8 @@ static void R_AddLine (seg_t *line)
     backsector = R_FakeFlat(backsector, &tempsec, NULL, NULL, true);
 
   /* cph - roll up linedef properties in flags */
-  if ((linedef = curline->linedef)->r_validcount != gametic)
+  linedef = curline->linedef;
+  if (__atomic_load_n(&linedef->r_validcount, __ATOMIC_ACQUIRE) != gametic)
     R_RecalcLineFlags();
 
   if (linedef->r_flags & RF_IGNORE)
@@ -38,21 +38,21 @@
 #pragma interface
 #endif
 
-extern seg_t    *curline;
-extern side_t   *sidedef;
-extern line_t   *linedef;
-extern sector_t *frontsector;
-extern sector_t *backsector;
+extern R_THREADLOCAL seg_t    *curline;
+extern R_THREADLOCAL side_t   *sidedef;
+extern R_THREADLOCAL line_t   *linedef;
+extern R_THREADLOCAL sector_t *frontsector;
+extern R_THREADLOCAL sector_t *backsector;
 
 /* old code -- killough:
  * extern drawseg_t drawsegs[MAXDRAWSEGS];
  * new code -- killough: */
-extern drawseg_t *drawsegs;
-extern unsigned maxdrawsegs;
+extern R_THREADLOCAL drawseg_t *drawsegs;
+extern R_THREADLOCAL unsigned maxdrawsegs;
 
-extern byte solidcol[MAX_SCREENWIDTH];
+extern R_THREADLOCAL byte solidcol[MAX_SCREENWIDTH];
 
-extern drawseg_t *ds_p;
+extern R_THREADLOCAL drawseg_t *ds_p;
 
 void R_ClearClipSegs(void);
 void R_ClearDrawSegs(void);
@@ -98,7 +98,8 @@ int R_ColormapNumForName(const char *name);      // killough 4/4/98
 /* cph 2001/11/17 - new func to do lighting calcs and get suitable colour map */
 const lighttable_t* R_ColourMap(int lightlevel, fixed_t spryscale);
 
-extern const byte *main_tranmap, *tranmap;
+extern const byte *main_tranmap;
+extern R_THREADLOCAL const byte *tranmap;
 
 /* Proff - Added for OpenGL - cph - const char* param */
 void R_SetPatchNum(patchnum_t *patchnum, const char *name);
@@ -58,6 +58,14 @@
 
 #define MAXDRAWSEGS   256
 
+// The software renderer's per frame state. With RENDER_THREADS each render
+// thread has its own copy and draws one strip of the view with it.
+#ifdef RENDER_THREADS
+#define R_THREADLOCAL __thread
+#else
+#define R_THREADLOCAL
+#endif
+
 //
 // INTERNAL MAP TYPES
 //  used by play and refresh
@@ -156,6 +164,8 @@ typedef struct
 	int numVerts;
 	unsigned short *indexes[2];		// floor = 0, ceiling = 1
 	struct drawVert_s *verts[2];
+	int vertLight[2];				// light the vert colors were faded from
+	unsigned vertLightGen[2];		// lightGen when they were faded
 #endif
 } sector_t;
 
@@ -428,11 +438,9 @@ typedef struct visplane
   int picnum, lightlevel, minx, maxx;
   fixed_t height;
   fixed_t xoffs, yoffs;         // killough 2/28/98: Support scrolling flats
+  unsigned int *bottom;       // in the same block as top, after its pads
   unsigned int pad1;          // leave pads for [minx-1]/[maxx+1]
-  unsigned int top[MAX_SCREENWIDTH];
-  unsigned int pad2, pad3;    // killough 2/8/98, 4/25/98
-  unsigned int bottom[MAX_SCREENWIDTH];
-  unsigned int pad4; // dropoff overflow
+  unsigned int top[1];        // SCREENWIDTH wide, see new_visplane
 } visplane_t;
 
 #endif
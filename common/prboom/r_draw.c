@@ -37,12 +37,14 @@
 #include "w_wad.h"
 #include "r_main.h"
 #include "r_draw.h"
+#include "r_drawsimd.h"
 #include "r_filter.h"
 #include "v_video.h"
 #include "st_stuff.h"
 #include "g_game.h"
 #include "am_map.h"
 #include "lprintf.h"
+#include "i_system.h"
 
 //
 // All drawing to the view buffer is accomplished in this file.
@@ -68,7 +70,7 @@ int  viewwindowy;
 //
 
 // CPhipps - made const*'s
-const byte *tranmap;          // translucency filter maps 256x256   // phares
+R_THREADLOCAL const byte *tranmap; // translucency filter maps 256x256   // phares
 const byte *main_tranmap;     // killough 4/11/98
 
 //
@@ -87,17 +89,25 @@ typedef enum
    COL_FLEXADD
 } columntype_e;
 
-static int    temp_x = 0;
-static int    tempyl[4], tempyh[4];
-static byte           byte_tempbuf[MAX_SCREENHEIGHT * 4];
-static unsigned short short_tempbuf[MAX_SCREENHEIGHT * 4];
-static unsigned int   int_tempbuf[MAX_SCREENHEIGHT * 4];
-static int    startx = 0;
-static int    temptype = COL_NONE;
-static int    commontop, commonbot;
-static const byte *temptranmap = NULL;
+static R_THREADLOCAL int    temp_x = 0;
+static R_THREADLOCAL int    tempyl[4], tempyh[4];
+static R_THREADLOCAL byte           byte_tempbuf[MAX_SCREENHEIGHT * 4];
+static R_THREADLOCAL unsigned short short_tempbuf[MAX_SCREENHEIGHT * 4];
+static R_THREADLOCAL unsigned int   int_tempbuf[MAX_SCREENHEIGHT * 4];
+static R_THREADLOCAL int    startx = 0;
+static R_THREADLOCAL int    temptype = COL_NONE;
+static R_THREADLOCAL int    commontop, commonbot;
+static R_THREADLOCAL const byte *temptranmap = NULL;
 // SoM 7-28-04: Fix the fuzz problem.
-static const byte   *tempfuzzmap;
+static R_THREADLOCAL const byte   *tempfuzzmap;
+
+// The view columns this thread draws. The column pipeline still goes
+// through every column so that it flushes, and moves the fuzz along,
+// exactly as it would drawing the whole view; only the pixels outside
+// the strip are left alone.
+R_THREADLOCAL int drawstripx1 = 0, drawstripx2 = MAX_SCREENWIDTH-1;
+
+#define R_OutsideStrip(x) ((x) < drawstripx1 || (x) > drawstripx2)
 
 //
 // Spectre/Invisibility.
@@ -120,7 +130,7 @@ static const int fuzzoffset_org[FUZZTABLE] = {
 
 static int fuzzoffset[FUZZTABLE];
 
-static int fuzzpos = 0;
+R_THREADLOCAL int fuzzpos = 0;
 
 // render pipelines
 #define RDC_STANDARD      1
@@ -141,6 +151,7 @@ draw_vars_t drawvars = {
   0, // byte_pitch
   0, // short_pitch
   0, // int_pitch
+  0, // tilestride
   RDRAW_FILTER_POINT, // filterwall
   RDRAW_FILTER_POINT, // filterfloor
   RDRAW_FILTER_POINT, // filtersprite
@@ -175,9 +186,9 @@ static void R_QuadFlushError(void)
    I_Error("R_FlushQuadColumn called without being initialized.\n");
 }
 
-static void (*R_FlushWholeColumns)(void) = R_FlushWholeError;
-static void (*R_FlushHTColumns)(void)    = R_FlushHTError;
-static void (*R_FlushQuadColumn)(void) = R_QuadFlushError;
+static R_THREADLOCAL void (*R_FlushWholeColumns)(void) = R_FlushWholeError;
+static R_THREADLOCAL void (*R_FlushHTColumns)(void)    = R_FlushHTError;
+static R_THREADLOCAL void (*R_FlushQuadColumn)(void) = R_QuadFlushError;
 
 static void R_FlushColumns(void)
 {
@@ -214,6 +225,7 @@ void R_ResetColumnBuffer(void)
 #define R_FLUSHWHOLE_FUNCNAME R_FlushWhole8
 #define R_FLUSHHEADTAIL_FUNCNAME R_FlushHT8
 #define R_FLUSHQUAD_FUNCNAME R_FlushQuad8
+#define R_FLUSHCOLUMN_FUNCNAME R_FlushColumn8
 #include "r_drawflush.inl"
 
 #define R_DRAWCOLUMN_PIPELINE RDC_TRANSLUCENT
@@ -221,6 +233,7 @@ void R_ResetColumnBuffer(void)
 #define R_FLUSHWHOLE_FUNCNAME R_FlushWholeTL8
 #define R_FLUSHHEADTAIL_FUNCNAME R_FlushHTTL8
 #define R_FLUSHQUAD_FUNCNAME R_FlushQuadTL8
+#define R_FLUSHCOLUMN_FUNCNAME R_FlushColumnTL8
 #include "r_drawflush.inl"
 
 #define R_DRAWCOLUMN_PIPELINE RDC_FUZZ
@@ -228,6 +241,7 @@ void R_ResetColumnBuffer(void)
 #define R_FLUSHWHOLE_FUNCNAME R_FlushWholeFuzz8
 #define R_FLUSHHEADTAIL_FUNCNAME R_FlushHTFuzz8
 #define R_FLUSHQUAD_FUNCNAME R_FlushQuadFuzz8
+#define R_FLUSHCOLUMN_FUNCNAME R_FlushColumnFuzz8
 #include "r_drawflush.inl"
 
 #define R_DRAWCOLUMN_PIPELINE RDC_STANDARD
@@ -235,6 +249,7 @@ void R_ResetColumnBuffer(void)
 #define R_FLUSHWHOLE_FUNCNAME R_FlushWhole15
 #define R_FLUSHHEADTAIL_FUNCNAME R_FlushHT15
 #define R_FLUSHQUAD_FUNCNAME R_FlushQuad15
+#define R_FLUSHCOLUMN_FUNCNAME R_FlushColumn15
 #include "r_drawflush.inl"
 
 #define R_DRAWCOLUMN_PIPELINE RDC_TRANSLUCENT
@@ -242,6 +257,7 @@ void R_ResetColumnBuffer(void)
 #define R_FLUSHWHOLE_FUNCNAME R_FlushWholeTL15
 #define R_FLUSHHEADTAIL_FUNCNAME R_FlushHTTL15
 #define R_FLUSHQUAD_FUNCNAME R_FlushQuadTL15
+#define R_FLUSHCOLUMN_FUNCNAME R_FlushColumnTL15
 #include "r_drawflush.inl"
 
 #define R_DRAWCOLUMN_PIPELINE RDC_FUZZ
@@ -249,6 +265,7 @@ void R_ResetColumnBuffer(void)
 #define R_FLUSHWHOLE_FUNCNAME R_FlushWholeFuzz15
 #define R_FLUSHHEADTAIL_FUNCNAME R_FlushHTFuzz15
 #define R_FLUSHQUAD_FUNCNAME R_FlushQuadFuzz15
+#define R_FLUSHCOLUMN_FUNCNAME R_FlushColumnFuzz15
 #include "r_drawflush.inl"
 
 #define R_DRAWCOLUMN_PIPELINE RDC_STANDARD
@@ -256,6 +273,7 @@ void R_ResetColumnBuffer(void)
 #define R_FLUSHWHOLE_FUNCNAME R_FlushWhole16
 #define R_FLUSHHEADTAIL_FUNCNAME R_FlushHT16
 #define R_FLUSHQUAD_FUNCNAME R_FlushQuad16
+#define R_FLUSHCOLUMN_FUNCNAME R_FlushColumn16
 #include "r_drawflush.inl"
 
 #define R_DRAWCOLUMN_PIPELINE RDC_TRANSLUCENT
@@ -263,6 +281,7 @@ void R_ResetColumnBuffer(void)
 #define R_FLUSHWHOLE_FUNCNAME R_FlushWholeTL16
 #define R_FLUSHHEADTAIL_FUNCNAME R_FlushHTTL16
 #define R_FLUSHQUAD_FUNCNAME R_FlushQuadTL16
+#define R_FLUSHCOLUMN_FUNCNAME R_FlushColumnTL16
 #include "r_drawflush.inl"
 
 #define R_DRAWCOLUMN_PIPELINE RDC_FUZZ
@@ -270,6 +289,7 @@ void R_ResetColumnBuffer(void)
 #define R_FLUSHWHOLE_FUNCNAME R_FlushWholeFuzz16
 #define R_FLUSHHEADTAIL_FUNCNAME R_FlushHTFuzz16
 #define R_FLUSHQUAD_FUNCNAME R_FlushQuadFuzz16
+#define R_FLUSHCOLUMN_FUNCNAME R_FlushColumnFuzz16
 #include "r_drawflush.inl"
 
 #define R_DRAWCOLUMN_PIPELINE RDC_STANDARD
@@ -277,6 +297,7 @@ void R_ResetColumnBuffer(void)
 #define R_FLUSHWHOLE_FUNCNAME R_FlushWhole32
 #define R_FLUSHHEADTAIL_FUNCNAME R_FlushHT32
 #define R_FLUSHQUAD_FUNCNAME R_FlushQuad32
+#define R_FLUSHCOLUMN_FUNCNAME R_FlushColumn32
 #include "r_drawflush.inl"
 
 #define R_DRAWCOLUMN_PIPELINE RDC_TRANSLUCENT
@@ -284,6 +305,7 @@ void R_ResetColumnBuffer(void)
 #define R_FLUSHWHOLE_FUNCNAME R_FlushWholeTL32
 #define R_FLUSHHEADTAIL_FUNCNAME R_FlushHTTL32
 #define R_FLUSHQUAD_FUNCNAME R_FlushQuadTL32
+#define R_FLUSHCOLUMN_FUNCNAME R_FlushColumnTL32
 #include "r_drawflush.inl"
 
 #define R_DRAWCOLUMN_PIPELINE RDC_FUZZ
@@ -291,6 +313,7 @@ void R_ResetColumnBuffer(void)
 #define R_FLUSHWHOLE_FUNCNAME R_FlushWholeFuzz32
 #define R_FLUSHHEADTAIL_FUNCNAME R_FlushHTFuzz32
 #define R_FLUSHQUAD_FUNCNAME R_FlushQuadFuzz32
+#define R_FLUSHCOLUMN_FUNCNAME R_FlushColumnFuzz32
 #include "r_drawflush.inl"
 
 //
@@ -986,6 +1009,10 @@ void R_DrawSpan(draw_span_vars_t *dsvars) {
   R_GetDrawSpanFunc(drawvars.filterfloor, drawvars.filterz)(dsvars);
 }
 
+int render_tiled;        // -tiledview, see r_draw.h
+static byte *tiledview;   // cache line aligned in tiledviewmem
+static void *tiledviewmem;
+
 //
 // R_InitBuffer
 // Creats lookup tables that avoid
@@ -1007,22 +1034,78 @@ void R_InitBuffer(int width, int height)
 
   viewwindowy = width==SCREENWIDTH ? 0 : (SCREENHEIGHT-(ST_SCALED_HEIGHT-1)-height)>>1;
 
-  drawvars.byte_topleft = screens[0].data + viewwindowy*screens[0].byte_pitch + viewwindowx;
-  drawvars.short_topleft = (unsigned short *)(screens[0].data) + viewwindowy*screens[0].short_pitch + viewwindowx;
-  drawvars.int_topleft = (unsigned int *)(screens[0].data) + viewwindowy*screens[0].int_pitch + viewwindowx;
-  drawvars.byte_pitch = screens[0].byte_pitch;
-  drawvars.short_pitch = screens[0].short_pitch;
-  drawvars.int_pitch = screens[0].int_pitch;
+  if (render_tiled && V_GetMode() != VID_MODEGL) {
+    const int tilesx = (width + R_TILEMASK) >> R_TILESHIFT;
+    const int tilesy = (height + R_TILEMASK) >> R_TILESHIFT;
+
+    // aligned, so that a row of a tile is whole cache lines
+    free(tiledviewmem);
+    tiledviewmem = calloc(1, (size_t)tilesx*tilesy*R_TILESIZE*R_TILESIZE*V_GetPixelDepth() + 63);
+    tiledview = (byte *)(((size_t)tiledviewmem + 63) & ~(size_t)63);
+
+    drawvars.byte_topleft = tiledview;
+    drawvars.short_topleft = (unsigned short *)tiledview;
+    drawvars.int_topleft = (unsigned int *)tiledview;
+    drawvars.byte_pitch = R_TILESIZE;
+    drawvars.short_pitch = R_TILESIZE;
+    drawvars.int_pitch = R_TILESIZE;
+    drawvars.tilestride = tilesx << (2*R_TILESHIFT);
+  } else {
+    drawvars.byte_topleft = screens[0].data + viewwindowy*screens[0].byte_pitch + viewwindowx;
+    drawvars.short_topleft = (unsigned short *)(screens[0].data) + viewwindowy*screens[0].short_pitch + viewwindowx;
+    drawvars.int_topleft = (unsigned int *)(screens[0].data) + viewwindowy*screens[0].int_pitch + viewwindowx;
+    drawvars.byte_pitch = screens[0].byte_pitch;
+    drawvars.short_pitch = screens[0].short_pitch;
+    drawvars.int_pitch = screens[0].int_pitch;
+    drawvars.tilestride = 0;
+  }
 
   if (V_GetMode() == VID_MODE8) {
     for (i=0; i<FUZZTABLE; i++)
-      fuzzoffset[i] = fuzzoffset_org[i]*screens[0].byte_pitch;
+      fuzzoffset[i] = fuzzoffset_org[i]*drawvars.byte_pitch;
   } else if ((V_GetMode() == VID_MODE15) || (V_GetMode() == VID_MODE16)) {
     for (i=0; i<FUZZTABLE; i++)
-      fuzzoffset[i] = fuzzoffset_org[i]*screens[0].short_pitch;
+      fuzzoffset[i] = fuzzoffset_org[i]*drawvars.short_pitch;
   } else if (V_GetMode() == VID_MODE32) {
     for (i=0; i<FUZZTABLE; i++)
-      fuzzoffset[i] = fuzzoffset_org[i]*screens[0].int_pitch;
+      fuzzoffset[i] = fuzzoffset_org[i]*drawvars.int_pitch;
+  }
+}
+
+//
+// R_LinearizeView
+//
+// Copies columns x1 to x2 of a tiled view to where the view is in
+// screens[0], a row at a time so the writes stream.
+//
+
+void R_LinearizeView(int x1, int x2)
+{
+  const int depth = V_GetPixelDepth();
+  int x, y, run;
+
+  if (!drawvars.tilestride)
+    return;
+  if (x2 > viewwidth-1)
+    x2 = viewwidth-1;
+
+  for (y = 0; y < viewheight; y++)
+  {
+    byte *dest = screens[0].data + (viewwindowy+y)*screens[0].byte_pitch + viewwindowx*depth;
+
+    // r_drawsimd.c
+    if (depth == 4 && drawkernels.tile_row)
+    {
+      drawkernels.tile_row((unsigned int *)dest + x1,
+                           (const unsigned int *)tiledview + R_TILEOFFSET(x1, y),
+                           x1 & R_TILEMASK, x2 - x1 + 1);
+      continue;
+    }
+    for (x = x1; x <= x2; x += run)
+    {
+      run = R_TILERUN(x, x2 - x + 1);
+      memcpy(dest + x*depth, tiledview + R_TILEOFFSET(x, y)*depth, run*depth);
+    }
   }
 }
 
@@ -1128,3 +1211,316 @@ void R_DrawViewBorder(void)
   for (i = top+viewheight; i < (SCREENHEIGHT - ST_SCALED_HEIGHT); i++)
     R_VideoErase (0, i, SCREENWIDTH);
 }
+
+//
+// R_BenchmarkTiledView
+//
+// -tilebench: a made up frame -- a wall column at every x, floor and
+// ceiling spans above and below, then a translucent and a spectre sprite --
+// drawn into a linear screen and into a tiled view, which is linearized and
+// checked against the linear one. As well as the time, the pixel writes of
+// both go through a model of a 32KB 8 way L1 with 64 byte lines and a 64
+// entry 4 way data TLB with 4KB pages, so there is a miss count to show on
+// machines that won't give out their hardware counters; where they do,
+// I_ReadMemCounters' counts are printed as well.
+//
+
+#define TILEBENCH_TRIALS 8      // best of
+#define TILEBENCH_TEXH   128
+
+typedef struct {
+  int      sets, ways, shift;
+  uint_64_t *tags;              // sets*ways, most recent first, 0 is empty
+  uint_64_t misses;
+} benchcache_t;
+
+static void R_BenchCacheTouch(benchcache_t *c, uint_64_t addr)
+{
+  const uint_64_t tag = (addr >> c->shift) + 1;
+  uint_64_t *set = c->tags + (tag % c->sets) * c->ways;
+  int i;
+
+  for (i = 0; i < c->ways-1 && set[i] != tag; i++)
+    ;
+  if (set[i] != tag)
+    c->misses++;
+  memmove(set + 1, set, i * sizeof(*set));
+  set[0] = tag;
+}
+
+typedef struct {
+  int yl, yh;
+} benchcolumn_t;
+
+typedef struct {
+  int width, height;
+  benchcolumn_t *walls;
+  int spritex1, spritex2;       // the translucent one, the spectre is right of it
+  int spriteyl, spriteyh;
+} tilebench_t;
+
+static unsigned int tilebenchseed;
+
+static int R_TileBenchRandom(void)
+{
+  tilebenchseed = tilebenchseed * 1664525 + 1013904223;
+  return tilebenchseed >> 8;
+}
+
+// the frame, drawn with whatever layout R_InitBuffer set up
+static void R_TileBenchDraw(const tilebench_t *tb, const byte *texture, const byte *flat,
+                            const lighttable_t *colormap)
+{
+  R_DrawColumn_f wall = R_GetDrawColumnFunc(RDC_PIPELINE_STANDARD, RDRAW_FILTER_POINT, RDRAW_FILTER_POINT);
+  R_DrawColumn_f tl = R_GetDrawColumnFunc(RDC_PIPELINE_TRANSLUCENT, RDRAW_FILTER_POINT, RDRAW_FILTER_POINT);
+  R_DrawColumn_f fuzz = R_GetDrawColumnFunc(RDC_PIPELINE_FUZZ, RDRAW_FILTER_POINT, RDRAW_FILTER_POINT);
+  const int spritew = tb->spritex2 - tb->spritex1 + 1;
+  draw_column_vars_t dcvars;
+  draw_span_vars_t dsvars;
+  int x, y;
+
+  R_SetDefaultDrawColumnVars(&dcvars);
+  dcvars.texheight = TILEBENCH_TEXH;
+  dcvars.colormap = dcvars.nextcolormap = colormap;
+  fuzzpos = 0;
+
+  for (x = 0; x < tb->width; x++)
+  {
+    dcvars.x = x;
+    dcvars.yl = tb->walls[x].yl;
+    dcvars.yh = tb->walls[x].yh;
+    dcvars.iscale = FRACUNIT * 64 / (tb->walls[x].yh - tb->walls[x].yl + 1);
+    dcvars.texturemid = 0;
+    dcvars.source = dcvars.prevsource = dcvars.nextsource =
+      texture + (x & 63) * TILEBENCH_TEXH;
+    wall(&dcvars);
+  }
+  R_ResetColumnBuffer();
+
+  memset(&dsvars, 0, sizeof(dsvars));
+  dsvars.source = flat;
+  dsvars.colormap = dsvars.nextcolormap = colormap;
+  dsvars.x1 = 0;
+  dsvars.x2 = tb->width - 1;
+  for (y = 0; y < tb->height; y++)
+    if (y < tb->height/4 || y >= tb->height - tb->height/4)
+    {
+      const int dist = D_abs(y - tb->height/2) + 1;
+
+      dsvars.y = y;
+      dsvars.xstep = FRACUNIT * 16 / dist;
+      dsvars.ystep = FRACUNIT * 4 / dist;
+      dsvars.xfrac = y << 12;
+      dsvars.yfrac = FRACUNIT * 1024 / dist;
+      R_DrawSpan(&dsvars);
+    }
+
+  dcvars.yl = tb->spriteyl;
+  dcvars.yh = tb->spriteyh;
+  dcvars.iscale = FRACUNIT / 2;
+  for (x = tb->spritex1; x <= tb->spritex2 + spritew; x++)
+  {
+    dcvars.x = x;
+    dcvars.source = texture + (x & 63) * TILEBENCH_TEXH;
+    (x <= tb->spritex2 ? tl : fuzz)(&dcvars);
+  }
+  R_ResetColumnBuffer();
+}
+
+// the same pixel writes, in the same order near enough, through the
+// cache and TLB models
+static void R_TileBenchTouch(benchcache_t *l1, benchcache_t *tlb, int x, int y)
+{
+  const uint_64_t addr = (uint_64_t)R_VIEWOFFSET(drawvars.int_pitch, x, y) * 4;
+
+  R_BenchCacheTouch(l1, addr);
+  R_BenchCacheTouch(tlb, addr);
+}
+
+static void R_TileBenchColumns(benchcache_t *l1, benchcache_t *tlb,
+                               int x1, int x2, const benchcolumn_t *columns,
+                               int yl, int yh)
+{
+  int x, y, k;
+
+  // a quad at a time, like the flushes
+  for (x = x1; x <= x2; x += 4)
+  {
+    const int n = x + 4 <= x2 + 1 ? 4 : x2 + 1 - x;
+    int top = columns ? columns[x].yl : yl;
+    int bot = columns ? columns[x].yh : yh;
+
+    for (k = 1; columns && k < n; k++)
+    {
+      top = MIN(top, columns[x+k].yl);
+      bot = MAX(bot, columns[x+k].yh);
+    }
+    for (y = top; y <= bot; y++)
+      for (k = 0; k < n; k++)
+        if (!columns || (y >= columns[x+k].yl && y <= columns[x+k].yh))
+          R_TileBenchTouch(l1, tlb, x + k, y);
+  }
+}
+
+static void R_TileBenchModel(const tilebench_t *tb, benchcache_t *l1, benchcache_t *tlb)
+{
+  const int spritew = tb->spritex2 - tb->spritex1 + 1;
+  int x, y;
+
+  R_TileBenchColumns(l1, tlb, 0, tb->width - 1, tb->walls, 0, 0);
+  for (y = 0; y < tb->height; y++)
+    if (y < tb->height/4 || y >= tb->height - tb->height/4)
+      for (x = 0; x < tb->width; x++)
+        R_TileBenchTouch(l1, tlb, x, y);
+  R_TileBenchColumns(l1, tlb, tb->spritex1, tb->spritex2 + spritew, NULL,
+                     tb->spriteyl, tb->spriteyh);
+}
+
+// the linearize reads every pixel once and writes it to the screen, which
+// is past the end of the tiles as far as the models go
+static void R_TileBenchModelLinearize(const tilebench_t *tb, benchcache_t *l1, benchcache_t *tlb)
+{
+  const uint_64_t screen = (uint_64_t)(drawvars.tilestride *
+    ((tb->height + R_TILEMASK) >> R_TILESHIFT)) * 4 + (1 << 20);
+  int x, y;
+
+  for (y = 0; y < tb->height; y++)
+    for (x = 0; x < tb->width; x++)
+    {
+      const uint_64_t dest = screen + ((uint_64_t)y * tb->width + x) * 4;
+
+      R_TileBenchTouch(l1, tlb, x, y);
+      R_BenchCacheTouch(l1, dest);
+      R_BenchCacheTouch(tlb, dest);
+    }
+}
+
+void R_BenchmarkTiledView(int width, int height)
+{
+  static const char *layouts[2] = {"linear", "tiled"};
+  const video_mode_t oldmode = V_GetMode();
+  const screeninfo_t oldscreen = screens[0];
+  const draw_vars_t olddrawvars = drawvars;
+  unsigned int *const oldpalette = V_Palette32;
+  const int oldwidth = SCREENWIDTH, oldheight = SCREENHEIGHT;
+  const int oldviewwidth = viewwidth, oldviewheight = viewheight;
+  const int oldcentery = centery, oldtiled = render_tiled;
+  const size_t size = (size_t)width * height * 4;
+  static unsigned int palette[256*VID_NUMCOLORWEIGHTS];
+  static byte texture[64*TILEBENCH_TEXH], flat[64*64], colormap[256];
+  unsigned int *frames[2];
+  uint_64_t l1tags[64*8], tlbtags[16*4];
+  double linear = 0;
+  tilebench_t tb;
+  int i, tiled;
+
+  width = width < 320 ? 320 : width > MAX_SCREENWIDTH ? MAX_SCREENWIDTH : width;
+  height = height < 200 ? 200 : height > MAX_SCREENHEIGHT ? MAX_SCREENHEIGHT : height;
+
+  V_InitMode(VID_MODE32);
+  lprintf(LO_INFO, "R_InitDrawSIMD ");
+  R_InitDrawSIMD();
+  lprintf(LO_INFO, "\n");
+  V_Palette32 = palette;
+  SCREENWIDTH = viewwidth = tb.width = width;
+  SCREENHEIGHT = viewheight = tb.height = height;
+  centery = height / 2;
+
+  tilebenchseed = 1;
+  for (i = 0; i < 256*VID_NUMCOLORWEIGHTS; i++)
+    palette[i] = R_TileBenchRandom() & 0xffffff;
+  for (i = 0; i < 64*TILEBENCH_TEXH; i++)
+    texture[i] = R_TileBenchRandom();
+  for (i = 0; i < 64*64; i++)
+    flat[i] = R_TileBenchRandom();
+  for (i = 0; i < 256; i++)
+    colormap[i] = R_TileBenchRandom();
+
+  tb.walls = malloc(width * sizeof(*tb.walls));
+  for (i = 0; i < width; i++)
+  {
+    tb.walls[i].yl = height/4 + R_TileBenchRandom() % (height/8);
+    tb.walls[i].yh = height - height/4 - 1 - R_TileBenchRandom() % (height/8);
+  }
+  tb.spritex1 = width/4;
+  tb.spritex2 = width/2 - 1;
+  tb.spriteyl = height/3;
+  tb.spriteyh = height - height/3;
+
+  lprintf(LO_INFO, "R_BenchmarkTiledView: %dx%d, %dx%d tiles, best of %d frames\n",
+          width, height, R_TILESIZE, R_TILESIZE, TILEBENCH_TRIALS);
+
+  for (tiled = 0; tiled < 2; tiled++)
+  {
+    benchcache_t l1 = {64, 8, 6, l1tags, 0}, tlb = {16, 4, 12, tlbtags, 0};
+    uint_64_t best = 0, bestlinearize = 0;
+    uint_64_t cache0, tlb0, cache1, tlb1;
+    boolean counted;
+    int trial;
+
+    frames[tiled] = calloc(1, size);
+    screens[0].data = (byte *)frames[tiled];
+    screens[0].width = width;
+    screens[0].height = height;
+    screens[0].byte_pitch = width * 4;
+    screens[0].short_pitch = width * 2;
+    screens[0].int_pitch = width;
+    render_tiled = tiled;
+    R_InitBuffer(width, height);
+
+    counted = I_ReadMemCounters(&cache0, &tlb0);
+    for (trial = 0; trial < TILEBENCH_TRIALS; trial++)
+    {
+      const uint_64_t start = I_GetTime_US();
+      uint_64_t drawn, time;
+
+      R_TileBenchDraw(&tb, texture, flat, colormap);
+      drawn = I_GetTime_US();
+      R_LinearizeView(0, width - 1);
+      time = I_GetTime_US() - start;
+      if (!best || time < best)
+        best = time, bestlinearize = time - (drawn - start);
+    }
+    counted = counted && I_ReadMemCounters(&cache1, &tlb1);
+
+    memset(l1tags, 0, sizeof(l1tags));
+    memset(tlbtags, 0, sizeof(tlbtags));
+    R_TileBenchModel(&tb, &l1, &tlb);
+
+    if (!tiled)
+      linear = best;
+    lprintf(LO_INFO, "%-6s %8.3f ms/frame", layouts[tiled], best / 1000.0);
+    if (tiled)
+      lprintf(LO_INFO, " (%.3f linearize) %.2fx", bestlinearize / 1000.0,
+              best ? linear / best : 0.0);
+    lprintf(LO_INFO, ", model %.0fk L1 %.0fk TLB misses",
+            l1.misses / 1000.0, tlb.misses / 1000.0);
+    if (tiled)
+    {
+      l1.misses = tlb.misses = 0;
+      R_TileBenchModelLinearize(&tb, &l1, &tlb);
+      lprintf(LO_INFO, " + %.0fk %.0fk linearize", l1.misses / 1000.0, tlb.misses / 1000.0);
+    }
+    if (counted)
+      lprintf(LO_INFO, ", counted %.0fk cache %.0fk dTLB misses/frame",
+              (cache1 - cache0) / 1000.0 / TILEBENCH_TRIALS,
+              (tlb1 - tlb0) / 1000.0 / TILEBENCH_TRIALS);
+    if (tiled && memcmp(frames[0], frames[1], size))
+      lprintf(LO_INFO, " DIFFERS");
+    lprintf(LO_INFO, "\n");
+  }
+
+  free(frames[0]);
+  free(frames[1]);
+  free(tb.walls);
+  render_tiled = oldtiled;
+  centery = oldcentery;
+  viewwidth = oldviewwidth;
+  viewheight = oldviewheight;
+  SCREENWIDTH = oldwidth;
+  SCREENHEIGHT = oldheight;
+  screens[0] = oldscreen;
+  drawvars = olddrawvars;
+  V_Palette32 = oldpalette;
+  V_InitMode(oldmode);
+}
@@ -109,6 +109,9 @@ typedef struct {
   int   byte_pitch;
   int   short_pitch;
   int   int_pitch;
+  // 0 for a linear screen, else pixels from one row of tiles to the next;
+  // the pitches are then the width of a tile
+  int   tilestride;
 
   enum draw_filter_type_e filterwall;
   enum draw_filter_type_e filterfloor;
@@ -127,6 +130,45 @@ typedef struct {
 
 extern draw_vars_t drawvars;
 
+//
+// Tiled view
+//
+// With -tiledview the software renderer draws the view into 64x64 pixel
+// tiles, each of them one block of memory, and R_LinearizeView copies the
+// tiles out to screens[0] when the view is done. The column flushes then
+// step 64 pixels a row inside a tile rather than a whole screen pitch,
+// which at high resolutions costs a cache line and a TLB entry a pixel.
+//
+
+#define R_TILESHIFT 6
+#define R_TILESIZE  (1<<R_TILESHIFT)
+#define R_TILEMASK  (R_TILESIZE-1)
+
+// x,y's offset in pixels from the top left of a tiled view
+#define R_TILEOFFSET(x, y) \
+  (((y)>>R_TILESHIFT)*drawvars.tilestride + (((x)>>R_TILESHIFT)<<(2*R_TILESHIFT)) + \
+   (((y)&R_TILEMASK)<<R_TILESHIFT) + ((x)&R_TILEMASK))
+
+// x,y's offset from drawvars' topleft, pitch being the pitch in use
+#define R_VIEWOFFSET(pitch, x, y) \
+  (drawvars.tilestride ? R_TILEOFFSET(x, y) : (y)*(pitch) + (x))
+
+// how many of the count rows (or columns) from pos can be stepped through
+// with the pitch (or 1): all of them on a linear screen, up to the tile's
+// edge in a tiled view
+#define R_TILERUN(pos, count) \
+  (drawvars.tilestride && R_TILESIZE-((pos)&R_TILEMASK) < (count) ? \
+   R_TILESIZE-((pos)&R_TILEMASK) : (count))
+
+extern int render_tiled;    // -tiledview
+
+// copies view columns x1 to x2 of the tiled view out to screens[0]
+void R_LinearizeView(int x1, int x2);
+
+// draws the same made up frame into a linear and a tiled view and compares
+// the time and the cache misses, -tilebench
+void R_BenchmarkTiledView(int width, int height);
+
 extern byte playernumtotrans[MAXPLAYERS]; // CPhipps - what translation table for what player
 extern byte       *translationtables;
 
@@ -157,4 +199,9 @@ void R_DrawViewBorder(void);
 // column drawing.
 void R_ResetColumnBuffer(void);
 
+// Render threads: the view columns the calling thread draws, and where
+// the spectre fuzz pattern is at
+extern R_THREADLOCAL int drawstripx1, drawstripx2;
+extern R_THREADLOCAL int fuzzpos;
+
 #endif
@@ -81,6 +81,22 @@
  #define GETCOL32(frac, nextfrac) VID_PAL32(GETCOL8_DEPTH(source[(frac)>>FRACBITS]), VID_COLORWEIGHTMASK)
 #endif
 
+#if (R_DRAWCOLUMN_PIPELINE & RDC_TRANSLATED)
+ #define R_DRAWCOLUMN_TRANSLATION translation
+#else
+ #define R_DRAWCOLUMN_TRANSLATION NULL
+#endif
+#if (R_DRAWCOLUMN_PIPELINE & RDC_BILINEAR)
+ #define R_DRAWCOLUMN_KERNEL drawkernels.column_linear
+ #define R_DRAWCOLUMN_FRACU filter_fracu
+#elif (R_DRAWCOLUMN_PIPELINE & RDC_ROUNDED)
+ #define R_DRAWCOLUMN_KERNEL drawkernels.column_rounded
+ #define R_DRAWCOLUMN_FRACU filter_fracu
+#else
+ #define R_DRAWCOLUMN_KERNEL drawkernels.column_point
+ #define R_DRAWCOLUMN_FRACU 0
+#endif
+
 #if (R_DRAWCOLUMN_PIPELINE & (RDC_BILINEAR|RDC_ROUNDED|RDC_DITHERZ))
   #define INCY(y) (y++)
 #else
@@ -247,6 +263,10 @@ static void R_DRAWCOLUMN_FUNCNAME(draw_column_vars_t *dcvars)
 
 // do nothing else when drawin fuzz columns
 #if (!(R_DRAWCOLUMN_PIPELINE & RDC_FUZZ))
+  // another render thread draws this one, the flush will skip it
+  if (R_OutsideStrip(dcvars->x))
+    return;
+
   {
     const byte          *source = dcvars->source;
     const lighttable_t  *colormap = dcvars->colormap;
@@ -284,6 +304,17 @@ static void R_DRAWCOLUMN_FUNCNAME(draw_column_vars_t *dcvars)
 	
     count++;
 
+#if ((R_DRAWCOLUMN_PIPELINE_BITS == 32) && !(R_DRAWCOLUMN_PIPELINE & (RDC_DITHERZ|RDC_NOCOLMAP)))
+    // everything but the non power of two heights has a SIMD version of the
+    // loops below, see r_drawsimd.c
+    if (R_DRAWCOLUMN_KERNEL && !(dcvars->texheight & (dcvars->texheight-1))) {
+      R_DRAWCOLUMN_KERNEL(dest, count, frac,
+                          ((unsigned)(dcvars->texheight-1) << FRACBITS) | 0xffff,
+                          dcvars, R_DRAWCOLUMN_TRANSLATION, R_DRAWCOLUMN_FRACU);
+      return;
+    }
+#endif
+
     // Inner loop that does the actual texture mapping,
     //  e.g. a DDA-lile scaling.
     // This is as fast as it gets.       (Yeah, right!!! -- killough)
@@ -376,6 +407,9 @@ static void R_DRAWCOLUMN_FUNCNAME(draw_column_vars_t *dcvars)
 #undef GETCOL15
 #undef GETCOL8
 #undef GETCOL
+#undef R_DRAWCOLUMN_KERNEL
+#undef R_DRAWCOLUMN_FRACU
+#undef R_DRAWCOLUMN_TRANSLATION
 #undef INCY
 #undef INCFRAC
 #undef COLTYPE
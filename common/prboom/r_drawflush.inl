@@ -89,37 +89,44 @@
   #endif
 #endif
 
+#if (R_DRAWCOLUMN_PIPELINE & RDC_FUZZ)
+// The fuzz copies the pixel a row above or below; in a tiled view that row
+// can be in the next tile.
+#define FUZZPIXEL(dest, x, y, fuzz) \
+  (drawvars.tilestride && (((y) + fuzzoffset_org[fuzz]) ^ (y)) & ~R_TILEMASK ? \
+   drawvars.TOPLEFT[R_TILEOFFSET((x), (y) + fuzzoffset_org[fuzz])] : \
+   (dest)[fuzzoffset[fuzz]])
+#endif
+
 //
-// R_FlushWholeOpaque
+// R_FlushColumn
 //
-// Flushes the entire columns in the buffer, one at a time.
-// This is used when a quad flush isn't possible.
-// Opaque version -- no remapping whatsoever.
+// Flushes count rows of one buffered column, starting at row y, in one run
+// on a linear screen and one run per tile in a tiled view. Returns where
+// the fuzz got to.
 //
-static void R_FLUSHWHOLE_FUNCNAME(void)
+static int R_FLUSHCOLUMN_FUNCNAME(const SCREENTYPE *source, int x, int y, int count, int fuzz)
 {
-   SCREENTYPE *source;
    SCREENTYPE *dest;
-   int  count, yl;
+   int run;
 
-   while(--temp_x >= 0)
+   for (; count > 0; y += run, count -= run)
    {
-      yl     = tempyl[temp_x];
-      source = &TEMPBUF[temp_x + (yl << 2)];
-      dest   = drawvars.TOPLEFT + yl*drawvars.PITCH + startx + temp_x;
-      count  = tempyh[temp_x] - yl + 1;
-      
-      while(--count >= 0)
+      int n = run = R_TILERUN(y, count);
+
+      dest = drawvars.TOPLEFT + R_VIEWOFFSET(drawvars.PITCH, x, y);
+      while(--n >= 0)
       {
 #if (R_DRAWCOLUMN_PIPELINE & RDC_TRANSLUCENT)
+         // haleyjd 09/11/04: use temptranmap here
          *dest = GETDESTCOLOR(*dest, *source);
 #elif (R_DRAWCOLUMN_PIPELINE & RDC_FUZZ)
          // SoM 7-28-04: Fix the fuzz problem.
-         *dest = GETDESTCOLOR(dest[fuzzoffset[fuzzpos]]);
-         
+         *dest = GETDESTCOLOR(FUZZPIXEL(dest, x, y + run - n - 1, fuzz));
+
          // Clamp table lookup index.
-         if(++fuzzpos == FUZZTABLE) 
-            fuzzpos = 0;
+         if(++fuzz == FUZZTABLE)
+            fuzz = 0;
 #else
          *dest = *source;
 #endif
@@ -128,6 +135,36 @@ static void R_FLUSHWHOLE_FUNCNAME(void)
          dest += drawvars.PITCH;
       }
    }
+   return fuzz;
+}
+
+//
+// R_FlushWholeOpaque
+//
+// Flushes the entire columns in the buffer, one at a time.
+// This is used when a quad flush isn't possible.
+// Opaque version -- no remapping whatsoever.
+//
+static void R_FLUSHWHOLE_FUNCNAME(void)
+{
+   int  count, yl;
+
+   while(--temp_x >= 0)
+   {
+      yl     = tempyl[temp_x];
+      count  = tempyh[temp_x] - yl + 1;
+
+      if (R_OutsideStrip(startx + temp_x))
+      {
+#if (R_DRAWCOLUMN_PIPELINE & RDC_FUZZ)
+         fuzzpos = (fuzzpos + count) % FUZZTABLE;
+#endif
+         continue;
+      }
+
+      fuzzpos = R_FLUSHCOLUMN_FUNCNAME(&TEMPBUF[temp_x + (yl << 2)],
+                                       startx + temp_x, yl, count, fuzzpos);
+   }
 }
 
 //
@@ -139,70 +176,46 @@ static void R_FLUSHWHOLE_FUNCNAME(void)
 //
 static void R_FLUSHHEADTAIL_FUNCNAME(void)
 {
-   SCREENTYPE *source;
-   SCREENTYPE *dest;
    int count, colnum = 0;
    int yl, yh;
 
    while(colnum < 4)
    {
+      const boolean skip = R_OutsideStrip(startx + colnum);
+
       yl = tempyl[colnum];
       yh = tempyh[colnum];
       
       // flush column head
       if(yl < commontop)
       {
-         source = &TEMPBUF[colnum + (yl << 2)];
-         dest   = drawvars.TOPLEFT + yl*drawvars.PITCH + startx + colnum;
          count  = commontop - yl;
-         
-         while(--count >= 0)
+
+         if (skip)
          {
-#if (R_DRAWCOLUMN_PIPELINE & RDC_TRANSLUCENT)
-            // haleyjd 09/11/04: use temptranmap here
-            *dest = GETDESTCOLOR(*dest, *source);
-#elif (R_DRAWCOLUMN_PIPELINE & RDC_FUZZ)
-            // SoM 7-28-04: Fix the fuzz problem.
-            *dest = GETDESTCOLOR(dest[fuzzoffset[fuzzpos]]);
-            
-            // Clamp table lookup index.
-            if(++fuzzpos == FUZZTABLE) 
-               fuzzpos = 0;
-#else
-            *dest = *source;
+#if (R_DRAWCOLUMN_PIPELINE & RDC_FUZZ)
+            fuzzpos = (fuzzpos + count) % FUZZTABLE;
 #endif
-
-            source += 4;
-            dest += drawvars.PITCH;
          }
+         else
+            fuzzpos = R_FLUSHCOLUMN_FUNCNAME(&TEMPBUF[colnum + (yl << 2)],
+                                             startx + colnum, yl, count, fuzzpos);
       }
       
       // flush column tail
       if(yh > commonbot)
       {
-         source = &TEMPBUF[colnum + ((commonbot + 1) << 2)];
-         dest   = drawvars.TOPLEFT + (commonbot + 1)*drawvars.PITCH + startx + colnum;
          count  = yh - commonbot;
-         
-         while(--count >= 0)
+
+         if (skip)
          {
-#if (R_DRAWCOLUMN_PIPELINE & RDC_TRANSLUCENT)
-            // haleyjd 09/11/04: use temptranmap here
-            *dest = GETDESTCOLOR(*dest, *source);
-#elif (R_DRAWCOLUMN_PIPELINE & RDC_FUZZ)
-            // SoM 7-28-04: Fix the fuzz problem.
-            *dest = GETDESTCOLOR(dest[fuzzoffset[fuzzpos]]);
-            
-            // Clamp table lookup index.
-            if(++fuzzpos == FUZZTABLE) 
-               fuzzpos = 0;
-#else
-            *dest = *source;
+#if (R_DRAWCOLUMN_PIPELINE & RDC_FUZZ)
+            fuzzpos = (fuzzpos + count) % FUZZTABLE;
 #endif
-
-            source += 4;
-            dest += drawvars.PITCH;
          }
+         else
+            fuzzpos = R_FLUSHCOLUMN_FUNCNAME(&TEMPBUF[colnum + ((commonbot + 1) << 2)],
+                                             startx + colnum, commonbot + 1, count, fuzzpos);
       }         
       ++colnum;
    }
@@ -210,9 +223,9 @@ static void R_FLUSHHEADTAIL_FUNCNAME(void)
 
 static void R_FLUSHQUAD_FUNCNAME(void)
 {
-   SCREENTYPE *source = &TEMPBUF[commontop << 2];
-   SCREENTYPE *dest = drawvars.TOPLEFT + commontop*drawvars.PITCH + startx;
-   int count;
+   SCREENTYPE *source;
+   SCREENTYPE *dest;
+   int count, run, y;
 #if (R_DRAWCOLUMN_PIPELINE & RDC_FUZZ)
    int fuzz1, fuzz2, fuzz3, fuzz4;
 
@@ -224,64 +237,114 @@ static void R_FLUSHQUAD_FUNCNAME(void)
 
    count = commonbot - commontop + 1;
 
-#if (R_DRAWCOLUMN_PIPELINE & RDC_TRANSLUCENT)
-   while(--count >= 0)
+   // part of the quad belongs to another render thread, or is in the next
+   // tile over; column by column does the same to each pixel, a column only
+   // reads itself
+   if (R_OutsideStrip(startx) || R_OutsideStrip(startx + 3) ||
+       R_TILERUN(startx, 4) < 4)
    {
-      dest[0] = GETDESTCOLOR(dest[0], source[0]);
-      dest[1] = GETDESTCOLOR(dest[1], source[1]);
-      dest[2] = GETDESTCOLOR(dest[2], source[2]);
-      dest[3] = GETDESTCOLOR(dest[3], source[3]);
-      source += 4 * sizeof(byte);
-      dest += drawvars.PITCH * sizeof(byte);
+#if (R_DRAWCOLUMN_PIPELINE & RDC_FUZZ)
+      const int fuzzstart[4] = {fuzz1, fuzz2, fuzz3, fuzz4};
+#else
+      const int fuzzstart[4] = {0, 0, 0, 0};
+#endif
+      int colnum;
+
+      for (colnum = 0; colnum < 4; colnum++)
+         if (!R_OutsideStrip(startx + colnum))
+            R_FLUSHCOLUMN_FUNCNAME(&TEMPBUF[(commontop << 2) + colnum],
+                                   startx + colnum, commontop, count,
+                                   fuzzstart[colnum]);
+      return;
    }
-#elif (R_DRAWCOLUMN_PIPELINE & RDC_FUZZ)
-   while(--count >= 0)
+
+   // the quad never straddles a tile, but it can go down through several
+   for (y = commontop; count > 0; y += run, count -= run)
    {
-      dest[0] = GETDESTCOLOR(dest[0 + fuzzoffset[fuzz1]]);
-      dest[1] = GETDESTCOLOR(dest[1 + fuzzoffset[fuzz2]]);
-      dest[2] = GETDESTCOLOR(dest[2 + fuzzoffset[fuzz3]]);
-      dest[3] = GETDESTCOLOR(dest[3 + fuzzoffset[fuzz4]]);
-      fuzz1 = (fuzz1 + 1) % FUZZTABLE;
-      fuzz2 = (fuzz2 + 1) % FUZZTABLE;
-      fuzz3 = (fuzz3 + 1) % FUZZTABLE;
-      fuzz4 = (fuzz4 + 1) % FUZZTABLE;
-      source += 4 * sizeof(byte);
-      dest += drawvars.PITCH * sizeof(byte);
-   }
+      int n = run = R_TILERUN(y, count);
+
+      source = &TEMPBUF[y << 2];
+      dest = drawvars.TOPLEFT + R_VIEWOFFSET(drawvars.PITCH, startx, y);
+
+#if ((R_DRAWCOLUMN_PIPELINE_BITS == 32) && !(R_DRAWCOLUMN_PIPELINE & RDC_FUZZ))
+      // r_drawsimd.c
+#if (R_DRAWCOLUMN_PIPELINE & RDC_TRANSLUCENT)
+      if (drawkernels.quad_blend)
+      {
+         drawkernels.quad_blend(dest, drawvars.PITCH, source, n);
+         continue;
+      }
 #else
-  #if (R_DRAWCOLUMN_PIPELINE_BITS == 8)
-   if ((sizeof(int) == 4) && (((int)source % 4) == 0) && (((int)dest % 4) == 0)) {
-      while(--count >= 0)
+      if (drawkernels.quad_copy)
+      {
+         drawkernels.quad_copy(dest, drawvars.PITCH, source, n);
+         continue;
+      }
+#endif
+#endif
+
+#if (R_DRAWCOLUMN_PIPELINE & RDC_TRANSLUCENT)
+      while(--n >= 0)
       {
-         *(int *)dest = *(int *)source;
+         dest[0] = GETDESTCOLOR(dest[0], source[0]);
+         dest[1] = GETDESTCOLOR(dest[1], source[1]);
+         dest[2] = GETDESTCOLOR(dest[2], source[2]);
+         dest[3] = GETDESTCOLOR(dest[3], source[3]);
          source += 4 * sizeof(byte);
          dest += drawvars.PITCH * sizeof(byte);
       }
-   } else {
-      while(--count >= 0)
+#elif (R_DRAWCOLUMN_PIPELINE & RDC_FUZZ)
+      while(--n >= 0)
+      {
+         const int row = y + run - n - 1;
+
+         dest[0] = GETDESTCOLOR(FUZZPIXEL(dest + 0, startx + 0, row, fuzz1));
+         dest[1] = GETDESTCOLOR(FUZZPIXEL(dest + 1, startx + 1, row, fuzz2));
+         dest[2] = GETDESTCOLOR(FUZZPIXEL(dest + 2, startx + 2, row, fuzz3));
+         dest[3] = GETDESTCOLOR(FUZZPIXEL(dest + 3, startx + 3, row, fuzz4));
+         fuzz1 = (fuzz1 + 1) % FUZZTABLE;
+         fuzz2 = (fuzz2 + 1) % FUZZTABLE;
+         fuzz3 = (fuzz3 + 1) % FUZZTABLE;
+         fuzz4 = (fuzz4 + 1) % FUZZTABLE;
+         source += 4 * sizeof(byte);
+         dest += drawvars.PITCH * sizeof(byte);
+      }
+#else
+  #if (R_DRAWCOLUMN_PIPELINE_BITS == 8)
+      if ((sizeof(int) == 4) && (((int)source % 4) == 0) && (((int)dest % 4) == 0)) {
+         while(--n >= 0)
+         {
+            *(int *)dest = *(int *)source;
+            source += 4 * sizeof(byte);
+            dest += drawvars.PITCH * sizeof(byte);
+         }
+      } else {
+         while(--n >= 0)
+         {
+            dest[0] = source[0];
+            dest[1] = source[1];
+            dest[2] = source[2];
+            dest[3] = source[3];
+            source += 4 * sizeof(byte);
+            dest += drawvars.PITCH * sizeof(byte);
+         }
+      }
+  #else
+      while(--n >= 0)
       {
          dest[0] = source[0];
          dest[1] = source[1];
          dest[2] = source[2];
          dest[3] = source[3];
-         source += 4 * sizeof(byte);
-         dest += drawvars.PITCH * sizeof(byte);
+         source += 4;
+         dest += drawvars.PITCH;
       }
-   }
-  #else
-   while(--count >= 0)
-   {
-      dest[0] = source[0];
-      dest[1] = source[1];
-      dest[2] = source[2];
-      dest[3] = source[3];
-      source += 4;
-      dest += drawvars.PITCH;
-   }
   #endif
 #endif
+   }
 }
 
+#undef FUZZPIXEL
 #undef GETDESTCOLOR32
 #undef GETDESTCOLOR16
 #undef GETDESTCOLOR15
@@ -298,3 +361,4 @@ static void R_FLUSHQUAD_FUNCNAME(void)
 #undef R_FLUSHWHOLE_FUNCNAME
 #undef R_FLUSHHEADTAIL_FUNCNAME
 #undef R_FLUSHQUAD_FUNCNAME
+#undef R_FLUSHCOLUMN_FUNCNAME
@@ -0,0 +1,468 @@
+/* Emacs style mode select   -*- C++ -*-
+ *-----------------------------------------------------------------------------
+ *
+ *
+ *  PrBoom: a Doom port merged with LxDoom and LSDLDoom
+ *  based on BOOM, a modified and improved DOOM engine
+ *  Copyright (C) 1999 by
+ *  id Software, Chi Hoang, Lee Killough, Jim Flynn, Rand Phares, Ty Halderman
+ *  Copyright (C) 1999-2000 by
+ *  Jess Haas, Nicolas Kalkhof, Colin Phipps, Florian Schulze
+ *  Copyright 2005, 2006 by
+ *  Florian Schulze, Colin Phipps, Neil Stevens, Andrey Budko
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ *  02111-1307, USA.
+ *
+ * DESCRIPTION:
+ *      Draw lists for the hardware renderers, see r_drawlist.h.
+ *
+ *      The buckets live as long as the list does, so after the first few
+ *      frames adding geometry is a hash lookup and a copy, with nothing to
+ *      sort: the order things are drawn in is the layer, then the order
+ *      the buckets first got something this frame.
+ *
+ *-----------------------------------------------------------------------------*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "doomtype.h"
+#include "i_system.h"
+#include "lprintf.h"
+#include "r_drawlist.h"
+
+static unsigned DL_Hash(const void *texture, unsigned state)
+{
+  unsigned h = (unsigned)((size_t)texture >> 4) ^ state * 0x9e3779b1u;
+  h *= 0x9e3779b1u;
+  return h ^ (h >> 16);
+}
+
+static void DL_Rehash(drawlist_t *dl, unsigned size)
+{
+  dlbucket_t **hash = calloc(size, sizeof *hash);
+  unsigned i;
+
+  if (!hash)
+    I_Error("DL_Rehash: out of memory for %u buckets", size);
+  if (dl->hash)
+    {
+      for (i = 0; i <= dl->hashmask; i++)
+        while (dl->hash[i])
+          {
+            dlbucket_t *b = dl->hash[i];
+            unsigned h = DL_Hash(b->texture, b->state) & (size-1);
+            dl->hash[i] = b->hashnext;
+            b->hashnext = hash[h];
+            hash[h] = b;
+          }
+      free(dl->hash);
+    }
+  dl->hash = hash;
+  dl->hashmask = size-1;
+}
+
+//
+// DL_Clear
+// Starts a frame, the buckets keep their memory
+//
+
+void DL_Clear(drawlist_t *dl)
+{
+  int i;
+
+  dl->frame++;
+  for (i = 0; i < DL_LAYERS; i++)
+    dl->first[i] = dl->last[i] = NULL;
+  dl->numindexes = dl->numbatches = 0;
+}
+
+//
+// DL_AddIndexes
+// Returns room for count indexes in the bucket for texture and state
+//
+
+dlindex_t *DL_AddIndexes(drawlist_t *dl, int layer, const void *texture,
+                         unsigned state, int count)
+{
+  dlbucket_t *b;
+  dlindex_t *out;
+  unsigned h;
+
+  if (!dl->hash)
+    DL_Rehash(dl, 64);
+
+  h = DL_Hash(texture, state) & dl->hashmask;
+  for (b = dl->hash[h]; b; b = b->hashnext)
+    if (b->texture == texture && b->state == state && b->layer == layer)
+      break;
+
+  if (!b)
+    {
+      if (!(b = calloc(1, sizeof *b)))
+        I_Error("DL_AddIndexes: out of memory for a bucket");
+      b->texture = texture;
+      b->state = state;
+      b->layer = layer;
+      b->frame = dl->frame - 1;
+      b->hashnext = dl->hash[h];
+      dl->hash[h] = b;
+      if (++dl->numbuckets > 2 * (int)(dl->hashmask+1))
+        DL_Rehash(dl, 2 * (dl->hashmask+1));
+    }
+
+  // the first thing in it this frame, it goes on the end of its layer
+  if (b->frame != dl->frame)
+    {
+      b->frame = dl->frame;
+      b->numindexes = 0;
+      b->next = NULL;
+      if (dl->last[layer])
+        dl->last[layer]->next = b;
+      else
+        dl->first[layer] = b;
+      dl->last[layer] = b;
+    }
+
+  if (b->numindexes + count > b->maxindexes)
+    {
+      b->maxindexes = b->maxindexes ? b->maxindexes*2 : 64;
+      if (b->maxindexes < b->numindexes + count)
+        b->maxindexes = b->numindexes + count;
+      b->indexes = realloc(b->indexes, b->maxindexes * sizeof *b->indexes);
+      if (!b->indexes)
+        I_Error("DL_AddIndexes: out of memory for %d indexes", b->maxindexes);
+    }
+
+  out = b->indexes + b->numindexes;
+  b->numindexes += count;
+  return out;
+}
+
+//
+// DL_Finish
+// Copies the frame's buckets into the merged index buffer, a batch each
+//
+
+void DL_Finish(drawlist_t *dl)
+{
+  int layer, total = 0, batches = 0;
+  dlbucket_t *b;
+
+  for (layer = 0; layer < DL_LAYERS; layer++)
+    for (b = dl->first[layer]; b; b = b->next)
+      total += b->numindexes, batches++;
+
+  if (total > dl->maxindexes)
+    {
+      free(dl->indexes);
+      dl->maxindexes = total*2;
+      if (!(dl->indexes = malloc(dl->maxindexes * sizeof *dl->indexes)))
+        I_Error("DL_Finish: out of memory for %d indexes", total);
+    }
+  if (batches > dl->maxbatches)
+    {
+      free(dl->batches);
+      dl->maxbatches = batches*2;
+      if (!(dl->batches = malloc(dl->maxbatches * sizeof *dl->batches)))
+        I_Error("DL_Finish: out of memory for %d batches", batches);
+    }
+
+  dl->numindexes = dl->numbatches = 0;
+  for (layer = 0; layer < DL_LAYERS; layer++)
+    for (b = dl->first[layer]; b; b = b->next)
+      if (b->numindexes)
+        {
+          dlbatch_t *batch = &dl->batches[dl->numbatches++];
+          batch->texture = b->texture;
+          batch->state = b->state;
+          batch->first = dl->numindexes;
+          batch->count = b->numindexes;
+          memcpy(dl->indexes + dl->numindexes, b->indexes,
+                 b->numindexes * sizeof *b->indexes);
+          dl->numindexes += b->numindexes;
+        }
+}
+
+//
+// DL_Submit
+// Draws the batches, only setting the state and texture when they change
+//
+
+void DL_Submit(const drawlist_t *dl, const dlbackend_t *backend)
+{
+  const void *bound = NULL;
+  unsigned state = 0;
+  int i;
+
+  for (i = 0; i < dl->numbatches; i++)
+    {
+      const dlbatch_t *batch = &dl->batches[i];
+
+      if (batch->state != state)
+        backend->SetState(state = batch->state);
+      if (batch->texture && batch->texture != bound)
+        backend->BindTexture(bound = batch->texture, batch->state);
+      backend->DrawIndexed(dl->indexes + batch->first, batch->count);
+    }
+  if (state)
+    backend->SetState(0);
+}
+
+//
+// DL_Free
+//
+
+void DL_Free(drawlist_t *dl)
+{
+  unsigned i;
+
+  if (dl->hash)
+    for (i = 0; i <= dl->hashmask; i++)
+      while (dl->hash[i])
+        {
+          dlbucket_t *b = dl->hash[i];
+          dl->hash[i] = b->hashnext;
+          free(b->indexes);
+          free(b);
+        }
+  free(dl->hash);
+  free(dl->indexes);
+  free(dl->batches);
+  memset(dl, 0, sizeof *dl);
+}
+
+//
+// The stub backend
+//
+// Counts what a real one would be asked to do. The checksum is over the
+// texture and state every index is drawn with, so two ways of drawing the
+// same frame can be checked against each other whatever order they go in.
+//
+
+dlcounts_t dl_stubcounts;
+static unsigned dl_stubchecksum;
+static const void *dl_stubtexture;
+static unsigned dl_stubstate;
+
+static void DL_StubSetState(unsigned state)
+{
+  dl_stubcounts.statechanges++;
+  dl_stubstate = state;
+}
+
+static void DL_StubBindTexture(const void *texture, unsigned state)
+{
+  dl_stubcounts.binds++;
+  dl_stubtexture = texture;
+}
+
+static void DL_StubDrawIndexed(const dlindex_t *indexes, int count)
+{
+  const unsigned key = DL_Hash(dl_stubtexture, dl_stubstate);
+  int i;
+
+  dl_stubcounts.drawcalls++;
+  dl_stubcounts.indexes += count;
+  for (i = 0; i < count; i++)
+    dl_stubchecksum += (key ^ indexes[i]) * 0x9e3779b1u;
+}
+
+const dlbackend_t dl_stubbackend = {
+  DL_StubSetState, DL_StubBindTexture, DL_StubDrawIndexed
+};
+
+static void DL_StubReset(void)
+{
+  memset(&dl_stubcounts, 0, sizeof dl_stubcounts);
+  dl_stubchecksum = 0;
+  dl_stubtexture = NULL;
+  dl_stubstate = 0;
+}
+
+//
+// DL_Benchmark
+//
+// -drawlistbench: a made up frame of wall quads and sector flats, in the
+// random order a BSP walk would find them, drawn the way NewDrawScene used
+// to -- everything in an array, qsorted by texture, a draw each run of a
+// texture, the state set and put back around each -- and through a draw
+// list with sky walls, walls, alpha tested walls and flats in that order
+// of layers, both into the stub backend. A texture's walls all have the
+// same state here; the old way took the state of the last wall in a run.
+//
+
+#define DLBENCH_TRIALS 8
+#define DLBENCH_SKY   1   // same as the iPhone renderer's states
+#define DLBENCH_ALPHA 2
+#define DLBENCH_FLAT  4
+
+typedef struct {
+  const void *texture;
+  unsigned state;
+  int layer;
+  int first, count;     // in dlbench_indexes
+} dlbenchitem_t;
+
+static unsigned int dlbenchseed;
+
+static int DL_BenchRandom(void)
+{
+  dlbenchseed = dlbenchseed * 1664525 + 1013904223;
+  return dlbenchseed >> 8;
+}
+
+static int DL_BenchSort(const void *a, const void *b)
+{
+  const dlbenchitem_t *ia = a, *ib = b;
+  if ((ia->state ^ ib->state) & DLBENCH_FLAT)
+    return (ia->state & DLBENCH_FLAT) ? 1 : -1;
+  return ia->texture < ib->texture ? -1 : ia->texture > ib->texture;
+}
+
+// the old way, the sort array is made and sorted every frame
+static void DL_BenchOld(const dlbenchitem_t *items, int numitems,
+                        const dlindex_t *indexes, dlindex_t *run)
+{
+  dlbenchitem_t *sorted = malloc(numitems * sizeof *sorted);
+  int i, numrun = 0;
+
+  memcpy(sorted, items, numitems * sizeof *sorted);
+  qsort(sorted, numitems, sizeof *sorted, DL_BenchSort);
+  for (i = 0; i < numitems; i++)
+    {
+      const dlbenchitem_t *item = &sorted[i];
+      memcpy(run + numrun, indexes + item->first, item->count * sizeof *run);
+      numrun += item->count;
+      if (i == numitems-1 || item->texture != item[1].texture)
+        {
+          if (item->state)
+            dl_stubbackend.SetState(item->state);
+          if (item->texture)
+            dl_stubbackend.BindTexture(item->texture, item->state);
+          dl_stubbackend.DrawIndexed(run, numrun);
+          if (item->state)
+            dl_stubbackend.SetState(0);
+          numrun = 0;
+        }
+    }
+  free(sorted);
+}
+
+static void DL_BenchNew(drawlist_t *dl, const dlbenchitem_t *items, int numitems,
+                        const dlindex_t *indexes)
+{
+  int i;
+
+  DL_Clear(dl);
+  for (i = 0; i < numitems; i++)
+    {
+      const dlbenchitem_t *item = &items[i];
+      memcpy(DL_AddIndexes(dl, item->layer, item->texture, item->state, item->count),
+             indexes + item->first, item->count * sizeof *indexes);
+    }
+  DL_Finish(dl);
+  DL_Submit(dl, &dl_stubbackend);
+}
+
+void DL_Benchmark(int walls, int textures)
+{
+  static const char *names[2] = {"sorted", "drawlist"};
+  const int flats = walls/4, numitems = walls + flats;
+  char *texturemem = malloc(textures + textures/4 + 1);
+  dlbenchitem_t *items = malloc(numitems * sizeof *items);
+  dlindex_t *indexes, *run;
+  drawlist_t dl;
+  dlcounts_t counts[2];
+  unsigned checksum[2];
+  uint_64_t best[2] = {0, 0};
+  int i, numindexes = 0, way, trial;
+
+  memset(&dl, 0, sizeof dl);
+  dlbenchseed = 1;
+
+  // walls are two triangles, flats a sector's worth
+  for (i = 0; i < numitems; i++)
+    {
+      dlbenchitem_t *item = &items[i];
+      if (i < walls)
+        {
+          // a few textures are used a lot, most only now and then
+          const int t = DL_BenchRandom() % (DL_BenchRandom() % textures + 1);
+          item->texture = texturemem + t;
+          item->state = t % 10 == 9 ? DLBENCH_ALPHA : 0;
+          item->layer = item->state ? 2 : 1;
+          if (DL_BenchRandom() % 20 == 0)
+            item->texture = NULL, item->state = DLBENCH_SKY, item->layer = 0;
+          item->count = 6;
+        }
+      else
+        {
+          item->texture = texturemem + textures + DL_BenchRandom() % (textures/4 + 1);
+          item->state = DLBENCH_FLAT;
+          item->layer = 3;
+          item->count = 3 * (2 + DL_BenchRandom() % 20);
+        }
+      item->first = numindexes;
+      numindexes += item->count;
+    }
+  indexes = malloc(numindexes * sizeof *indexes);
+  run = malloc(numindexes * sizeof *run);
+  for (i = 0; i < numindexes; i++)
+    indexes[i] = DL_BenchRandom() & 0xffff;
+
+  // shuffle the walls and flats together, the BSP walk finds them mixed
+  for (i = numitems-1; i > 0; i--)
+    {
+      const int j = DL_BenchRandom() % (i+1);
+      dlbenchitem_t t = items[i];
+      items[i] = items[j], items[j] = t;
+    }
+
+  lprintf(LO_INFO, "DL_Benchmark: %d walls, %d flats, %d wall and %d flat textures, best of %d\n",
+          walls, flats, textures, textures/4 + 1, DLBENCH_TRIALS);
+
+  for (trial = 0; trial < DLBENCH_TRIALS; trial++)
+    for (way = 0; way < 2; way++)
+      {
+        const uint_64_t start = I_GetTime_US();
+        uint_64_t time;
+
+        DL_StubReset();
+        if (way)
+          DL_BenchNew(&dl, items, numitems, indexes);
+        else
+          DL_BenchOld(items, numitems, indexes, run);
+        time = I_GetTime_US() - start;
+        if (!best[way] || time < best[way])
+          best[way] = time;
+        counts[way] = dl_stubcounts;
+        checksum[way] = dl_stubchecksum;
+      }
+
+  for (way = 0; way < 2; way++)
+    lprintf(LO_INFO, "%-8s %8.3f ms, %u draws, %u binds, %u state changes, %u indexes\n",
+            names[way], best[way] / 1000.0, counts[way].drawcalls, counts[way].binds,
+            counts[way].statechanges, counts[way].indexes);
+  if (checksum[0] != checksum[1])
+    lprintf(LO_INFO, "DL_Benchmark: the draw list DIFFERS\n");
+
+  DL_Free(&dl);
+  free(indexes);
+  free(run);
+  free(items);
+  free(texturemem);
+}
@@ -0,0 +1,104 @@
+/* Emacs style mode select   -*- C++ -*-
+ *-----------------------------------------------------------------------------
+ *
+ *
+ *  PrBoom: a Doom port merged with LxDoom and LSDLDoom
+ *  based on BOOM, a modified and improved DOOM engine
+ *  Copyright (C) 1999 by
+ *  id Software, Chi Hoang, Lee Killough, Jim Flynn, Rand Phares, Ty Halderman
+ *  Copyright (C) 1999-2000 by
+ *  Jess Haas, Nicolas Kalkhof, Colin Phipps, Florian Schulze
+ *  Copyright 2005, 2006 by
+ *  Florian Schulze, Colin Phipps, Neil Stevens, Andrey Budko
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ *  02111-1307, USA.
+ *
+ * DESCRIPTION:
+ *      Draw lists for the hardware renderers: geometry is dropped into a
+ *      bucket per texture and render state as the BSP walk finds it, then
+ *      handed to a backend as one merged index buffer, one draw a bucket.
+ *      Nothing here knows about GL; textures and states are whatever the
+ *      backend binds and sets.
+ *
+ *-----------------------------------------------------------------------------*/
+
+#ifndef __R_DRAWLIST__
+#define __R_DRAWLIST__
+
+#include "doomtype.h"
+
+#define DL_LAYERS 4     /* buckets are drawn a layer at a time, lowest first */
+
+typedef unsigned short dlindex_t;
+
+typedef struct dlbucket_s {
+  const void *texture;
+  unsigned state;
+  int layer;
+  dlindex_t *indexes;             /* this frame's, kept from frame to frame */
+  int numindexes, maxindexes;
+  int frame;                      /* the last one anything was added in */
+  struct dlbucket_s *hashnext;    /* buckets with the same hash */
+  struct dlbucket_s *next;        /* the layer's buckets this frame */
+} dlbucket_t;
+
+/* One draw: a bucket's indexes, once they are merged */
+typedef struct {
+  const void *texture;
+  unsigned state;
+  int first, count;
+} dlbatch_t;
+
+typedef struct {
+  dlbucket_t **hash;              /* hashmask+1 chains */
+  unsigned hashmask;
+  int numbuckets;
+  int frame;
+  dlbucket_t *first[DL_LAYERS], *last[DL_LAYERS];
+
+  dlindex_t *indexes;             /* merged by DL_Finish */
+  int numindexes, maxindexes;
+  dlbatch_t *batches;
+  int numbatches, maxbatches;
+} drawlist_t;
+
+/* What DL_Submit calls. The backend is taken to start in state 0 and is
+ * put back in it at the end. A NULL texture isn't bound, its batch draws
+ * with whatever was bound before. */
+typedef struct {
+  void (*SetState)(unsigned state);
+  void (*BindTexture)(const void *texture, unsigned state);
+  void (*DrawIndexed)(const dlindex_t *indexes, int count);
+} dlbackend_t;
+
+typedef struct {
+  unsigned drawcalls, statechanges, binds, indexes;
+} dlcounts_t;
+
+void DL_Clear(drawlist_t *dl);
+dlindex_t *DL_AddIndexes(drawlist_t *dl, int layer, const void *texture,
+                         unsigned state, int count);
+void DL_Finish(drawlist_t *dl);
+void DL_Submit(const drawlist_t *dl, const dlbackend_t *backend);
+void DL_Free(drawlist_t *dl);
+
+/* A backend that draws nothing, only counts into dl_stubcounts */
+extern const dlbackend_t dl_stubbackend;
+extern dlcounts_t dl_stubcounts;
+
+void DL_Benchmark(int walls, int textures);
+
+#endif
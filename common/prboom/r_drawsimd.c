@@ -0,0 +1,686 @@
+/* Emacs style mode select   -*- C++ -*-
+ *-----------------------------------------------------------------------------
+ *
+ *
+ *  PrBoom: a Doom port merged with LxDoom and LSDLDoom
+ *  based on BOOM, a modified and improved DOOM engine
+ *  Copyright (C) 1999 by
+ *  id Software, Chi Hoang, Lee Killough, Jim Flynn, Rand Phares, Ty Halderman
+ *  Copyright (C) 1999-2000 by
+ *  Jess Haas, Nicolas Kalkhof, Colin Phipps, Florian Schulze
+ *  Copyright 2005, 2006 by
+ *  Florian Schulze, Colin Phipps, Neil Stevens, Andrey Budko
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ *  02111-1307, USA.
+ *
+ * DESCRIPTION:
+ *      SIMD inner loops for the 32 bit span and column drawers, picked
+ *      at startup from what the CPU supports.
+ *
+ *-----------------------------------------------------------------------------*/
+
+#include <stddef.h>
+#include <string.h>
+
+#include "doomstat.h"
+#include "m_argv.h"
+#include "i_system.h"
+#include "r_main.h"
+#include "r_draw.h"
+#include "r_drawsimd.h"
+#include "r_filter.h"
+#include "v_video.h"
+#include "lprintf.h"
+
+#if defined(__i386__) || defined(__x86_64__)
+#define RDRAW_SIMD_HAVE_X86
+#include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define RDRAW_SIMD_HAVE_NEON
+#include <arm_neon.h>
+#endif
+
+draw_kernels_t drawkernels;
+enum draw_simd_e drawsimd = RDRAW_SIMD_NONE;
+
+#if defined(RDRAW_SIMD_HAVE_X86) || defined(RDRAW_SIMD_HAVE_NEON)
+
+//
+// R_Scale2xColor
+//
+// filter_getScale2xQuadColors()[q] without the static quad, which the
+// kernels can't share between render threads
+//
+
+static byte R_Scale2xColor(byte e, byte b, byte f, byte h, byte d, int q)
+{
+  const byte rowColors[3] = { d, e, f };
+  const int code = (b == f) | (f == h)<<1 | (h == d)<<2 | (d == b)<<3;
+
+  return q == 4 ? e : rowColors[filter_roundedRowMap[q*16+code]];
+}
+
+#endif
+
+#ifdef RDRAW_SIMD_HAVE_X86
+
+// i386 builds don't assume SSE2, x86_64 always has it
+#define SSE2_TARGET __attribute__((target("sse2")))
+
+// a*b for 16 bit a and b, all 32 bits of it
+static SSE2_TARGET __m128i R_Mul16_SSE2(__m128i a, __m128i b)
+{
+  return _mm_or_si128(_mm_mullo_epi16(a, b),
+                      _mm_slli_epi32(_mm_mulhi_epu16(a, b), 16));
+}
+
+
+#define SIMD_FUNCNAME(name) R_ ## name ## _SSE2
+#define SIMD_TARGET SSE2_TARGET
+#define SIMD_LANES 4
+#define vec_t __m128i
+#define V_SET1(x) _mm_set1_epi32(x)
+#define V_LOAD(p) _mm_loadu_si128((const __m128i *)(p))
+#define V_STORE(p, v) _mm_storeu_si128((__m128i *)(p), (v))
+#define V_ADD(a, b) _mm_add_epi32((a), (b))
+#define V_SUB(a, b) _mm_sub_epi32((a), (b))
+#define V_AND(a, b) _mm_and_si128((a), (b))
+#define V_OR(a, b) _mm_or_si128((a), (b))
+#define V_SRA(v, n) _mm_srai_epi32((v), (n))
+#define V_SRL(v, n) _mm_srli_epi32((v), (n))
+#define V_SLL(v, n) _mm_slli_epi32((v), (n))
+#define V_MUL16(a, b) R_Mul16_SSE2((a), (b))
+#include "r_drawsimd.inl"
+
+#define SIMD_FUNCNAME(name) R_ ## name ## _AVX2
+#define SIMD_TARGET __attribute__((target("avx2")))
+#define SIMD_LANES 8
+#define vec_t __m256i
+#define V_SET1(x) _mm256_set1_epi32(x)
+#define V_LOAD(p) _mm256_loadu_si256((const __m256i *)(p))
+#define V_STORE(p, v) _mm256_storeu_si256((__m256i *)(p), (v))
+#define V_ADD(a, b) _mm256_add_epi32((a), (b))
+#define V_SUB(a, b) _mm256_sub_epi32((a), (b))
+#define V_AND(a, b) _mm256_and_si256((a), (b))
+#define V_OR(a, b) _mm256_or_si256((a), (b))
+#define V_SRA(v, n) _mm256_srai_epi32((v), (n))
+#define V_SRL(v, n) _mm256_srli_epi32((v), (n))
+#define V_SLL(v, n) _mm256_slli_epi32((v), (n))
+#define V_MUL16(a, b) _mm256_mullo_epi32((a), (b))
+#include "r_drawsimd.inl"
+
+// The quad flush is four pixels wide whatever the vector size, so AVX2
+// uses these too
+
+static SSE2_TARGET void R_QuadCopy_SSE2(unsigned int *dest, int pitch,
+                                        const unsigned int *source, int count)
+{
+  while (--count >= 0)
+  {
+    _mm_storeu_si128((__m128i *)dest, _mm_loadu_si128((const __m128i *)source));
+    source += 4;
+    dest += pitch;
+  }
+}
+
+// GETBLENDED32_3268, the multiplies by 5 and 11 as shifts
+static SSE2_TARGET void R_QuadBlend_SSE2(unsigned int *dest, int pitch,
+                                         const unsigned int *source, int count)
+{
+  const __m128i rbmask = _mm_set1_epi32(0xff00ff);
+  const __m128i gmask = _mm_set1_epi32(0x00ff00);
+
+  while (--count >= 0)
+  {
+    const __m128i d = _mm_loadu_si128((const __m128i *)dest);
+    const __m128i s = _mm_loadu_si128((const __m128i *)source);
+    const __m128i drb = _mm_and_si128(d, rbmask), srb = _mm_and_si128(s, rbmask);
+    const __m128i dg = _mm_and_si128(d, gmask), sg = _mm_and_si128(s, gmask);
+    const __m128i rb = _mm_add_epi32(_mm_add_epi32(_mm_slli_epi32(drb, 2), drb),
+                                     _mm_add_epi32(_mm_add_epi32(_mm_slli_epi32(srb, 3),
+                                                                 _mm_slli_epi32(srb, 1)), srb));
+    const __m128i g = _mm_add_epi32(_mm_add_epi32(_mm_slli_epi32(dg, 2), dg),
+                                    _mm_add_epi32(_mm_add_epi32(_mm_slli_epi32(sg, 3),
+                                                                _mm_slli_epi32(sg, 1)), sg));
+
+    _mm_storeu_si128((__m128i *)dest,
+                     _mm_or_si128(_mm_and_si128(_mm_srli_epi32(rb, 4), rbmask),
+                                  _mm_and_si128(_mm_srli_epi32(g, 4), gmask)));
+    source += 4;
+    dest += pitch;
+  }
+}
+
+// The linearized view isn't read again before it goes to the screen, so
+// the stores go around the cache. The rows are 16 byte aligned as long as
+// the pitch and the view's left edge are; when they aren't this is a copy.
+static SSE2_TARGET void R_TileRow_SSE2(unsigned int *dest, const unsigned int *source,
+                                       int phase, int count)
+{
+  while (count > 0)
+  {
+    const int run = MIN(count, R_TILESIZE - phase);
+    int i = 0;
+
+    if (!((size_t)dest & 15))
+      for (; i + 4 <= run; i += 4)
+        _mm_stream_si128((__m128i *)(dest + i), _mm_loadu_si128((const __m128i *)(source + i)));
+    for (; i < run; i++)
+      dest[i] = source[i];
+    dest += run;
+    source += R_TILESIZE*R_TILESIZE - phase;
+    count -= run;
+    phase = 0;
+  }
+  _mm_sfence();
+}
+
+#endif // RDRAW_SIMD_HAVE_X86
+
+#ifdef RDRAW_SIMD_HAVE_NEON
+
+#define SIMD_FUNCNAME(name) R_ ## name ## _NEON
+#define SIMD_TARGET
+#define SIMD_LANES 4
+#define vec_t int32x4_t
+#define V_SET1(x) vdupq_n_s32(x)
+#define V_LOAD(p) vld1q_s32((const int32_t *)(p))
+#define V_STORE(p, v) vst1q_s32((int32_t *)(p), (v))
+#define V_ADD(a, b) vaddq_s32((a), (b))
+#define V_SUB(a, b) vsubq_s32((a), (b))
+#define V_AND(a, b) vandq_s32((a), (b))
+#define V_OR(a, b) vorrq_s32((a), (b))
+#define V_SRA(v, n) vshrq_n_s32((v), (n))
+#define V_SRL(v, n) vreinterpretq_s32_u32(vshrq_n_u32(vreinterpretq_u32_s32(v), (n)))
+#define V_SLL(v, n) vshlq_n_s32((v), (n))
+#define V_MUL16(a, b) vmulq_s32((a), (b))
+#include "r_drawsimd.inl"
+
+static void R_QuadCopy_NEON(unsigned int *dest, int pitch,
+                            const unsigned int *source, int count)
+{
+  while (--count >= 0)
+  {
+    vst1q_u32(dest, vld1q_u32(source));
+    source += 4;
+    dest += pitch;
+  }
+}
+
+// GETBLENDED32_3268
+static void R_QuadBlend_NEON(unsigned int *dest, int pitch,
+                             const unsigned int *source, int count)
+{
+  const uint32x4_t rbmask = vdupq_n_u32(0xff00ff);
+  const uint32x4_t gmask = vdupq_n_u32(0x00ff00);
+
+  while (--count >= 0)
+  {
+    const uint32x4_t d = vld1q_u32(dest);
+    const uint32x4_t s = vld1q_u32(source);
+    const uint32x4_t rb = vmlaq_n_u32(vmulq_n_u32(vandq_u32(d, rbmask), 5),
+                                      vandq_u32(s, rbmask), 11);
+    const uint32x4_t g = vmlaq_n_u32(vmulq_n_u32(vandq_u32(d, gmask), 5),
+                                     vandq_u32(s, gmask), 11);
+
+    vst1q_u32(dest, vorrq_u32(vandq_u32(vshrq_n_u32(rb, 4), rbmask),
+                              vandq_u32(vshrq_n_u32(g, 4), gmask)));
+    source += 4;
+    dest += pitch;
+  }
+}
+
+#endif // RDRAW_SIMD_HAVE_NEON
+
+static const draw_kernels_t simdkernels[RDRAW_SIMD_MAX] = {
+#ifdef RDRAW_SIMD_HAVE_X86
+  [RDRAW_SIMD_SSE2] = {
+    R_SpanPoint_SSE2, R_SpanLinear_SSE2, R_SpanRounded_SSE2,
+    R_ColumnPoint_SSE2, R_ColumnLinear_SSE2, R_ColumnRounded_SSE2,
+    R_QuadCopy_SSE2, R_QuadBlend_SSE2,
+    R_TileRow_SSE2,
+  },
+  [RDRAW_SIMD_AVX2] = {
+    R_SpanPoint_AVX2, R_SpanLinear_AVX2, R_SpanRounded_AVX2,
+    R_ColumnPoint_AVX2, R_ColumnLinear_AVX2, R_ColumnRounded_AVX2,
+    R_QuadCopy_SSE2, R_QuadBlend_SSE2,
+    R_TileRow_SSE2,
+  },
+#endif
+#ifdef RDRAW_SIMD_HAVE_NEON
+  [RDRAW_SIMD_NEON] = {
+    R_SpanPoint_NEON, R_SpanLinear_NEON, R_SpanRounded_NEON,
+    R_ColumnPoint_NEON, R_ColumnLinear_NEON, R_ColumnRounded_NEON,
+    R_QuadCopy_NEON, R_QuadBlend_NEON,
+    NULL,   // no streaming store to gain over the C loop's memcpy of each run
+  },
+#endif
+};
+
+static const char *simdnames[RDRAW_SIMD_MAX] = { "C", "SSE2", "AVX2", "NEON" };
+
+const char *R_DrawSIMDName(enum draw_simd_e simd)
+{
+  return simd >= 0 && simd < RDRAW_SIMD_MAX ? simdnames[simd] : "?";
+}
+
+static boolean R_DrawSIMDSupported(enum draw_simd_e simd)
+{
+  switch (simd)
+  {
+    case RDRAW_SIMD_NONE:
+      return true;
+#ifdef RDRAW_SIMD_HAVE_X86
+    case RDRAW_SIMD_SSE2:
+      __builtin_cpu_init();
+      return __builtin_cpu_supports("sse2") != 0;
+    case RDRAW_SIMD_AVX2:
+      __builtin_cpu_init();
+      return __builtin_cpu_supports("avx2") != 0;
+#endif
+#ifdef RDRAW_SIMD_HAVE_NEON
+    case RDRAW_SIMD_NEON:
+      return true;
+#endif
+    default:
+      return false;
+  }
+}
+
+boolean R_SetDrawSIMD(enum draw_simd_e simd)
+{
+  if (simd < 0 || simd >= RDRAW_SIMD_MAX || !R_DrawSIMDSupported(simd))
+    return false;
+  drawsimd = simd;
+  drawkernels = simdkernels[simd];
+  // Kernels -drawbench doesn't put ahead of the C loop are left to it.
+  // Emulating the 32 bit multiply costs SSE2 more than it saves on
+  // columns. A point column is one load and lookup per pixel either way,
+  // and the quad copy is a plain copy the compiler vectorises too, so
+  // neither wins on x86 (0.9-1.2x and 1.02-1.05x).
+  if (simd == RDRAW_SIMD_SSE2)
+    drawkernels.column_linear = NULL;
+  if (simd == RDRAW_SIMD_SSE2 || simd == RDRAW_SIMD_AVX2)
+  {
+    drawkernels.column_point = NULL;
+    drawkernels.quad_copy = NULL;
+  }
+  return true;
+}
+
+//
+// R_InitDrawSIMD
+//
+// The widest the CPU has, less the kernels R_SetDrawSIMD leaves to the
+// C loops; -nosimd keeps them all
+//
+
+void R_InitDrawSIMD(void)
+{
+  int simd = RDRAW_SIMD_NONE;
+
+  if (!M_CheckParm("-nosimd"))
+    for (simd = RDRAW_SIMD_MAX-1; simd > RDRAW_SIMD_NONE; simd--)
+      if (R_DrawSIMDSupported(simd))
+        break;
+  R_SetDrawSIMD(simd);
+  lprintf(LO_INFO, "(%s) ", R_DrawSIMDName(drawsimd));
+}
+
+//
+// The C loops
+//
+// As r_drawspan.inl, r_drawcolumn.inl and r_drawflush.inl have them for 32
+// bit, to check the kernels against and time them by
+//
+
+#define GETDEPTHMAP(col) colormap[(col)]
+#define GETCOL8_DEPTH(col) colormap[translation ? translation[(col)] : (col)]
+
+static void R_SpanPoint_C(unsigned int *dest, int count,
+                          fixed_t xfrac, fixed_t yfrac,
+                          fixed_t xstep, fixed_t ystep,
+                          const byte *source, const lighttable_t *colormap)
+{
+  while (count--)
+  {
+    const fixed_t spot = ((xfrac >> 16) & 63) | ((yfrac >> 10) & 4032);
+
+    xfrac += xstep;
+    yfrac += ystep;
+    *dest++ = VID_PAL32(GETDEPTHMAP(source[spot]), VID_COLORWEIGHTMASK);
+  }
+}
+
+static void R_SpanLinear_C(unsigned int *dest, int count,
+                           fixed_t xfrac, fixed_t yfrac,
+                           fixed_t xstep, fixed_t ystep,
+                           const byte *source, const lighttable_t *colormap)
+{
+  while (count--)
+  {
+    *dest++ = filter_getFilteredForSpan32(GETDEPTHMAP, xfrac, yfrac);
+    xfrac += xstep;
+    yfrac += ystep;
+  }
+}
+
+static void R_SpanRounded_C(unsigned int *dest, int count,
+                            fixed_t xfrac, fixed_t yfrac,
+                            fixed_t xstep, fixed_t ystep,
+                            const byte *source, const lighttable_t *colormap)
+{
+  while (count--)
+  {
+    *dest++ = VID_PAL32(GETDEPTHMAP(filter_getRoundedForSpan(xfrac, yfrac)), VID_COLORWEIGHTMASK);
+    xfrac += xstep;
+    yfrac += ystep;
+  }
+}
+
+static void R_ColumnPoint_C(unsigned int *dest, int count,
+                            fixed_t frac, fixed_t mask,
+                            const draw_column_vars_t *dcvars,
+                            const byte *translation,
+                            unsigned int fracu)
+{
+  const byte *source = dcvars->source;
+  const lighttable_t *colormap = dcvars->colormap;
+
+  (void)fracu;
+  while (count--)
+  {
+    *dest = VID_PAL32(GETCOL8_DEPTH(source[(frac & mask)>>FRACBITS]), VID_COLORWEIGHTMASK);
+    dest += 4;
+    frac += dcvars->iscale;
+  }
+}
+
+static void R_ColumnLinear_C(unsigned int *dest, int count,
+                             fixed_t frac, fixed_t mask,
+                             const draw_column_vars_t *dcvars,
+                             const byte *translation,
+                             unsigned int fracu)
+{
+  const byte *source = dcvars->source;
+  const byte *nextsource = dcvars->nextsource;
+  const lighttable_t *colormap = dcvars->colormap;
+  const unsigned int filter_fracu = fracu;
+
+  while (count--)
+  {
+    *dest = filter_getFilteredForColumn32(GETCOL8_DEPTH, frac & mask, (frac+FRACUNIT) & mask);
+    dest += 4;
+    frac += dcvars->iscale;
+  }
+}
+
+static void R_ColumnRounded_C(unsigned int *dest, int count,
+                              fixed_t frac, fixed_t mask,
+                              const draw_column_vars_t *dcvars,
+                              const byte *translation,
+                              unsigned int fracu)
+{
+  const byte *source = dcvars->source;
+  const byte *prevsource = dcvars->prevsource;
+  const byte *nextsource = dcvars->nextsource;
+  const lighttable_t *colormap = dcvars->colormap;
+  const unsigned int filter_fracu = fracu;
+
+  while (count--)
+  {
+    *dest = VID_PAL32(GETCOL8_DEPTH(filter_getRoundedForColumn(frac & mask, (frac+FRACUNIT) & mask)),
+                      VID_COLORWEIGHTMASK);
+    dest += 4;
+    frac += dcvars->iscale;
+  }
+}
+
+static void R_QuadCopy_C(unsigned int *dest, int pitch,
+                         const unsigned int *source, int count)
+{
+  while (--count >= 0)
+  {
+    dest[0] = source[0];
+    dest[1] = source[1];
+    dest[2] = source[2];
+    dest[3] = source[3];
+    source += 4;
+    dest += pitch;
+  }
+}
+
+static void R_QuadBlend_C(unsigned int *dest, int pitch,
+                          const unsigned int *source, int count)
+{
+  while (--count >= 0)
+  {
+    dest[0] = GETBLENDED32_3268(dest[0], source[0]);
+    dest[1] = GETBLENDED32_3268(dest[1], source[1]);
+    dest[2] = GETBLENDED32_3268(dest[2], source[2]);
+    dest[3] = GETBLENDED32_3268(dest[3], source[3]);
+    source += 4;
+    dest += pitch;
+  }
+}
+
+#undef GETCOL8_DEPTH
+#undef GETDEPTHMAP
+
+static const draw_kernels_t ckernels = {
+  R_SpanPoint_C, R_SpanLinear_C, R_SpanRounded_C,
+  R_ColumnPoint_C, R_ColumnLinear_C, R_ColumnRounded_C,
+  R_QuadCopy_C, R_QuadBlend_C,
+};
+
+//
+// R_BenchmarkDrawKernels
+//
+// Runs each kernel over the same random spans, columns and quads as its C
+// loop, compares every pixel, and reports pixels/ns. Needs no wad: the
+// flat, texture, colormap and palette are made up.
+//
+
+#define BENCH_JOBS   512
+#define BENCH_WIDTH  320
+#define BENCH_HEIGHT 200
+#define BENCH_PITCH  (BENCH_JOBS*4)
+#define BENCH_TIME   200000      // usec per kernel per instruction set
+#define BENCH_TRIALS 10
+
+enum { BENCH_SPAN, BENCH_COLUMN, BENCH_QUAD };
+
+typedef struct {
+  int     count;
+  fixed_t frac, yfrac;      // frac is xfrac for spans
+  fixed_t step, ystep;
+  fixed_t mask;
+  const byte *translation;
+  unsigned int fracu;
+  draw_column_vars_t dcvars;
+} benchjob_t;
+
+static const struct {
+  const char *name;
+  int         kind;
+  size_t      kernel;
+} benchkernels[] = {
+  {"span point",      BENCH_SPAN,   offsetof(draw_kernels_t, span_point)},
+  {"span linear",     BENCH_SPAN,   offsetof(draw_kernels_t, span_linear)},
+  {"span rounded",    BENCH_SPAN,   offsetof(draw_kernels_t, span_rounded)},
+  {"column point",    BENCH_COLUMN, offsetof(draw_kernels_t, column_point)},
+  {"column linear",   BENCH_COLUMN, offsetof(draw_kernels_t, column_linear)},
+  {"column rounded",  BENCH_COLUMN, offsetof(draw_kernels_t, column_rounded)},
+  {"quad copy",       BENCH_QUAD,   offsetof(draw_kernels_t, quad_copy)},
+  {"quad translucent",BENCH_QUAD,   offsetof(draw_kernels_t, quad_blend)},
+};
+
+static unsigned int benchseed;
+
+static int R_BenchRandom(void)
+{
+  benchseed = benchseed * 1664525 + 1013904223;
+  return benchseed >> 8;
+}
+
+// one pass over the jobs, returns the pixels drawn
+static int R_BenchPass(const draw_kernels_t *kernels, int b,
+                       const benchjob_t *jobs, const byte *flat,
+                       const lighttable_t *colormap,
+                       unsigned int *out, const unsigned int *quads)
+{
+  const char *k = (const char *)kernels + benchkernels[b].kernel;
+  int pixels = 0;
+  int i;
+
+  for (i = 0; i < BENCH_JOBS; i++)
+  {
+    const benchjob_t *job = &jobs[i];
+
+    switch (benchkernels[b].kind)
+    {
+      case BENCH_SPAN:
+        (*(const R_SpanKernel32_f *)k)(out + i*BENCH_WIDTH, job->count,
+                                       job->frac, job->yfrac, job->step, job->ystep,
+                                       flat, colormap);
+        break;
+      case BENCH_COLUMN:
+        (*(const R_ColumnKernel32_f *)k)(out + i*BENCH_HEIGHT*4, job->count,
+                                         job->frac, job->mask, &job->dcvars,
+                                         job->translation, job->fracu);
+        break;
+      case BENCH_QUAD:
+        (*(const R_QuadKernel32_f *)k)(out + i*4, BENCH_PITCH,
+                                       quads + i*BENCH_HEIGHT*4, job->count);
+        break;
+    }
+    pixels += benchkernels[b].kind == BENCH_QUAD ? job->count*4 : job->count;
+  }
+  return pixels;
+}
+
+void R_BenchmarkDrawKernels(void)
+{
+  static benchjob_t jobs[BENCH_JOBS];
+  static unsigned int base[BENCH_JOBS*BENCH_HEIGHT*4];
+  static unsigned int quads[BENCH_JOBS*BENCH_HEIGHT*4];
+  static unsigned int ref[BENCH_JOBS*BENCH_HEIGHT*4];
+  static unsigned int out[BENCH_JOBS*BENCH_HEIGHT*4];
+  static unsigned int palette[256*VID_NUMCOLORWEIGHTS];
+  static byte flat[64*64], texture[3][256], colormap[256], translation[256];
+  unsigned int *oldpalette = V_Palette32;
+  int b, i, simd;
+
+  R_FilterInit();
+  V_Palette32 = palette;
+
+  benchseed = 1;
+  for (i = 0; i < 256*VID_NUMCOLORWEIGHTS; i++)
+    palette[i] = R_BenchRandom();
+  for (i = 0; i < 64*64; i++)
+    flat[i] = R_BenchRandom();
+  for (i = 0; i < 3*256; i++)
+    texture[i / 256][i % 256] = R_BenchRandom();
+  for (i = 0; i < 256; i++)
+  {
+    colormap[i] = R_BenchRandom();
+    translation[i] = R_BenchRandom();
+  }
+  for (i = 0; i < BENCH_JOBS*BENCH_HEIGHT*4; i++)
+  {
+    base[i] = R_BenchRandom() & 0xffffff;
+    quads[i] = R_BenchRandom() & 0xffffff;
+  }
+
+  for (b = 0; b < (int)(sizeof(benchkernels)/sizeof(benchkernels[0])); b++)
+  {
+    const int kind = benchkernels[b].kind;
+    double cspeed = 0;
+
+    for (i = 0; i < BENCH_JOBS; i++)
+    {
+      benchjob_t *job = &jobs[i];
+
+      memset(job, 0, sizeof(*job));
+      job->count = 1 + R_BenchRandom() % (kind == BENCH_SPAN ? BENCH_WIDTH : BENCH_HEIGHT);
+      job->frac = R_BenchRandom() << 8;
+      job->yfrac = R_BenchRandom() << 8;
+      job->step = (R_BenchRandom() % (2*FRACUNIT)) - FRACUNIT;
+      job->ystep = (R_BenchRandom() % (2*FRACUNIT)) - FRACUNIT;
+      job->mask = ((unsigned)(64 << (i % 3)) - 1) << FRACBITS | 0xffff;
+      // the rounded filter only keeps 8 bits of u
+      job->fracu = R_BenchRandom() &
+        (benchkernels[b].kernel == offsetof(draw_kernels_t, column_rounded) ? 0xff : 0xffff);
+      job->dcvars.iscale = FRACUNIT/4 + R_BenchRandom() % (2*FRACUNIT);
+      job->dcvars.prevsource = texture[0];
+      job->dcvars.source = texture[1];
+      job->dcvars.nextsource = texture[2];
+      job->dcvars.colormap = colormap;
+      job->translation = i & 1 ? translation : NULL;
+    }
+
+    lprintf(LO_INFO, "%-17s", benchkernels[b].name);
+    for (simd = RDRAW_SIMD_NONE; simd < RDRAW_SIMD_MAX; simd++)
+    {
+      const draw_kernels_t *kernels = simd == RDRAW_SIMD_NONE ? &ckernels : &simdkernels[simd];
+      uint_64_t start, elapsed;
+      double speed;
+      int trial;
+
+      if (!R_DrawSIMDSupported(simd))
+        continue;
+
+      // the translucent quad reads what it draws over, so start from the
+      // same picture every time
+      memcpy(out, base, sizeof(out));
+      R_BenchPass(kernels, b, jobs, flat, colormap, out, quads);
+      if (simd == RDRAW_SIMD_NONE)
+        memcpy(ref, out, sizeof(ref));
+
+      // best of a few short runs, the machine isn't always ours
+      speed = 0;
+      for (trial = 0; trial < BENCH_TRIALS; trial++)
+      {
+        double pixels = 0;
+
+        start = I_GetTime_US();
+        do
+        {
+          pixels += R_BenchPass(kernels, b, jobs, flat, colormap, out, quads);
+          elapsed = I_GetTime_US() - start;
+        } while (elapsed < BENCH_TIME / BENCH_TRIALS);
+        if (pixels / (elapsed * 1000.0) > speed)
+          speed = pixels / (elapsed * 1000.0);
+      }
+
+      if (simd == RDRAW_SIMD_NONE)
+      {
+        cspeed = speed;
+        lprintf(LO_INFO, "  %s %.3f px/ns", simdnames[simd], speed);
+      }
+      else
+      {
+        memcpy(out, base, sizeof(out));
+        R_BenchPass(kernels, b, jobs, flat, colormap, out, quads);
+        lprintf(LO_INFO, "  %s %.3f px/ns %.2fx%s", simdnames[simd], speed,
+                speed / cspeed, memcmp(out, ref, sizeof(out)) ? " DIFFERS" : "");
+      }
+    }
+    lprintf(LO_INFO, "\n");
+  }
+
+  V_Palette32 = oldpalette;
+}
@@ -0,0 +1,96 @@
+/* Emacs style mode select   -*- C++ -*-
+ *-----------------------------------------------------------------------------
+ *
+ *
+ *  PrBoom: a Doom port merged with LxDoom and LSDLDoom
+ *  based on BOOM, a modified and improved DOOM engine
+ *  Copyright (C) 1999 by
+ *  id Software, Chi Hoang, Lee Killough, Jim Flynn, Rand Phares, Ty Halderman
+ *  Copyright (C) 1999-2000 by
+ *  Jess Haas, Nicolas Kalkhof, Colin Phipps, Florian Schulze
+ *  Copyright 2005, 2006 by
+ *  Florian Schulze, Colin Phipps, Neil Stevens, Andrey Budko
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ *  02111-1307, USA.
+ *
+ * DESCRIPTION:
+ *      SIMD inner loops for the 32 bit span and column drawers.
+ *
+ *-----------------------------------------------------------------------------*/
+
+#ifndef __R_DRAWSIMD__
+#define __R_DRAWSIMD__
+
+#include "r_draw.h"
+
+enum draw_simd_e {
+  RDRAW_SIMD_NONE,    // the C loops in r_drawspan.inl and friends
+  RDRAW_SIMD_SSE2,
+  RDRAW_SIMD_AVX2,
+  RDRAW_SIMD_NEON,
+  RDRAW_SIMD_MAX
+};
+
+// One row of a 64x64 flat, count pixels to dest
+typedef void (*R_SpanKernel32_f)(unsigned int *dest, int count,
+                                 fixed_t xfrac, fixed_t yfrac,
+                                 fixed_t xstep, fixed_t ystep,
+                                 const byte *source,
+                                 const lighttable_t *colormap);
+
+// One column into the quad buffer (dest steps by 4). mask is the power of
+// two texture height as a fixed_t mask, or -1 for no wrapping. translation
+// is NULL unless the pipeline translates, fracu is the filter's u fraction
+// as the C loop computes it.
+typedef void (*R_ColumnKernel32_f)(unsigned int *dest, int count,
+                                   fixed_t frac, fixed_t mask,
+                                   const draw_column_vars_t *dcvars,
+                                   const byte *translation,
+                                   unsigned int fracu);
+
+// count rows of four buffered columns to the screen
+typedef void (*R_QuadKernel32_f)(unsigned int *dest, int pitch,
+                                 const unsigned int *source, int count);
+
+// count pixels of one row of a tiled view to the screen; source is the
+// first of them, phase pixels into its row of a tile (see r_draw.h)
+typedef void (*R_TileRowKernel32_f)(unsigned int *dest, const unsigned int *source,
+                                    int phase, int count);
+
+// NULL entries mean the C loop is used
+typedef struct {
+  R_SpanKernel32_f   span_point;
+  R_SpanKernel32_f   span_linear;
+  R_SpanKernel32_f   span_rounded;
+  R_ColumnKernel32_f column_point;
+  R_ColumnKernel32_f column_linear;
+  R_ColumnKernel32_f column_rounded;
+  R_QuadKernel32_f   quad_copy;
+  R_QuadKernel32_f   quad_blend;    // translucent, GETBLENDED32_3268
+  R_TileRowKernel32_f tile_row;     // R_LinearizeView
+} draw_kernels_t;
+
+extern draw_kernels_t drawkernels;
+extern enum draw_simd_e drawsimd;
+
+void R_InitDrawSIMD(void);                       // best supported, or -nosimd
+boolean R_SetDrawSIMD(enum draw_simd_e simd);    // false if not supported
+const char *R_DrawSIMDName(enum draw_simd_e simd);
+
+// checks every kernel against the C loops and prints pixels/ns, -drawbench
+void R_BenchmarkDrawKernels(void);
+
+#endif
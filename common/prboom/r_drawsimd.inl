@@ -0,0 +1,340 @@
+/* Emacs style mode select   -*- C++ -*-
+ *-----------------------------------------------------------------------------
+ *
+ *
+ *  PrBoom: a Doom port merged with LxDoom and LSDLDoom
+ *  based on BOOM, a modified and improved DOOM engine
+ *  Copyright (C) 1999 by
+ *  id Software, Chi Hoang, Lee Killough, Jim Flynn, Rand Phares, Ty Halderman
+ *  Copyright (C) 1999-2000 by
+ *  Jess Haas, Nicolas Kalkhof, Colin Phipps, Florian Schulze
+ *  Copyright 2005, 2006 by
+ *  Florian Schulze, Colin Phipps, Neil Stevens, Andrey Budko
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ *  02111-1307, USA.
+ *
+ *-----------------------------------------------------------------------------*/
+
+//
+// The span and column kernels, included once per instruction set by
+// r_drawsimd.c with SIMD_LANES, vec_t and the V_ macros defined for it.
+//
+// Texture coordinates, tap addresses and filter weights are worked out
+// SIMD_LANES pixels at a time with the same integer arithmetic as the C
+// loops, so the results are bit for bit the same. The texel, colormap and
+// palette lookups are scalar: they are byte and word loads from tables
+// that are small enough to stay in cache, and a hardware gather of them
+// is slower than the loads it replaces.
+//
+
+#define V_CONST(x) V_SET1((int)(x))
+
+static SIMD_TARGET vec_t SIMD_FUNCNAME(Ramp)(fixed_t base, fixed_t step)
+{
+  int lanes[SIMD_LANES];
+  int i;
+
+  for (i = 0; i < SIMD_LANES; i++)
+    lanes[i] = (int)((unsigned)base + (unsigned)step * i);
+  return V_LOAD(lanes);
+}
+
+//
+// Spans
+//
+
+static SIMD_TARGET void SIMD_FUNCNAME(SpanPoint)(unsigned int *dest, int count,
+                                                 fixed_t xfrac, fixed_t yfrac,
+                                                 fixed_t xstep, fixed_t ystep,
+                                                 const byte *source,
+                                                 const lighttable_t *colormap)
+{
+  const unsigned int *pal = V_Palette32 + VID_COLORWEIGHTMASK;
+  const vec_t dx = V_CONST((unsigned)xstep * SIMD_LANES);
+  const vec_t dy = V_CONST((unsigned)ystep * SIMD_LANES);
+  const vec_t umask = V_CONST(63);
+  const vec_t vmask = V_CONST(4032);
+  vec_t x = SIMD_FUNCNAME(Ramp)(xfrac, xstep);
+  vec_t y = SIMD_FUNCNAME(Ramp)(yfrac, ystep);
+  int spot[SIMD_LANES];
+
+  while (count > 0)
+  {
+    const int n = count < SIMD_LANES ? count : SIMD_LANES;
+    int i;
+
+    V_STORE(spot, V_OR(V_AND(V_SRA(x, 16), umask), V_AND(V_SRA(y, 10), vmask)));
+    for (i = 0; i < n; i++)
+      dest[i] = pal[colormap[source[spot[i]]]*VID_NUMCOLORWEIGHTS];
+
+    x = V_ADD(x, dx);
+    y = V_ADD(y, dy);
+    dest += n;
+    count -= n;
+  }
+}
+
+// filter_getFilteredForSpan32
+static SIMD_TARGET void SIMD_FUNCNAME(SpanLinear)(unsigned int *dest, int count,
+                                                  fixed_t xfrac, fixed_t yfrac,
+                                                  fixed_t xstep, fixed_t ystep,
+                                                  const byte *source,
+                                                  const lighttable_t *colormap)
+{
+  const unsigned int *pal = V_Palette32;
+  const vec_t dx = V_CONST((unsigned)xstep * SIMD_LANES);
+  const vec_t dy = V_CONST((unsigned)ystep * SIMD_LANES);
+  const vec_t fracmask = V_CONST(0xffff);
+  const vec_t one = V_CONST(FRACUNIT);
+  const vec_t umask = V_CONST(0x3f);
+  const vec_t vmask = V_CONST(0xfc0);
+  vec_t x = SIMD_FUNCNAME(Ramp)(xfrac, xstep);
+  vec_t y = SIMD_FUNCNAME(Ramp)(yfrac, ystep);
+  int tap[4][SIMD_LANES], weight[4][SIMD_LANES];
+
+  while (count > 0)
+  {
+    const int n = count < SIMD_LANES ? count : SIMD_LANES;
+    const vec_t u = V_AND(x, fracmask);
+    const vec_t v = V_AND(y, fracmask);
+    const vec_t iu = V_SUB(fracmask, u);
+    const vec_t iv = V_SUB(fracmask, v);
+    const vec_t x0 = V_AND(V_SRA(x, 16), umask);
+    const vec_t x1 = V_AND(V_SRA(V_ADD(x, one), 16), umask);
+    const vec_t y0 = V_AND(V_SRA(y, 10), vmask);
+    const vec_t y1 = V_AND(V_SRA(V_ADD(y, one), 10), vmask);
+    int i;
+
+    V_STORE(tap[0], V_OR(x1, y1));
+    V_STORE(tap[1], V_OR(x0, y1));
+    V_STORE(tap[2], V_OR(x0, y0));
+    V_STORE(tap[3], V_OR(x1, y0));
+    V_STORE(weight[0], V_SRL(V_MUL16(u, v), 32-VID_COLORWEIGHTBITS));
+    V_STORE(weight[1], V_SRL(V_MUL16(iu, v), 32-VID_COLORWEIGHTBITS));
+    V_STORE(weight[2], V_SRL(V_MUL16(iu, iv), 32-VID_COLORWEIGHTBITS));
+    V_STORE(weight[3], V_SRL(V_MUL16(u, iv), 32-VID_COLORWEIGHTBITS));
+    for (i = 0; i < n; i++)
+      dest[i] = pal[colormap[source[tap[0][i]]]*VID_NUMCOLORWEIGHTS + weight[0][i]] +
+                pal[colormap[source[tap[1][i]]]*VID_NUMCOLORWEIGHTS + weight[1][i]] +
+                pal[colormap[source[tap[2][i]]]*VID_NUMCOLORWEIGHTS + weight[2][i]] +
+                pal[colormap[source[tap[3][i]]]*VID_NUMCOLORWEIGHTS + weight[3][i]];
+
+    x = V_ADD(x, dx);
+    y = V_ADD(y, dy);
+    dest += n;
+    count -= n;
+  }
+}
+
+// filter_getRoundedForSpan
+static SIMD_TARGET void SIMD_FUNCNAME(SpanRounded)(unsigned int *dest, int count,
+                                                   fixed_t xfrac, fixed_t yfrac,
+                                                   fixed_t xstep, fixed_t ystep,
+                                                   const byte *source,
+                                                   const lighttable_t *colormap)
+{
+  const unsigned int *pal = V_Palette32 + VID_COLORWEIGHTMASK;
+  const vec_t dx = V_CONST((unsigned)xstep * SIMD_LANES);
+  const vec_t dy = V_CONST((unsigned)ystep * SIMD_LANES);
+  const vec_t one = V_CONST(FRACUNIT);
+  const vec_t umask = V_CONST(0x3f);
+  const vec_t vmask = V_CONST(0xfc0);
+  const vec_t bytemask = V_CONST(0xff);
+  vec_t x = SIMD_FUNCNAME(Ramp)(xfrac, xstep);
+  vec_t y = SIMD_FUNCNAME(Ramp)(yfrac, ystep);
+  int tap[6][SIMD_LANES];
+
+  while (count > 0)
+  {
+    const int n = count < SIMD_LANES ? count : SIMD_LANES;
+    const vec_t x0 = V_AND(V_SRA(x, 16), umask);
+    const vec_t y0 = V_AND(V_SRA(y, 10), vmask);
+    int i;
+
+    V_STORE(tap[0], V_OR(x0, y0));                                      // e
+    V_STORE(tap[1], V_OR(x0, V_AND(V_SRA(V_SUB(y, one), 10), vmask)));  // b
+    V_STORE(tap[2], V_OR(V_AND(V_SRA(V_ADD(x, one), 16), umask), y0));  // f
+    V_STORE(tap[3], V_OR(x0, V_AND(V_SRA(V_ADD(y, one), 10), vmask)));  // h
+    V_STORE(tap[4], V_OR(V_AND(V_SRA(V_SUB(x, one), 16), umask), y0));  // d
+    V_STORE(tap[5], V_ADD(V_SLL(V_SRL(V_AND(V_SRA(x, 8), bytemask), 8-FILTER_UVBITS), FILTER_UVBITS),
+                          V_SRL(V_AND(V_SRA(y, 8), bytemask), 8-FILTER_UVBITS)));
+    for (i = 0; i < n; i++)
+      dest[i] = pal[colormap[R_Scale2xColor(source[tap[0][i]], source[tap[1][i]],
+                                            source[tap[2][i]], source[tap[3][i]],
+                                            source[tap[4][i]],
+                                            filter_roundedUVMap[tap[5][i]])]
+                    *VID_NUMCOLORWEIGHTS];
+
+    x = V_ADD(x, dx);
+    y = V_ADD(y, dy);
+    dest += n;
+    count -= n;
+  }
+}
+
+//
+// Columns
+//
+// The C loops mask frac with the texture height before using it; for the
+// unmasked texheight == 0 case mask is -1, which leaves frac alone.
+//
+
+#define GETCOL8_MAPPED(col) (translation ? translation[(col)] : (col))
+
+static SIMD_TARGET void SIMD_FUNCNAME(ColumnPoint)(unsigned int *dest, int count,
+                                                   fixed_t frac, fixed_t mask,
+                                                   const draw_column_vars_t *dcvars,
+                                                   const byte *translation,
+                                                   unsigned int fracu)
+{
+  const unsigned int *pal = V_Palette32 + VID_COLORWEIGHTMASK;
+  const byte *source = dcvars->source;
+  const lighttable_t *colormap = dcvars->colormap;
+  const vec_t vmask = V_CONST(mask);
+  const vec_t df = V_CONST((unsigned)dcvars->iscale * SIMD_LANES);
+  vec_t f = SIMD_FUNCNAME(Ramp)(frac, dcvars->iscale);
+  int texel[SIMD_LANES];
+
+  (void)fracu;
+  while (count > 0)
+  {
+    const int n = count < SIMD_LANES ? count : SIMD_LANES;
+    int i;
+
+    V_STORE(texel, V_SRA(V_AND(f, vmask), FRACBITS));
+    for (i = 0; i < n; i++)
+      dest[i << 2] = pal[colormap[GETCOL8_MAPPED(source[texel[i]])]*VID_NUMCOLORWEIGHTS];
+
+    f = V_ADD(f, df);
+    dest += n << 2;
+    count -= n;
+  }
+}
+
+// filter_getFilteredForColumn32
+static SIMD_TARGET void SIMD_FUNCNAME(ColumnLinear)(unsigned int *dest, int count,
+                                                    fixed_t frac, fixed_t mask,
+                                                    const draw_column_vars_t *dcvars,
+                                                    const byte *translation,
+                                                    unsigned int fracu)
+{
+  const unsigned int *pal = V_Palette32;
+  const byte *source = dcvars->source;
+  const byte *nextsource = dcvars->nextsource;
+  const lighttable_t *colormap = dcvars->colormap;
+  const vec_t vmask = V_CONST(mask);
+  const vec_t fracmask = V_CONST(0xffff);
+  const vec_t u = V_CONST(fracu);
+  const vec_t iu = V_CONST(0xffff - fracu);
+  const vec_t one = V_CONST(FRACUNIT);
+  const vec_t df = V_CONST((unsigned)dcvars->iscale * SIMD_LANES);
+  vec_t f = SIMD_FUNCNAME(Ramp)(frac, dcvars->iscale);
+  int texel[2][SIMD_LANES], weight[4][SIMD_LANES];
+
+  while (count > 0)
+  {
+    const int n = count < SIMD_LANES ? count : SIMD_LANES;
+    const vec_t texv = V_AND(f, vmask);
+    const vec_t v = V_AND(texv, fracmask);
+    const vec_t iv = V_SUB(fracmask, v);
+    int i;
+
+    V_STORE(texel[0], V_SRA(texv, FRACBITS));
+    V_STORE(texel[1], V_SRA(V_AND(V_ADD(f, one), vmask), FRACBITS));
+    V_STORE(weight[0], V_SRL(V_MUL16(u, v), 32-VID_COLORWEIGHTBITS));
+    V_STORE(weight[1], V_SRL(V_MUL16(iu, v), 32-VID_COLORWEIGHTBITS));
+    V_STORE(weight[2], V_SRL(V_MUL16(iu, iv), 32-VID_COLORWEIGHTBITS));
+    V_STORE(weight[3], V_SRL(V_MUL16(u, iv), 32-VID_COLORWEIGHTBITS));
+    for (i = 0; i < n; i++)
+    {
+      const int t = texel[0][i], nt = texel[1][i];
+
+      dest[i << 2] =
+        pal[colormap[GETCOL8_MAPPED(nextsource[nt])]*VID_NUMCOLORWEIGHTS + weight[0][i]] +
+        pal[colormap[GETCOL8_MAPPED(source[nt])]*VID_NUMCOLORWEIGHTS + weight[1][i]] +
+        pal[colormap[GETCOL8_MAPPED(source[t])]*VID_NUMCOLORWEIGHTS + weight[2][i]] +
+        pal[colormap[GETCOL8_MAPPED(nextsource[t])]*VID_NUMCOLORWEIGHTS + weight[3][i]];
+    }
+
+    f = V_ADD(f, df);
+    dest += n << 2;
+    count -= n;
+  }
+}
+
+// filter_getRoundedForColumn, fracu is 8 bits here
+static SIMD_TARGET void SIMD_FUNCNAME(ColumnRounded)(unsigned int *dest, int count,
+                                                     fixed_t frac, fixed_t mask,
+                                                     const draw_column_vars_t *dcvars,
+                                                     const byte *translation,
+                                                     unsigned int fracu)
+{
+  const unsigned int *pal = V_Palette32 + VID_COLORWEIGHTMASK;
+  const byte *source = dcvars->source;
+  const byte *prevsource = dcvars->prevsource;
+  const byte *nextsource = dcvars->nextsource;
+  const lighttable_t *colormap = dcvars->colormap;
+  const vec_t vmask = V_CONST(mask);
+  const vec_t one = V_CONST(FRACUNIT);
+  const vec_t urow = V_CONST((fracu>>(8-FILTER_UVBITS))<<FILTER_UVBITS);
+  const vec_t df = V_CONST((unsigned)dcvars->iscale * SIMD_LANES);
+  vec_t f = SIMD_FUNCNAME(Ramp)(frac, dcvars->iscale);
+  int tap[3][SIMD_LANES];
+
+  while (count > 0)
+  {
+    const int n = count < SIMD_LANES ? count : SIMD_LANES;
+    const vec_t texv = V_AND(f, vmask);
+    int i;
+
+    V_STORE(tap[0], V_SRA(texv, FRACBITS));
+    V_STORE(tap[1], V_SRA(V_AND(V_ADD(f, one), vmask), FRACBITS));
+    V_STORE(tap[2], V_ADD(urow, V_SRL(V_AND(V_SRA(texv, 8), V_CONST(0xff)), 8-FILTER_UVBITS)));
+    for (i = 0; i < n; i++)
+    {
+      const int t = tap[0][i];
+
+      dest[i << 2] = pal[colormap[GETCOL8_MAPPED(R_Scale2xColor(source[t], source[MAX(0, t-1)],
+                                                                nextsource[t], source[tap[1][i]],
+                                                                prevsource[t],
+                                                                filter_roundedUVMap[tap[2][i]]))]
+                         *VID_NUMCOLORWEIGHTS];
+    }
+
+    f = V_ADD(f, df);
+    dest += n << 2;
+    count -= n;
+  }
+}
+
+#undef GETCOL8_MAPPED
+#undef V_CONST
+
+#undef SIMD_FUNCNAME
+#undef SIMD_TARGET
+#undef SIMD_LANES
+#undef vec_t
+#undef V_SET1
+#undef V_LOAD
+#undef V_STORE
+#undef V_ADD
+#undef V_SUB
+#undef V_AND
+#undef V_OR
+#undef V_SRA
+#undef V_SRL
+#undef V_SLL
+#undef V_MUL16
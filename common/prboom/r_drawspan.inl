@@ -76,6 +76,15 @@
  #define GETCOL(col) GETCOL_POINT(col)
 #endif
 
+// the SIMD version of the loop below, if there is one, see r_drawsimd.c
+#if (R_DRAWSPAN_PIPELINE & RDC_BILINEAR)
+ #define R_DRAWSPAN_KERNEL drawkernels.span_linear
+#elif (R_DRAWSPAN_PIPELINE & RDC_ROUNDED)
+ #define R_DRAWSPAN_KERNEL drawkernels.span_rounded
+#else
+ #define R_DRAWSPAN_KERNEL drawkernels.span_point
+#endif
+
 static void R_DRAWSPAN_FUNCNAME(draw_span_vars_t *dsvars)
 {
 #if (R_DRAWSPAN_PIPELINE & (RDC_ROUNDED|RDC_BILINEAR))
@@ -90,63 +99,88 @@ static void R_DRAWSPAN_FUNCNAME(draw_span_vars_t *dsvars)
   }
 #endif
   {
-  unsigned count = dsvars->x2 - dsvars->x1 + 1;
-  fixed_t xfrac = dsvars->xfrac;
-  fixed_t yfrac = dsvars->yfrac;
+  // render threads: start at the first column of this thread's strip,
+  // stepped to exactly where the whole span would have been
+  const int skip = dsvars->x1 < drawstripx1 ? drawstripx1 - dsvars->x1 : 0;
+  const int last = dsvars->x2 > drawstripx2 ? drawstripx2 : dsvars->x2;
+  unsigned count = last - dsvars->x1 - skip + 1;
+  fixed_t xfrac = dsvars->xfrac + (fixed_t)((unsigned)dsvars->xstep * skip);
+  fixed_t yfrac = dsvars->yfrac + (fixed_t)((unsigned)dsvars->ystep * skip);
   const fixed_t xstep = dsvars->xstep;
   const fixed_t ystep = dsvars->ystep;
   const byte *source = dsvars->source;
   const byte *colormap = dsvars->colormap;
   (void)colormap;
-  SCREENTYPE *dest = drawvars.TOPLEFT + dsvars->y*drawvars.PITCH + dsvars->x1;
+  int x = dsvars->x1 + skip;
+  SCREENTYPE *dest;
 #if (R_DRAWSPAN_PIPELINE & (RDC_DITHERZ|RDC_BILINEAR))
   const int y = dsvars->y;
-  int x1 = dsvars->x1;
+  int x1 = dsvars->x1 - skip;
   
   (void)y;
   (void)x1;
 #endif
+  if (x > last)
+    return;
 #if (R_DRAWSPAN_PIPELINE & RDC_DITHERZ)
   const int fracz = (dsvars->z >> 12) & 255;
   const byte *dither_colormaps[2] = { dsvars->colormap, dsvars->nextcolormap };
 #endif
 
+  // a linear screen takes the whole span in one go, a tiled view one
+  // tile at a time
   while (count) {
+    unsigned run = R_TILERUN(x, (int)count);
+
+    dest = drawvars.TOPLEFT + R_VIEWOFFSET(drawvars.PITCH, x, dsvars->y);
+    x += run;
+    count -= run;
+#if ((R_DRAWSPAN_PIPELINE_BITS == 32) && !(R_DRAWSPAN_PIPELINE & RDC_DITHERZ))
+    if (R_DRAWSPAN_KERNEL) {
+      R_DRAWSPAN_KERNEL(dest, run, xfrac, yfrac, xstep, ystep, source, colormap);
+      xfrac += (fixed_t)((unsigned)xstep * run);
+      yfrac += (fixed_t)((unsigned)ystep * run);
+      continue;
+    }
+#endif
+
+    while (run) {
 #if ((R_DRAWSPAN_PIPELINE_BITS != 8) && (R_DRAWSPAN_PIPELINE & RDC_BILINEAR))
-    // truecolor bilinear filtered
-    *dest++ = GETCOL(0);
-    xfrac += xstep;
-    yfrac += ystep;
-    count--;
+      // truecolor bilinear filtered
+      *dest++ = GETCOL(0);
+      xfrac += xstep;
+      yfrac += ystep;
+      run--;
   #if (R_DRAWSPAN_PIPELINE & RDC_DITHERZ)
-    x1--;
+      x1--;
   #endif
 #elif (R_DRAWSPAN_PIPELINE & RDC_ROUNDED)
-    *dest++ = GETCOL(filter_getRoundedForSpan(xfrac, yfrac));
-    xfrac += xstep;
-    yfrac += ystep;
-    count--;
+      *dest++ = GETCOL(filter_getRoundedForSpan(xfrac, yfrac));
+      xfrac += xstep;
+      yfrac += ystep;
+      run--;
   #if (R_DRAWSPAN_PIPELINE & RDC_DITHERZ)
-    x1--;
+      x1--;
   #endif
 #else
   #if (R_DRAWSPAN_PIPELINE & RDC_BILINEAR)
-    // 8 bit bilinear
-    const fixed_t xtemp = ((xfrac >> 16) + (filter_getDitheredPixelLevel(x1, y, ((xfrac>>8)&0xff)))) & 63;
-    const fixed_t ytemp = ((yfrac >> 10) + 64*(filter_getDitheredPixelLevel(x1, y, ((yfrac>>8)&0xff)))) & 4032;
+      // 8 bit bilinear
+      const fixed_t xtemp = ((xfrac >> 16) + (filter_getDitheredPixelLevel(x1, y, ((xfrac>>8)&0xff)))) & 63;
+      const fixed_t ytemp = ((yfrac >> 10) + 64*(filter_getDitheredPixelLevel(x1, y, ((yfrac>>8)&0xff)))) & 4032;
   #else
-    const fixed_t xtemp = (xfrac >> 16) & 63;
-    const fixed_t ytemp = (yfrac >> 10) & 4032;
+      const fixed_t xtemp = (xfrac >> 16) & 63;
+      const fixed_t ytemp = (yfrac >> 10) & 4032;
   #endif
-    const fixed_t spot = xtemp | ytemp;
-    xfrac += xstep;
-    yfrac += ystep;
-    *dest++ = GETCOL(source[spot]);
-    count--;
+      const fixed_t spot = xtemp | ytemp;
+      xfrac += xstep;
+      yfrac += ystep;
+      *dest++ = GETCOL(source[spot]);
+      run--;
   #if (R_DRAWSPAN_PIPELINE & (RDC_DITHERZ|RDC_BILINEAR))
-    x1--;
+      x1--;
   #endif
 #endif
+    }
   }
   }
 }
@@ -155,6 +189,7 @@ static void R_DRAWSPAN_FUNCNAME(draw_span_vars_t *dsvars)
 #undef GETCOL_LINEAR
 #undef GETCOL_POINT
 #undef GETCOL
+#undef R_DRAWSPAN_KERNEL
 #undef PITCH
 #undef TOPLEFT
 #undef SCREENTYPE
@@ -29,6 +29,7 @@
  *-----------------------------------------------------------------------------*/
 
 #include "doomtype.h"
+#include "r_defs.h"
 #include "r_filter.h"
 
 #define DMR 16
@@ -98,8 +99,9 @@ byte *filter_getScale2xQuadColors(byte e, byte b, byte f, byte h, byte d) {
   // D E F
   // G H I
   // perform the Scale2x algorithm (quickly) to get the new quad to represent E
-  static byte quad[5];
-  static byte rowColors[3];
+  // per render thread, the caller reads the quad after we return
+  static R_THREADLOCAL byte quad[5];
+  static R_THREADLOCAL byte rowColors[3];
   int code;
   
   rowColors[0] = d;
@@ -48,16 +48,21 @@
 #include "r_plane.h"
 #include "r_bsp.h"
 #include "r_draw.h"
+#include "r_drawsimd.h"
 #include "m_bbox.h"
 #include "r_sky.h"
 #include "v_video.h"
 #include "lprintf.h"
+#include "m_profile.h"
 #include "st_stuff.h"
 #include "i_main.h"
 #include "i_system.h"
 #include "g_game.h"
 #include "r_demo.h"
 #include "r_fps.h"
+#ifdef RENDER_THREADS
+#include <pthread.h>
+#endif
 
 // Fineangles in the SCREENWIDTH wide window.
 #define FIELDOFVIEW 2048
@@ -187,8 +192,8 @@ angle_t R_PointToAngle(fixed_t x, fixed_t y)
 	// JDC: added parenthesis to force constant evaluation
     return (int)(atan2(y-viewy, x-viewx) * (ANG180/M_PI) );	
 #else
-  static fixed_t oldx, oldy;
-  static angle_t oldresult;
+  static R_THREADLOCAL fixed_t oldx, oldy;
+  static R_THREADLOCAL angle_t oldresult;
 
   x -= viewx; y -= viewy;
 
@@ -457,6 +462,8 @@ void R_Init (void)
   R_InitTranslationTables();
   lprintf(LO_INFO, "R_InitPatches ");
   R_InitPatches();
+  lprintf(LO_INFO, "R_InitDrawSIMD ");
+  R_InitDrawSIMD();
 }
 
 //
@@ -537,7 +544,7 @@ int autodetect_hom = 0;       // killough 2/7/98: HOM autodetection flag
 //
 // R_ShowStats
 //
-int rendered_visplanes, rendered_segs, rendered_vissprites;
+R_THREADLOCAL int rendered_visplanes, rendered_segs, rendered_vissprites;
 boolean rendering_stats;
 
 static void R_ShowStats(void)
@@ -578,12 +585,11 @@ static void R_ShowStats(void)
 }
 
 //
-// R_RenderView
+// R_RenderScene
 //
-void R_RenderPlayerView (player_t* player)
-{
-  R_SetupFrame (player);
 
+static void R_RenderScene(player_t *player)
+{
   // Clear buffers.
   R_ClearClipSegs ();
   R_ClearDrawSegs ();
@@ -592,21 +598,162 @@ void R_RenderPlayerView (player_t* player)
 
   rendered_segs = rendered_visplanes = 0;
 
-  // proff 11/99: clear buffers
-  gld_InitDrawScene();
-  // proff 11/99: switch to perspective mode
-  gld_StartDrawScene();
+#ifdef GL_DOOM
+  if (V_GetMode() == VID_MODEGL) {
+    // proff 11/99: clear buffers
+    gld_InitDrawScene();
+    // proff 11/99: switch to perspective mode
+    gld_StartDrawScene();
+  }
+#endif
 
   // The head node is the last node output.
-  R_RenderBSPNode (numnodes-1);
+  {
+    PROF_BEGIN(R_RenderBSPNode);
+    R_RenderBSPNode (numnodes-1);
+    PROF_END(R_RenderBSPNode);
+  }
   R_ResetColumnBuffer();
-    
-  // proff 11/99: draw the scene
-  gld_DrawScene(player);
-    
-  // proff 11/99: finishing off
-  gld_EndDrawScene();	
 
+#ifdef GL_DOOM
+  if (V_GetMode() == VID_MODEGL) {
+    // proff 11/99: draw the scene
+    gld_DrawScene(player);
+
+    // proff 11/99: finishing off
+    gld_EndDrawScene();
+  } else
+#endif
+  {
+    // the software renderer, only used by the headless benchmark build
+    R_DrawPlanes ();
+    R_DrawMasked ();
+    R_ResetColumnBuffer();
+    R_LinearizeView(drawstripx1, drawstripx2);
+  }
+}
+
+//
+// Render threads
+//
+// -renderthreads N splits the software renderer's view into N strips of
+// columns, one per thread. Every thread walks the whole frame -- BSP, walls,
+// visplanes, sprites -- with its own copy of the renderer state, but only
+// writes the pixels of its own strip (see drawstripx1 in r_draw.c). Doing
+// the same work in the same order keeps every pixel the same as with one
+// thread, seg steppers, span steps and fuzz included; the pixel work, which
+// is most of a frame at high resolutions, is what gets split. The per frame
+// buffers come from libc rather than the zone, and the patch and lump
+// caches are behind R_LockCache.
+//
+
+int render_threads = 1;
+R_THREADLOCAL int renderthread;
+
+#ifdef RENDER_THREADS
+
+#define MAXRENDERTHREADS 16
+
+static pthread_mutex_t cachelock = PTHREAD_MUTEX_INITIALIZER;
+
+void R_LockCache(void)
+{
+  pthread_mutex_lock(&cachelock);
+}
+
+void R_UnlockCache(void)
+{
+  pthread_mutex_unlock(&cachelock);
+}
+
+static pthread_mutex_t striplock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t stripwake = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t stripdone = PTHREAD_COND_INITIALIZER;
+static int stripgeneration, stripbusy, strips, stripthreads;
+static int stripfuzzpos;
+static player_t *stripplayer;
+
+static void R_RenderStrip(player_t *player, int strip, int count)
+{
+  drawstripx1 = viewwidth * strip / count;
+  drawstripx2 = viewwidth * (strip + 1) / count - 1;
+  R_RenderScene(player);
+  drawstripx1 = 0;
+  drawstripx2 = MAX_SCREENWIDTH-1;
+}
+
+static void *R_StripThread(void *arg)
+{
+  int generation = 0;
+
+  renderthread = (int)(size_t)arg;
+  pthread_mutex_lock(&striplock);
+  for (;;) {
+    while (generation == stripgeneration)
+      pthread_cond_wait(&stripwake, &striplock);
+    generation = stripgeneration;
+    if (renderthread < strips) {
+      pthread_mutex_unlock(&striplock);
+      // carry on the fuzz from where the main thread is
+      fuzzpos = stripfuzzpos;
+      R_RenderStrip(stripplayer, renderthread, strips);
+      pthread_mutex_lock(&striplock);
+      if (!--stripbusy)
+        pthread_cond_signal(&stripdone);
+    }
+  }
+  return NULL;
+}
+
+static void R_RenderStrips(player_t *player, int count)
+{
+  if (count > MAXRENDERTHREADS)
+    count = MAXRENDERTHREADS;
+
+  while (stripthreads < count-1) {
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, R_StripThread, (void *)(size_t)(stripthreads+1))) {
+      lprintf(LO_WARN, "R_RenderStrips: could not start thread %d\n", stripthreads+1);
+      break;
+    }
+    pthread_detach(thread);
+    stripthreads++;
+  }
+  if (count > stripthreads+1)
+    count = stripthreads+1;
+
+  pthread_mutex_lock(&striplock);
+  stripplayer = player;
+  stripfuzzpos = fuzzpos;
+  strips = count;
+  stripbusy = count-1;
+  stripgeneration++;
+  pthread_cond_broadcast(&stripwake);
+  pthread_mutex_unlock(&striplock);
+
+  R_RenderStrip(player, 0, count);
+
+  pthread_mutex_lock(&striplock);
+  while (stripbusy)
+    pthread_cond_wait(&stripdone, &striplock);
+  pthread_mutex_unlock(&striplock);
+}
+
+#endif
+
+//
+// R_RenderView
+//
+void R_RenderPlayerView (player_t* player)
+{
+  R_SetupFrame (player);
+
+#ifdef RENDER_THREADS
+  if (render_threads > 1 && V_GetMode() != VID_MODEGL)
+    R_RenderStrips(player, render_threads);
+  else
+#endif
+    R_RenderScene(player);
 
   if (rendering_stats) R_ShowStats();
 
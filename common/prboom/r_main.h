@@ -63,7 +63,7 @@ extern int      validcount;
 // Rendering stats
 //
 
-extern int rendered_visplanes, rendered_segs, rendered_vissprites;
+extern R_THREADLOCAL int rendered_visplanes, rendered_segs, rendered_vissprites;
 extern boolean rendering_stats;
 
 //
@@ -117,4 +117,16 @@ void R_Init(void);                           // Called by startup code.
 void R_SetViewSize(int blocks);              // Called by M_Responder.
 void R_ExecuteSetViewSize(void);             // cph - called by D_Display to complete a view resize
 
+// software renderer threads, each drawing one strip of the view
+extern int render_threads;
+extern R_THREADLOCAL int renderthread;       // 0 on the main thread
+
+#ifdef RENDER_THREADS
+void R_LockCache(void);                      // patch and lump caches
+void R_UnlockCache(void);
+#else
+#define R_LockCache()
+#define R_UnlockCache()
+#endif
+
 #endif
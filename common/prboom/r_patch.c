@@ -679,6 +679,7 @@ const rpatch_t *R_CachePatchNum(int id) {
     I_Error("createPatch: %i >= numlumps", id);
 #endif
 
+  R_LockCache();
   if (!patches[id].data)
     createPatch(id);
 
@@ -697,6 +698,7 @@ const rpatch_t *R_CachePatchNum(int id) {
 	    lumpinfo[id].name, patches[id].locks);
 #endif
 
+  R_UnlockCache();
   return &patches[id];
 }
 
@@ -708,12 +710,14 @@ void R_UnlockPatchNum(int id)
     lprintf(LO_DEBUG, "R_UnlockPatchNum: Excess unlocks on %8s (%d-%d)\n", 
 	    lumpinfo[id].name, patches[id].locks, unlocks);
 #endif
+  R_LockCache();
   patches[id].locks -= unlocks;
   /* cph - Note: must only tell z_zone to make purgeable if currently locked, 
    * else it might already have been purged
    */
   if (unlocks && !patches[id].locks)
     Z_ChangeTag(patches[id].data, PU_CACHE);
+  R_UnlockCache();
 }
 
 //---------------------------------------------------------------------------
@@ -728,6 +732,7 @@ const rpatch_t *R_CacheTextureCompositePatchNum(int id) {
     I_Error("createTextureCompositePatch: %i >= numtextures", id);
 #endif
 
+  R_LockCache();
   if (!texture_composites[id].data)
     createTextureCompositePatch(id);
 
@@ -746,6 +751,7 @@ const rpatch_t *R_CacheTextureCompositePatchNum(int id) {
 	    textures[id]->name, texture_composites[id].locks);
 #endif
 
+  R_UnlockCache();
   return &texture_composites[id];
 
 }
@@ -758,12 +764,14 @@ void R_UnlockTextureCompositePatchNum(int id)
     lprintf(LO_DEBUG, "R_UnlockTextureCompositePatchNum: Excess unlocks on %8s (%d-%d)\n", 
 	    textures[id]->name, texture_composites[id].locks, unlocks);
 #endif
+  R_LockCache();
   texture_composites[id].locks -= unlocks;
   /* cph - Note: must only tell z_zone to make purgeable if currently locked, 
    * else it might already have been purged
    */
   if (unlocks && !texture_composites[id].locks)
     Z_ChangeTag(texture_composites[id].data, PU_CACHE);
+  R_UnlockCache();
 }
 
 //---------------------------------------------------------------------------
@@ -31,10 +31,11 @@
  *       while maintaining a per column clipping list only.
  *      Moreover, the sky areas have to be determined.
  *
- * MAXVISPLANES is no longer a limit on the number of visplanes,
- * but a limit on the number of hash slots; larger numbers mean
- * better performance usually but after a point they are wasted,
- * and memory and time overheads creep in.
+ * The visplane hash starts at MINVISPLANES slots and doubles whenever
+ * a frame has more visplanes than slots, so chains stay short on
+ * detailed maps without wasting time clearing a huge table on simple
+ * ones. The visplanes themselves come from a per-thread arena that is
+ * rewound at the start of every frame.
  *
  * For more information on visplanes, see:
  *
@@ -48,6 +49,8 @@
 #include "config.h"
 #endif
 
+#include <stddef.h>
+
 #include "z_zone.h"  /* memory allocation wrappers -- killough */
 
 #include "doomstat.h"
@@ -60,47 +63,79 @@
 #include "v_video.h"
 #include "lprintf.h"
 
-#define MAXVISPLANES 128    /* must be a power of 2 */
-
-static visplane_t *visplanes[MAXVISPLANES];   // killough
-static visplane_t *freetail;                  // killough
-static visplane_t **freehead = &freetail;     // killough
-visplane_t *floorplane, *ceilingplane;
-
-// killough -- hash function for visplanes
-// Empirically verified to be fairly uniform:
-
-#define visplane_hash(picnum,lightlevel,height) \
-  ((unsigned)((picnum)*3+(lightlevel)+(height)*7) & (MAXVISPLANES-1))
+#define MINVISPLANES 256    /* must be a power of 2 */
+#define MAXVISPLANEHASH 65536
+#define PLANECHUNK 64       /* visplanes per arena block */
+
+static R_THREADLOCAL visplane_t **visplanes;   // the hash, visplanemask+1 slots
+static R_THREADLOCAL unsigned visplanemask;
+static R_THREADLOCAL int visplanewidth;   // the arena's visplanes are this wide
+R_THREADLOCAL visplane_t *floorplane, *ceilingplane;
+
+R_THREADLOCAL planestats_t planestats;
+static R_THREADLOCAL unsigned frameplanes; // visplanes made this frame
+
+// A visplane with room for top and bottom, width columns each, and the
+// pads either side of them, rounded so the next one in a block is aligned
+#define visplane_size(width) \
+  ((offsetof(visplane_t, top) + (2*(width)+4) * sizeof(unsigned int) + 15) & ~(size_t)15)
+
+// The arena: blocks of PLANECHUNK visplanes, kept from frame to frame.
+// planeblock is the block being handed out, planeblockused how much of it.
+typedef struct planeblock_s {
+  struct planeblock_s *next;
+  size_t pad;               // keep the visplanes after it 16 byte aligned
+} planeblock_t;
+
+static R_THREADLOCAL planeblock_t *planeblocks, *planeblock;
+static R_THREADLOCAL int planeblockused;
+
+#define planeblock_plane(block, i) \
+  ((visplane_t *)((byte *)((block)+1) + (i)*visplane_size(visplanewidth)))
+
+// The old killough hash, picnum*3+lightlevel+height*7, only used the low
+// bits, and heights are whole map units so most of those were zero. Fold
+// the height down and mix all of it, offsets included, then take the
+// top bits of the product.
+static unsigned visplane_hash(int picnum, int lightlevel, fixed_t height,
+                              fixed_t xoffs, fixed_t yoffs)
+{
+  unsigned h = (unsigned)height ^ ((unsigned)height >> 16);
+  h = h * 0x9e3779b1u ^ (unsigned)picnum;
+  h = h * 0x9e3779b1u ^ (unsigned)lightlevel;
+  h = h * 0x9e3779b1u ^ (unsigned)(xoffs ^ yoffs);
+  h *= 0x9e3779b1u;
+  return (h ^ (h >> 15)) & visplanemask;
+}
 
-size_t maxopenings;
-int *openings,*lastopening; // dropoff overflow
+R_THREADLOCAL size_t maxopenings;
+R_THREADLOCAL int *openings,*lastopening; // dropoff overflow
 
 // Clip values are the solid pixel bounding the range.
 //  floorclip starts out SCREENHEIGHT
 //  ceilingclip starts out -1
 
-int floorclip[MAX_SCREENWIDTH], ceilingclip[MAX_SCREENWIDTH]; // dropoff overflow
+R_THREADLOCAL int floorclip[MAX_SCREENWIDTH], ceilingclip[MAX_SCREENWIDTH]; // dropoff overflow
 
 // spanstart holds the start of a plane span; initialized to 0 at start
 
-static int spanstart[MAX_SCREENHEIGHT];                // killough 2/8/98
+static R_THREADLOCAL int spanstart[MAX_SCREENHEIGHT];  // killough 2/8/98
 
 //
 // texture mapping
 //
 
-static const lighttable_t **planezlight;
-static fixed_t planeheight;
+static R_THREADLOCAL const lighttable_t **planezlight;
+static R_THREADLOCAL fixed_t planeheight;
 
 // killough 2/8/98: make variables static
 
-static fixed_t basexscale, baseyscale;
-static fixed_t cachedheight[MAX_SCREENHEIGHT];
-static fixed_t cacheddistance[MAX_SCREENHEIGHT];
-static fixed_t cachedxstep[MAX_SCREENHEIGHT];
-static fixed_t cachedystep[MAX_SCREENHEIGHT];
-static fixed_t xoffs,yoffs;    // killough 2/28/98: flat offsets
+static R_THREADLOCAL fixed_t basexscale, baseyscale;
+static R_THREADLOCAL fixed_t cachedheight[MAX_SCREENHEIGHT];
+static R_THREADLOCAL fixed_t cacheddistance[MAX_SCREENHEIGHT];
+static R_THREADLOCAL fixed_t cachedxstep[MAX_SCREENHEIGHT];
+static R_THREADLOCAL fixed_t cachedystep[MAX_SCREENHEIGHT];
+static R_THREADLOCAL fixed_t xoffs,yoffs;    // killough 2/28/98: flat offsets
 
 fixed_t yslope[MAX_SCREENHEIGHT], distscale[MAX_SCREENWIDTH];
 
@@ -200,14 +235,42 @@ void R_ClearPlanes(void)
   for (i=0 ; i<viewwidth ; i++)
     floorclip[i] = viewheight, ceilingclip[i] = -1;
 
-  for (i=0;i<MAXVISPLANES;i++)    // new code -- killough
-    for (*freehead = visplanes[i], visplanes[i] = NULL; *freehead; )
-      freehead = &(*freehead)->next;
+  // the resolution changed, the arena's visplanes are the wrong size
+  if (visplanewidth != SCREENWIDTH)
+    {
+      while (planeblocks)
+        {
+          planeblock_t *next = planeblocks->next;
+          (free)(planeblocks);
+          planeblocks = next;
+        }
+      visplanewidth = SCREENWIDTH;
+    }
+  planeblock = planeblocks;
+  planeblockused = 0;
+
+  // the last frame had more visplanes than hash slots, double it until not
+  if (!visplanes || (frameplanes > visplanemask+1 && visplanemask+1 < MAXVISPLANEHASH))
+    {
+      unsigned slots = visplanes ? visplanemask+1 : MINVISPLANES;
+      while (slots < frameplanes && slots < MAXVISPLANEHASH)
+        slots <<= 1;
+      (free)(visplanes);
+      visplanes = (calloc)(slots, sizeof *visplanes);
+      visplanemask = slots-1;
+    }
+  else
+    memset(visplanes, 0, (visplanemask+1) * sizeof *visplanes);
+
+  if (frameplanes > planestats.planesmax)
+    planestats.planesmax = frameplanes;
+  frameplanes = 0;
+  planestats.frames++;
 
   lastopening = openings;
 
   // texture calculation
-  memset (cachedheight, 0, sizeof(cachedheight));
+  memset (cachedheight, 0, viewheight * sizeof(*cachedheight));
 
   // scale will be unit scale at SCREENWIDTH/2 distance
   basexscale = FixedDiv (viewsin,projection);
@@ -215,20 +278,63 @@ void R_ClearPlanes(void)
 }
 
 // New function, by Lee Killough
+// Takes the next visplane from the arena, adding a block when it runs out
 
 static visplane_t *new_visplane(unsigned hash)
 {
-  visplane_t *check = freetail;
-  if (!check)
-    check = calloc(1, sizeof *check);
-  else
-    if (!(freetail = freetail->next))
-      freehead = &freetail;
+  visplane_t *check;
+
+  if (!planeblock || planeblockused == PLANECHUNK)
+    {
+      planeblock_t *next = planeblock ? planeblock->next : planeblocks;
+      if (!next)
+        {
+          int i;
+          next = (malloc)(sizeof *next + PLANECHUNK*visplane_size(visplanewidth));
+          if (!next)
+            I_Error("new_visplane: out of memory for %d visplanes", frameplanes);
+          next->next = NULL;
+          for (i = 0; i < PLANECHUNK; i++)
+            {
+              check = planeblock_plane(next, i);
+              check->bottom = check->top + visplanewidth + 2;
+            }
+          if (planeblock)
+            planeblock->next = next;
+          else
+            planeblocks = next;
+        }
+      planeblock = next;
+      planeblockused = 0;
+    }
+
+  check = planeblock_plane(planeblock, planeblockused++);
   check->next = visplanes[hash];
   visplanes[hash] = check;
+  frameplanes++;
+  planestats.planes++;
   return check;
 }
 
+// top[] is only kept up to date between minx and maxx, so a visplane
+// getting wider marks its new columns empty here rather than clearing
+// all of it up front
+
+static void R_WidenPlane(visplane_t *pl, int minx, int maxx)
+{
+  if (pl->minx > pl->maxx)
+    memset(pl->top + minx, 0xff, (maxx-minx+1) * sizeof *pl->top);
+  else
+    {
+      if (minx < pl->minx)
+        memset(pl->top + minx, 0xff, (pl->minx-minx) * sizeof *pl->top);
+      if (maxx > pl->maxx)
+        memset(pl->top + pl->maxx+1, 0xff, (maxx-pl->maxx) * sizeof *pl->top);
+    }
+  pl->minx = minx;
+  pl->maxx = maxx;
+}
+
 /*
  * R_DupPlane
  *
@@ -236,17 +342,20 @@ static visplane_t *new_visplane(unsigned hash)
  */
 visplane_t *R_DupPlane(const visplane_t *pl, int start, int stop)
 {
-      unsigned hash = visplane_hash(pl->picnum, pl->lightlevel, pl->height);
+      unsigned hash = visplane_hash(pl->picnum, pl->lightlevel, pl->height,
+                                    pl->xoffs, pl->yoffs);
       visplane_t *new_pl = new_visplane(hash);
 
+      planestats.dups++;
+
       new_pl->height = pl->height;
       new_pl->picnum = pl->picnum;
       new_pl->lightlevel = pl->lightlevel;
       new_pl->xoffs = pl->xoffs;           // killough 2/28/98
       new_pl->yoffs = pl->yoffs;
-      new_pl->minx = start;
-      new_pl->maxx = stop;
-      memset(new_pl->top, 0xff, sizeof new_pl->top);
+      new_pl->minx = viewwidth;
+      new_pl->maxx = -1;
+      R_WidenPlane(new_pl, start, stop);
       return new_pl;
 }
 //
@@ -259,20 +368,27 @@ visplane_t *R_FindPlane(fixed_t height, int picnum, int lightlevel,
 {
   visplane_t *check;
   unsigned hash;                      // killough
+  unsigned chain = 0;
 
   if (picnum == skyflatnum || picnum & PL_SKYFLAT)
     height = lightlevel = 0;         // killough 7/19/98: most skies map together
 
   // New visplane algorithm uses hash table -- killough
-  hash = visplane_hash(picnum,lightlevel,height);
+  hash = visplane_hash(picnum,lightlevel,height,xoffset,yoffset);
+  planestats.lookups++;
 
   for (check=visplanes[hash]; check; check=check->next)  // killough
+  {
+    planestats.probes++;
+    if (++chain > planestats.chainmax)
+      planestats.chainmax = chain;
     if (height == check->height &&
         picnum == check->picnum &&
         lightlevel == check->lightlevel &&
         xoffset == check->xoffs &&      // killough 2/28/98: Add offset checks
         yoffset == check->yoffs)
       return check;
+  }
 
   check = new_visplane(hash);         // killough
 
@@ -284,8 +400,6 @@ visplane_t *R_FindPlane(fixed_t height, int picnum, int lightlevel,
   check->xoffs = xoffset;               // killough 2/28/98: Save offsets
   check->yoffs = yoffset;
 
-  memset (check->top, 0xff, sizeof check->top);
-
   return check;
 }
 
@@ -310,7 +424,7 @@ visplane_t *R_CheckPlane(visplane_t *pl, int start, int stop)
     ;
 
   if (x > intrh) { /* Can use existing plane; extend range */
-    pl->minx = unionl; pl->maxx = unionh;
+    R_WidenPlane(pl, unionl, unionh);
     return pl;
   } else /* Cannot use existing plane; create a new one */
     return R_DupPlane(pl,start,stop);
@@ -427,7 +541,9 @@ static void R_DoDrawPlane(visplane_t *pl)
       int stop, light;
       draw_span_vars_t dsvars;
 
+      R_LockCache();
       dsvars.source = W_CacheLumpNum(firstflat + flattranslation[pl->picnum]);
+      R_UnlockCache();
 
       xoffs = pl->xoffs;  // killough 2/28/98: Add offsets
       yoffs = pl->yoffs;
@@ -448,7 +564,9 @@ static void R_DoDrawPlane(visplane_t *pl)
          R_MakeSpans(x,pl->top[x-1],pl->bottom[x-1],
                      pl->top[x],pl->bottom[x], &dsvars);
 
+      R_LockCache();
       W_UnlockLumpNum(firstflat + flattranslation[pl->picnum]);
+      R_UnlockCache();
     }
   }
 }
@@ -460,9 +578,17 @@ static void R_DoDrawPlane(visplane_t *pl)
 
 void R_DrawPlanes (void)
 {
-  visplane_t *pl;
+  planeblock_t *block;
   int i;
-  for (i=0;i<MAXVISPLANES;i++)
-    for (pl=visplanes[i]; pl; pl=pl->next, rendered_visplanes++)
-      R_DoDrawPlane(pl);
+
+  // in the order they were made, straight from the arena
+  if (planeblock)
+    for (block = planeblocks; ; block = block->next)
+      {
+        int used = block == planeblock ? planeblockused : PLANECHUNK;
+        for (i = 0; i < used; i++, rendered_visplanes++)
+          R_DoDrawPlane(planeblock_plane(block, i));
+        if (block == planeblock)
+          break;
+      }
 }
@@ -44,11 +44,22 @@
 #define PL_SKYFLAT (0x80000000)
 
 /* Visplane related. */
-extern int *lastopening; // dropoff overflow
+extern R_THREADLOCAL int *lastopening; // dropoff overflow
 
-extern int floorclip[], ceilingclip[]; // dropoff overflow
+extern R_THREADLOCAL int floorclip[], ceilingclip[]; // dropoff overflow
 extern fixed_t yslope[], distscale[];
 
+/* Counts from the visplane hash and arena, kept per render thread */
+typedef struct {
+  unsigned frames;
+  unsigned planes, planesmax;   /* visplanes made, in all and most in a frame */
+  unsigned dups;                /* of those, split off by R_CheckPlane */
+  unsigned lookups, probes;     /* R_FindPlane calls, chain entries looked at */
+  unsigned chainmax;            /* longest chain walked */
+} planestats_t;
+
+extern R_THREADLOCAL planestats_t planestats;
+
 void R_InitPlanes(void);
 void R_ClearPlanes(void);
 void R_DrawPlanes (void);
@@ -40,6 +40,7 @@
 #include "r_plane.h"
 #include "r_things.h"
 #include "r_draw.h"
+#include "p_saveg.h"
 #include "w_wad.h"
 #include "v_video.h"
 #include "lprintf.h"
@@ -49,46 +50,46 @@
 // killough 1/6/98: replaced globals with statics where appropriate
 
 // True if any of the segs textures might be visible.
-static boolean  segtextured;
-static boolean  markfloor;      // False if the back side is the same plane.
-static boolean  markceiling;
-static boolean  maskedtexture;
-static int      toptexture;
-static int      bottomtexture;
-static int      midtexture;
+static R_THREADLOCAL boolean  segtextured;
+static R_THREADLOCAL boolean  markfloor;      // False if the back side is the same plane.
+static R_THREADLOCAL boolean  markceiling;
+static R_THREADLOCAL boolean  maskedtexture;
+static R_THREADLOCAL int      toptexture;
+static R_THREADLOCAL int      bottomtexture;
+static R_THREADLOCAL int      midtexture;
 
-static fixed_t  toptexheight, midtexheight, bottomtexheight; // cph
+static R_THREADLOCAL fixed_t  toptexheight, midtexheight, bottomtexheight; // cph
 
-angle_t         rw_normalangle; // angle to line origin
-int             rw_angle1;
-fixed_t         rw_distance;
+R_THREADLOCAL angle_t         rw_normalangle; // angle to line origin
+R_THREADLOCAL int             rw_angle1;
+R_THREADLOCAL fixed_t         rw_distance;
 
 //
 // regular wall
 //
-static int      rw_x;
-static int      rw_stopx;
-static angle_t  rw_centerangle;
-static fixed_t  rw_offset;
-static fixed_t  rw_scale;
-static fixed_t  rw_scalestep;
-static fixed_t  rw_midtexturemid;
-static fixed_t  rw_toptexturemid;
-static fixed_t  rw_bottomtexturemid;
-static int      rw_lightlevel;
-static int      worldtop;
-static int      worldbottom;
-static int      worldhigh;
-static int      worldlow;
-static fixed_t  pixhigh;
-static fixed_t  pixlow;
-static fixed_t  pixhighstep;
-static fixed_t  pixlowstep;
-static fixed_t  topfrac;
-static fixed_t  topstep;
-static fixed_t  bottomfrac;
-static fixed_t  bottomstep;
-static int      *maskedtexturecol; // dropoff overflow
+static R_THREADLOCAL int      rw_x;
+static R_THREADLOCAL int      rw_stopx;
+static R_THREADLOCAL angle_t  rw_centerangle;
+static R_THREADLOCAL fixed_t  rw_offset;
+static R_THREADLOCAL fixed_t  rw_scale;
+static R_THREADLOCAL fixed_t  rw_scalestep;
+static R_THREADLOCAL fixed_t  rw_midtexturemid;
+static R_THREADLOCAL fixed_t  rw_toptexturemid;
+static R_THREADLOCAL fixed_t  rw_bottomtexturemid;
+static R_THREADLOCAL int      rw_lightlevel;
+static R_THREADLOCAL int      worldtop;
+static R_THREADLOCAL int      worldbottom;
+static R_THREADLOCAL int      worldhigh;
+static R_THREADLOCAL int      worldlow;
+static R_THREADLOCAL fixed_t  pixhigh;
+static R_THREADLOCAL fixed_t  pixlow;
+static R_THREADLOCAL fixed_t  pixhighstep;
+static R_THREADLOCAL fixed_t  pixlowstep;
+static R_THREADLOCAL fixed_t  topfrac;
+static R_THREADLOCAL fixed_t  topstep;
+static R_THREADLOCAL fixed_t  bottomfrac;
+static R_THREADLOCAL fixed_t  bottomstep;
+static R_THREADLOCAL int      *maskedtexturecol; // dropoff overflow
 
 //
 // R_ScaleFromGlobalAngle
@@ -139,8 +140,11 @@ void R_RenderMaskedSegRange(drawseg_t *ds, int x1, int x2)
     {
       colfunc = R_GetDrawColumnFunc(RDC_PIPELINE_TRANSLUCENT, drawvars.filterwall, drawvars.filterz);
       tranmap = main_tranmap;
-      if (curline->linedef->tranlump > 0)
+      if (curline->linedef->tranlump > 0) {
+        R_LockCache();
         tranmap = W_CacheLumpNum(curline->linedef->tranlump-1);
+        R_UnlockCache();
+      }
     }
   // killough 4/11/98: end translucent 2s normal code
 
@@ -243,8 +247,11 @@ void R_RenderMaskedSegRange(drawseg_t *ds, int x1, int x2)
       }
 
   // Except for main_tranmap, mark others purgable at this point
-  if (curline->linedef->tranlump > 0 && general_translucency)
+  if (curline->linedef->tranlump > 0 && general_translucency) {
+    R_LockCache();
     W_UnlockLumpNum(curline->linedef->tranlump-1); // cph - unlock it
+    R_UnlockCache();
+  }
 
   R_UnlockTextureCompositePatchNum(texnum);
 
@@ -260,17 +267,23 @@ void R_RenderMaskedSegRange(drawseg_t *ds, int x1, int x2)
 
 #define HEIGHTBITS 12
 #define HEIGHTUNIT (1<<HEIGHTBITS)
-static int didsolidcol; /* True if at least one column was marked solid */
+static R_THREADLOCAL int didsolidcol; /* True if at least one column was marked solid */
 
 static void R_RenderSegLoop (void)
 {
-  const rpatch_t *tex_patch;
+  const rpatch_t *mid_patch, *top_patch, *bottom_patch;
   R_DrawColumn_f colfunc = R_GetDrawColumnFunc(RDC_PIPELINE_STANDARD, drawvars.filterwall, drawvars.filterz);
   draw_column_vars_t dcvars;
   fixed_t  texturecolumn = 0;   // shut up compiler warning
 
   R_SetDefaultDrawColumnVars(&dcvars);
 
+  // look the textures up once for the whole seg rather than every column,
+  // the cache is shared with the other render threads
+  mid_patch = midtexture ? R_CacheTextureCompositePatchNum(midtexture) : NULL;
+  top_patch = toptexture ? R_CacheTextureCompositePatchNum(toptexture) : NULL;
+  bottom_patch = bottomtexture ? R_CacheTextureCompositePatchNum(bottomtexture) : NULL;
+
   rendered_segs++;
   for ( ; rw_x < rw_stopx ; rw_x++)
     {
@@ -349,14 +362,11 @@ static void R_RenderSegLoop (void)
           dcvars.yl = yl;     // single sided line
           dcvars.yh = yh;
           dcvars.texturemid = rw_midtexturemid;
-          tex_patch = R_CacheTextureCompositePatchNum(midtexture);
-          dcvars.source = R_GetTextureColumn(tex_patch, texturecolumn);
-          dcvars.prevsource = R_GetTextureColumn(tex_patch, texturecolumn-1);
-          dcvars.nextsource = R_GetTextureColumn(tex_patch, texturecolumn+1);
+          dcvars.source = R_GetTextureColumn(mid_patch, texturecolumn);
+          dcvars.prevsource = R_GetTextureColumn(mid_patch, texturecolumn-1);
+          dcvars.nextsource = R_GetTextureColumn(mid_patch, texturecolumn+1);
           dcvars.texheight = midtexheight;
           colfunc (&dcvars);
-          R_UnlockTextureCompositePatchNum(midtexture);
-          tex_patch = NULL;
           ceilingclip[rw_x] = viewheight;
           floorclip[rw_x] = -1;
         }
@@ -378,14 +388,11 @@ static void R_RenderSegLoop (void)
                   dcvars.yl = yl;
                   dcvars.yh = mid;
                   dcvars.texturemid = rw_toptexturemid;
-                  tex_patch = R_CacheTextureCompositePatchNum(toptexture);
-                  dcvars.source = R_GetTextureColumn(tex_patch,texturecolumn);
-                  dcvars.prevsource = R_GetTextureColumn(tex_patch,texturecolumn-1);
-                  dcvars.nextsource = R_GetTextureColumn(tex_patch,texturecolumn+1);
+                  dcvars.source = R_GetTextureColumn(top_patch,texturecolumn);
+                  dcvars.prevsource = R_GetTextureColumn(top_patch,texturecolumn-1);
+                  dcvars.nextsource = R_GetTextureColumn(top_patch,texturecolumn+1);
                   dcvars.texheight = toptexheight;
                   colfunc (&dcvars);
-                  R_UnlockTextureCompositePatchNum(toptexture);
-                  tex_patch = NULL;
                   ceilingclip[rw_x] = mid;
                 }
               else
@@ -412,14 +419,11 @@ static void R_RenderSegLoop (void)
                   dcvars.yl = mid;
                   dcvars.yh = yh;
                   dcvars.texturemid = rw_bottomtexturemid;
-                  tex_patch = R_CacheTextureCompositePatchNum(bottomtexture);
-                  dcvars.source = R_GetTextureColumn(tex_patch, texturecolumn);
-                  dcvars.prevsource = R_GetTextureColumn(tex_patch, texturecolumn-1);
-                  dcvars.nextsource = R_GetTextureColumn(tex_patch, texturecolumn+1);
+                  dcvars.source = R_GetTextureColumn(bottom_patch, texturecolumn);
+                  dcvars.prevsource = R_GetTextureColumn(bottom_patch, texturecolumn-1);
+                  dcvars.nextsource = R_GetTextureColumn(bottom_patch, texturecolumn+1);
                   dcvars.texheight = bottomtexheight;
                   colfunc (&dcvars);
-                  R_UnlockTextureCompositePatchNum(bottomtexture);
-                  tex_patch = NULL;
                   floorclip[rw_x] = mid;
                 }
               else
@@ -447,6 +451,13 @@ static void R_RenderSegLoop (void)
       topfrac += topstep;
       bottomfrac += bottomstep;
     }
+
+  if (mid_patch)
+    R_UnlockTextureCompositePatchNum(midtexture);
+  if (top_patch)
+    R_UnlockTextureCompositePatchNum(toptexture);
+  if (bottom_patch)
+    R_UnlockTextureCompositePatchNum(bottomtexture);
 }
 
 // killough 5/2/98: move from r_main.c, made static, simplified
@@ -481,13 +492,19 @@ void R_StoreWallRange(const int start, const int stop)
     {
       unsigned pos = ds_p - drawsegs; // jff 8/9/98 fix from ZDOOM1.14a
       unsigned newmax = maxdrawsegs ? maxdrawsegs*2 : 128; // killough
-      drawsegs = realloc(drawsegs,newmax*sizeof(*drawsegs));
+      drawsegs = (realloc)(drawsegs,newmax*sizeof(*drawsegs));
       ds_p = drawsegs + pos;          // jff 8/9/98 fix from ZDOOM1.14a
       maxdrawsegs = newmax;
     }
 
-  if(curline->miniseg == false) // figgi -- skip minisegs
+  // only the main thread marks the automap, the other render threads see
+  // the same lines
+  if(curline->miniseg == false && !renderthread && // figgi -- skip minisegs
+     !(curline->linedef->flags & ML_MAPPED))
+  {
     curline->linedef->flags |= ML_MAPPED;
+    P_MarkLineDirty(curline->linedef);
+  }
 
 #ifdef GL_DOOM
   if (V_GetMode() == VID_MODEGL)
@@ -510,7 +527,11 @@ void R_StoreWallRange(const int start, const int stop)
   linedef = curline->linedef;
 
   // mark the segment as visible for auto map
-  linedef->flags |= ML_MAPPED;
+  if (!renderthread && !(linedef->flags & ML_MAPPED))
+  {
+    linedef->flags |= ML_MAPPED;
+    P_MarkLineDirty(linedef);
+  }
 
   // calculate rw_distance for scale calculation
   rw_normalangle = curline->angle + ANG90;
@@ -530,8 +551,8 @@ void R_StoreWallRange(const int start, const int stop)
   rw_stopx = stop+1;
 
   {     // killough 1/6/98, 2/1/98: remove limit on openings
-    extern int *openings; // dropoff overflow
-    extern size_t maxopenings;
+    extern R_THREADLOCAL int *openings; // dropoff overflow
+    extern R_THREADLOCAL size_t maxopenings;
     size_t pos = lastopening - openings;
     size_t need = (rw_stopx - start)*4 + pos;
     if (need > maxopenings)
@@ -543,7 +564,11 @@ void R_StoreWallRange(const int start, const int stop)
         do
           maxopenings = maxopenings ? maxopenings*2 : 16384;
         while (need > maxopenings);
-        openings = realloc(openings, maxopenings * sizeof(*openings));
+        // a new block rather than a realloc, so that the drawsegs' pointers
+        // can still be compared with the old one below
+        openings = (malloc)(maxopenings * sizeof(*openings));
+        if (pos)
+          memcpy(openings, oldopenings, pos * sizeof(*openings));
         lastopening = openings + pos;
 
       // jff 8/9/98 borrowed fix for openings from ZDOOM1.14
@@ -558,6 +583,7 @@ void R_StoreWallRange(const int start, const int stop)
           ADJUST (sprbottomclip);
         }
 #undef ADJUST
+      (free)(oldopenings);
       }
   }  // killough: end of code to remove limits on openings
 
@@ -101,13 +101,13 @@ extern player_t         *viewplayer;
 extern angle_t          clipangle;
 extern int              viewangletox[FINEANGLES/2];
 extern angle_t          xtoviewangle[MAX_SCREENWIDTH+1];  // killough 2/8/98
-extern fixed_t          rw_distance;
-extern angle_t          rw_normalangle;
+extern R_THREADLOCAL fixed_t    rw_distance;
+extern R_THREADLOCAL angle_t    rw_normalangle;
 
 // angle to line origin
-extern int              rw_angle1;
+extern R_THREADLOCAL int        rw_angle1;
 
-extern visplane_t       *floorplane;
-extern visplane_t       *ceilingplane;
+extern R_THREADLOCAL visplane_t *floorplane;
+extern R_THREADLOCAL visplane_t *ceilingplane;
 
 #endif
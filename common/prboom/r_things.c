@@ -41,6 +41,7 @@
 #include "r_fps.h"
 #include "v_video.h"
 #include "lprintf.h"
+#include "i_system.h"
 
 #define MINZ        (FRACUNIT*4)
 #define BASEYCENTER 100
@@ -264,8 +265,27 @@ static void R_InitSpriteDefs(const char * const * namelist)
 // GAME FUNCTIONS
 //
 
-static vissprite_t *vissprites, **vissprite_ptrs;  // killough
-static size_t num_vissprite, num_vissprite_alloc, num_vissprite_ptrs;
+// The vissprites come from an arena of VISSPRITECHUNK blocks, kept from
+// frame to frame and rewound by R_ClearSprites, so they never move once
+// made and growing doesn't copy the ones already there.
+
+#define VISSPRITECHUNK 256
+
+typedef struct visspriteblock_s {
+  struct visspriteblock_s *next;
+  vissprite_t sprites[VISSPRITECHUNK];
+} visspriteblock_t;
+
+static R_THREADLOCAL visspriteblock_t *visspriteblocks, *visspriteblock;
+static R_THREADLOCAL int visspriteblockused;
+
+static R_THREADLOCAL vissprite_t **vissprite_ptrs;  // killough
+static R_THREADLOCAL size_t num_vissprite, num_vissprite_ptrs;
+
+// The render threads other than the main one can't share validcount in the
+// sectors, they mark the sectors they have added sprites from in here.
+static R_THREADLOCAL int *sectormarks;
+static R_THREADLOCAL int numsectormarks;
 
 //
 // R_InitSprites
@@ -288,6 +308,15 @@ void R_InitSprites(const char * const *namelist)
 void R_ClearSprites (void)
 {
   num_vissprite = 0;            // killough
+  visspriteblock = visspriteblocks;
+  visspriteblockused = 0;
+
+  if (renderthread && numsectormarks != numsectors)
+    {
+      (free)(sectormarks);
+      sectormarks = (calloc)(numsectors, sizeof *sectormarks);
+      numsectormarks = numsectors;
+    }
 }
 
 //
@@ -296,18 +325,25 @@ void R_ClearSprites (void)
 
 static vissprite_t *R_NewVisSprite(void)
 {
-  if (num_vissprite >= num_vissprite_alloc)             // killough
+  if (!visspriteblock || visspriteblockused == VISSPRITECHUNK)
     {
-      size_t num_vissprite_alloc_prev = num_vissprite_alloc;
-
-      num_vissprite_alloc = num_vissprite_alloc ? num_vissprite_alloc*2 : 128;
-      vissprites = realloc(vissprites,num_vissprite_alloc*sizeof(*vissprites));
-      
-      //e6y: set all fields to zero
-      memset(vissprites + num_vissprite_alloc_prev, 0,
-        (num_vissprite_alloc - num_vissprite_alloc_prev)*sizeof(*vissprites));
+      visspriteblock_t *next = visspriteblock ? visspriteblock->next : visspriteblocks;
+      if (!next)
+        {
+          //e6y: set all fields to zero
+          if (!(next = (calloc)(1, sizeof *next)))
+            I_Error("R_NewVisSprite: out of memory for %u vissprites",
+                    (unsigned)num_vissprite);
+          if (visspriteblock)
+            visspriteblock->next = next;
+          else
+            visspriteblocks = next;
+        }
+      visspriteblock = next;
+      visspriteblockused = 0;
     }
- return vissprites + num_vissprite++;
+  num_vissprite++;
+  return &visspriteblock->sprites[visspriteblockused++];
 }
 
 //
@@ -317,10 +353,10 @@ static vissprite_t *R_NewVisSprite(void)
 //  in posts/runs of opaque pixels.
 //
 
-int   *mfloorclip;   // dropoff overflow
-int   *mceilingclip; // dropoff overflow
-fixed_t spryscale;
-fixed_t sprtopscreen;
+R_THREADLOCAL int   *mfloorclip;   // dropoff overflow
+R_THREADLOCAL int   *mceilingclip; // dropoff overflow
+R_THREADLOCAL fixed_t spryscale;
+R_THREADLOCAL fixed_t sprtopscreen;
 
 void R_DrawMaskedColumn(
   const rpatch_t *patch,
@@ -664,6 +700,7 @@ static void R_ProjectSprite (mobj_t* thing, int lightlevel)
 void R_AddSprites(subsector_t* subsec, int lightlevel)
 {
   sector_t* sec=subsec->sector;
+  int *mark = renderthread ? &sectormarks[sec - sectors] : &sec->validcount;
   mobj_t *thing;
 
   // BSP is traversed by subsector.
@@ -671,11 +708,11 @@ void R_AddSprites(subsector_t* subsec, int lightlevel)
   //  subsectors during BSP building.
   // Thus we check whether its already added.
 
-  if (sec->validcount == validcount)
+  if (*mark == validcount)
     return;
 
   // Well, now it will be done.
-  sec->validcount = validcount;
+  *mark = validcount;
 
   // Handle all things in sector.
 
@@ -837,151 +874,264 @@ void R_DrawPlayerSprites(void)
 // Rewritten by Lee Killough to avoid using unnecessary
 // linked lists, and to use faster sorting algorithm.
 //
+// A stable LSD radix sort, a byte at a time, on the scales flipped so
+// ascending keys put the nearest sprite first. Sprites at the same scale
+// stay in the order the BSP walk found them. A byte that is the same in
+// every key, usually the top one or two, is skipped, and short lists get
+// an insertion sort instead.
+//
 
-#ifdef DJGPP
-
-// killough 9/22/98: inlined memcpy of pointer arrays
-// CPhipps - added memory as modified
-#define bcopyp(d, s, n) asm(" cld; rep; movsl;" :: "D"(d), "S"(s), "c"(n) : "%cc", "%esi", "%edi", "%ecx", "memory")
-
-#else
-
-#define bcopyp(d, s, n) memcpy(d, s, (n) * sizeof(void *))
-
-#endif
+typedef struct {
+  unsigned key;
+  vissprite_t *vis;
+} vissort_t;
 
-// killough 9/2/98: merge sort
+static R_THREADLOCAL vissort_t *vissort_keys;
+static R_THREADLOCAL size_t num_vissort_keys;
 
-static void msort(vissprite_t **s, vissprite_t **t, int n)
+static void R_RadixSortVisSprites(vissort_t *keys, vissort_t *temp, size_t n)
 {
-  if (n >= 16)
+  size_t count[4][256];
+  vissort_t *const start = keys;
+  size_t i;
+  int pass;
+
+  if (n < 32)
     {
-      int n1 = n/2, n2 = n - n1;
-      vissprite_t **s1 = s, **s2 = s + n1, **d = t;
+      for (i = 1; i < n; i++)
+        {
+          vissort_t k = keys[i];
+          size_t j = i;
+          for (; j && keys[j-1].key > k.key; j--)
+            keys[j] = keys[j-1];
+          keys[j] = k;
+        }
+      return;
+    }
 
-      msort(s1, t, n1);
-      msort(s2, t, n2);
+  memset(count, 0, sizeof count);
+  for (i = 0; i < n; i++)
+    {
+      unsigned k = keys[i].key;
+      count[0][k & 0xff]++;
+      count[1][(k >> 8) & 0xff]++;
+      count[2][(k >> 16) & 0xff]++;
+      count[3][k >> 24]++;
+    }
 
-      while ((*s1)->scale > (*s2)->scale ?
-             (*d++ = *s1++, --n1) : (*d++ = *s2++, --n2));
+  for (pass = 0; pass < 4; pass++)
+    {
+      const int shift = pass*8;
+      size_t *c = count[pass], sum = 0;
+      vissort_t *swap;
 
-      if (n2)
-        bcopyp(d, s2, n2);
-      else
-        bcopyp(d, s1, n1);
+      if (c[(keys[0].key >> shift) & 0xff] == n)
+        continue;             // all the same in this byte
 
-      bcopyp(s, t, n);
-    }
-  else
-    {
-      int i;
-      for (i = 1; i < n; i++)
+      for (i = 0; i < 256; i++)
         {
-          vissprite_t *temp = s[i];
-          if (s[i-1]->scale < temp->scale)
-            {
-              int j = i;
-              while ((s[j] = s[j-1])->scale < temp->scale && --j);
-              s[j] = temp;
-            }
+          size_t t = c[i];
+          c[i] = sum;
+          sum += t;
         }
+      for (i = 0; i < n; i++)
+        temp[c[(keys[i].key >> shift) & 0xff]++] = keys[i];
+
+      swap = keys, keys = temp, temp = swap;
     }
+
+  if (keys != start)          // odd number of passes, copy it back
+    memcpy(temp, keys, n * sizeof *keys);
 }
 
 void R_SortVisSprites (void)
 {
   if (num_vissprite)
     {
-      int i = num_vissprite;
+      visspriteblock_t *block = visspriteblocks;
+      size_t i;
 
       // If we need to allocate more pointers for the vissprites,
       // allocate as many as were allocated for sprites -- killough
       // killough 9/22/98: allocate twice as many
 
-      if (num_vissprite_ptrs < num_vissprite*2)
+      if (num_vissprite_ptrs < num_vissprite)
         {
-          free(vissprite_ptrs);  // better than realloc -- no preserving needed
-          vissprite_ptrs = malloc((num_vissprite_ptrs = num_vissprite_alloc*2)
-                                  * sizeof *vissprite_ptrs);
+          (free)(vissprite_ptrs);  // better than realloc -- no preserving needed
+          vissprite_ptrs = (malloc)((num_vissprite_ptrs = num_vissprite*2)
+                                    * sizeof *vissprite_ptrs);
+        }
+      if (num_vissort_keys < num_vissprite*2)
+        {
+          (free)(vissort_keys);
+          vissort_keys = (malloc)((num_vissort_keys = num_vissprite*4)
+                                  * sizeof *vissort_keys);
         }
 
-      while (--i>=0)
-        vissprite_ptrs[i] = vissprites+i;
+      for (i = 0; i < num_vissprite; block = block->next)
+        {
+          int j;
+          for (j = 0; j < VISSPRITECHUNK && i < num_vissprite; j++, i++)
+            {
+              vissort_keys[i].key = ~(unsigned)block->sprites[j].scale;
+              vissort_keys[i].vis = &block->sprites[j];
+            }
+        }
 
-      // killough 9/22/98: replace qsort with merge sort, since the keys
-      // are roughly in order to begin with, due to BSP rendering.
+      R_RadixSortVisSprites(vissort_keys, vissort_keys + num_vissprite, num_vissprite);
 
-      msort(vissprite_ptrs, vissprite_ptrs + num_vissprite, num_vissprite);
+      for (i = 0; i < num_vissprite; i++)
+        vissprite_ptrs[i] = vissort_keys[i].vis;
     }
 }
 
 //
-// R_DrawSprite
+// R_BinDrawSegs
+//
+// Splits the view into at most DSBINS runs of columns and, for each, marks
+// which drawsegs could clip a sprite there: ones that touch it and have a
+// silhouette or a masked mid texture. R_DrawSprite then only looks at the
+// drawsegs marked in the runs the sprite covers, rather than all of them.
+// The marks are bits in drawseg order, so picking them out from the top
+// bit down goes through the drawsegs in the same order as the old scan.
 //
 
-static void R_DrawSprite (vissprite_t* spr)
+#define DSBINS 64
+
+static R_THREADLOCAL uint_64_t *dsbins;   // dsbinwords words a bin, word major
+static R_THREADLOCAL size_t dsbinwords, num_dsbins_alloc;
+static R_THREADLOCAL int dsbinshift, numdsbins;
+
+static void R_BinDrawSegs(void)
 {
+  const size_t n = ds_p - drawsegs;
   drawseg_t *ds;
-  int     clipbot[MAX_SCREENWIDTH]; // killough 2/8/98: // dropoff overflow
-  int     cliptop[MAX_SCREENWIDTH]; // change to MAX_*  // dropoff overflow
+
+  for (dsbinshift = 0; (viewwidth-1) >> dsbinshift >= DSBINS; dsbinshift++)
+    ;
+  numdsbins = ((viewwidth-1) >> dsbinshift) + 1;
+  dsbinwords = (n+63) / 64;
+
+  if (num_dsbins_alloc < dsbinwords*numdsbins)
+    {
+      (free)(dsbins);
+      dsbins = (malloc)((num_dsbins_alloc = dsbinwords*DSBINS*2) * sizeof *dsbins);
+    }
+  memset(dsbins, 0, dsbinwords*numdsbins * sizeof *dsbins);
+
+  for (ds = drawsegs; ds < ds_p; ds++)
+    if (ds->silhouette || ds->maskedtexturecol)
+      {
+        const size_t i = ds - drawsegs;
+        const uint_64_t bit = (uint_64_t)1 << (i & 63);
+        uint_64_t *word = dsbins + (i >> 6)*numdsbins;
+        int b;
+        for (b = ds->x1 >> dsbinshift; b <= ds->x2 >> dsbinshift; b++)
+          word[b] |= bit;
+      }
+}
+
+//
+// R_ClipSpriteToDrawSeg
+// Determines if the drawseg obscures the sprite, and clips it if it does
+//
+
+static void R_ClipSpriteToDrawSeg(const vissprite_t *spr, drawseg_t *ds,
+                                  int *clipbot, int *cliptop)
+{
   int     x;
   int     r1;
   int     r2;
   fixed_t scale;
   fixed_t lowscale;
 
-  for (x = spr->x1 ; x<=spr->x2 ; x++)
-    clipbot[x] = cliptop[x] = -2;
+  if (ds->x1 > spr->x2 || ds->x2 < spr->x1 ||
+      (!ds->silhouette && !ds->maskedtexturecol))
+    return;        // does not cover sprite
 
-  // Scan drawsegs from end to start for obscuring segs.
-  // The first drawseg that has a greater scale is the clip seg.
+  r1 = ds->x1 < spr->x1 ? spr->x1 : ds->x1;
+  r2 = ds->x2 > spr->x2 ? spr->x2 : ds->x2;
 
-  // Modified by Lee Killough:
-  // (pointer check was originally nonportable
-  // and buggy, by going past LEFT end of array):
+  if (ds->scale1 > ds->scale2)
+    {
+      lowscale = ds->scale2;
+      scale = ds->scale1;
+    }
+  else
+    {
+      lowscale = ds->scale1;
+      scale = ds->scale2;
+    }
 
-  //    for (ds=ds_p-1 ; ds >= drawsegs ; ds--)    old buggy code
+  if (scale < spr->scale || (lowscale < spr->scale &&
+                !R_PointOnSegSide (spr->gx, spr->gy, ds->curline)))
+    {
+      if (ds->maskedtexturecol)       // masked mid texture?
+        R_RenderMaskedSegRange(ds, r1, r2);
+      return;                 // seg is behind sprite
+    }
 
-  for (ds=ds_p ; ds-- > drawsegs ; )  // new -- killough
-    {      // determine if the drawseg obscures the sprite
-      if (ds->x1 > spr->x2 || ds->x2 < spr->x1 ||
-          (!ds->silhouette && !ds->maskedtexturecol))
-        continue;      // does not cover sprite
+  // clip this piece of the sprite
+  // killough 3/27/98: optimized and made much shorter
 
-      r1 = ds->x1 < spr->x1 ? spr->x1 : ds->x1;
-      r2 = ds->x2 > spr->x2 ? spr->x2 : ds->x2;
+  if (ds->silhouette&SIL_BOTTOM && spr->gz < ds->bsilheight) //bottom sil
+    for (x=r1 ; x<=r2 ; x++)
+      if (clipbot[x] == -2)
+        clipbot[x] = ds->sprbottomclip[x];
 
-      if (ds->scale1 > ds->scale2)
-        {
-          lowscale = ds->scale2;
-          scale = ds->scale1;
-        }
-      else
-        {
-          lowscale = ds->scale1;
-          scale = ds->scale2;
-        }
+  if (ds->silhouette&SIL_TOP && spr->gzt > ds->tsilheight)   // top sil
+    for (x=r1 ; x<=r2 ; x++)
+      if (cliptop[x] == -2)
+        cliptop[x] = ds->sprtopclip[x];
+}
 
-      if (scale < spr->scale || (lowscale < spr->scale &&
-                    !R_PointOnSegSide (spr->gx, spr->gy, ds->curline)))
-        {
-          if (ds->maskedtexturecol)       // masked mid texture?
-            R_RenderMaskedSegRange(ds, r1, r2);
-          continue;               // seg is behind sprite
-        }
+// the highest bit set, the last drawseg in a word
+#ifdef __GNUC__
+#define dsbin_last(w) (63 - __builtin_clzll(w))
+#else
+static int dsbin_last(uint_64_t w)
+{
+  int i = 63;
+  while (!(w >> i))
+    i--;
+  return i;
+}
+#endif
 
-      // clip this piece of the sprite
-      // killough 3/27/98: optimized and made much shorter
+//
+// R_ClipVisSprite
+//
+// Fills clipbot and cliptop, spr->x1 to spr->x2, for drawing the sprite
+//
+
+static void R_ClipVisSprite(vissprite_t *spr, int *clipbot, int *cliptop)
+{
+  const int b1 = spr->x1 >> dsbinshift, b2 = spr->x2 >> dsbinshift;
+  size_t  w;
+  int     x;
+
+  for (x = spr->x1 ; x<=spr->x2 ; x++)
+    clipbot[x] = cliptop[x] = -2;
+
+  // Scan drawsegs from end to start for obscuring segs.
+  // The first drawseg that has a greater scale is the clip seg.
+  // Only the ones R_BinDrawSegs found near the sprite are looked at.
+
+  for (w = dsbinwords ; w-- > 0 ; )
+    {
+      const uint_64_t *word = dsbins + w*numdsbins;
+      uint_64_t bits = 0;
+      int b;
 
-      if (ds->silhouette&SIL_BOTTOM && spr->gz < ds->bsilheight) //bottom sil
-        for (x=r1 ; x<=r2 ; x++)
-          if (clipbot[x] == -2)
-            clipbot[x] = ds->sprbottomclip[x];
+      for (b = b1 ; b <= b2 ; b++)
+        bits |= word[b];
 
-      if (ds->silhouette&SIL_TOP && spr->gzt > ds->tsilheight)   // top sil
-        for (x=r1 ; x<=r2 ; x++)
-          if (cliptop[x] == -2)
-            cliptop[x] = ds->sprtopclip[x];
+      while (bits)
+        {
+          const int i = dsbin_last(bits);
+          bits &= ~((uint_64_t)1 << i);
+          R_ClipSpriteToDrawSeg(spr, drawsegs + w*64 + i, clipbot, cliptop);
+        }
     }
 
   // killough 3/27/98:
@@ -1037,7 +1187,18 @@ static void R_DrawSprite (vissprite_t* spr)
     if (cliptop[x] == -2)
       cliptop[x] = -1;
   }
+}
+
+//
+// R_DrawSprite
+//
+
+static void R_DrawSprite (vissprite_t* spr)
+{
+  int     clipbot[MAX_SCREENWIDTH]; // killough 2/8/98: // dropoff overflow
+  int     cliptop[MAX_SCREENWIDTH]; // change to MAX_*  // dropoff overflow
 
+  R_ClipVisSprite(spr, clipbot, cliptop);
   mfloorclip = clipbot;
   mceilingclip = cliptop;
   R_DrawVisSprite (spr, spr->x1, spr->x2);
@@ -1053,6 +1214,7 @@ void R_DrawMasked(void)
   drawseg_t *ds;
 
   R_SortVisSprites();
+  R_BinDrawSegs();
 
   // draw all vissprites back to front
 
@@ -1077,3 +1239,244 @@ void R_DrawMasked(void)
   if (!viewangleoffset)
     R_DrawPlayerSprites ();
 }
+
+//
+// R_BenchmarkVisSprites
+//
+// -spritebench: a made up frame of numsprites sprites, their scales
+// mostly falling with a bit of noise as they would in BSP order, and
+// SPRITEBENCH_DRAWSEGS drawsegs of all widths in front of and behind them.
+// Times the merge sort R_SortVisSprites used to do against the radix sort,
+// and clipping every sprite against every drawseg against clipping it
+// against the binned ones, checking both pairs come out the same.
+//
+
+#define SPRITEBENCH_TRIALS 8      // best of
+#define SPRITEBENCH_DRAWSEGS 4096
+
+static unsigned int spritebenchseed;
+
+static int R_SpriteBenchRandom(void)
+{
+  spritebenchseed = spritebenchseed * 1664525 + 1013904223;
+  return spritebenchseed >> 8;
+}
+
+// killough 9/2/98: merge sort, as R_SortVisSprites had it
+
+static void R_SpriteBenchMergeSort(vissprite_t **s, vissprite_t **t, int n)
+{
+  if (n >= 16)
+    {
+      int n1 = n/2, n2 = n - n1;
+      vissprite_t **s1 = s, **s2 = s + n1, **d = t;
+
+      R_SpriteBenchMergeSort(s1, t, n1);
+      R_SpriteBenchMergeSort(s2, t, n2);
+
+      while ((*s1)->scale > (*s2)->scale ?
+             (*d++ = *s1++, --n1) : (*d++ = *s2++, --n2));
+
+      if (n2)
+        memcpy(d, s2, n2 * sizeof *d);
+      else
+        memcpy(d, s1, n1 * sizeof *d);
+
+      memcpy(s, t, n * sizeof *s);
+    }
+  else
+    {
+      int i;
+      for (i = 1; i < n; i++)
+        {
+          vissprite_t *temp = s[i];
+          if (s[i-1]->scale < temp->scale)
+            {
+              int j = i;
+              while ((s[j] = s[j-1])->scale < temp->scale && --j);
+              s[j] = temp;
+            }
+        }
+    }
+}
+
+void R_BenchmarkVisSprites(int numsprites)
+{
+  const int oldviewwidth = viewwidth, oldviewheight = viewheight;
+  drawseg_t *const olddrawsegs = drawsegs, *const oldds_p = ds_p;
+  static int topclip[MAX_SCREENWIDTH], bottomclip[MAX_SCREENWIDTH];
+  static int clipbot[MAX_SCREENWIDTH], cliptop[MAX_SCREENWIDTH];
+  static vertex_t verts[2];
+  static seg_t seg;
+  vissprite_t **sorted;
+  uint_64_t best[2][2] = {{0, 0}, {0, 0}};
+  unsigned int sum[2] = {0, 0};
+  uint_64_t looked[2] = {0, 0};
+  const char *problem = NULL;
+  int trial, i;
+
+  viewwidth = 1920;
+  viewheight = 1080;
+  spritebenchseed = 1;
+
+  // a wall across the view at y 0, so which side a sprite is on is
+  // whether its gy is above or below it
+  verts[0].x = -4096*FRACUNIT, verts[1].x = 4096*FRACUNIT;
+  seg.v1 = &verts[0], seg.v2 = &verts[1];
+
+  for (i = 0; i < viewwidth; i++)
+    {
+      topclip[i] = R_SpriteBenchRandom() % (viewheight/2);
+      bottomclip[i] = viewheight/2 + R_SpriteBenchRandom() % (viewheight/2);
+    }
+
+  // mostly narrow drawsegs, some wide, three quarters of them clip sprites
+  drawsegs = (malloc)(SPRITEBENCH_DRAWSEGS * sizeof *drawsegs);
+  for (ds_p = drawsegs; ds_p < drawsegs + SPRITEBENCH_DRAWSEGS; ds_p++)
+    {
+      const int width = 1 + R_SpriteBenchRandom() % (R_SpriteBenchRandom() % 8 ? 64 : viewwidth);
+      memset(ds_p, 0, sizeof *ds_p);
+      ds_p->curline = &seg;
+      ds_p->x1 = R_SpriteBenchRandom() % viewwidth;
+      ds_p->x2 = ds_p->x1 + width - 1 < viewwidth ? ds_p->x1 + width - 1 : viewwidth - 1;
+      ds_p->scale1 = FRACUNIT/64 + R_SpriteBenchRandom() % (4*FRACUNIT);
+      ds_p->scale2 = FRACUNIT/64 + R_SpriteBenchRandom() % (4*FRACUNIT);
+      ds_p->silhouette = R_SpriteBenchRandom() & SIL_BOTH;
+      ds_p->bsilheight = (R_SpriteBenchRandom() % 256 - 128) * FRACUNIT;
+      ds_p->tsilheight = (R_SpriteBenchRandom() % 256 - 128) * FRACUNIT;
+      ds_p->sprtopclip = topclip;
+      ds_p->sprbottomclip = bottomclip;
+    }
+
+  R_ClearSprites();
+  for (i = 0; i < numsprites; i++)
+    {
+      vissprite_t *vis = R_NewVisSprite();
+      const int width = 2 + R_SpriteBenchRandom() % 96;
+      vis->x1 = R_SpriteBenchRandom() % viewwidth;
+      vis->x2 = vis->x1 + width - 1 < viewwidth ? vis->x1 + width - 1 : viewwidth - 1;
+      vis->scale = 4*FRACUNIT - (fixed_t)((int_64_t)i * (4*FRACUNIT - FRACUNIT/64) / numsprites)
+        - R_SpriteBenchRandom() % (FRACUNIT/4);
+      if (vis->scale < FRACUNIT/128)
+        vis->scale = FRACUNIT/128;
+      vis->gx = (R_SpriteBenchRandom() % 8192 - 4096) * FRACUNIT;
+      vis->gy = (R_SpriteBenchRandom() % 8192 - 4096) * FRACUNIT;
+      vis->gz = (R_SpriteBenchRandom() % 256 - 128) * FRACUNIT;
+      vis->gzt = vis->gz + 56*FRACUNIT;
+      vis->heightsec = -1;
+    }
+
+  lprintf(LO_INFO, "R_BenchmarkVisSprites: %d sprites, %d drawsegs, %dx%d, best of %d\n",
+          numsprites, SPRITEBENCH_DRAWSEGS, viewwidth, viewheight, SPRITEBENCH_TRIALS);
+
+  // sort: the old merge sort, then the radix sort
+  sorted = (malloc)(numsprites * 2 * sizeof *sorted);
+  for (trial = 0; trial < SPRITEBENCH_TRIALS; trial++)
+    {
+      uint_64_t start, time;
+      visspriteblock_t *block = visspriteblocks;
+
+      for (i = 0; i < numsprites; block = block->next)
+        {
+          int j;
+          for (j = 0; j < VISSPRITECHUNK && i < numsprites; j++)
+            sorted[i++] = &block->sprites[j];
+        }
+      start = I_GetTime_US();
+      R_SpriteBenchMergeSort(sorted, sorted + numsprites, numsprites);
+      time = I_GetTime_US() - start;
+      if (!best[0][0] || time < best[0][0])
+        best[0][0] = time;
+
+      start = I_GetTime_US();
+      R_SortVisSprites();
+      time = I_GetTime_US() - start;
+      if (!best[0][1] || time < best[0][1])
+        best[0][1] = time;
+    }
+  for (i = 0; i < numsprites; i++)
+    if (sorted[i]->scale != vissprite_ptrs[i]->scale ||
+        (i && vissprite_ptrs[i]->scale > vissprite_ptrs[i-1]->scale))
+      problem = "sort order";
+
+  // clip: every drawseg, then the binned ones
+  for (trial = 0; trial < SPRITEBENCH_TRIALS; trial++)
+    {
+      int binned;
+      for (binned = 0; binned < 2; binned++)
+        {
+          const uint_64_t start = I_GetTime_US();
+          uint_64_t time;
+          unsigned int s = 0;
+
+          if (binned)
+            R_BinDrawSegs();
+          for (i = 0; i < numsprites; i++)
+            {
+              vissprite_t *spr = vissprite_ptrs[i];
+              int x;
+
+              if (binned)
+                R_ClipVisSprite(spr, clipbot, cliptop);
+              else
+                {
+                  drawseg_t *ds;
+                  for (x = spr->x1 ; x<=spr->x2 ; x++)
+                    clipbot[x] = cliptop[x] = -2;
+                  for (ds = ds_p ; ds-- > drawsegs ; )
+                    R_ClipSpriteToDrawSeg(spr, ds, clipbot, cliptop);
+                  for (x = spr->x1 ; x<=spr->x2 ; x++)
+                    {
+                      if (clipbot[x] == -2)
+                        clipbot[x] = viewheight;
+                      if (cliptop[x] == -2)
+                        cliptop[x] = -1;
+                    }
+                }
+              for (x = spr->x1 ; x<=spr->x2 ; x++)
+                s = s*31 + clipbot[x]*7 + cliptop[x];
+            }
+          time = I_GetTime_US() - start;
+          if (!best[1][binned] || time < best[1][binned])
+            best[1][binned] = time;
+          sum[binned] = s;
+        }
+    }
+  if (sum[0] != sum[1])
+    problem = "clipping";
+
+  // how many drawsegs each way looked at
+  looked[0] = (uint_64_t)numsprites * SPRITEBENCH_DRAWSEGS;
+  for (i = 0; i < numsprites; i++)
+    {
+      const vissprite_t *spr = vissprite_ptrs[i];
+      size_t w;
+      for (w = 0; w < dsbinwords; w++)
+        {
+          uint_64_t bits = 0;
+          int b;
+          for (b = spr->x1 >> dsbinshift; b <= spr->x2 >> dsbinshift; b++)
+            bits |= dsbins[w*numdsbins + b];
+          for (; bits; bits &= bits - 1)
+            looked[1]++;
+        }
+    }
+
+  lprintf(LO_INFO, "sort   merge %8.3f ms, radix  %8.3f ms, %.2fx\n",
+          best[0][0] / 1000.0, best[0][1] / 1000.0,
+          best[0][1] ? (double)best[0][0] / best[0][1] : 0.0);
+  lprintf(LO_INFO, "clip   all   %8.3f ms, binned %8.3f ms, %.2fx, %.1f -> %.1f drawsegs a sprite\n",
+          best[1][0] / 1000.0, best[1][1] / 1000.0,
+          best[1][1] ? (double)best[1][0] / best[1][1] : 0.0,
+          (double)looked[0] / numsprites, (double)looked[1] / numsprites);
+  if (problem)
+    lprintf(LO_INFO, "R_BenchmarkVisSprites: %s DIFFERS\n", problem);
+
+  (free)(sorted);
+  (free)(drawsegs);
+  drawsegs = olddrawsegs;
+  ds_p = oldds_p;
+  R_ClearSprites();
+  viewwidth = oldviewwidth;
+  viewheight = oldviewheight;
+}
@@ -47,10 +47,10 @@ extern int screenheightarray[MAX_SCREENWIDTH]; /* change to MAX_*  */ // dropoff
 
 /* Vars for R_DrawMaskedColumn */
 
-extern int     *mfloorclip;    // dropoff overflow
-extern int     *mceilingclip;  // dropoff overflow
-extern fixed_t spryscale;
-extern fixed_t sprtopscreen;
+extern R_THREADLOCAL int     *mfloorclip;    // dropoff overflow
+extern R_THREADLOCAL int     *mceilingclip;  // dropoff overflow
+extern R_THREADLOCAL fixed_t spryscale;
+extern R_THREADLOCAL fixed_t sprtopscreen;
 extern fixed_t pspritescale;
 extern fixed_t pspriteiscale;
 /* proff 11/06/98: Added for high-res */
@@ -68,5 +68,6 @@ void R_DrawPlayerSprites(void);
 void R_InitSprites(const char * const * namelist);
 void R_ClearSprites(void);
 void R_DrawMasked(void);
+void R_BenchmarkVisSprites(int numsprites);
 
 #endif
@@ -46,6 +46,7 @@
 #include "m_random.h"
 #include "w_wad.h"
 #include "lprintf.h"
+#include "m_profile.h"
 
 // when to clip out sounds
 // Does not fit the large outdoor areas.
@@ -419,6 +420,7 @@ void S_UpdateSounds(void* listener_p)
 {
   mobj_t *listener = (mobj_t*) listener_p;
   int cnum;
+  PROF_BEGIN(S_UpdateSounds);
 
   //jff 1/22/98 return if sound is not enabled
   if (!snd_card || nosfxparm)
@@ -469,6 +471,7 @@ void S_UpdateSounds(void* listener_p)
             S_StopChannel(cnum);
         }
     }
+  PROF_END(S_UpdateSounds);
 }
 
 
@@ -381,6 +381,7 @@ static void V_DrawMemPatch(int x, int y, int scrn, const rpatch_t *patch,
     drawvars.byte_pitch = screens[scrn].byte_pitch;
     drawvars.short_pitch = screens[scrn].short_pitch;
     drawvars.int_pitch = screens[scrn].int_pitch;
+    drawvars.tilestride = 0;
 
     if (!(flags & VPT_STRETCH)) {
       DX = 1 << 16;
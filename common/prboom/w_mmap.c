@@ -25,7 +25,11 @@
  *  02111-1307, USA.
  *
  * DESCRIPTION:
- *      Transparent access to data in WADs using mmap
+ *      Lump cache. WAD files are mapped read-only and lumps that can be
+ *      used in place are returned straight from the mapping; the rest,
+ *      and everything when mapping is off or fails, are read into the
+ *      zone as PU_CACHE blocks. Both kinds go through the same lock
+ *      counts, so callers don't need to know which one they got.
  *
  *-----------------------------------------------------------------------------
  */
@@ -54,13 +58,19 @@
 #include "z_zone.h"
 #include "lprintf.h"
 #include "i_system.h"
+#include "m_profile.h"
+
+// false reads every lump into the zone (-nowadmmap)
+boolean wad_mmap = true;
+wadcachestats_t wadcachestats;
 
 static struct {
-  void *cache;
+  void *cache;    // zone copy, if there is one
 #ifdef TIMEDIAG
   int locktic;
 #endif
-  int locks;
+  unsigned int locks;
+  boolean mapped;   // has been used through the mapping
 } *cachelump;
 
 #ifdef HEAPDUMP
@@ -82,7 +92,7 @@ static void W_ReportLocks(void)
   int i;
   lprintf(LO_DEBUG, "W_ReportLocks:\nLump     Size   Locks  Tics\n");
   for (i=0; i<numlumps; i++) {
-    if (cachelump[i].locks > 0)
+    if (cachelump[i].locks)
       lprintf(LO_DEBUG, "%8.8s %6u %2d   %6d\n", lumpinfo[i].name,
         W_LumpLength(i), cachelump[i].locks, gametic - cachelump[i].locktic);
   }
@@ -97,124 +107,87 @@ typedef struct {
   void   *data;
 } mmap_info_t;
 
-mmap_info_t *mapped_wad;
+static mmap_info_t *mapped_wad;
 
-void W_DoneCache(void)
+static void *W_MapWad(int wad_index)
 {
-  size_t i;
+  mmap_info_t *m = &mapped_wad[wad_index];
 
-  if (cachelump) {
-    free(cachelump);
-    cachelump = NULL;
-  }
+  m->hnd = (HANDLE)OpenFile(wadfiles[wad_index].name, &m->fileinfo, OF_READ);
+  if (m->hnd == (HANDLE)HFILE_ERROR)
+    return NULL;
+  m->hnd_map = CreateFileMapping(m->hnd, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (m->hnd_map)
+    m->data = MapViewOfFile(m->hnd_map, FILE_MAP_READ, 0, 0, 0);
+  return m->data;
+}
+
+static void W_UnmapWads(void)
+{
+  size_t i;
 
   if (!mapped_wad)
     return;
   for (i=0; i<numwadfiles; i++)
   {
     if (mapped_wad[i].data)
-    {
       UnmapViewOfFile(mapped_wad[i].data);
-      mapped_wad[i].data=NULL;
-    }
     if (mapped_wad[i].hnd_map)
-    {
       CloseHandle(mapped_wad[i].hnd_map);
-      mapped_wad[i].hnd_map=NULL;
-    }
-    if (mapped_wad[i].hnd)
-    {
+    if (mapped_wad[i].hnd && mapped_wad[i].hnd != (HANDLE)HFILE_ERROR)
       CloseHandle(mapped_wad[i].hnd);
-      mapped_wad[i].hnd=NULL;
-    }
   }
   free(mapped_wad);
+  mapped_wad = NULL;
 }
 
-void W_InitCache(void)
-{
-  // set up caching
-  cachelump = calloc(numlumps, sizeof *cachelump);
-  if (!cachelump)
-    I_Error ("W_Init: Couldn't allocate lumpcache");
+#define W_WadMapping(i) (mapped_wad ? (const byte *)mapped_wad[i].data : NULL)
 
-#ifdef TIMEDIAG
-  atexit(W_ReportLocks);
-#endif
+#else
 
-  mapped_wad = calloc(numwadfiles,sizeof(mmap_info_t));
-  memset(mapped_wad,0,sizeof(mmap_info_t)*numwadfiles);
-  {
-    int i;
-    for (i=0; i<numlumps; i++)
-    {
-      int wad_index = (int)(lumpinfo[i].wadfile-wadfiles);
+typedef struct {
+  void   *data;
+  size_t size;
+} mmap_info_t;
 
-      cachelump[i].locks = -1;
+static mmap_info_t *mapped_wad;
 
-      if (!lumpinfo[i].wadfile)
-        continue;
-#ifdef RANGECHECK
-      if ((wad_index<0)||((size_t)wad_index>=numwadfiles))
-        I_Error("W_InitCache: wad_index out of range");
-#endif
-      if (!mapped_wad[wad_index].data)
-      {
-        mapped_wad[wad_index].hnd =
-          (HANDLE)OpenFile(
-            wadfiles[wad_index].name,
-            &mapped_wad[wad_index].fileinfo,
-            OF_READ
-          );
-        if (mapped_wad[wad_index].hnd==(HANDLE)HFILE_ERROR)
-          I_Error("W_InitCache: OpenFile for memory mapping failed (LastError %i)",GetLastError());
-        mapped_wad[wad_index].hnd_map =
-          CreateFileMapping(
-            mapped_wad[wad_index].hnd,
-            NULL,
-            PAGE_READONLY,
-            0,
-            0,
-            NULL
-          );
-        if (mapped_wad[wad_index].hnd_map==NULL)
-          I_Error("W_InitCache: CreateFileMapping for memory mapping failed (LastError %i)",GetLastError());
-        mapped_wad[wad_index].data =
-          MapViewOfFile(
-            mapped_wad[wad_index].hnd_map,
-            FILE_MAP_READ,
-            0,
-            0,
-            0
-          );
-        if (mapped_wad[wad_index].hnd_map==NULL)
-          I_Error("W_InitCache: MapViewOfFile for memory mapping failed (LastError %i)",GetLastError());
-      }
-    }
-  }
+static void *W_MapWad(int wad_index)
+{
+  mmap_info_t *m = &mapped_wad[wad_index];
+  int fd = wadfiles[wad_index].handle;
+  void *data;
+
+  m->size = I_Filelength(fd);
+  data = mmap(NULL, m->size, PROT_READ, MAP_SHARED, fd, 0);
+  return m->data = (data == MAP_FAILED ? NULL : data);
 }
 
-const void* W_CacheLumpNum(int lump)
+static void W_UnmapWads(void)
 {
-  int wad_index = (int)(lumpinfo[lump].wadfile-wadfiles);
-#ifdef RANGECHECK
-  if ((wad_index<0)||((size_t)wad_index>=numwadfiles))
-    I_Error("W_CacheLumpNum: wad_index out of range");
-  if ((unsigned)lump >= (unsigned)numlumps)
-    I_Error ("W_CacheLumpNum: %i >= numlumps",lump);
-#endif
-  if (!lumpinfo[lump].wadfile)
-    return NULL;
-  return (void*)((unsigned char *)mapped_wad[wad_index].data+lumpinfo[lump].position);
+  size_t i;
+
+  if (!mapped_wad)
+    return;
+  for (i=0; i<numwadfiles; i++)
+    if (mapped_wad[i].data && munmap(mapped_wad[i].data, mapped_wad[i].size))
+      I_Error("W_DoneCache: failed to munmap");
+  free(mapped_wad);
+  mapped_wad = NULL;
 }
 
-#else
+#define W_WadMapping(i) (mapped_wad ? (const byte *)mapped_wad[i].data : NULL)
 
-void ** mapped_wad;
+#endif
 
+/* W_InitCache
+ *
+ * cph 2001/07/07 - split from W_Init
+ */
 void W_InitCache(void)
 {
-  int maxfd = 0;
+  size_t i;
+
   // set up caching
   cachelump = calloc(numlumps, sizeof *cachelump);
   if (!cachelump)
@@ -224,111 +197,185 @@ void W_InitCache(void)
   atexit(W_ReportLocks);
 #endif
 
-  {
-    int i;
-    for (i=0; i<numlumps; i++)
-      if (lumpinfo[i].wadfile)
-        if (lumpinfo[i].wadfile->handle > maxfd) maxfd = lumpinfo[i].wadfile->handle;
-  }
-  mapped_wad = calloc(maxfd+1,sizeof *mapped_wad);
-  {
-    int i;
-    for (i=0; i<numlumps; i++) {
-      cachelump[i].locks = -1;
-      if (lumpinfo[i].wadfile) {
-        int fd = lumpinfo[i].wadfile->handle;
-        if (!mapped_wad[fd])
-          if ((mapped_wad[fd] = mmap(NULL,I_Filelength(fd),PROT_READ,MAP_SHARED,fd,0)) == MAP_FAILED) 
-            I_Error("W_InitCache: failed to mmap");
-      }
-    }
-  }
+  memset(&wadcachestats, 0, sizeof wadcachestats);
+  mapped_wad = calloc(numwadfiles, sizeof *mapped_wad);
+  if (!mapped_wad)
+    return;
+  // a wad that won't map is simply read, like with -nowadmmap
+  for (i=0; i<numwadfiles; i++)
+    if (wadfiles[i].handle > 0 && !W_MapWad(i))
+      lprintf(LO_WARN, "W_InitCache: couldn't map %s, reading it instead\n",
+              wadfiles[i].name);
 }
 
 void W_DoneCache(void)
 {
-  {
-    int i;
-    for (i=0; i<numlumps; i++)
-      if (lumpinfo[i].wadfile) {
-        int fd = lumpinfo[i].wadfile->handle;
-        if (mapped_wad[fd]) {
-          if (munmap(mapped_wad[fd],I_Filelength(fd))) 
-            I_Error("W_DoneCache: failed to munmap");
-          mapped_wad[fd] = NULL;
-        }
-      }
+  W_UnmapWads();
+  if (cachelump) {
+    free(cachelump);
+    cachelump = NULL;
   }
-  free(mapped_wad);
 }
 
-const void* W_CacheLumpNum(int lump)
+/* W_MappedLump
+ *
+ * Where the lump is in the mapping, or NULL if it has to be read into the
+ * zone: mapping is off, the wad isn't mapped, or the lump isn't 4 byte
+ * aligned in the file. The renderer reads ints and fixed_t straight out
+ * of patches, nodes and the blockmap, so an unaligned lump gets a copy.
+ */
+static const void *W_MappedLump(int lump)
 {
-#ifdef RANGECHECK
-  if ((unsigned)lump >= (unsigned)numlumps)
-    I_Error ("W_CacheLumpNum: %i >= numlumps",lump);
-#endif
-//	printf( "W_CacheLumpNum( %i ) = %s\n", lump, lumpinfo[lump].name );	// JDC tracking hitches
-  if (!lumpinfo[lump].wadfile)
+  const lumpinfo_t *l = &lumpinfo[lump];
+  const byte *base;
+
+  if (!wad_mmap || !l->wadfile || (l->position & 3))
     return NULL;
-  return ((unsigned char*)mapped_wad[lumpinfo[lump].wadfile->handle]+lumpinfo[lump].position);
+  base = W_WadMapping(l->wadfile - wadfiles);
+  return base ? base + l->position : NULL;
 }
-#endif
 
-/*
- * W_LockLumpNum
- *
- * This copies the lump into a malloced memory region and returns its address
- * instead of returning a pointer into the memory mapped area
+/* W_ZoneLump
  *
+ * Reads the lump into the zone if it isn't there already.
  */
-const void* W_LockLumpNum(int lump)
+static void *W_ZoneLump(int lump)
 {
-  size_t len = W_LumpLength(lump);
-  const void *data = W_CacheLumpNum(lump);
-
   if (!cachelump[lump].cache) {
-    // read the lump in
-    Z_Malloc(len, PU_CACHE, &cachelump[lump].cache);
-    memcpy(cachelump[lump].cache, data, len);
+    int len = W_LumpLength(lump);
+
+    W_ReadLump(lump, Z_Malloc(len, PU_CACHE, &cachelump[lump].cache));
+    wadcachestats.lumpscopied++;
+    wadcachestats.bytescopied += len;
   }
+  return cachelump[lump].cache;
+}
 
+static void W_AddLock(int lump, boolean zone)
+{
   /* cph - if wasn't locked but now is, tell z_zone to hold it */
-  if (cachelump[lump].locks <= 0) {
-    Z_ChangeTag(cachelump[lump].cache,PU_STATIC);
+  if (!cachelump[lump].locks) {
 #ifdef TIMEDIAG
     cachelump[lump].locktic = gametic;
 #endif
-    // reset lock counter
-    cachelump[lump].locks = 1;
-  } else {
-    // increment lock counter
-    cachelump[lump].locks += 1;
+    if (cachelump[lump].cache)
+      Z_ChangeTag(cachelump[lump].cache,PU_STATIC);
+  } else if (zone) {
+    // the copy may be new, and locked through the mapping until now
+    Z_ChangeTag(cachelump[lump].cache,PU_STATIC);
   }
+  cachelump[lump].locks++;
 
 #ifdef SIMPLECHECKS
   if (!((cachelump[lump].locks+1) & 0xf))
     lprintf(LO_DEBUG, "W_CacheLumpNum: High lock on %8s (%d)\n",
       lumpinfo[lump].name, cachelump[lump].locks);
 #endif
+}
+
+/* W_CacheLumpNum
+ * killough 4/25/98: simplified
+ * CPhipps - modified for new lump locking scheme
+ *           returns a const*
+ */
+
+const void *W_CacheLumpNum(int lump)
+{
+  const void *data;
+  PROF_BEGIN(W_CacheLumpNum);
+#ifdef RANGECHECK
+  if ((unsigned)lump >= (unsigned)numlumps)
+    I_Error ("W_CacheLumpNum: %i >= numlumps",lump);
+#endif
+
+  if ((data = W_MappedLump(lump)) != NULL) {
+    if (!cachelump[lump].mapped) {
+      cachelump[lump].mapped = true;
+      wadcachestats.lumpsmapped++;
+      wadcachestats.bytesmapped += W_LumpLength(lump);
+    }
+    W_AddLock(lump, false);
+  } else {
+    data = W_ZoneLump(lump);
+    W_AddLock(lump, true);
+  }
+
+  PROF_END(W_CacheLumpNum);
+  return data;
+}
 
+/*
+ * W_LockLumpNum
+ *
+ * Like W_CacheLumpNum, but the data is always a zone copy, never a pointer
+ * into the mapping: for code like the SDL mixer that can't take a page
+ * fault at the wrong moment.
+ */
+const void *W_LockLumpNum(int lump)
+{
+#ifdef RANGECHECK
+  if ((unsigned)lump >= (unsigned)numlumps)
+    I_Error ("W_LockLumpNum: %i >= numlumps",lump);
+#endif
+  W_ZoneLump(lump);
+  W_AddLock(lump, true);
   return cachelump[lump].cache;
 }
 
-void W_UnlockLumpNum(int lump) {
-  if (cachelump[lump].locks == -1)
-    return; // this lump is memory mapped
+/*
+ * W_UnlockLumpNum
+ *
+ * CPhipps - this changes (should reduce) the number of locks on a lump
+ */
 
+void W_UnlockLumpNum(int lump)
+{
 #ifdef SIMPLECHECKS
-  if (cachelump[lump].locks == 0)
+  if (!cachelump[lump].locks) {
     lprintf(LO_DEBUG, "W_UnlockLumpNum: Excess unlocks on %8s\n",
       lumpinfo[lump].name);
+    return;
+  }
 #endif
-  cachelump[lump].locks -= 1;
+  cachelump[lump].locks--;
   /* cph - Note: must only tell z_zone to make purgeable if currently locked,
    * else it might already have been purged
    */
-  if (cachelump[lump].locks == 0)
+  if (!cachelump[lump].locks && cachelump[lump].cache)
     Z_ChangeTag(cachelump[lump].cache, PU_CACHE);
 }
 
+/*
+ * W_FlushCache
+ *
+ * Drops every zone copy that isn't locked, so the next use of each lump
+ * starts cold again. For the load benchmark.
+ */
+void W_FlushCache(void)
+{
+  int i;
+
+  Z_FreeTags(PU_CACHE, PU_CACHE);
+  for (i=0; i<numlumps; i++)
+    if (!cachelump[i].locks)
+      cachelump[i].mapped = false;
+}
+
+/*
+ * W_CacheUsage
+ *
+ * Bytes of lumps held in the zone right now, and bytes of lumps in use
+ * through the mapping (which the OS can drop and page back in).
+ */
+void W_CacheUsage(size_t *zone, size_t *mapped)
+{
+  int i;
+
+  *zone = *mapped = 0;
+  for (i=0; i<numlumps; i++) {
+    if (cachelump[i].cache)
+      *zone += W_LumpLength(i);
+    if (cachelump[i].mapped)
+      *mapped += W_LumpLength(i);
+  }
+}
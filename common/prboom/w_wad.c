@@ -476,3 +476,24 @@ void W_ReadLump(int lump, void *dest)
     }
 }
 
+//
+// W_PrefetchLump
+// Reads the lump through a scratch buffer and throws it away, to get it
+//  into the OS cache. Uses pread, so it can run on another thread while
+//  W_ReadLump is seeking the same handle.
+//
+
+void W_PrefetchLump(int lump, void *buffer, size_t size)
+{
+  const lumpinfo_t *l = lumpinfo + lump;
+  size_t done;
+
+  if (lump < 0 || lump >= numlumps || !l->wadfile)
+    return;
+  for (done = 0; done < (size_t)l->size; done += size)
+    if (pread(l->wadfile->handle, buffer,
+              l->size - done < size ? l->size - done : size,
+              l->position + done) <= 0)
+      break;
+}
+
@@ -35,6 +35,7 @@
 #ifndef __W_WAD__
 #define __W_WAD__
 
+#include "doomtype.h"
 
 //
 // TYPES
@@ -87,6 +88,22 @@ void W_Init(void); // CPhipps - uses the above array
 void W_ReleaseAllWads(void); // Proff - Added for iwad switching
 void W_InitCache(void);
 void W_DoneCache(void);
+void W_FlushCache(void);
+void W_CacheUsage(size_t *zone, size_t *mapped);
+
+// Lumps come straight from the mapped wad where they can; otherwise, and
+// for all of them when wad_mmap is false, they are read into the zone.
+extern boolean wad_mmap;
+
+typedef struct
+{
+  int    lumpscopied;   // reads into the zone
+  size_t bytescopied;
+  int    lumpsmapped;   // lumps first used through the mapping
+  size_t bytesmapped;
+} wadcachestats_t;
+
+extern wadcachestats_t wadcachestats;
 
 typedef struct
 {
@@ -123,6 +140,7 @@ int     (W_CheckNumForName)(const char* name, int);   // killough 4/17/98
 int     W_GetNumForName (const char* name);
 int     W_LumpLength (int lump);
 void    W_ReadLump (int lump, void *dest);
+void    W_PrefetchLump (int lump, void *buffer, size_t size);
 // CPhipps - modified for 'new' lump locking
 const void* W_CacheLumpNum (int lump);
 const void* W_LockLumpNum(int lump);
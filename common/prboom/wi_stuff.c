@@ -43,6 +43,7 @@
 #include "sounds.h"
 #include "lprintf.h"  // jff 08/03/98 - declaration of lprintf
 #include "r_draw.h"
+#include "p_setup.h"
 
 // Ty 03/17/98: flag that new par times have been loaded in d_deh
 extern boolean deh_pars;
@@ -2004,6 +2005,9 @@ void WI_Start(wbstartstruct_t* wbstartstruct)
   WI_initVariables(wbstartstruct);
   WI_loadData();
 
+  // start reading the next map while the stats count up
+  P_PrefetchLevel(wbs->epsd+1, wbs->next+1);
+
   if (deathmatch)
     WI_initDeathmatchStats();
   else if (netgame)
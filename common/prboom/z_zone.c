@@ -202,7 +202,7 @@ void Z_DumpMemory(void)
         fprintf(fp, "malloc %s:%d:%d", block->file, block->line, block->size);
         total_malloc += block->size;
         if (block->file)
-          if (strstr(block->file,"w_memcache.c"))
+          if (strstr(block->file,"w_mmap.c"))
             W_PrintLump(fp, (char*)block + HEADER_SIZE);
         fputc('\n', fp);
         break;